@@ -119,10 +119,12 @@ const a3_spot_shadow_shaders = [
 
 const a3_sphere_shadow_shaders = [
 	maek.GLSLC('./src/shaders/A3/A3-sphere-shadow.vert'),
+	maek.GLSLC('./src/shaders/A3/A3-sphere-shadow-layered.vert'),
 ];
 
 const a3_sun_shadow_shaders = [
 	maek.GLSLC('./src/shaders/A3/A3-sun-shadow.vert'),
+	maek.GLSLC('./src/shaders/A3/A3-sun-shadow-layered.vert'),
 ];
 
 const a3_tiled_lighting_compute_shaders = ENABLE_TILED_LIGHTING
@@ -131,6 +133,14 @@ const a3_tiled_lighting_compute_shaders = ENABLE_TILED_LIGHTING
 	]
 	: [];
 
+const a3_cull_compute_shaders = [
+	maek.GLSLC('./src/shaders/A3/A3-cull.comp'),
+];
+
+const a3_hiz_compute_shaders = [
+	maek.GLSLC('./src/shaders/A3/A3-hiz.comp'),
+];
+
 const a3_cascade_debug_shaders = [
 	maek.GLSLC('./src/shaders/A3/A3-cascade-debug-lambertian.frag'),
 	maek.GLSLC('./src/shaders/A3/A3-cascade-debug-pbr.frag'),
@@ -243,10 +253,12 @@ const deferred_spot_shadow_shaders = [
 
 const deferred_sphere_shadow_shaders = [
 	maek.GLSLC('./src/shaders/Deferred/Deferred-sphere-shadow.vert'),
+	maek.GLSLC('./src/shaders/Deferred/Deferred-sphere-shadow-layered.vert'),
 ];
 
 const deferred_sun_shadow_shaders = [
 	maek.GLSLC('./src/shaders/Deferred/Deferred-sun-shadow.vert'),
+	maek.GLSLC('./src/shaders/Deferred/Deferred-sun-shadow-layered.vert'),
 ];
 
 const deferred_tiled_lighting_compute_shaders = [
@@ -258,6 +270,14 @@ const deferred_tonemap_shaders = [
 	maek.GLSLC('./src/shaders/Deferred/Deferred-tonemap.frag'),
 ];
 
+const deferred_cull_compute_shaders = [
+	maek.GLSLC('./src/shaders/Deferred/Deferred-cull.comp'),
+];
+
+const deferred_hiz_compute_shaders = [
+	maek.GLSLC('./src/shaders/Deferred/Deferred-hiz.comp'),
+];
+
 const deferred_write_shaders = [
 	maek.GLSLC('./src/shaders/Deferred/Deferred-write.vert'),
 	maek.GLSLC('./src/shaders/Deferred/Deferred-write.frag'),
@@ -296,6 +316,8 @@ const common_objs = [
 	maek.CPP('./src/core/A3/A3SphereShadowPipeline.cpp', undefined, { depends: [...a3_sphere_shadow_shaders] }),
 	maek.CPP('./src/core/A3/A3SunShadowPipeline.cpp', undefined, { depends: [...a3_sun_shadow_shaders, ...a3_cascade_debug_shaders] }),
 	maek.CPP('./src/core/A3/A3TiledLightingComputePipeline.cpp', undefined, { depends: [...a3_tiled_lighting_compute_shaders] }),
+	maek.CPP('./src/core/A3/A3CullComputePipeline.cpp', undefined, { depends: [...a3_cull_compute_shaders] }),
+	maek.CPP('./src/core/A3/A3HiZComputePipeline.cpp', undefined, { depends: [...a3_hiz_compute_shaders] }),
 	maek.CPP('./src/core/A3/A3ToneMappingPipeline.cpp', undefined, { depends: [...a3_tonemap_shaders] }),
 	// Deferred files
 	maek.CPP('./src/core/Deferred/Deferred.cpp'),
@@ -306,6 +328,8 @@ const common_objs = [
 	maek.CPP('./src/core/Deferred/DeferredSphereShadowPipeline.cpp', undefined, { depends: [...deferred_sphere_shadow_shaders] }),
 	maek.CPP('./src/core/Deferred/DeferredSunShadowPipeline.cpp', undefined, { depends: [...deferred_sun_shadow_shaders ] }),
 	maek.CPP('./src/core/Deferred/DeferredTiledLightingComputePipeline.cpp', undefined, { depends: [...deferred_tiled_lighting_compute_shaders] }),
+	maek.CPP('./src/core/Deferred/DeferredCullComputePipeline.cpp', undefined, { depends: [...deferred_cull_compute_shaders] }),
+	maek.CPP('./src/core/Deferred/DeferredHiZComputePipeline.cpp', undefined, { depends: [...deferred_hiz_compute_shaders] }),
 	maek.CPP('./src/core/Deferred/DeferredToneMappingPipeline.cpp', undefined, { depends: [...deferred_tonemap_shaders] }),
 	// SSAO files
 	maek.CPP('./src/core/SSAO/SSAO.cpp'),
@@ -336,13 +360,23 @@ const common_objs = [
 	// utility files
 	maek.CPP('./src/utils/general/SceneTree.cpp'),
 	maek.CPP('./src/utils/general/sejp.cpp'),
+	maek.CPP('./src/utils/general/MappedFile.cpp'),
+	maek.CPP('./src/utils/general/JobSystem.cpp'),
+	maek.CPP('./src/utils/general/BVH.cpp'),
+	maek.CPP('./src/utils/general/SoftwareOcclusion.cpp'),
+	maek.CPP('./src/utils/general/VisibilityCache.cpp'),
+	maek.CPP('./src/utils/general/DrawSort.cpp'),
+	maek.CPP('./src/utils/general/ShadowCache.cpp'),
+	maek.CPP('./src/utils/general/ShadowAtlas.cpp'),
 	maek.CPP('./src/utils/loader/S72Loader.cpp'),
+	maek.CPP('./src/utils/loader/S72Binary.cpp'),
 	maek.CPP('./src/utils/loader/Texture2DLoader.cpp'),
 	maek.CPP('./src/utils/loader/TextureCubeLoader.cpp'),
 	maek.CPP('./src/utils/manager/CameraManager.cpp'),
 	maek.CPP('./src/utils/manager/buffer/RenderTarget.cpp'),
 	maek.CPP('./src/utils/manager/buffer/HDRBufferManager.cpp'),
 	maek.CPP('./src/utils/manager/buffer/GBufferManager.cpp'),
+	maek.CPP('./src/utils/manager/buffer/HiZBufferManager.cpp'),
 	maek.CPP('./src/utils/manager/LightsManager.cpp'),
 	maek.CPP('./src/utils/manager/QueryPoolManager.cpp'),
 	maek.CPP('./src/utils/manager/RenderPassManager.cpp'),
@@ -357,13 +391,40 @@ const common_objs = [
 
 const main_obj = maek.CPP('./src/main.cpp');
 const cube_obj = maek.CPP('./src/cube.cpp');
+const bench_objs = [
+	maek.CPP('./src/bench.cpp'),
+	maek.CPP('./src/bench/loading.cpp'),
+	maek.CPP('./src/bench/scene.cpp'),
+	maek.CPP('./src/bench/culling.cpp'),
+	maek.CPP('./src/bench/shadows.cpp'),
+	maek.CPP('./src/bench/draws.cpp'),
+];
+const s72cook_obj = maek.CPP('./src/s72cook.cpp');
 
 const main_exe = maek.LINK([...common_objs, main_obj], 'bin/main');
 const cube_exe = maek.LINK([...common_objs, cube_obj], 'bin/cube');
+const bench_exe = maek.LINK([...common_objs, ...bench_objs], 'bin/bench');
+const s72cook_exe = maek.LINK([...common_objs, s72cook_obj], 'bin/s72cook');
 
 
 //default targets:
-maek.TARGETS = [main_exe, cube_exe];
+maek.TARGETS = [main_exe, cube_exe, bench_exe, s72cook_exe];
+
+//':cook' cooks every example scene into a binary '.s72b' next to it (loaded in place of the '.s72' while up to date):
+{
+	const fs = require('fs');
+	const scene_dir = './external/s72/examples';
+	const cooked = [];
+	if (fs.existsSync(scene_dir)) {
+		for (const file of fs.readdirSync(scene_dir).sort()) {
+			if (file.endsWith('.s72')) cooked.push(maek.COOK(`${scene_dir}/${file}`, s72cook_exe));
+		}
+	}
+	const task = async () => { };
+	task.depends = cooked;
+	task.label = 'COOK scenes';
+	maek.tasks[':cook'] = task;
+}
 
 //- - - - - - - - - - - - - - - - - - - - -
 function custom_flags_and_rules() {
@@ -399,6 +460,7 @@ function custom_flags_and_rules() {
 			`-L${VULKAN_SDK}/lib`,
 			`-L${GLFW_DIR}/lib`,
 			'-lX11',
+			'-pthread',
 			`-lvulkan`,
 			`-lglfw3`,
 			`pre/${maek.OS}-${process.arch}/refsol.o`
@@ -587,6 +649,55 @@ function custom_flags_and_rules() {
 
 		return spirvFile;
 	};
+
+	//maek.COOK is a rule to turn a .s72 scene into a cooked .s72b (using the s72cook executable):
+	// s72File is the scene to cook; the output is written next to it
+	// cookerExe is the (built) s72cook executable
+	maek.COOK = (s72File, cookerExe) => {
+		const path = require('path').posix; //NOTE: expect posix-style paths even on windows
+		const fsPromises = require('fs').promises;
+
+		const s72bFile = s72File + 'b';
+		//NOTE: absolute path, since maek.run looks up relative commands in PATH
+		const command = [require('path').resolve(cookerExe), s72File, s72bFile];
+
+		//The actual build task:
+		const task = async () => {
+			await maek.run(command, `${task.label}`,
+				async () => {
+					//mesh data also goes into the cooked file (as bounding boxes), so re-cook when it changes:
+					const read = [s72File];
+					try {
+						const scene = JSON.parse(await fsPromises.readFile(s72File, 'utf8'));
+						const srcs = new Set();
+						for (const obj of scene.slice(1)) {
+							if (obj.type !== 'MESH') continue;
+							if (obj.indices) srcs.add(obj.indices.src);
+							for (const name in (obj.attributes || {})) srcs.add(obj.attributes[name].src);
+						}
+						for (const src of srcs) read.push(path.join(path.dirname(s72File), src));
+					} catch (e) {
+						//(the cooker already reported any problem with the scene)
+					}
+					return {
+						read: read,
+						written: [s72bFile]
+					};
+				}
+			);
+		};
+
+		task.depends = [s72File, cookerExe];
+
+		task.label = `COOK ${s72bFile}`;
+
+		if (s72bFile in maek.tasks) {
+			throw new Error(`Task ${task.label} purports to create ${s72bFile}, but ${maek.tasks[s72bFile].label} already creates that file.`);
+		}
+		maek.tasks[s72bFile] = task;
+
+		return s72bFile;
+	};
 }
 
 //======================================================================
@@ -0,0 +1,143 @@
+"""Run bin/main headless with validation layers on for every culling, shadow and recording flag combination.
+
+A run fails if it exits non-zero or the validation layers report an error or warning. Some pairs of runs
+must also draw identical frames (--threads 1 against 4 threads, --layered-shadows against one pass per
+face and cascade); those compare the last frame each saved.
+
+Usage (from the repository root, after `node Maekfile.js`):
+    python scripts/validate_flags.py --scene <scene.s72> [--frames 8] [--physical-device <name>]
+
+On a machine without a GPU, point the loader at lavapipe first, e.g.
+    VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json python scripts/validate_flags.py ...
+
+The scene should have shadowed sun, sphere and spot lights. main.cpp picks the application (A3 by default);
+build it with Deferred instead to validate that path.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+from pathlib import Path
+
+
+COMBINATIONS = {
+    "default": [],
+    "gpu-culling": ["--gpu-culling"],
+    "occlusion-last-frame": ["--occlusion-culling", "last-frame"],
+    "occlusion-two-phase": ["--occlusion-culling", "two-phase"],
+    "occlusion-two-phase-reverse-z": ["--occlusion-culling", "two-phase", "--reverse-z"],
+    "software-occlusion": ["--software-occlusion", "16"],
+    "visibility-cache": ["--visibility-cache", "0.5", "5"],
+    "shadow-cache-static": ["--shadow-cache", "static"],
+    "shadow-cache-split": ["--shadow-cache", "split"],
+    "shadow-atlas": ["--shadow-atlas", "2048", "4"],
+    "shadow-atlas-unlimited": ["--shadow-atlas", "2048", "0"],
+    "shadow-atlas-cache-static": ["--shadow-atlas", "2048", "4", "--shadow-cache", "static"],
+    "layered-shadows": ["--layered-shadows"],
+    "layered-shadows-cache-static": ["--layered-shadows", "--shadow-cache", "static"],
+    "layered-shadows-atlas": ["--layered-shadows", "--shadow-atlas", "2048", "0"],
+    "threads-1": ["--threads", "1"],
+    "threads-4": ["--threads", "4"],
+    "threads-4-gpu-culling": ["--threads", "4", "--gpu-culling"],
+    "threads-4-layered-shadows": ["--threads", "4", "--layered-shadows"],
+}
+
+# runs whose last frames must match exactly:
+SAME_IMAGE = [
+    ("threads-1", "threads-4"),
+    ("default", "layered-shadows"),
+    ("shadow-atlas-unlimited", "layered-shadows-atlas"),
+]
+
+ANSI_PATTERN = re.compile(r"\x1b\[[0-9;]*m")
+MESSAGE_PATTERN = re.compile(r"^(E|w): ")
+PPM_HEADER_PATTERN = re.compile(rb"P6\s+(\d+)\s+(\d+)\s+255\s")
+
+
+def read_ppm(path: Path):
+    data = path.read_bytes()
+    header = PPM_HEADER_PATTERN.match(data)
+    if header is None:
+        raise ValueError(f"{path} is not a binary PPM.")
+    width, height = int(header.group(1)), int(header.group(2))
+    return width, height, data[header.end() : header.end() + width * height * 3]
+
+
+def run_combination(args, name: str, flags, out_dir: Path):
+    image = out_dir / f"{name}.ppm"
+    image.unlink(missing_ok=True)
+    events = "".join(f"AVAILABLE {1.0 / 60.0:.6f}\n" for _ in range(args.frames - 1))
+    events += f"AVAILABLE {1.0 / 60.0:.6f} {image}\n"
+
+    command = [args.bin, "--headless", "--debug", "--scene", args.scene, "--drawing-size", "640", "480", *flags]
+    if args.physical_device:
+        command += ["--physical-device", args.physical_device]
+
+    result = subprocess.run(command, input=events, capture_output=True, text=True)
+    messages = []
+    for line in result.stderr.splitlines():
+        line = ANSI_PATTERN.sub("", line)
+        if MESSAGE_PATTERN.match(line):
+            messages.append(line)
+
+    return command, result, messages, image
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bin", default="bin/main")
+    parser.add_argument("--scene", required=True)
+    parser.add_argument("--frames", type=int, default=8)
+    parser.add_argument("--physical-device", default="")
+    parser.add_argument("--out", default="validate_flags_out", help="directory for the saved frames")
+    parser.add_argument("--only", nargs="*", default=None, help="combination names to run (default: all)")
+    args = parser.parse_args()
+    args.frames = max(args.frames, 1)
+
+    out_dir = Path(args.out)
+    out_dir.mkdir(parents=True, exist_ok=True)
+
+    names = args.only if args.only else list(COMBINATIONS)
+    failed = []
+    images = {}
+    for name in names:
+        command, result, messages, image = run_combination(args, name, COMBINATIONS[name], out_dir)
+        print(f"[{name}] {' '.join(command)}")
+        if result.returncode != 0 or messages:
+            failed.append(name)
+            print(f"  FAILED: exit code {result.returncode}, {len(messages)} validation errors/warnings")
+            for line in messages[:20]:
+                print(f"    {line}")
+            if result.returncode != 0:
+                sys.stdout.write("".join(f"    {line}\n" for line in result.stderr.splitlines()[-20:]))
+        else:
+            print("  ok: no validation errors or warnings")
+        if image.exists():
+            images[name] = image
+
+    for first, second in SAME_IMAGE:
+        if first not in images or second not in images:
+            continue
+        w0, h0, pixels0 = read_ppm(images[first])
+        w1, h1, pixels1 = read_ppm(images[second])
+        if (w0, h0) != (w1, h1):
+            failed.append(f"{first} = {second}")
+            print(f"[{first} = {second}] FAILED: sizes differ ({w0}x{h0} and {w1}x{h1})")
+            continue
+        differing = sum(1 for i in range(0, len(pixels0), 3) if pixels0[i : i + 3] != pixels1[i : i + 3])
+        largest = max((abs(a - b) for a, b in zip(pixels0, pixels1)), default=0)
+        if differing != 0:
+            failed.append(f"{first} = {second}")
+            print(f"[{first} = {second}] FAILED: {differing} of {w0 * h0} pixels differ (by up to {largest})")
+        else:
+            print(f"[{first} = {second}] ok: identical {w0}x{h0} frames")
+
+    if failed:
+        print(f"\n{len(failed)} failed: {', '.join(failed)}")
+        sys.exit(1)
+    print("\nall combinations ran without validation errors or warnings")
+
+
+if __name__ == "__main__":
+    main()
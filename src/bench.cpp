@@ -0,0 +1,107 @@
+#include "bench/bench.hpp"
+
+#include <iostream>
+
+void Options::add(std::string const &flag, uint32_t &value) {
+	setters[flag] = [&value](std::string const &text) { value = static_cast<uint32_t>(std::stoul(text)); };
+}
+
+void Options::add(std::string const &flag, float &value) {
+	setters[flag] = [&value](std::string const &text) { value = std::stof(text); };
+}
+
+void Options::add(std::string const &flag, double &value) {
+	setters[flag] = [&value](std::string const &text) { value = std::stod(text); };
+}
+
+void Options::add(std::string const &flag, std::string &value) {
+	setters[flag] = [&value](std::string const &text) { value = text; };
+}
+
+void Options::add(std::string const &flag, std::vector<double> &list) {
+	setters[flag] = [&list](std::string const &text) {
+		list.clear();
+		for (size_t begin = 0; begin < text.size();) {
+			size_t end = text.find(',', begin);
+			if (end == std::string::npos) end = text.size();
+			list.push_back(std::stod(text.substr(begin, end - begin)));
+			begin = end + 1;
+		}
+	};
+}
+
+void Options::parse(std::vector<std::string> const &args, size_t positional_count) {
+	for (size_t i = 0; i < args.size(); ++i) {
+		std::string const &arg = args[i];
+		if (!arg.starts_with("--")) {
+			positional.emplace_back(arg);
+			continue;
+		}
+		auto found = setters.find(arg);
+		if (found == setters.end()) throw UsageError("Unknown option: " + arg);
+		if (i + 1 >= args.size()) throw UsageError("Option " + arg + " needs a value");
+		found->second(args[++i]);
+	}
+	if (positional.size() != positional_count) {
+		throw UsageError("Wrong number of arguments (expected " + std::to_string(positional_count) + ", got " + std::to_string(positional.size()) + ")");
+	}
+}
+
+struct Mode {
+	const char *name;
+	const char *usage; //arguments, then what the mode measures
+	int (*run)(std::vector<std::string> const &args);
+};
+
+static const Mode modes[] = {
+	{"load", "<scene.s72> [--repeat N]   (time sejp::load, S72Loader on the json, and on the cooked <scene.s72>b if present)", bench_load},
+	{"generate", "<out.s72> <megabytes>  (write a synthetic driver-heavy scene)", bench_generate},
+	{"scan", "[--sizes 1,100,1024] [--dir <path>]  (compare sejp scalar/SIMD structural scanning)", bench_scan},
+	{"hierarchy", "[--nodes 1000,1000000] [--frames N]  (time per-frame animation + transform update)", bench_hierarchy},
+	{"animation", "[--drivers 1000,50000] [--keys N] [--frames N]  (time per-frame driver evaluation)", bench_animation},
+	{"update", "[--nodes 100000] [--threads 1,2,4,8,16] [--frames N]  (time the per-frame scene update on a JobSystem)", bench_update},
+	{"cull", "[--boxes 1000000] [--repeat N]  (compare per-box and batched SIMD frustum culling)", bench_cull},
+	{"bvh", "[--instances 200000] [--moving 0.01] [--frames N]  (compare linear and BVH frustum culling of a city)", bench_bvh},
+	{"shadows", "[--instances 200000] [--lights 50] [--repeat N]  (count and time per-view shadow caster culling, and the passes layered rendering saves)", bench_shadows},
+	{"shadow-cache", "[--instances 200000] [--lights 50] [--moving 20] [--frames N]  (count shadow views redrawn with static and split shadow map caching)", bench_shadow_cache},
+	{"shadow-atlas", "[--lights 64] [--size 4096] [--budget 8] [--moving 8] [--frames N]  (pack spot light shadow maps into one atlas on a walking camera, with a per-frame tile budget)", bench_shadow_atlas},
+	{"cache", "[--instances 200000] [--speed 0.02] [--turn 0.002] [--moving 0] [--frames N]  (compare BVH culling with the temporal visibility cache on a walking camera)", bench_cache},
+	{"occlusion", "[--instances 200000] [--occluders 32] [--threads 1,8] [--frames N] [--dump <out.pgm>]  (time software occlusion culling of a city at street level)", bench_occlusion},
+	{"gpu-cull", "[--instances 20000] [--frames N]  (run the GPU culling shader's steps on the CPU: frustum-only counts against CPU culling, two-phase and last-frame popping)", bench_gpu_cull},
+	{"instancing", "[--instances 20000] [--groups 50] [--frames N]  (time grouping visible instances by mesh and material into instanced draws)", bench_instancing},
+	{"sort", "[--keys 100000] [--meshes 500] [--repeat N]  (compare std::sort and the radix sort of packed draw keys)", bench_sort},
+};
+
+static void print_usage(const char *prog) {
+	std::cerr << "Usage:\n";
+	for (Mode const &mode : modes) {
+		std::cerr << "  " << prog << " " << mode.name << " " << mode.usage << "\n";
+	}
+	std::cerr << "\n";
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	const std::string name = argv[1];
+	const std::vector<std::string> args(argv + 2, argv + argc);
+
+	for (Mode const &mode : modes) {
+		if (name != mode.name) continue;
+		try {
+			return mode.run(args);
+		} catch (UsageError &e) {
+			std::cerr << e.what() << "\n";
+			print_usage(argv[0]);
+			return 1;
+		} catch (std::exception &e) {
+			std::cerr << "Error: " << e.what() << "\n";
+			return 1;
+		}
+	}
+
+	print_usage(argv[0]);
+	return 1;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// Shared pieces of the bench tool: per-mode option parsing, the scene builders
+// several modes share, and each mode's entry point (by area: loading.cpp,
+// scene.cpp, culling.cpp, shadows.cpp, draws.cpp).
+
+#include "CameraManager.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Thrown for a command line a mode can't run with (bench prints it along with the usage).
+struct UsageError : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+// The options of one mode: add() ties each "--flag" to the variable its value is parsed into
+// (so the variable's initial value is the default), then parse() reads the mode's arguments.
+struct Options {
+	void add(std::string const &flag, uint32_t &value);
+	void add(std::string const &flag, float &value);
+	void add(std::string const &flag, double &value);
+	void add(std::string const &flag, std::string &value);
+	void add(std::string const &flag, std::vector<double> &list); //comma-separated, e.g. "1,100,1024"
+
+	//throws UsageError on an unknown flag, a flag without a value, or other than 'positional_count' positional arguments:
+	void parse(std::vector<std::string> const &args, size_t positional_count = 0);
+	std::vector<std::string> positional; //(arguments that are not flags or their values, in order)
+
+private:
+	std::unordered_map<std::string, std::function<void(std::string const &)>> setters;
+};
+
+// the frustum of a camera at 'eye' looking along 'forward' (planes facing inward, like CameraManager::get_frustum):
+CameraManager::Frustum make_view_frustum(glm::vec3 eye, glm::vec3 forward, glm::vec3 up, float fov_y, float aspect, float near, float far);
+
+// buildings on a jittered side x side grid, as unit boxes scaled and placed by their model matrices:
+std::vector<glm::mat4> make_city(size_t count, uint32_t side, float spacing, std::mt19937 &mt);
+
+// Mode entry points; 'args' are the arguments after the mode name.
+int bench_load(std::vector<std::string> const &args);
+int bench_generate(std::vector<std::string> const &args);
+int bench_scan(std::vector<std::string> const &args);
+
+int bench_hierarchy(std::vector<std::string> const &args);
+int bench_animation(std::vector<std::string> const &args);
+int bench_update(std::vector<std::string> const &args);
+
+int bench_cull(std::vector<std::string> const &args);
+int bench_bvh(std::vector<std::string> const &args);
+int bench_cache(std::vector<std::string> const &args);
+int bench_occlusion(std::vector<std::string> const &args);
+int bench_gpu_cull(std::vector<std::string> const &args);
+
+int bench_shadows(std::vector<std::string> const &args);
+int bench_shadow_cache(std::vector<std::string> const &args);
+int bench_shadow_atlas(std::vector<std::string> const &args);
+
+int bench_instancing(std::vector<std::string> const &args);
+int bench_sort(std::vector<std::string> const &args);
@@ -0,0 +1,802 @@
+// Culling: SIMD frustum tests, the BVH, the temporal visibility cache, and software occlusion.
+
+#include "bench.hpp"
+
+#include "BVH.hpp"
+#include "JobSystem.hpp"
+#include "SoftwareOcclusion.hpp"
+#include "Timer.hpp"
+#include "VisibilityCache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+//--------------------------------------------------------------------
+// Frustum culling: the per-box path (8 transformed corners, then is_box_visible) vs Frustum::are_boxes_visible.
+
+static const char *batch_cull_width() {
+#if defined(__AVX512F__)
+	return "AVX-512, 16";
+#elif defined(__AVX__)
+	return "AVX, 8";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	return "SSE2, 4";
+#else
+	return "scalar, 1";
+#endif
+}
+
+static int run_cull(std::vector<double> const &sizes, uint32_t repeat) {
+	// a 90-degree view down -z, from 0.1 to 100 units:
+	CameraManager::Frustum frustum;
+	const float s = std::sqrt(0.5f);
+	frustum.planes[0] = {glm::vec3(s, 0.0f, -s), 0.0f};
+	frustum.planes[1] = {glm::vec3(-s, 0.0f, -s), 0.0f};
+	frustum.planes[2] = {glm::vec3(0.0f, s, -s), 0.0f};
+	frustum.planes[3] = {glm::vec3(0.0f, -s, -s), 0.0f};
+	frustum.planes[4] = {glm::vec3(0.0f, 0.0f, -1.0f), -0.1f};
+	frustum.planes[5] = {glm::vec3(0.0f, 0.0f, 1.0f), 100.0f};
+
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+
+		// random boxes, randomly rotated, scaled, and scattered around the view:
+		std::mt19937 mt(0x0c011);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<glm::vec3> bounds_min(count), bounds_max(count);
+		std::vector<glm::mat4> models(count);
+		for (size_t i = 0; i < count; ++i) {
+			glm::vec3 center(unit(mt), unit(mt), unit(mt));
+			glm::vec3 extent = 0.3f + 0.25f * glm::vec3(unit(mt), unit(mt), unit(mt));
+			bounds_min[i] = center - extent;
+			bounds_max[i] = center + extent;
+
+			glm::vec3 translation(60.0f * unit(mt), 60.0f * unit(mt), -60.0f + 60.0f * unit(mt));
+			glm::quat rotation = glm::normalize(glm::quat(unit(mt), unit(mt), unit(mt), unit(mt)));
+			glm::vec3 scale = 1.25f + 0.75f * glm::vec3(unit(mt), unit(mt), unit(mt));
+			models[i] = glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+		}
+
+		std::vector<uint64_t> per_box((count + 63) / 64, 0);
+		double per_box_time = 1e30;
+		for (uint32_t r = 0; r < repeat; ++r) {
+			Timer timer([&](double elapsed) { per_box_time = std::min(per_box_time, elapsed); });
+			std::fill(per_box.begin(), per_box.end(), 0);
+			for (size_t i = 0; i < count; ++i) {
+				const glm::vec3 &bmin = bounds_min[i];
+				const glm::vec3 &bmax = bounds_max[i];
+				glm::vec3 world_min(std::numeric_limits<float>::max());
+				glm::vec3 world_max(std::numeric_limits<float>::lowest());
+				for (int c = 0; c < 8; ++c) {
+					glm::vec3 corner((c & 1 ? bmax.x : bmin.x), (c & 2 ? bmax.y : bmin.y), (c & 4 ? bmax.z : bmin.z));
+					glm::vec3 wp = glm::vec3(models[i] * glm::vec4(corner, 1.0f));
+					world_min = glm::min(world_min, wp);
+					world_max = glm::max(world_max, wp);
+				}
+				if (frustum.is_box_visible(world_min, world_max)) per_box[i / 64] |= uint64_t(1) << (i % 64);
+			}
+		}
+
+		CameraManager::BoxBatch boxes;
+		std::vector<uint64_t> batched;
+		double fill_time = 1e30, batch_time = 1e30;
+		for (uint32_t r = 0; r < repeat; ++r) {
+			{
+				Timer timer([&](double elapsed) { fill_time = std::min(fill_time, elapsed); });
+				boxes.resize(count);
+				for (size_t i = 0; i < count; ++i) {
+					boxes.set(i, bounds_min[i], bounds_max[i], models[i]);
+				}
+			}
+			Timer timer([&](double elapsed) { batch_time = std::min(batch_time, elapsed); });
+			frustum.are_boxes_visible(boxes, batched);
+		}
+
+		// the two paths round differently, so a box that just touches a plane may land on either side:
+		size_t visible = 0, differ = 0;
+		for (size_t w = 0; w < per_box.size(); ++w) {
+			for (uint64_t bits = per_box[w]; bits != 0; bits &= bits - 1) ++visible;
+			for (uint64_t bits = per_box[w] ^ batched[w]; bits != 0; bits &= bits - 1) ++differ;
+		}
+
+		std::cout << count << " boxes (" << visible << " visible, best of " << repeat << "):\n"
+		          << "  per-box (8 corners):        " << per_box_time * 1000.0 << " ms\n"
+		          << "  batched (" << batch_cull_width() << " wide):    " << batch_time * 1000.0 << " ms ("
+		          << per_box_time / batch_time << "x), plus " << fill_time * 1000.0 << " ms to fill the BoxBatch ("
+		          << per_box_time / (batch_time + fill_time) << "x overall)\n"
+		          << "  " << differ << " boxes classified differently" << std::endl;
+		if (differ > count / 10000) return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+// BVH culling: a city of static instances (a few percent visible), against linear culling of every instance.
+
+CameraManager::Frustum make_view_frustum(glm::vec3 eye, glm::vec3 forward, glm::vec3 up, float fov_y, float aspect, float near, float far) {
+	forward = glm::normalize(forward);
+	const glm::vec3 right = glm::normalize(glm::cross(forward, up));
+	const glm::vec3 camera_up = glm::cross(right, forward);
+	const float tan_y = std::tan(0.5f * fov_y);
+	const float tan_x = tan_y * aspect;
+	const glm::vec3 normals[4] = {
+		glm::normalize(forward * tan_x + right), glm::normalize(forward * tan_x - right),
+		glm::normalize(forward * tan_y + camera_up), glm::normalize(forward * tan_y - camera_up),
+	};
+	CameraManager::Frustum frustum;
+	for (int p = 0; p < 4; ++p) {
+		frustum.planes[p] = {normals[p], -glm::dot(normals[p], eye)};
+	}
+	frustum.planes[4] = {forward, -glm::dot(forward, eye) - near};
+	frustum.planes[5] = {-forward, glm::dot(forward, eye) + far};
+	return frustum;
+}
+
+static size_t count_bits(std::vector<uint64_t> const &mask) {
+	size_t count = 0;
+	for (uint64_t word : mask) count += size_t(std::popcount(word));
+	return count;
+}
+
+std::vector<glm::mat4> make_city(size_t count, uint32_t side, float spacing, std::mt19937 &mt) {
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::mat4> models(count);
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec3 position((float(i % side) + 0.5f * unit(mt)) * spacing, 0.0f, (float(i / side) + 0.5f * unit(mt)) * spacing);
+		glm::vec3 scale(1.0f + 2.0f * unit(mt), 2.5f + 20.0f * unit(mt) * unit(mt), 1.0f + 2.0f * unit(mt));
+		position.y = scale.y;
+		models[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), scale);
+	}
+	return models;
+}
+
+static int run_bvh(std::vector<double> const &sizes, double moving, uint32_t frames) {
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+		const float spacing = 8.0f;
+
+		std::mt19937 mt(0xc17);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<glm::mat4> models = make_city(count, side, spacing, mt);
+		const glm::vec3 local_min(-1.0f), local_max(1.0f);
+
+		std::vector<BVH::Box> bounds(count);
+		for (size_t i = 0; i < count; ++i) {
+			bounds[i] = BVH::transform_box(models[i], local_min, local_max);
+		}
+		BVH bvh;
+		double build_time = 0.0;
+		{
+			Timer timer([&](double elapsed) { build_time = elapsed; });
+			bvh.build(bounds);
+		}
+
+		// the camera stands in the middle of the city, turning a full circle over the frames:
+		const glm::vec3 eye(0.5f * spacing * float(side), 20.0f, 0.5f * spacing * float(side));
+		const size_t moved_count = static_cast<size_t>(moving * double(count));
+		std::vector<uint64_t> linear, batched, hierarchical;
+		CameraManager::BoxBatch boxes;
+		double linear_time = 0.0, batched_time = 0.0, refit_time = 0.0, bvh_time = 0.0;
+		size_t visible = 0, differ = 0;
+		for (uint32_t f = 0; f < frames; ++f) {
+			const float angle = 6.2831853f * float(f) / float(frames);
+			CameraManager::Frustum frustum = make_view_frustum(eye, glm::vec3(std::cos(angle), -0.1f, std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+			// some buildings move (bounds recomputed from the new model matrices, then the tree refit):
+			{
+				Timer timer([&](double elapsed) { refit_time += elapsed; });
+				for (size_t m = 0; m < moved_count; ++m) {
+					const uint32_t i = uint32_t(mt() % count);
+					models[i] = glm::translate(glm::mat4(1.0f), glm::vec3(unit(mt) - 0.5f, 0.0f, unit(mt) - 0.5f)) * models[i];
+					bounds[i] = BVH::transform_box(models[i], local_min, local_max);
+					bvh.update(i, bounds[i]);
+				}
+				bvh.refit();
+			}
+
+			{ // linear: every world AABB through is_box_visible
+				Timer timer([&](double elapsed) { linear_time += elapsed; });
+				linear.assign((count + 63) / 64, 0);
+				for (size_t i = 0; i < count; ++i) {
+					if (frustum.is_box_visible(bounds[i].min, bounds[i].max)) linear[i / 64] |= uint64_t(1) << (i % 64);
+				}
+			}
+			{ // linear, batched: fill a BoxBatch from the model matrices, then are_boxes_visible
+				Timer timer([&](double elapsed) { batched_time += elapsed; });
+				boxes.resize(count);
+				for (size_t i = 0; i < count; ++i) {
+					boxes.set(i, local_min, local_max, models[i]);
+				}
+				frustum.are_boxes_visible(boxes, batched);
+			}
+			{
+				Timer timer([&](double elapsed) { bvh_time += elapsed; });
+				bvh.cull(frustum, hierarchical);
+			}
+
+			visible += count_bits(hierarchical);
+			for (size_t w = 0; w < linear.size(); ++w) {
+				differ += size_t(std::popcount(linear[w] ^ hierarchical[w]));
+			}
+		}
+
+		std::cout << count << " instances (" << bvh.node_count() << " BVH nodes, built in " << build_time * 1000.0 << " ms; "
+		          << 100.0 * double(visible) / double(count) / frames << "% visible, " << moved_count << " moving per frame):\n"
+		          << "  linear (is_box_visible):      " << linear_time / frames * 1000.0 << " ms/frame\n"
+		          << "  linear (are_boxes_visible):   " << batched_time / frames * 1000.0 << " ms/frame (with BoxBatch fill)\n"
+		          << "  BVH refit:                    " << refit_time / frames * 1000.0 << " ms/frame\n"
+		          << "  BVH cull:                     " << bvh_time / frames * 1000.0 << " ms/frame ("
+		          << linear_time / bvh_time << "x vs is_box_visible, " << batched_time / bvh_time << "x vs are_boxes_visible)\n"
+		          << "  " << differ << " instances classified differently from is_box_visible" << std::endl;
+		if (differ != 0) return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+// Temporal visibility cache: the city seen by a camera walking (and slowly turning) through it,
+// optionally with some buildings moving, against culling every frame from scratch.
+
+static int run_cache(std::vector<double> const &sizes, float speed, float turn, double moving, uint32_t frames) {
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+		const float spacing = 8.0f;
+
+		std::mt19937 mt(0xc17);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<glm::mat4> models = make_city(count, side, spacing, mt);
+		const glm::vec3 local_min(-1.0f), local_max(1.0f);
+		std::vector<BVH::Box> bounds(count);
+		for (size_t i = 0; i < count; ++i) {
+			bounds[i] = BVH::transform_box(models[i], local_min, local_max);
+		}
+		BVH bvh;
+		bvh.build(bounds);
+
+		VisibilityCache cache;
+		glm::mat4 perspective = glm::perspectiveRH_ZO(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+		perspective[1][1] *= -1.0f;
+		const size_t moved_count = static_cast<size_t>(moving * double(count));
+		std::vector<uint32_t> moved;
+		std::vector<uint64_t> fresh, cached;
+		double bvh_time = 0.0, cache_time = 0.0;
+		size_t differ = 0;
+		for (uint32_t f = 0; f < frames; ++f) {
+			const float angle = turn * float(f);
+			const glm::vec3 eye(0.5f * spacing * float(side), 20.0f, 0.5f * spacing * float(side) + speed * float(f));
+			const glm::mat4 view = glm::lookAtRH(eye, eye + glm::vec3(std::cos(angle), -0.1f, std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+			const CameraManager::Frustum frustum = CameraManager::Frustum::from_matrix(perspective * view);
+
+			moved.clear();
+			for (size_t m = 0; m < moved_count; ++m) {
+				const uint32_t i = uint32_t(mt() % count);
+				models[i] = glm::translate(glm::mat4(1.0f), glm::vec3(unit(mt) - 0.5f, 0.0f, unit(mt) - 0.5f)) * models[i];
+				bounds[i] = BVH::transform_box(models[i], local_min, local_max);
+				bvh.update(i, bounds[i]);
+				moved.emplace_back(i);
+			}
+			bvh.refit();
+
+			{
+				Timer timer([&](double elapsed) { bvh_time += elapsed; });
+				bvh.cull(frustum, fresh);
+			}
+			{
+				Timer timer([&](double elapsed) { cache_time += elapsed; });
+				cache.cull(bvh, frustum, perspective, view, moved, f == 0, cached);
+			}
+			for (size_t w = 0; w < fresh.size(); ++w) {
+				differ += size_t(std::popcount(fresh[w] ^ cached[w]));
+			}
+		}
+
+		std::cout << count << " instances (camera moving " << speed << " units and turning " << turn << " radians per frame, " << moved_count << " instances moving per frame):\n"
+		          << "  BVH cull:                     " << bvh_time / frames * 1000.0 << " ms/frame\n"
+		          << "  visibility cache:             " << cache_time / frames * 1000.0 << " ms/frame ("
+		          << 100.0 * cache.total.hit_rate() << "% hit rate, " << cache.total.rebuilds << " rebuilds in " << frames << " frames)\n"
+		          << "  " << differ << " instances classified differently from BVH cull" << std::endl;
+		if (differ != 0) return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+// Software occlusion: the city seen from street level, where near buildings hide most of what the frustum lets through.
+
+// unit box (-1 .. 1) as a triangle list:
+static std::vector<glm::vec3> make_box_triangles() {
+	std::vector<glm::vec3> positions;
+	for (int axis = 0; axis < 3; ++axis) {
+		for (float side : {-1.0f, 1.0f}) {
+			glm::vec3 corner[4];
+			for (int k = 0; k < 4; ++k) {
+				corner[k][axis] = side;
+				corner[k][(axis + 1) % 3] = (k & 1) ? 1.0f : -1.0f;
+				corner[k][(axis + 2) % 3] = (k & 2) ? 1.0f : -1.0f;
+			}
+			positions.insert(positions.end(), {corner[0], corner[1], corner[3], corner[0], corner[3], corner[2]});
+		}
+	}
+	return positions;
+}
+
+static int run_occlusion(std::vector<double> const &sizes, uint32_t occluder_count, std::vector<double> const &thread_counts, uint32_t frames, std::string const &dump) {
+	const std::vector<glm::vec3> box = make_box_triangles();
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+		const float spacing = 8.0f;
+
+		std::mt19937 mt(0xc17);
+		std::vector<glm::mat4> models = make_city(count, side, spacing, mt);
+		std::vector<BVH::Box> bounds(count);
+		for (size_t i = 0; i < count; ++i) {
+			bounds[i] = BVH::transform_box(models[i], glm::vec3(-1.0f), glm::vec3(1.0f));
+		}
+		BVH bvh;
+		bvh.build(bounds);
+
+		for (double threads : thread_counts) {
+			JobSystem jobs(static_cast<uint32_t>(threads));
+			SoftwareOcclusion occlusion;
+			std::vector<uint64_t> visible, occluder_bits;
+			std::vector<std::pair<float, uint32_t>> ranking;
+			std::vector<SoftwareOcclusion::Occluder> occluders;
+			double cull_time = 0.0, pick_time = 0.0, render_time = 0.0, test_time = 0.0;
+			size_t frustum_visible = 0, hidden = 0, triangles = 0;
+			for (uint32_t f = 0; f < frames; ++f) {
+				// the camera walks down a street (between grid columns), turning a quarter circle over the frames:
+				const float angle = 1.5707963f * float(f) / float(frames);
+				const glm::vec3 eye((0.5f * float(side) + 0.75f) * spacing, 1.7f, 0.25f * spacing * float(side) + float(f));
+				const glm::vec3 forward(std::sin(angle), 0.0f, std::cos(angle));
+				glm::mat4 perspective = glm::perspectiveRH_ZO(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+				perspective[1][1] *= -1.0f;
+				const glm::mat4 clip_from_world = perspective * glm::lookAtRH(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+
+				{
+					Timer timer([&](double elapsed) { cull_time += elapsed; });
+					bvh.cull(CameraManager::Frustum::from_matrix(clip_from_world), visible);
+				}
+				{ // same ranking as A3/Deferred render_software_occlusion
+					Timer timer([&](double elapsed) { pick_time += elapsed; });
+					ranking.clear();
+					for (size_t word = 0; word < visible.size(); ++word) {
+						for (uint64_t bits = visible[word]; bits != 0; bits &= bits - 1) {
+							const uint32_t i = uint32_t(word * 64 + size_t(std::countr_zero(bits)));
+							const glm::vec3 extent = bounds[i].max - bounds[i].min;
+							const float depth = std::max((clip_from_world * glm::vec4((bounds[i].min + bounds[i].max) * 0.5f, 1.0f)).w, 1e-3f);
+							ranking.emplace_back((extent.x * extent.y + extent.y * extent.z + extent.z * extent.x) / (depth * depth), i);
+						}
+					}
+					const size_t picked = std::min<size_t>(ranking.size(), occluder_count);
+					std::partial_sort(ranking.begin(), ranking.begin() + picked, ranking.end(), std::greater<>());
+					occluders.clear();
+					occluder_bits.assign(visible.size(), 0);
+					for (size_t k = 0; k < picked; ++k) {
+						const uint32_t i = ranking[k].second;
+						occluders.emplace_back(SoftwareOcclusion::Occluder{&box, models[i]});
+						occluder_bits[i / 64] |= uint64_t(1) << (i % 64);
+					}
+				}
+				{
+					Timer timer([&](double elapsed) { render_time += elapsed; });
+					occlusion.render(clip_from_world, occluders, jobs);
+				}
+				{
+					Timer timer([&](double elapsed) { test_time += elapsed; });
+					for (size_t word = 0; word < visible.size(); ++word) {
+						for (uint64_t bits = visible[word] & ~occluder_bits[word]; bits != 0; bits &= bits - 1) {
+							const size_t i = word * 64 + size_t(std::countr_zero(bits));
+							if (!occlusion.is_box_visible(bounds[i].min, bounds[i].max)) ++hidden;
+						}
+					}
+				}
+				frustum_visible += count_bits(visible);
+				triangles += occlusion.triangle_count();
+			}
+			if (!dump.empty()) occlusion.save_pgm(dump);
+
+			const double total = pick_time + render_time + test_time;
+			std::cout << count << " instances, " << occluder_count << " occluders, " << jobs.thread_count() << " threads ("
+			          << double(frustum_visible) / frames << " in the frustum, "
+			          << 100.0 * double(hidden) / double(std::max<size_t>(frustum_visible, 1)) << "% of those hidden; "
+			          << double(triangles) / frames << " triangles rasterized):\n"
+			          << "  BVH cull:                     " << cull_time / frames * 1000.0 << " ms/frame\n"
+			          << "  pick occluders:               " << pick_time / frames * 1000.0 << " ms/frame\n"
+			          << "  rasterize " << SoftwareOcclusion::Width << "x" << SoftwareOcclusion::Height << ":           " << render_time / frames * 1000.0 << " ms/frame\n"
+			          << "  test boxes:                   " << test_time / frames * 1000.0 << " ms/frame\n"
+			          << "  occlusion total:              " << total / frames * 1000.0 << " ms/frame" << std::endl;
+		}
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+// GPU culling, transcribed: A3-cull.comp (Deferred-cull.comp is the same) and the A3-hiz.comp pyramid it tests
+// against, run on the CPU over the street-level city on a walking camera, with the views laid out like A3's
+// cull_views (Lambertian and PBR main views, then the six faces of a sphere light's shadow). Depth is the drawn
+// instances' boxes, rasterized by SoftwareOcclusion at its resolution. Per frame:
+//  - frustum only: each view's draws against CPU culling of the same pass (is_box_visible, and the BVH)
+//  - two-phase: instances the finished frame shows (tested against the pyramid of everything in the frustum)
+//    that neither phase drew -- popping, which two-phase culling should never do -- and instances drawn twice
+//  - last-frame: the same popping count, against the previous frame's pyramid
+
+namespace cull_shader { //(names and steps follow A3-cull.comp)
+
+enum : uint32_t { PassLambertian = 1, PassPBR = 2, PassShadow = 4 }; //(A3CommonData::CullLambertian, ...)
+enum Phase : uint32_t { FrustumOnly = 0, TwoPhaseFirst = 1, TwoPhaseSecond = 2, AgainstLastFrame = 3 };
+
+struct Instance {
+	glm::vec3 bounds_min, bounds_max;
+	uint32_t pass_mask;
+};
+
+struct View {
+	CameraManager::Frustum frustum;
+	uint32_t pass_mask;
+	uint32_t occlusion_mask; //this view's bit of 'visibility' (0: no occlusion culling)
+};
+
+// A3-hiz.comp: level 0 is the depth buffer, each further level half the last (rounded down, at least 1), with
+// every texel the farthest of the texels of the level below that its footprint touches (depth is not reversed):
+struct Pyramid {
+	std::vector<glm::ivec2> sizes;
+	std::vector<std::vector<float>> levels;
+	glm::mat4 clip_from_world = glm::mat4(1.0f);
+
+	void build(std::vector<float> const &depth, glm::ivec2 size, glm::mat4 const &clip_from_world_) {
+		clip_from_world = clip_from_world_;
+		sizes.assign(1, size);
+		levels.assign(1, depth);
+		while (size != glm::ivec2(1)) {
+			const glm::ivec2 src_size = size;
+			size = glm::max(size / 2, glm::ivec2(1));
+			std::vector<float> const &src = levels.back();
+			std::vector<float> dst(size_t(size.x) * size.y);
+			for (int y = 0; y < size.y; ++y) {
+				for (int x = 0; x < size.x; ++x) {
+					const glm::ivec2 lo = (glm::ivec2(x, y) * src_size) / size;
+					const glm::ivec2 hi = glm::min(((glm::ivec2(x, y) + 1) * src_size + size - 1) / size - 1, src_size - 1);
+					float farthest = src[size_t(lo.y) * src_size.x + lo.x];
+					for (int sy = lo.y; sy <= hi.y; ++sy) {
+						for (int sx = lo.x; sx <= hi.x; ++sx) {
+							farthest = std::max(farthest, src[size_t(sy) * src_size.x + sx]);
+						}
+					}
+					dst[size_t(y) * size.x + x] = farthest;
+				}
+			}
+			sizes.emplace_back(size);
+			levels.emplace_back(std::move(dst));
+		}
+	}
+
+	float fetch(int level, glm::ivec2 texel) const {
+		return levels[level][size_t(texel.y) * sizes[level].x + texel.x];
+	}
+};
+
+static bool frustum_visible(View const &view, glm::vec3 center, glm::vec3 extent) {
+	for (auto const &plane : view.frustum.planes) {
+		const float d = glm::dot(plane.normal, center) + plane.distance;
+		const float r = glm::dot(glm::abs(plane.normal), extent);
+		if (d + r < 0.0f) return false;
+	}
+	return true;
+}
+
+// 'hiz' null is HIZ_LEVELS == 0 (no pyramid yet: everything passes)
+static bool hiz_visible(Pyramid const *hiz, glm::vec3 bounds_min, glm::vec3 bounds_max) {
+	if (!hiz) return true;
+
+	glm::vec2 uv_min(1.0f);
+	glm::vec2 uv_max(0.0f);
+	float nearest = 1.0f;
+	for (uint32_t c = 0; c < 8; ++c) {
+		const glm::vec3 corner(
+			(c & 1) ? bounds_max.x : bounds_min.x,
+			(c & 2) ? bounds_max.y : bounds_min.y,
+			(c & 4) ? bounds_max.z : bounds_min.z
+		);
+		const glm::vec4 clip = hiz->clip_from_world * glm::vec4(corner, 1.0f);
+		if (clip.w <= 1e-5f) return true;
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		uv_min = glm::min(uv_min, glm::vec2(ndc) * 0.5f + 0.5f);
+		uv_max = glm::max(uv_max, glm::vec2(ndc) * 0.5f + 0.5f);
+		nearest = std::min(nearest, ndc.z);
+	}
+	uv_min = glm::clamp(uv_min, glm::vec2(0.0f), glm::vec2(1.0f));
+	uv_max = glm::clamp(uv_max, glm::vec2(0.0f), glm::vec2(1.0f));
+
+	const int level_count = int(hiz->levels.size());
+	const glm::vec2 size = (uv_max - uv_min) * glm::vec2(hiz->sizes[0]);
+	int level = std::clamp(int(std::ceil(std::log2(std::max(std::max(size.x, size.y), 1.0f)))), 0, level_count - 1);
+	glm::ivec2 texel_min, texel_max;
+	for (;;) {
+		const glm::ivec2 level_size = hiz->sizes[level];
+		texel_min = glm::clamp(glm::ivec2(uv_min * glm::vec2(level_size)), glm::ivec2(0), level_size - 1);
+		texel_max = glm::clamp(glm::ivec2(uv_max * glm::vec2(level_size)), glm::ivec2(0), level_size - 1);
+		if ((texel_max.x - texel_min.x <= 1 && texel_max.y - texel_min.y <= 1) || level + 1 >= level_count) break;
+		level += 1;
+	}
+
+	float farthest = hiz->fetch(level, texel_min);
+	for (int y = texel_min.y; y <= texel_max.y; ++y) {
+		for (int x = texel_min.x; x <= texel_max.x; ++x) {
+			farthest = std::max(farthest, hiz->fetch(level, glm::ivec2(x, y)));
+		}
+	}
+	return nearest <= farthest;
+}
+
+// one dispatch over the first 'view_count' views: draws[view] gets the instances main() would append to the view's
+// COMMANDS region, at most 'capacity' (counts[view] is COUNTS[view], which may run past it)
+static void dispatch(Phase phase, std::vector<Instance> const &instances, std::vector<View> const &views, uint32_t view_count,
+	Pyramid const *hiz, std::vector<uint32_t> &visibility, uint32_t capacity,
+	std::vector<std::vector<uint32_t>> &draws, std::vector<uint32_t> &counts) {
+	draws.assign(views.size(), {});
+	counts.assign(views.size(), 0);
+	for (uint32_t view = 0; view < view_count; ++view) {
+		for (uint32_t instance = 0; instance < uint32_t(instances.size()); ++instance) {
+			Instance const &inst = instances[instance];
+			if ((inst.pass_mask & views[view].pass_mask) == 0) continue;
+
+			const glm::vec3 center = 0.5f * (inst.bounds_min + inst.bounds_max);
+			const glm::vec3 extent = 0.5f * (inst.bounds_max - inst.bounds_min);
+			bool visible = frustum_visible(views[view], center, extent);
+
+			const uint32_t occlusion_mask = views[view].occlusion_mask;
+			if (occlusion_mask != 0 && phase != FrustumOnly) {
+				const bool was_visible = (visibility[instance] & occlusion_mask) != 0;
+				if (phase == TwoPhaseFirst) {
+					visible = visible && was_visible;
+				} else if (phase == TwoPhaseSecond) {
+					visible = visible && hiz_visible(hiz, inst.bounds_min, inst.bounds_max);
+					if (visible) visibility[instance] |= occlusion_mask;
+					else visibility[instance] &= ~occlusion_mask;
+					visible = visible && !was_visible;
+				} else {
+					visible = visible && hiz_visible(hiz, inst.bounds_min, inst.bounds_max);
+				}
+			}
+			if (!visible) continue;
+
+			const uint32_t slot = counts[view]++;
+			if (slot >= capacity) continue;
+			draws[view].emplace_back(instance);
+		}
+	}
+}
+
+} //namespace cull_shader
+
+static int run_gpu_cull(std::vector<double> const &sizes, uint32_t frames) {
+	using namespace cull_shader;
+	const std::vector<glm::vec3> box = make_box_triangles();
+	const uint32_t MainViews = 2; //(A3's CullShadowViewFirst)
+	const uint32_t Workspaces = 2; //(RTG::Configuration::workspaces: two-phase visibility is per workspace, so two frames old)
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+		const float spacing = 8.0f;
+
+		std::mt19937 mt(0xc17);
+		std::vector<glm::mat4> models = make_city(count, side, spacing, mt);
+		std::vector<BVH::Box> bounds(count);
+		std::vector<Instance> instances(count);
+		for (size_t i = 0; i < count; ++i) {
+			bounds[i] = BVH::transform_box(models[i], glm::vec3(-1.0f), glm::vec3(1.0f));
+			instances[i] = Instance{bounds[i].min, bounds[i].max, ((i % 3 == 0) ? PassPBR : PassLambertian) | PassShadow};
+		}
+		BVH bvh;
+		bvh.build(bounds);
+		const uint32_t capacity = uint32_t(count); //(A3 sizes every view's region for the whole scene)
+
+		JobSystem jobs(1);
+		SoftwareOcclusion raster;
+		const glm::ivec2 depth_size(SoftwareOcclusion::Width, SoftwareOcclusion::Height);
+		std::vector<SoftwareOcclusion::Occluder> occluders;
+		// rasterize the main views' draws and build their pyramid:
+		auto build_pyramid = [&](glm::mat4 const &clip_from_world, std::initializer_list<std::vector<uint32_t> const *> draw_lists, Pyramid &pyramid) {
+			occluders.clear();
+			for (auto const *list : draw_lists) {
+				for (uint32_t i : *list) occluders.emplace_back(SoftwareOcclusion::Occluder{&box, models[i]});
+			}
+			raster.render(clip_from_world, occluders, jobs);
+			pyramid.build(raster.depth_buffer(), depth_size, clip_from_world);
+		};
+
+		std::vector<std::vector<uint32_t>> visibility(Workspaces, std::vector<uint32_t>(count, 0));
+		std::vector<uint32_t> no_visibility(count, 0);
+		Pyramid last_frame, phase_one, finished;
+		bool last_frame_valid = false;
+		std::vector<std::vector<uint32_t>> draws, first_draws, second_draws, last_frame_draws;
+		std::vector<uint32_t> counts, drawn_marks(count, 0), shown_marks(count, 0);
+		std::vector<uint64_t> bvh_bits;
+		size_t view_mismatches = 0, bvh_mismatches = 0, over_capacity = 0;
+		size_t frustum_draws = 0, main_in_frustum = 0, two_phase_first = 0, two_phase_second = 0, two_phase_missing = 0, drawn_twice = 0;
+		size_t last_frame_drawn = 0, last_frame_missing = 0, last_frame_popping_frames = 0, shown_total = 0;
+		uint32_t mark = 0;
+		for (uint32_t f = 0; f < frames; ++f) {
+			//the camera walks down a street as in 'occlusion', with a sphere light above the street ahead of it:
+			const float angle = 1.5707963f * float(f) / float(frames);
+			const glm::vec3 eye((0.5f * float(side) + 0.75f) * spacing, 1.7f, 0.25f * spacing * float(side) + float(f));
+			const glm::vec3 forward(std::sin(angle), 0.0f, std::cos(angle));
+			glm::mat4 perspective = glm::perspectiveRH_ZO(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+			perspective[1][1] *= -1.0f;
+			const glm::mat4 clip_from_world = perspective * glm::lookAtRH(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+
+			std::vector<View> views(MainViews + 6);
+			views[0] = View{CameraManager::Frustum::from_matrix(clip_from_world), PassLambertian, 1};
+			views[1] = View{CameraManager::Frustum::from_matrix(clip_from_world), PassPBR, 2};
+			const glm::vec3 light = eye + 20.0f * forward + glm::vec3(0.0f, 12.0f, 0.0f);
+			const glm::vec3 face_dirs[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+			const glm::vec3 face_ups[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+			for (uint32_t face = 0; face < 6; ++face) {
+				const glm::mat4 face_clip = glm::perspectiveRH_ZO(1.5707963f, 1.0f, 0.1f, 60.0f) * glm::lookAtRH(light, light + face_dirs[face], face_ups[face]);
+				views[MainViews + face] = View{CameraManager::Frustum::from_matrix(face_clip), PassShadow, 0};
+			}
+
+			{ //frustum only, against CPU culling of each view's pass:
+				dispatch(FrustumOnly, instances, views, uint32_t(views.size()), nullptr, no_visibility, capacity, draws, counts);
+				for (uint32_t v = 0; v < uint32_t(views.size()); ++v) {
+					if (counts[v] > capacity) ++over_capacity;
+					frustum_draws += draws[v].size();
+					std::vector<uint32_t> expected;
+					for (uint32_t i = 0; i < uint32_t(count); ++i) {
+						if ((instances[i].pass_mask & views[v].pass_mask) && views[v].frustum.is_box_visible(bounds[i].min, bounds[i].max)) expected.emplace_back(i);
+					}
+					if (expected != draws[v]) ++view_mismatches;
+
+					bvh.cull(views[v].frustum, bvh_bits);
+					size_t draw = 0;
+					for (uint32_t i = 0; i < uint32_t(count); ++i) {
+						const bool listed = (draw < draws[v].size() && draws[v][draw] == i);
+						if (listed) ++draw;
+						const bool in_bvh = ((bvh_bits[i / 64] >> (i % 64)) & 1) && (instances[i].pass_mask & views[v].pass_mask);
+						if (listed != in_bvh) ++bvh_mismatches;
+					}
+				}
+			}
+
+			//what the finished frame shows: main view instances in front of the pyramid of everything in the frustum
+			std::vector<std::vector<uint32_t>> const &in_frustum = draws;
+			build_pyramid(clip_from_world, {&in_frustum[0], &in_frustum[1]}, finished);
+			++mark;
+			for (uint32_t v = 0; v < MainViews; ++v) {
+				main_in_frustum += in_frustum[v].size();
+				for (uint32_t i : in_frustum[v]) {
+					if (hiz_visible(&finished, instances[i].bounds_min, instances[i].bounds_max)) {
+						shown_marks[i] = mark;
+						++shown_total;
+					}
+				}
+			}
+
+			{ //two-phase: last visible first, then the rest against the pyramid of what the first phase drew
+				std::vector<uint32_t> &workspace_visibility = visibility[f % Workspaces];
+				dispatch(TwoPhaseFirst, instances, views, uint32_t(views.size()), nullptr, workspace_visibility, capacity, first_draws, counts);
+				build_pyramid(clip_from_world, {&first_draws[0], &first_draws[1]}, phase_one);
+				dispatch(TwoPhaseSecond, instances, views, MainViews, &phase_one, workspace_visibility, capacity, second_draws, counts);
+				for (uint32_t v = 0; v < MainViews; ++v) {
+					two_phase_first += first_draws[v].size();
+					two_phase_second += second_draws[v].size();
+					for (uint32_t i : first_draws[v]) drawn_marks[i] = mark;
+					for (uint32_t i : second_draws[v]) {
+						if (drawn_marks[i] == mark) ++drawn_twice;
+						drawn_marks[i] = mark;
+					}
+				}
+				for (uint32_t i = 0; i < uint32_t(count); ++i) {
+					if (shown_marks[i] == mark && drawn_marks[i] != mark) ++two_phase_missing;
+				}
+			}
+
+			{ //last-frame: against the pyramid the previous frame built from what it drew
+				dispatch(AgainstLastFrame, instances, views, uint32_t(views.size()), last_frame_valid ? &last_frame : nullptr, no_visibility, capacity, last_frame_draws, counts);
+				++mark;
+				size_t missing = 0;
+				for (uint32_t v = 0; v < MainViews; ++v) {
+					last_frame_drawn += last_frame_draws[v].size();
+					for (uint32_t i : last_frame_draws[v]) drawn_marks[i] = mark;
+				}
+				for (uint32_t v = 0; v < MainViews; ++v) {
+					for (uint32_t i : in_frustum[v]) {
+						if (shown_marks[i] == mark - 1 && drawn_marks[i] != mark) ++missing;
+					}
+				}
+				last_frame_missing += missing;
+				if (missing) ++last_frame_popping_frames;
+				build_pyramid(clip_from_world, {&last_frame_draws[0], &last_frame_draws[1]}, last_frame);
+				last_frame_valid = true;
+			}
+		}
+
+		std::cout << count << " instances, " << MainViews << " main + 6 shadow views, " << frames << " frames ("
+		          << double(main_in_frustum) / frames << " main view draws in the frustum, " << double(shown_total) / frames << " of them shown):\n"
+		          << "  frustum only: " << double(frustum_draws) / frames << " draws/frame; " << view_mismatches << " view lists differ from is_box_visible, "
+		          << bvh_mismatches << " instances from the BVH, " << over_capacity << " views over capacity\n"
+		          << "  two-phase:    " << double(two_phase_first) / frames << " + " << double(two_phase_second) / frames << " main view draws/frame; "
+		          << two_phase_missing << " shown instances not drawn, " << drawn_twice << " drawn twice\n"
+		          << "  last-frame:   " << double(last_frame_drawn) / frames << " main view draws/frame; "
+		          << last_frame_missing << " shown instances not drawn (popping, in " << last_frame_popping_frames << " frames)" << std::endl;
+		if (view_mismatches || over_capacity || two_phase_missing || drawn_twice) return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+
+int bench_cull(std::vector<std::string> const &args) {
+	std::vector<double> sizes{1000000.0};
+	uint32_t repeat = 10;
+	Options options;
+	options.add("--boxes", sizes);
+	options.add("--repeat", repeat);
+	options.parse(args);
+	return run_cull(sizes, std::max(repeat, 1u));
+}
+
+int bench_bvh(std::vector<std::string> const &args) {
+	std::vector<double> sizes{200000.0};
+	double moving = 0.01;
+	uint32_t frames = 60;
+	Options options;
+	options.add("--instances", sizes);
+	options.add("--moving", moving);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_bvh(sizes, moving, std::max(frames, 1u));
+}
+
+int bench_cache(std::vector<std::string> const &args) {
+	std::vector<double> sizes{200000.0};
+	float speed = 0.02f;
+	float turn = 0.002f;
+	double moving = 0.0;
+	uint32_t frames = 300;
+	Options options;
+	options.add("--instances", sizes);
+	options.add("--speed", speed);
+	options.add("--turn", turn);
+	options.add("--moving", moving);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_cache(sizes, speed, turn, moving, std::max(frames, 1u));
+}
+
+int bench_occlusion(std::vector<std::string> const &args) {
+	std::vector<double> sizes{200000.0};
+	uint32_t occluders = 32;
+	std::vector<double> thread_counts{1.0, 8.0};
+	uint32_t frames = 60;
+	std::string dump;
+	Options options;
+	options.add("--instances", sizes);
+	options.add("--occluders", occluders);
+	options.add("--threads", thread_counts);
+	options.add("--frames", frames);
+	options.add("--dump", dump);
+	options.parse(args);
+	return run_occlusion(sizes, occluders, thread_counts, std::max(frames, 1u), dump);
+}
+
+int bench_gpu_cull(std::vector<std::string> const &args) {
+	std::vector<double> sizes{20000.0};
+	uint32_t frames = 120;
+	Options options;
+	options.add("--instances", sizes);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_gpu_cull(sizes, std::max(frames, 1u));
+}
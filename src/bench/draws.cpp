@@ -0,0 +1,168 @@
+// Draws: automatic instancing and draw key sorting.
+
+#include "bench.hpp"
+
+#include "DrawSort.hpp"
+#include "InstanceGrouper.hpp"
+#include "Timer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+//--------------------------------------------------------------------
+// Automatic instancing: visible instances of a few repeated (mesh, material) pairs, in scene order,
+// grouped so each pair becomes one instanced draw (what the CPU culling path does every frame).
+
+struct InstancingInstance {
+	uint32_t first, count; //vertex range
+	glm::mat4 model, model_normal;
+	size_t material_index;
+	uint32_t draw_group;
+};
+
+struct InstancingDraw { //(same layout as VkDrawIndirectCommand)
+	uint32_t vertex_count, instance_count, first_vertex, first_instance;
+};
+
+static int run_instancing(std::vector<double> const &sizes, uint32_t group_count, uint32_t frames) {
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		std::mt19937 mt(0x1257);
+		std::vector<uint32_t> scene_groups(count);
+		for (auto &group : scene_groups) group = uint32_t(mt() % group_count);
+
+		InstanceGrouper grouper;
+		std::vector<InstancingInstance> instances, scratch;
+		std::vector<InstancingDraw> draws;
+		double group_time = 0.0, build_time = 0.0;
+		size_t visible_total = 0;
+		for (uint32_t f = 0; f < frames; ++f) {
+			//about half the scene is visible, in scene order:
+			instances.clear();
+			for (size_t i = 0; i < count; ++i) {
+				if (mt() & 1) continue;
+				const uint32_t group = scene_groups[i];
+				instances.emplace_back(InstancingInstance{
+					.first = group * 36, .count = 36,
+					.model = glm::mat4(float(i)), .model_normal = glm::mat4(1.0f),
+					.material_index = group % 7, .draw_group = group,
+				});
+			}
+			visible_total += instances.size();
+
+			{
+				Timer timer([&](double elapsed) { group_time += elapsed; });
+				grouper.group(instances, group_count,
+					[](InstancingInstance const &inst) { return inst.draw_group; }, scratch);
+			}
+			{
+				Timer timer([&](double elapsed) { build_time += elapsed; });
+				draws.clear();
+				for (uint32_t i = 0; i < uint32_t(instances.size()); ) {
+					uint32_t end = i + 1;
+					while (end < uint32_t(instances.size()) && instances[end].draw_group == instances[i].draw_group) ++end;
+					draws.emplace_back(InstancingDraw{instances[i].count, end - i, instances[i].first, i});
+					i = end;
+				}
+			}
+
+			//every pair present should be exactly one draw, with its instances still in scene order:
+			std::vector<uint8_t> seen(group_count, 0);
+			for (InstancingDraw const &draw : draws) {
+				const uint32_t group = instances[draw.first_instance].draw_group;
+				if (seen[group]++) {
+					std::cerr << "group " << group << " was split into several draws" << std::endl;
+					return 1;
+				}
+				for (uint32_t k = 1; k < draw.instance_count; ++k) {
+					if (instances[draw.first_instance + k].model[0][0] <= instances[draw.first_instance + k - 1].model[0][0]) {
+						std::cerr << "group " << group << " lost its scene order" << std::endl;
+						return 1;
+					}
+				}
+			}
+		}
+
+		std::cout << count << " instances of " << group_count << " (mesh, material) pairs, " << double(visible_total) / frames << " visible per frame:\n"
+		          << "  draws:                        " << double(visible_total) / frames << " -> " << draws.size() << "\n"
+		          << "  group instances:              " << group_time / frames * 1000.0 << " ms/frame\n"
+		          << "  build draw commands:          " << build_time / frames * 1000.0 << " ms/frame" << std::endl;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+// Draw sorting: packed (pipeline, mesh, depth) keys of a visible draw list, radix sorted as the renderer does.
+
+static int run_sort(std::vector<double> const &sizes, uint32_t meshes, uint32_t repeat) {
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		std::mt19937 mt(0x5047);
+		std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+		std::vector<uint64_t> scene_keys(count);
+		for (auto &key : scene_keys) {
+			key = DrawSort::key(mt() % 2, mt() % meshes, depth(mt));
+		}
+
+		DrawSort sorter;
+		std::vector<uint64_t> expected;
+		std::vector<uint32_t> order;
+		double std_time = 0.0, radix_time = 0.0;
+		for (uint32_t r = 0; r < repeat; ++r) {
+			expected = scene_keys;
+			{
+				Timer timer([&](double elapsed) { std_time += elapsed; });
+				std::stable_sort(expected.begin(), expected.end());
+			}
+			{
+				Timer timer([&](double elapsed) { radix_time += elapsed; });
+				sorter.sort(scene_keys, order);
+			}
+		}
+
+		//'order' visits the keys in std::stable_sort's order, each key once:
+		size_t wrong = (order.size() == count ? 0 : 1);
+		std::vector<uint8_t> visited(count, 0);
+		for (size_t i = 0; i < count && wrong == 0; ++i) {
+			if (order[i] >= count || visited[order[i]]++ || scene_keys[order[i]] != expected[i]) ++wrong;
+		}
+		for (size_t i = 1; i < count && wrong == 0; ++i) {
+			if (scene_keys[order[i]] == scene_keys[order[i - 1]] && order[i] < order[i - 1]) ++wrong; //(stable)
+		}
+
+		std::cout << count << " draw keys (" << meshes << " meshes, 2 pipelines):\n"
+		          << "  std::stable_sort:             " << std_time / repeat * 1000.0 << " ms\n"
+		          << "  radix sort:                   " << radix_time / repeat * 1000.0 << " ms" << std::endl;
+		if (wrong != 0) {
+			std::cerr << "  radix sort disagrees with std::stable_sort" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+
+int bench_instancing(std::vector<std::string> const &args) {
+	std::vector<double> sizes{20000.0};
+	uint32_t groups = 50;
+	uint32_t frames = 100;
+	Options options;
+	options.add("--instances", sizes);
+	options.add("--groups", groups);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_instancing(sizes, std::max(groups, 1u), std::max(frames, 1u));
+}
+
+int bench_sort(std::vector<std::string> const &args) {
+	std::vector<double> sizes{100000.0};
+	uint32_t meshes = 500;
+	uint32_t repeat = 50;
+	Options options;
+	options.add("--keys", sizes);
+	options.add("--meshes", meshes);
+	options.add("--repeat", repeat);
+	options.parse(args);
+	return run_sort(sizes, std::max(meshes, 1u), std::max(repeat, 1u));
+}
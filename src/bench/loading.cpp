@@ -0,0 +1,167 @@
+// Loading: sejp / S72Loader load times and sejp structural scanning.
+
+#include "bench.hpp"
+
+#include "MappedFile.hpp"
+#include "S72Binary.hpp"
+#include "S72Loader.hpp"
+#include "sejp.hpp"
+#include "Timer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// Writes a scene with a shallow node hierarchy and long keyframe arrays,
+// which is the shape of our animation-heavy .s72 files.
+static void generate_scene(std::string const &path, double megabytes) {
+	std::ofstream out(path, std::ios::binary);
+	if (!out) throw std::runtime_error("Failed to open '" + path + "' for writing.");
+
+	const uint64_t target_bytes = static_cast<uint64_t>(megabytes * 1024.0 * 1024.0);
+	const uint32_t node_count = 1024;
+	std::mt19937 mt(0x5eed);
+	std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+	out << "[\"s72-v2\",\n";
+	out << "{\"type\":\"SCENE\",\"name\":\"bench\",\"roots\":[\"node-0\"]},\n";
+	out << "{\"type\":\"MESH\",\"name\":\"mesh\",\"topology\":\"TRIANGLE_LIST\",\"count\":3,\"attributes\":{"
+		<< "\"POSITION\":{\"src\":\"mesh.b72\",\"offset\":0,\"stride\":12,\"format\":\"R32G32B32_SFLOAT\"}}},\n";
+	for (uint32_t n = 0; n < node_count; ++n) {
+		out << "{\"type\":\"NODE\",\"name\":\"node-" << n << "\",\"translation\":[" << dist(mt) << "," << dist(mt) << "," << dist(mt) << "],"
+			<< "\"rotation\":[0,0,0,1],\"scale\":[1,1,1],\"mesh\":\"mesh\"";
+		uint32_t first_child = n * 4 + 1;
+		if (first_child < node_count) {
+			out << ",\"children\":[";
+			for (uint32_t c = first_child; c < first_child + 4 && c < node_count; ++c) {
+				out << (c == first_child ? "" : ",") << "\"node-" << c << "\"";
+			}
+			out << "]";
+		}
+		out << "},\n";
+	}
+
+	// fill the rest of the budget with translation drivers:
+	uint32_t driver = 0;
+	while (static_cast<uint64_t>(out.tellp()) < target_bytes) {
+		const uint32_t keys = 4096;
+		out << "{\"type\":\"DRIVER\",\"name\":\"driver-" << driver << "\",\"node\":\"node-" << (driver % node_count) << "\",\"channel\":\"translation\",\"times\":[";
+		for (uint32_t k = 0; k < keys; ++k) out << (k ? "," : "") << (k / 60.0f);
+		out << "],\"values\":[";
+		for (uint32_t k = 0; k < keys * 3; ++k) out << (k ? "," : "") << dist(mt);
+		out << "],\"interpolation\":\"LINEAR\"},\n";
+		++driver;
+	}
+	out << "{\"type\":\"NODE\",\"name\":\"tail\"}\n]\n";
+}
+
+static int run_load(std::string const &path, uint32_t repeat) {
+	const double megabytes = static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+	std::cout << "Scene '" << path << "' (" << megabytes << " MB), " << repeat << " repetitions:" << std::endl;
+
+	double best_parse = 1e30;
+	double best_load = 1e30;
+	double best_cooked = 1e30;
+	const std::string cooked_path = path + "b";
+	const bool has_cooked = std::filesystem::exists(cooked_path);
+	for (uint32_t r = 0; r < repeat; ++r) {
+		{
+			Timer timer([&](double elapsed) { best_parse = std::min(best_parse, elapsed); });
+			sejp::value root = sejp::load(path);
+			(void)root;
+		}
+		{
+			Timer timer([&](double elapsed) { best_load = std::min(best_load, elapsed); });
+			auto doc = S72Loader::load_string(MappedFile(path).bytes());
+			(void)doc;
+		}
+		if (has_cooked) {
+			Timer timer([&](double elapsed) { best_cooked = std::min(best_cooked, elapsed); });
+			auto doc = S72Loader::load_cooked(cooked_path);
+			(void)doc;
+		}
+	}
+
+	std::cout << "  sejp::load            " << best_parse * 1000.0 << " ms (" << megabytes / best_parse << " MB/s)" << std::endl;
+	std::cout << "  S72Loader (json)      " << best_load * 1000.0 << " ms (" << megabytes / best_load << " MB/s)" << std::endl;
+	if (has_cooked) {
+		const double cooked_megabytes = static_cast<double>(std::filesystem::file_size(cooked_path)) / (1024.0 * 1024.0);
+		std::cout << "  S72Loader (cooked)    " << best_cooked * 1000.0 << " ms (" << cooked_megabytes << " MB file)" << std::endl;
+	}
+	return 0;
+}
+
+// Times stage-1 structural scanning alone and full sejp::load for every
+// scanning backend on generated scenes of each size (cached in 'dir').
+static int run_scan(std::vector<double> const &sizes, std::filesystem::path const &dir) {
+	const std::vector<std::pair<sejp::Scan, const char *>> scans{
+		{sejp::Scan::Scalar, "scalar"},
+		{sejp::Scan::SSE2, "sse2"},
+		{sejp::Scan::AVX2, "avx2"},
+	};
+
+	for (double size : sizes) {
+		std::filesystem::path path = dir / ("bench-" + std::to_string(static_cast<uint64_t>(size)) + "MB.s72");
+		if (!std::filesystem::exists(path)) {
+			std::cout << "Generating '" << path.string() << "'..." << std::endl;
+			generate_scene(path.string(), size);
+		}
+		const double megabytes = static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+		std::cout << "Scene '" << path.string() << "' (" << megabytes << " MB):" << std::endl;
+
+		std::string contents;
+		{
+			std::ifstream in(path, std::ios::binary);
+			contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+
+		for (auto const &[scan, name] : scans) {
+			double best_stage1 = 1e30;
+			double best_load = 1e30;
+			uint64_t structurals = 0;
+			try {
+				for (uint32_t r = 0; r < 3; ++r) {
+					Timer timer([&](double elapsed) { best_stage1 = std::min(best_stage1, elapsed); });
+					structurals = sejp::count_structurals(contents, scan);
+				}
+				Timer timer([&](double elapsed) { best_load = elapsed; });
+				sejp::value root = sejp::load(path.string(), scan);
+				(void)root;
+			} catch (std::exception &e) {
+				std::cout << "  " << name << ": skipped (" << e.what() << ")" << std::endl;
+				continue;
+			}
+			std::cout << "  " << name << ": stage 1 " << best_stage1 * 1000.0 << " ms (" << megabytes / 1024.0 / best_stage1 << " GB/s, "
+			          << structurals << " structurals); sejp::load " << best_load * 1000.0 << " ms (" << megabytes / best_load << " MB/s)" << std::endl;
+		}
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+
+int bench_load(std::vector<std::string> const &args) {
+	uint32_t repeat = 5;
+	Options options;
+	options.add("--repeat", repeat);
+	options.parse(args, 1);
+	return run_load(options.positional[0], repeat);
+}
+
+int bench_generate(std::vector<std::string> const &args) {
+	Options options;
+	options.parse(args, 2);
+	generate_scene(options.positional[0], std::stod(options.positional[1]));
+	return 0;
+}
+
+int bench_scan(std::vector<std::string> const &args) {
+	std::vector<double> sizes{1.0, 100.0, 1024.0};
+	std::string dir = std::filesystem::temp_directory_path().string();
+	Options options;
+	options.add("--sizes", sizes);
+	options.add("--dir", dir);
+	options.parse(args);
+	return run_scan(sizes, dir);
+}
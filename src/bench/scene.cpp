@@ -0,0 +1,498 @@
+// Scene update: transform hierarchy, animation drivers, and the per-frame update on a JobSystem.
+
+#include "bench.hpp"
+
+#include "BVH.hpp"
+#include "JobSystem.hpp"
+#include "S72Loader.hpp"
+#include "SceneTree.hpp"
+#include "Timer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// The recursive traversal SceneTree used before the flattened hierarchy, kept as
+// a reference: local matrices cached in a hash map, world matrices rebuilt by
+// recursion every frame, and dirty flags pushed down to every descendant.
+// (Animation only handles the LINEAR translation drivers that make_hierarchy_scene writes.)
+namespace legacy {
+
+struct State {
+	std::unordered_map<size_t, glm::mat4> local_matrix_cache;
+	std::vector<uint8_t> dirty;
+};
+
+static glm::mat4 compute_local_matrix(const glm::vec3 &translation, const glm::vec4 &rotation, const glm::vec3 &scale) {
+	glm::mat4 T = glm::translate(glm::mat4(1.0f), translation);
+	glm::quat q(rotation.w, rotation.x, rotation.y, rotation.z);
+	glm::mat4 R = glm::mat4_cast(q);
+	glm::mat4 S = glm::scale(glm::mat4(1.0f), scale);
+	return T * R * S;
+}
+
+static void traverse_node(State &state, S72Loader::Document &doc, size_t node_index, const glm::mat4 &parent_matrix, std::vector<SceneTree::MeshTreeData> &out_meshes) {
+	S72Loader::Node &node = doc.nodes[node_index];
+
+	glm::mat4 local_matrix;
+	auto cache_it = state.local_matrix_cache.find(node_index);
+	if (!state.dirty[node_index] && cache_it != state.local_matrix_cache.end()) {
+		local_matrix = cache_it->second;
+	} else {
+		local_matrix = compute_local_matrix(node.translation, node.rotation, node.scale);
+		state.local_matrix_cache[node_index] = local_matrix;
+		state.dirty[node_index] = 0;
+	}
+	glm::mat4 world_matrix = parent_matrix * local_matrix;
+
+	if (node.mesh_index != S72Loader::NoIndex) {
+		const S72Loader::Mesh &mesh = doc.meshes[node.mesh_index];
+		size_t material_index = (mesh.material_index != S72Loader::NoIndex ? mesh.material_index : 0);
+		out_meshes.push_back({world_matrix, node.mesh_index, material_index});
+	}
+	for (uint32_t child : node.child_indices) {
+		traverse_node(state, doc, child, world_matrix, out_meshes);
+	}
+}
+
+static void mark_dirty(State &state, S72Loader::Document &doc, size_t node_index) {
+	state.dirty[node_index] = 1;
+	state.local_matrix_cache.erase(node_index);
+	for (uint32_t child : doc.nodes[node_index].child_indices) {
+		mark_dirty(state, doc, child);
+	}
+}
+
+static void update(State &state, S72Loader::Document &doc, float time, std::vector<SceneTree::MeshTreeData> &out_meshes) {
+	for (const auto &driver : doc.drivers) {
+		if (driver.node_index == S72Loader::NoIndex || driver.times.empty()) continue;
+		size_t pre_index, tail_index;
+		if (time < driver.times.front()) {
+			pre_index = tail_index = 0;
+		} else if (time > driver.times.back()) {
+			pre_index = tail_index = driver.times.size() - 1;
+		} else {
+			tail_index = std::distance(driver.times.begin(), std::upper_bound(driver.times.begin(), driver.times.end(), time));
+			pre_index = tail_index > 0 ? tail_index - 1 : 0;
+		}
+		float ratio = 0.0f;
+		if (pre_index != tail_index) {
+			float duration = driver.times[tail_index] - driver.times[pre_index];
+			if (duration > std::numeric_limits<float>::epsilon()) ratio = (time - driver.times[pre_index]) / duration;
+		}
+		glm::vec3 v1(driver.values[3 * pre_index + 0], driver.values[3 * pre_index + 1], driver.values[3 * pre_index + 2]);
+		glm::vec3 v_result = v1;
+		if (pre_index != tail_index) {
+			glm::vec3 v2(driver.values[3 * tail_index + 0], driver.values[3 * tail_index + 1], driver.values[3 * tail_index + 2]);
+			v_result = glm::mix(v1, v2, ratio);
+		}
+		S72Loader::Node &node = doc.nodes[driver.node_index];
+		if (node.translation != v_result) {
+			node.translation = v_result;
+			mark_dirty(state, doc, driver.node_index);
+		}
+	}
+
+	out_meshes.clear();
+	for (uint32_t root : doc.scene.root_indices) {
+		traverse_node(state, doc, root, glm::mat4(1.0f), out_meshes);
+	}
+}
+
+// SceneTree::update_animation before drivers were compiled: channel strings and a binary search per driver per frame
+static void animate(S72Loader::Document &doc, float time) {
+	for (const auto &driver : doc.drivers) {
+		if (driver.node_index == S72Loader::NoIndex || driver.times.empty()) continue;
+		size_t pre_index, tail_index;
+		if (time < driver.times.front()) {
+			pre_index = tail_index = 0;
+		} else if (time >= driver.times.back()) {
+			pre_index = tail_index = driver.times.size() - 1;
+		} else {
+			tail_index = std::distance(driver.times.begin(), std::upper_bound(driver.times.begin(), driver.times.end(), time));
+			pre_index = tail_index > 0 ? tail_index - 1 : 0;
+		}
+		float ratio = 0.0f;
+		if (pre_index != tail_index) {
+			float duration = driver.times[tail_index] - driver.times[pre_index];
+			if (duration > std::numeric_limits<float>::epsilon()) ratio = (time - driver.times[pre_index]) / duration;
+		}
+		S72Loader::Node &node = doc.nodes[driver.node_index];
+		if (driver.channel == "rotation") {
+			glm::quat q1(driver.values[4 * pre_index + 3], driver.values[4 * pre_index + 0], driver.values[4 * pre_index + 1], driver.values[4 * pre_index + 2]);
+			glm::quat q_result = q1;
+			if (pre_index != tail_index) {
+				glm::quat q2(driver.values[4 * tail_index + 3], driver.values[4 * tail_index + 0], driver.values[4 * tail_index + 1], driver.values[4 * tail_index + 2]);
+				q_result = glm::slerp(q1, q2, ratio);
+			}
+			node.rotation = glm::vec4(q_result.x, q_result.y, q_result.z, q_result.w);
+		} else {
+			glm::vec3 v1(driver.values[3 * pre_index + 0], driver.values[3 * pre_index + 1], driver.values[3 * pre_index + 2]);
+			glm::vec3 v_result = v1;
+			if (pre_index != tail_index && driver.interpolation == "LINEAR") {
+				glm::vec3 v2(driver.values[3 * tail_index + 0], driver.values[3 * tail_index + 1], driver.values[3 * tail_index + 2]);
+				v_result = glm::mix(v1, v2, ratio);
+			}
+			if (driver.channel == "translation") node.translation = v_result;
+			else if (driver.channel == "scale") node.scale = v_result;
+		}
+	}
+}
+
+} // namespace legacy
+
+// A 4-ary tree of mesh nodes; every 16th node (but not the root) is animated, and the
+// subtree under node-1 is also a second root (so it is instanced twice).
+static std::string make_hierarchy_scene(uint32_t node_count) {
+	std::mt19937 mt(0x5eed);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	std::ostringstream out;
+	out << "[\"s72-v2\",\n";
+	out << "{\"type\":\"SCENE\",\"name\":\"bench\",\"roots\":[\"node-0\"" << (node_count > 1 ? ",\"node-1\"" : "") << "]},\n";
+	out << "{\"type\":\"MESH\",\"name\":\"mesh\",\"topology\":\"TRIANGLE_LIST\",\"count\":3,\"attributes\":{"
+		<< "\"POSITION\":{\"src\":\"mesh.b72\",\"offset\":0,\"stride\":12,\"format\":\"R32G32B32_SFLOAT\"}}}";
+	for (uint32_t n = 0; n < node_count; ++n) {
+		out << ",\n{\"type\":\"NODE\",\"name\":\"node-" << n << "\",\"translation\":[" << dist(mt) << "," << dist(mt) << "," << dist(mt) << "],"
+			<< "\"rotation\":[0,0," << std::sin(0.1f * n) << "," << std::cos(0.1f * n) << "],\"scale\":[1,1,1],\"mesh\":\"mesh\"";
+		uint32_t first_child = n * 4 + 1;
+		if (first_child < node_count) {
+			out << ",\"children\":[";
+			for (uint32_t c = first_child; c < first_child + 4 && c < node_count; ++c) {
+				out << (c == first_child ? "" : ",") << "\"node-" << c << "\"";
+			}
+			out << "]";
+		}
+		out << "}";
+	}
+	for (uint32_t n = 15; n < node_count; n += 16) {
+		out << ",\n{\"type\":\"DRIVER\",\"name\":\"driver-" << n << "\",\"node\":\"node-" << n << "\",\"channel\":\"translation\",\"times\":[0,1,2,3],\"values\":[";
+		for (uint32_t k = 0; k < 12; ++k) out << (k ? "," : "") << dist(mt);
+		out << "],\"interpolation\":\"LINEAR\"}";
+	}
+	out << "\n]\n";
+	return out.str();
+}
+
+// Times animation + transform update per frame with the old recursive traversal
+// and with SceneTree's flattened hierarchy (which only revisits dirty subtrees),
+// and checks that they agree.
+static int run_hierarchy(std::vector<double> const &sizes, uint32_t frames) {
+	for (double size : sizes) {
+		const uint32_t node_count = static_cast<uint32_t>(size);
+		std::string scene = make_hierarchy_scene(node_count);
+		auto old_doc = S72Loader::load_string(scene);
+		auto new_doc = S72Loader::load_string(scene);
+		std::cout << node_count << " nodes, " << new_doc->hierarchy.node.size() << " instances, " << new_doc->drivers.size() << " drivers:" << std::endl;
+
+		legacy::State state;
+		state.dirty.assign(old_doc->nodes.size(), 1);
+		std::vector<SceneTree::MeshTreeData> old_meshes, new_meshes;
+		std::vector<SceneTree::LightTreeData> lights;
+		std::vector<SceneTree::CameraTreeData> cameras;
+		std::vector<SceneTree::EnvironmentTreeData> environments;
+
+		// (first frame computes every local matrix, so it is left out of the timings)
+		legacy::update(state, *old_doc, 0.0f, old_meshes);
+		SceneTree::update_animation(new_doc, 0.0f);
+		SceneTree::traverse_scene(new_doc, new_meshes, lights, cameras, environments);
+
+		SceneTree::TreeChanges changes;
+		double old_total = 0.0;
+		double new_total = 0.0;
+		size_t changed = 0;
+		for (uint32_t f = 1; f <= frames; ++f) {
+			float time = std::fmod(f / 60.0f, 3.0f);
+			{
+				Timer timer([&](double elapsed) { old_total += elapsed; });
+				legacy::update(state, *old_doc, time, old_meshes);
+			}
+			{
+				Timer timer([&](double elapsed) { new_total += elapsed; });
+				SceneTree::update_animation(new_doc, time);
+				SceneTree::traverse_scene(new_doc, new_meshes, lights, cameras, environments, changes);
+			}
+			changed += changes.meshes.size();
+		}
+
+		float max_error = 0.0f;
+		if (old_meshes.size() != new_meshes.size()) throw std::runtime_error("Traversals emitted different mesh counts.");
+		for (size_t i = 0; i < old_meshes.size(); ++i) {
+			for (int c = 0; c < 4; ++c) {
+				for (int r = 0; r < 4; ++r) {
+					max_error = std::max(max_error, std::abs(old_meshes[i].model_matrix[c][r] - new_meshes[i].model_matrix[c][r]));
+				}
+			}
+		}
+
+		std::cout << "  recursive + hash map cache  " << old_total / frames * 1000.0 << " ms/frame" << std::endl;
+		std::cout << "  flattened, dirty ranges     " << new_total / frames * 1000.0 << " ms/frame ("
+		          << old_total / new_total << "x; max difference " << max_error << ")" << std::endl;
+		std::cout << "  " << static_cast<double>(changed) / frames << " of " << new_meshes.size() << " mesh entries changed per frame" << std::endl;
+	}
+	return 0;
+}
+
+// Flat scene with translation, rotation, and scale drivers on each node (in that order),
+// each with 'keys' keyframes at random times in [0, 8); translation and scale are LINEAR or STEP.
+static std::string make_animation_scene(uint32_t driver_count, uint32_t keys) {
+	std::mt19937 mt(0x5eed);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> time_dist(0.0f, 8.0f);
+
+	uint32_t node_count = (driver_count + 2) / 3;
+	std::ostringstream out;
+	out << "[\"s72-v2\",\n";
+	out << "{\"type\":\"SCENE\",\"name\":\"bench\",\"roots\":[";
+	for (uint32_t n = 0; n < node_count; ++n) out << (n ? "," : "") << "\"node-" << n << "\"";
+	out << "]}";
+	for (uint32_t n = 0; n < node_count; ++n) {
+		out << ",\n{\"type\":\"NODE\",\"name\":\"node-" << n << "\"}";
+	}
+	std::vector<float> times(keys);
+	for (uint32_t d = 0; d < driver_count; ++d) {
+		static const char *channels[3] = {"translation", "rotation", "scale"};
+		uint32_t channel = d % 3;
+		for (float &t : times) t = time_dist(mt);
+		std::sort(times.begin(), times.end());
+
+		out << ",\n{\"type\":\"DRIVER\",\"name\":\"driver-" << d << "\",\"node\":\"node-" << d / 3 << "\",\"channel\":\"" << channels[channel] << "\",\"times\":[";
+		for (uint32_t k = 0; k < keys; ++k) out << (k ? "," : "") << times[k];
+		out << "],\"values\":[";
+		for (uint32_t k = 0; k < keys; ++k) {
+			if (channel == 1) {
+				glm::vec4 q = glm::normalize(glm::vec4(dist(mt), dist(mt), dist(mt), dist(mt)));
+				out << (k ? "," : "") << q.x << "," << q.y << "," << q.z << "," << q.w;
+			} else {
+				out << (k ? "," : "") << dist(mt) << "," << dist(mt) << "," << dist(mt);
+			}
+		}
+		out << "],\"interpolation\":\"" << (channel != 1 && mt() % 4 == 0 ? "STEP" : "LINEAR") << "\"}";
+	}
+	out << "\n]\n";
+	return out.str();
+}
+
+// Times update_animation per frame with the old per-driver evaluation and with
+// compiled tracks (cursors + batched interpolation), and checks that they agree.
+static int run_animation(std::vector<double> const &sizes, uint32_t keys, uint32_t frames) {
+	for (double size : sizes) {
+		const uint32_t driver_count = static_cast<uint32_t>(size);
+		std::string scene = make_animation_scene(driver_count, keys);
+		auto old_doc = S72Loader::load_string(scene);
+		auto new_doc = S72Loader::load_string(scene);
+		std::cout << driver_count << " drivers, " << keys << " keys each:" << std::endl;
+
+		double old_total = 0.0;
+		double new_total = 0.0;
+		for (uint32_t f = 0; f < frames; ++f) {
+			float time = std::fmod(f / 60.0f, 9.0f) - 0.5f; //(also runs off both ends and wraps around)
+			{
+				Timer timer([&](double elapsed) { old_total += elapsed; });
+				legacy::animate(*old_doc, time);
+			}
+			{
+				Timer timer([&](double elapsed) { new_total += elapsed; });
+				SceneTree::update_animation(new_doc, time);
+			}
+			new_doc->hierarchy.dirty_nodes.clear(); //(as traverse_scene would)
+			std::fill(new_doc->hierarchy.local_dirty.begin(), new_doc->hierarchy.local_dirty.end(), uint8_t(0));
+		}
+
+		float max_error = 0.0f;
+		S72Loader::Hierarchy const &h = new_doc->hierarchy;
+		for (size_t n = 0; n < old_doc->nodes.size(); ++n) {
+			S72Loader::Node const &node = old_doc->nodes[n];
+			for (int c = 0; c < 3; ++c) {
+				max_error = std::max(max_error, std::abs(node.translation[c] - h.translation[n][c]));
+				max_error = std::max(max_error, std::abs(node.scale[c] - h.scale[n][c]));
+			}
+			for (int c = 0; c < 4; ++c) {
+				max_error = std::max(max_error, std::abs(node.rotation[c] - h.rotation[n][c]));
+			}
+		}
+
+		std::cout << "  per-driver search      " << old_total / frames * 1000.0 << " ms/frame" << std::endl;
+		std::cout << "  compiled tracks        " << new_total / frames * 1000.0 << " ms/frame ("
+		          << old_total / new_total << "x; max difference " << max_error << ")" << std::endl;
+	}
+	return 0;
+}
+
+// The per-frame CPU work of A3::update (and SSAO/SSDO/Deferred) on a JobSystem: animation, transforms,
+// shadow instances and bounds for moved meshes, BVH culling, then instance lists built per chunk and appended in chunk order.
+struct UpdateInstance {
+	glm::mat4 MODEL;
+	glm::mat4 MODEL_NORMAL;
+	size_t mesh_index;
+};
+
+struct UpdateState {
+	std::vector<SceneTree::MeshTreeData> meshes;
+	std::vector<SceneTree::LightTreeData> lights;
+	std::vector<SceneTree::CameraTreeData> cameras;
+	std::vector<SceneTree::EnvironmentTreeData> environments;
+	std::vector<UpdateInstance> shadow;
+	std::vector<UpdateInstance> visible;
+	std::vector<std::vector<UpdateInstance>> chunks;
+	SceneTree::TreeChanges changes;
+	std::vector<BVH::Box> bounds;
+	BVH bvh;
+	std::vector<uint64_t> mask;
+};
+
+static void run_update_frame(JobSystem &jobs, std::shared_ptr<S72Loader::Document> doc, float time, CameraManager::Frustum const &frustum, UpdateState &state) {
+	SceneTree::update_animation(doc, time, &jobs);
+	SceneTree::traverse_scene(doc, state.meshes, state.lights, state.cameras, state.environments, state.changes, &jobs);
+
+	const size_t ChunkSize = 1024;
+	auto update_mesh = [&](size_t i) {
+		const glm::mat4 MODEL = state.meshes[i].model_matrix;
+		const auto &range = doc->meshes[state.meshes[i].mesh_index].range;
+		state.shadow[i] = UpdateInstance{MODEL, glm::transpose(glm::inverse(MODEL)), state.meshes[i].mesh_index};
+		state.bounds[i] = BVH::transform_box(MODEL, range.aabb_min, range.aabb_max);
+	};
+	if (state.changes.all || state.shadow.size() != state.meshes.size()) {
+		state.shadow.resize(state.meshes.size());
+		state.bounds.resize(state.meshes.size());
+		jobs.parallel_for(state.meshes.size(), ChunkSize, [&](size_t, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) update_mesh(i);
+		});
+		state.bvh.build(state.bounds);
+	} else {
+		jobs.parallel_for(state.changes.meshes.size(), ChunkSize, [&](size_t, size_t begin, size_t end) {
+			for (size_t k = begin; k < end; ++k) update_mesh(state.changes.meshes[k]);
+		});
+		for (uint32_t i : state.changes.meshes) {
+			state.bvh.update(i, state.bounds[i]);
+		}
+		state.bvh.refit();
+	}
+	state.bvh.cull(frustum, state.mask);
+
+	state.chunks.resize(JobSystem::chunk_count(state.meshes.size(), ChunkSize));
+	jobs.parallel_for(state.meshes.size(), ChunkSize, [&](size_t chunk, size_t begin, size_t end) {
+		std::vector<UpdateInstance> &out = state.chunks[chunk];
+		out.clear();
+		for (size_t word = begin / 64; word < (end + 63) / 64; ++word) {
+			for (uint64_t bits = state.mask[word]; bits != 0; bits &= bits - 1) {
+				out.push_back(state.shadow[word * 64 + size_t(std::countr_zero(bits))]);
+			}
+		}
+	});
+	state.visible.clear();
+	for (auto const &chunk : state.chunks) {
+		state.visible.insert(state.visible.end(), chunk.begin(), chunk.end());
+	}
+}
+
+static bool same_instances(std::vector<UpdateInstance> const &a, std::vector<UpdateInstance> const &b) {
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (std::memcmp(&a[i].MODEL, &b[i].MODEL, sizeof(glm::mat4)) != 0) return false;
+		if (std::memcmp(&a[i].MODEL_NORMAL, &b[i].MODEL_NORMAL, sizeof(glm::mat4)) != 0) return false;
+		if (a[i].mesh_index != b[i].mesh_index) return false;
+	}
+	return true;
+}
+
+// Times the scene update for each thread count (make_hierarchy_scene, so 1/16th of nodes animate),
+// and checks every thread count produces exactly the serial result.
+static int run_update(std::vector<double> const &sizes, std::vector<double> const &thread_counts, uint32_t frames) {
+	// a box around the middle of the scene (part of it is culled):
+	CameraManager::Frustum frustum;
+	for (int p = 0; p < 6; ++p) {
+		glm::vec3 normal(0.0f);
+		normal[p / 2] = (p % 2 ? -1.0f : 1.0f);
+		frustum.planes[p].normal = normal;
+		frustum.planes[p].distance = 2.0f;
+	}
+
+	for (double size : sizes) {
+		const uint32_t node_count = static_cast<uint32_t>(size);
+		std::string scene = make_hierarchy_scene(node_count);
+
+		UpdateState reference;
+		double serial = 0.0;
+		for (double threads_d : thread_counts) {
+			const uint32_t threads = static_cast<uint32_t>(threads_d);
+			JobSystem jobs(threads);
+			auto doc = S72Loader::load_string(scene);
+			for (auto &mesh : doc->meshes) { //(the mesh data isn't there to compute bounds from)
+				mesh.range.aabb_min = glm::vec3(-0.1f);
+				mesh.range.aabb_max = glm::vec3(0.1f);
+			}
+			if (threads_d == thread_counts.front()) {
+				std::cout << node_count << " nodes, " << doc->hierarchy.node.size() << " instances, " << doc->drivers.size() << " drivers:" << std::endl;
+			}
+
+			UpdateState state;
+			run_update_frame(jobs, doc, 0.0f, frustum, state); //(first frame fills the outputs; not timed)
+			double total = 0.0;
+			for (uint32_t f = 1; f <= frames; ++f) {
+				float time = std::fmod(f / 60.0f, 3.0f);
+				Timer timer([&](double elapsed) { total += elapsed; });
+				run_update_frame(jobs, doc, time, frustum, state);
+			}
+
+			bool same = true;
+			if (reference.meshes.empty()) {
+				reference = state;
+				serial = total;
+			} else {
+				same = same_instances(reference.shadow, state.shadow) && same_instances(reference.visible, state.visible);
+			}
+			std::cout << "  " << jobs.thread_count() << " thread" << (jobs.thread_count() == 1 ? " " : "s") << "  "
+			          << total / frames * 1000.0 << " ms/frame (" << serial / total << "x; "
+			          << state.visible.size() << " of " << state.shadow.size() << " visible"
+			          << (same ? "" : "; DIFFERS from first run") << ")" << std::endl;
+			if (!same) return 1;
+		}
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+
+int bench_hierarchy(std::vector<std::string> const &args) {
+	std::vector<double> sizes{1000.0, 10000.0, 100000.0, 1000000.0};
+	uint32_t frames = 100;
+	Options options;
+	options.add("--nodes", sizes);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_hierarchy(sizes, frames);
+}
+
+int bench_animation(std::vector<std::string> const &args) {
+	std::vector<double> sizes{1000.0, 50000.0};
+	uint32_t keys = 32;
+	uint32_t frames = 600;
+	Options options;
+	options.add("--drivers", sizes);
+	options.add("--keys", keys);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_animation(sizes, keys, frames);
+}
+
+int bench_update(std::vector<std::string> const &args) {
+	std::vector<double> sizes{100000.0};
+	std::vector<double> threads{1.0, 2.0, 4.0, 8.0, 16.0};
+	uint32_t frames = 100;
+	Options options;
+	options.add("--nodes", sizes);
+	options.add("--threads", threads);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_update(sizes, threads, frames);
+}
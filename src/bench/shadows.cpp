@@ -0,0 +1,470 @@
+// Shadows: per-view caster culling, shadow map caching, and the spot light shadow atlas.
+
+#include "bench.hpp"
+
+#include "BVH.hpp"
+#include "JobSystem.hpp"
+#include "LightsManager.hpp"
+#include "ShadowAtlas.hpp"
+#include "ShadowCache.hpp"
+#include "Timer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+//--------------------------------------------------------------------
+// Shadow caster culling: the city lit by a couple of cascaded suns plus spot and sphere lights,
+// comparing per-view caster lists against drawing every instance into every shadow view.
+
+// reversed-Z and flipped Y, as LightsManager builds its light matrices:
+static glm::mat4 to_light_clip(glm::mat4 proj) {
+	proj[1][1] *= -1.0f;
+	for (int c = 0; c < 4; ++c) proj[c][2] = proj[c][3] - proj[c][2];
+	return proj;
+}
+
+// a couple of suns with cascades covering growing slices of the view from 'eye' along 'forward', and the rest
+// of the lights half spots pointing down into the streets and half spheres among the buildings around it:
+struct ShadowLights {
+	std::vector<LightsManager::SunLight> suns;
+	std::vector<LightsManager::SpotLight> spots;
+	std::vector<LightsManager::SphereLight> spheres;
+	std::vector<LightsManager::SphereShadowMatrices> sphere_matrices;
+};
+
+static ShadowLights make_shadow_lights(glm::vec3 eye, glm::vec3 forward, uint32_t light_count, std::mt19937 &mt) {
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float cascade_far[LightsManager::SunCascadeCount] = {15.0f, 50.0f, 150.0f, 400.0f};
+
+	ShadowLights lights;
+	std::vector<LightsManager::SunLight> &suns = lights.suns;
+	suns.resize(std::min(light_count, 2u));
+	for (size_t l = 0; l < suns.size(); ++l) {
+		auto &sun = suns[l];
+		sun.direction = glm::normalize(glm::vec3(0.3f + 0.4f * float(l), -1.0f, 0.2f));
+		float cascade_near = 0.1f;
+		for (uint32_t c = 0; c < LightsManager::SunCascadeCount; ++c) {
+			const float radius = 0.5f * (cascade_far[c] - cascade_near) + 10.0f;
+			const glm::vec3 center = eye + forward * (0.5f * (cascade_near + cascade_far[c]));
+			const glm::mat4 view = glm::lookAtRH(center - sun.direction * 500.0f, center, glm::vec3(0.0f, 0.0f, 1.0f));
+			sun.orthographic[c] = to_light_clip(glm::orthoRH_ZO(-radius, radius, -radius, radius, 500.0f - radius, 500.0f + radius)) * view;
+			cascade_near = cascade_far[c];
+		}
+	}
+
+	const uint32_t local_count = light_count - uint32_t(suns.size());
+	std::vector<LightsManager::SpotLight> &spots = lights.spots;
+	std::vector<LightsManager::SphereLight> &spheres = lights.spheres;
+	std::vector<LightsManager::SphereShadowMatrices> &sphere_matrices = lights.sphere_matrices;
+	spots.resize(local_count / 2);
+	spheres.resize(local_count - spots.size());
+	sphere_matrices.resize(spheres.size());
+	auto near_eye = [&]() {
+		return eye + glm::vec3(200.0f * (unit(mt) - 0.5f), 0.0f, 200.0f * (unit(mt) - 0.5f));
+	};
+	for (auto &spot : spots) {
+		spot.position = near_eye() + glm::vec3(0.0f, 10.0f + 20.0f * unit(mt), 0.0f);
+		spot.direction = glm::normalize(glm::vec3(unit(mt) - 0.5f, -1.0f, unit(mt) - 0.5f));
+		spot.fov = 0.6f + 0.6f * unit(mt);
+		spot.near_plane = 0.1f;
+		spot.far_plane = 40.0f;
+		spot.perspective = to_light_clip(glm::perspectiveRH_ZO(spot.fov, 1.0f, spot.near_plane, spot.far_plane))
+		                 * glm::lookAtRH(spot.position, spot.position + spot.direction, glm::vec3(0.0f, 0.0f, 1.0f));
+	}
+	const glm::vec3 face_dirs[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+	const glm::vec3 face_ups[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+	for (size_t l = 0; l < spheres.size(); ++l) {
+		auto &sphere = spheres[l];
+		sphere.position = near_eye() + glm::vec3(0.0f, 3.0f + 10.0f * unit(mt), 0.0f);
+		sphere.near_plane = 0.1f;
+		sphere.far_plane = 15.0f + 15.0f * unit(mt);
+		for (uint32_t f = 0; f < 6; ++f) {
+			sphere_matrices[l].face_pv[f] = to_light_clip(glm::perspectiveRH_ZO(1.5707963f, 1.0f, sphere.near_plane, sphere.far_plane))
+			                              * glm::lookAtRH(sphere.position, sphere.position + face_dirs[f], face_ups[f]);
+		}
+	}
+	return lights;
+}
+
+static int run_shadows(std::vector<double> const &sizes, uint32_t light_count, uint32_t repeat) {
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+		const float spacing = 8.0f;
+		const float extent = spacing * float(side);
+
+		std::mt19937 mt(0x5add0);
+		std::vector<glm::mat4> models = make_city(count, side, spacing, mt);
+		std::vector<BVH::Box> bounds(count);
+		for (size_t i = 0; i < count; ++i) {
+			bounds[i] = BVH::transform_box(models[i], glm::vec3(-1.0f), glm::vec3(1.0f));
+		}
+		BVH bvh;
+		bvh.build(bounds);
+
+		// the viewer stands in the middle of the city:
+		const glm::vec3 eye(0.5f * extent, 20.0f, 0.5f * extent);
+		const glm::vec3 forward = glm::normalize(glm::vec3(1.0f, -0.1f, 0.3f));
+		ShadowLights lights = make_shadow_lights(eye, forward, light_count, mt);
+		auto const &suns = lights.suns;
+		auto const &spots = lights.spots;
+		auto const &spheres = lights.spheres;
+		auto const &sphere_matrices = lights.sphere_matrices;
+
+		LightsManager::ShadowCasters sun_casters, sphere_casters, spot_casters;
+		double serial_time = 0.0, parallel_time = 0.0;
+		JobSystem jobs;
+		for (uint32_t r = 0; r < repeat; ++r) {
+			{
+				Timer timer([&](double elapsed) { serial_time += elapsed; });
+				LightsManager::cull_shadow_casters(bvh, suns, spheres, sphere_matrices, spots, sun_casters, sphere_casters, spot_casters);
+			}
+			{
+				Timer timer([&](double elapsed) { parallel_time += elapsed; });
+				LightsManager::cull_shadow_casters(bvh, suns, spheres, sphere_matrices, spots, sun_casters, sphere_casters, spot_casters, &jobs);
+			}
+		}
+
+		// check every view against a linear pass over all instances:
+		size_t differ = 0;
+		auto check = [&](LightsManager::ShadowCasters const &casters, uint32_t view, auto const &casts) {
+			std::vector<uint32_t> expected, got(casters.instances.begin() + casters.first(view), casters.instances.begin() + casters.first(view) + casters.count(view));
+			for (uint32_t i = 0; i < uint32_t(count); ++i) {
+				if (casts(bounds[i])) expected.emplace_back(i);
+			}
+			std::sort(got.begin(), got.end());
+			if (got != expected) differ += 1;
+		};
+		for (uint32_t v = 0; v < sun_casters.view_count(); ++v) {
+			CameraManager::Frustum frustum = CameraManager::Frustum::from_matrix(suns[v / LightsManager::SunCascadeCount].orthographic[v % LightsManager::SunCascadeCount]);
+			for (size_t p = 4; p < 6; ++p) {
+				if (glm::dot(frustum.planes[p].normal, suns[v / LightsManager::SunCascadeCount].direction) > 0.0f) {
+					frustum.planes[p] = CameraManager::FrustumPlane{glm::vec3(0.0f), std::numeric_limits<float>::max()};
+				}
+			}
+			check(sun_casters, v, [&](BVH::Box const &box) { return frustum.is_box_visible(box.min, box.max); });
+		}
+		for (uint32_t v = 0; v < sphere_casters.view_count(); ++v) {
+			const auto &sphere = spheres[v / 6];
+			const CameraManager::Frustum frustum = CameraManager::Frustum::from_matrix(sphere_matrices[v / 6].face_pv[v % 6]);
+			check(sphere_casters, v, [&](BVH::Box const &box) {
+				const glm::vec3 d = glm::max(glm::max(box.min - sphere.position, sphere.position - box.max), glm::vec3(0.0f));
+				return glm::dot(d, d) <= sphere.far_plane * sphere.far_plane && frustum.is_box_visible(box.min, box.max);
+			});
+		}
+		for (uint32_t v = 0; v < spot_casters.view_count(); ++v) {
+			const CameraManager::Frustum frustum = CameraManager::Frustum::from_matrix(spots[v].perspective);
+			check(spot_casters, v, [&](BVH::Box const &box) { return frustum.is_box_visible(box.min, box.max); });
+		}
+
+		const size_t views = sun_casters.view_count() + sphere_casters.view_count() + spot_casters.view_count();
+		const size_t draws_before = views * count;
+		const size_t draws_after = sun_casters.instances.size() + sphere_casters.instances.size() + spot_casters.instances.size();
+		std::cout << count << " instances, " << suns.size() << " suns + " << spots.size() << " spots + " << spheres.size() << " spheres ("
+		          << views << " shadow views):\n"
+		          << "  draws, every instance in every view: " << draws_before << "\n"
+		          << "  draws, per-view casters:             " << draws_after << " (sun " << sun_casters.instances.size()
+		          << ", sphere " << sphere_casters.instances.size() << ", spot " << spot_casters.instances.size() << "; "
+		          << double(draws_before) / double(std::max<size_t>(draws_after, 1)) << "x fewer)\n"
+		          << "  culling:                             " << serial_time / repeat * 1000.0 << " ms serial, "
+		          << parallel_time / repeat * 1000.0 << " ms on " << jobs.thread_count() << " threads\n"
+		          << "  " << differ << " views differ from a linear test" << std::endl;
+		if (differ != 0) return 1;
+
+		// layered rendering (--layered-shadows): each light's views merged into one pass, each caster listed once
+		// with a mask of the views it was culled into; the masks must give back exactly the per-view lists
+		auto report_layered = [&](char const *name, LightsManager::ShadowCasters const &casters, uint32_t layer_count) {
+			std::vector<uint32_t> masks(count, 0), unique;
+			size_t listed = 0, masks_differ = 0;
+			for (uint32_t light = 0; light < casters.view_count() / layer_count; ++light) {
+				unique.clear();
+				for (uint32_t layer = 0; layer < layer_count; ++layer) {
+					const uint32_t view = light * layer_count + layer;
+					for (uint32_t k = casters.first(view); k < casters.first(view) + casters.count(view); ++k) {
+						if (masks[casters.instances[k]] == 0) unique.emplace_back(casters.instances[k]);
+						masks[casters.instances[k]] |= 1u << layer;
+					}
+				}
+				for (uint32_t layer = 0; layer < layer_count; ++layer) {
+					const uint32_t view = light * layer_count + layer;
+					std::vector<uint32_t> expected(casters.instances.begin() + casters.first(view), casters.instances.begin() + casters.first(view) + casters.count(view)), got;
+					for (uint32_t i : unique) {
+						if (masks[i] & (1u << layer)) got.emplace_back(i);
+					}
+					std::sort(expected.begin(), expected.end());
+					std::sort(got.begin(), got.end());
+					if (got != expected) masks_differ += 1;
+				}
+				for (uint32_t i : unique) masks[i] = 0;
+				listed += unique.size();
+			}
+			std::cout << "  " << name << ", layered: " << casters.view_count() / layer_count << " passes (not " << casters.view_count()
+			          << "), " << listed << " caster entries (not " << casters.instances.size() << "; "
+			          << double(casters.instances.size()) / double(std::max<size_t>(listed, 1)) << " views per caster), "
+			          << masks_differ << " views differ from their masks" << std::endl;
+			return masks_differ;
+		};
+		if (report_layered("suns", sun_casters, LightsManager::SunCascadeCount) != 0) return 1;
+		if (report_layered("spheres", sphere_casters, LightsManager::SphereShadowFaceCount) != 0) return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+// Shadow map caching: the city and lights of `shadows`, with a few instances moving every frame (and the viewer,
+// so the sun cascades, standing still), counting the shadow views each ShadowCache mode redraws.
+
+static int run_shadow_cache(std::vector<double> const &sizes, uint32_t light_count, uint32_t moving_count, uint32_t frames) {
+	for (double size : sizes) {
+		const size_t count = static_cast<size_t>(size);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+		const float spacing = 8.0f;
+		const float extent = spacing * float(side);
+
+		std::mt19937 mt(0x5add0);
+		std::vector<glm::mat4> models = make_city(count, side, spacing, mt);
+		std::vector<BVH::Box> bounds(count);
+		for (size_t i = 0; i < count; ++i) {
+			bounds[i] = BVH::transform_box(models[i], glm::vec3(-1.0f), glm::vec3(1.0f));
+		}
+		BVH bvh;
+		bvh.build(bounds);
+
+		const glm::vec3 eye(0.5f * extent, 20.0f, 0.5f * extent);
+		const glm::vec3 forward = glm::normalize(glm::vec3(1.0f, -0.1f, 0.3f));
+		ShadowLights lights = make_shadow_lights(eye, forward, light_count, mt);
+
+		// the moving instances ("cars") drive back and forth near the viewer:
+		std::vector<uint32_t> movers;
+		for (size_t i = 0; i < count && movers.size() < moving_count; ++i) {
+			const glm::vec3 position(models[i][3]);
+			if (std::abs(position.x - eye.x) < 100.0f && std::abs(position.z - eye.z) < 100.0f) movers.emplace_back(uint32_t(i));
+		}
+
+		std::vector<glm::mat4> sun_matrices, sphere_matrices, spot_matrices;
+		for (auto const &sun : lights.suns) sun_matrices.insert(sun_matrices.end(), std::begin(sun.orthographic), std::end(sun.orthographic));
+		for (auto const &matrices : lights.sphere_matrices) sphere_matrices.insert(sphere_matrices.end(), matrices.face_pv.begin(), matrices.face_pv.end());
+		for (auto const &spot : lights.spots) spot_matrices.emplace_back(spot.perspective);
+
+		ShadowCache static_cache, split_cache;
+		LightsManager::ShadowCasters sun_casters, sphere_casters, spot_casters;
+		std::array<LightsManager::ShadowCasters *, ShadowCache::KindCount> casters{&sun_casters, &sphere_casters, &spot_casters};
+		std::array<std::vector<glm::mat4> const *, ShadowCache::KindCount> matrices{&sun_matrices, &sphere_matrices, &spot_matrices};
+		std::array<std::vector<std::vector<uint32_t>>, ShadowCache::KindCount> previous_sets; //per view: sorted casters, last frame
+		JobSystem jobs;
+
+		std::vector<uint32_t> moved;
+		uint64_t views = 0, plain_draws = 0, static_draws = 0, split_draws = 0, missed = 0;
+		double static_time = 0.0, split_time = 0.0;
+		for (uint32_t frame = 0; frame < frames; ++frame) {
+			moved.clear();
+			if (frame > 0) {
+				for (uint32_t i : movers) {
+					models[i][3].x += ((frame / 60) % 2 == 0 ? 0.25f : -0.25f);
+					bounds[i] = BVH::transform_box(models[i], glm::vec3(-1.0f), glm::vec3(1.0f));
+					bvh.update(i, bounds[i]);
+					moved.emplace_back(i);
+				}
+				bvh.refit();
+			}
+			LightsManager::cull_shadow_casters(bvh, lights.suns, lights.spheres, lights.sphere_matrices, lights.spots,
+				sun_casters, sphere_casters, spot_casters, &jobs);
+
+			{
+				Timer timer([&](double elapsed) { static_time += elapsed; });
+				static_cache.begin_update(false, moved, frame == 0, count);
+				for (uint32_t kind = 0; kind < ShadowCache::KindCount; ++kind) {
+					static_cache.update_views(ShadowCache::Kind(kind), *matrices[kind], casters[kind]->instances, casters[kind]->view_first);
+				}
+			}
+			{
+				Timer timer([&](double elapsed) { split_time += elapsed; });
+				split_cache.begin_update(true, moved, frame == 0, count);
+				for (uint32_t kind = 0; kind < ShadowCache::KindCount; ++kind) {
+					split_cache.update_views(ShadowCache::Kind(kind), *matrices[kind], casters[kind]->instances, casters[kind]->view_first);
+				}
+			}
+
+			// draws with each mode, and a check that every view whose casters changed (as sets) or moved was redrawn:
+			for (uint32_t kind = 0; kind < ShadowCache::KindCount; ++kind) {
+				LightsManager::ShadowCasters const &kind_casters = *casters[kind];
+				previous_sets[kind].resize(kind_casters.view_count());
+				for (uint32_t v = 0; v < kind_casters.view_count(); ++v) {
+					ShadowCache::View const &cached = static_cache.views[kind][v];
+					ShadowCache::View const &split = split_cache.views[kind][v];
+					const uint32_t first = kind_casters.first(v), end = first + kind_casters.count(v);
+					views += 1;
+					plain_draws += kind_casters.count(v);
+					if (cached.draw) static_draws += kind_casters.count(v);
+					if (split.draw_static) split_draws += split.dynamic_first - first;
+					if (split.draw) split_draws += end - split.dynamic_first;
+
+					std::vector<uint32_t> set(kind_casters.instances.begin() + first, kind_casters.instances.begin() + end);
+					std::sort(set.begin(), set.end());
+					bool dirty = (frame == 0 || set != previous_sets[kind][v]);
+					for (uint32_t i : moved) dirty = dirty || std::binary_search(set.begin(), set.end(), i);
+					if (dirty && (!cached.draw || !split.draw)) missed += 1;
+					previous_sets[kind][v] = std::move(set);
+				}
+			}
+		}
+
+		std::cout << count << " instances, " << movers.size() << " moving, " << views / frames << " shadow views, " << frames << " frames:\n"
+		          << "  views redrawn:      static cache " << static_cache.total.drawn << ", split cache " << split_cache.total.drawn
+		          << " (" << split_cache.total.static_drawn << " static maps) of " << views
+		          << " (" << static_cache.total.hit_rate() * 100.0 << "% / " << split_cache.total.hit_rate() * 100.0 << "% kept)\n"
+		          << "  caster draws/frame: no cache " << plain_draws / frames << ", static cache " << static_draws / frames
+		          << ", split cache " << split_draws / frames << "\n"
+		          << "  cache update:       " << static_time / frames * 1000.0 << " ms static, " << split_time / frames * 1000.0 << " ms split (per frame)\n"
+		          << "  " << missed << " changed views not redrawn" << std::endl;
+		if (missed != 0) return 1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------
+// Shadow atlas: spot lights along the streets of a city, seen by a camera walking down one of them; a few lights'
+// casters move each frame. Tiles are sized by screen coverage, and at most 'budget' are drawn per frame.
+
+static int run_shadow_atlas(uint32_t light_count, uint32_t atlas_size, uint32_t budget, uint32_t moving_count, uint32_t frames) {
+	const uint32_t map_size = 1024; // each light's own map, without the atlas
+	const float screen_width = 1920.0f, screen_height = 1080.0f, fov = 1.0f;
+
+	std::mt19937 mt(0xa71a5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	struct Spot {
+		glm::vec3 position;
+		float reach;
+	};
+	std::vector<Spot> spots(light_count);
+	for (Spot &spot : spots) {
+		spot.position = glm::vec3(400.0f * unit(mt), 8.0f + 8.0f * unit(mt), 40.0f * (unit(mt) - 0.5f));
+		spot.reach = 15.0f + 25.0f * unit(mt);
+	}
+
+	ShadowAtlas atlas, unlimited;
+	atlas.configure(atlas_size, 64, budget);
+	unlimited.configure(atlas_size, 64, 0);
+	std::vector<ShadowAtlas::Request> requests(light_count);
+	std::vector<uint8_t> cells; // (overlap check) per smallest tile of the atlas: covered
+	const uint32_t cells_per_side = atlas_size / atlas.min_tile;
+
+	uint64_t drawn = 0, most_drawn = 0, drawn_texels = 0, unlimited_texels = 0, visible = 0, unmapped_visible = 0, overlaps = 0;
+	uint32_t longest_wait = 0;
+	double update_time = 0.0;
+	for (uint32_t frame = 0; frame < frames; ++frame) {
+		const glm::vec3 eye(-20.0f + 0.5f * float(frame % 900), 1.7f, 0.0f);
+		const glm::vec3 forward = glm::normalize(glm::vec3(1.0f, -0.05f, 0.1f * std::sin(0.01f * float(frame))));
+		const CameraManager::Frustum frustum = make_view_frustum(eye, forward, glm::vec3(0.0f, 1.0f, 0.0f), fov, screen_width / screen_height, 0.1f, 1000.0f);
+
+		for (uint32_t i = 0; i < light_count; ++i) {
+			Spot const &spot = spots[i];
+			ShadowAtlas::Request request{.resolution = 0, .importance = 0.0f, .dirty = true};
+			if (frustum.is_box_visible(spot.position - glm::vec3(spot.reach), spot.position + glm::vec3(spot.reach))) {
+				request = ShadowAtlas::coverage_request(glm::length(spot.position - eye), spot.reach, fov, screen_width, screen_height, map_size);
+				visible += 1;
+			}
+			request.dirty = (frame == 0);
+			requests[i] = request;
+		}
+		for (uint32_t m = 0; m < moving_count; ++m) requests[mt() % light_count].dirty = true;
+
+		{
+			Timer timer([&](double elapsed) { update_time += elapsed; });
+			atlas.update(requests);
+		}
+		unlimited.update(requests);
+
+		cells.assign(size_t(cells_per_side) * cells_per_side, 0);
+		uint32_t frame_drawn = 0;
+		for (uint32_t i = 0; i < light_count; ++i) {
+			ShadowAtlas::Light const &light = atlas.lights[i];
+			if (light.draw) {
+				frame_drawn += 1;
+				drawn_texels += uint64_t(light.tile.size) * light.tile.size;
+			}
+			if (requests[i].importance > 0.0f && !light.valid) unmapped_visible += 1;
+			if (requests[i].importance > 0.0f) longest_wait = std::max(longest_wait, light.waited);
+			if (!light.valid) continue;
+			for (uint32_t y = light.tile.y / atlas.min_tile; y < (light.tile.y + light.tile.size) / atlas.min_tile; ++y) {
+				for (uint32_t x = light.tile.x / atlas.min_tile; x < (light.tile.x + light.tile.size) / atlas.min_tile; ++x) {
+					if (x >= cells_per_side || y >= cells_per_side || cells[size_t(y) * cells_per_side + x]++) overlaps += 1;
+				}
+			}
+		}
+		for (ShadowAtlas::Light const &light : unlimited.lights) {
+			if (light.draw) unlimited_texels += uint64_t(light.tile.size) * light.tile.size;
+		}
+		drawn += frame_drawn;
+		most_drawn = std::max<uint64_t>(most_drawn, frame_drawn);
+	}
+
+	const double mtexels = 1.0 / (1024.0 * 1024.0);
+	std::cout << light_count << " spot lights, " << atlas_size << "^2 atlas, budget " << budget << " tiles, " << moving_count << " lights' casters moving, " << frames << " frames:\n"
+	          << "  memory:          " << double(light_count) * map_size * map_size * mtexels << " Mtexels as separate " << map_size << "^2 maps, "
+	          << double(atlas_size) * atlas_size * mtexels << " Mtexels as an atlas\n"
+	          << "  drawn/frame:     " << double(drawn) / frames << " tiles (at most " << most_drawn << "), "
+	          << double(drawn_texels) / frames * mtexels << " Mtexels; " << double(unlimited_texels) / frames * mtexels
+	          << " Mtexels without a budget; " << double(light_count) * map_size * map_size * mtexels << " Mtexels redrawing every map\n"
+	          << "  atlas in use:    " << double(atlas.last.texels) * 100.0 / (double(atlas_size) * atlas_size) << "% (last frame)\n"
+	          << "  visible lights:  " << double(visible) / frames << " per frame, " << double(unmapped_visible) / frames
+	          << " without a map, longest wait " << longest_wait << " frames\n"
+	          << "  atlas update:    " << update_time / frames * 1000.0 << " ms per frame\n"
+	          << "  " << overlaps << " overlapping tile cells" << std::endl;
+	if (overlaps != 0 || (budget != 0 && most_drawn > budget)) return 1;
+	return 0;
+}
+
+//--------------------------------------------------------------------
+
+int bench_shadows(std::vector<std::string> const &args) {
+	std::vector<double> sizes{200000.0};
+	uint32_t lights = 50;
+	uint32_t repeat = 20;
+	Options options;
+	options.add("--instances", sizes);
+	options.add("--lights", lights);
+	options.add("--repeat", repeat);
+	options.parse(args);
+	return run_shadows(sizes, lights, std::max(repeat, 1u));
+}
+
+int bench_shadow_cache(std::vector<std::string> const &args) {
+	std::vector<double> sizes{200000.0};
+	uint32_t lights = 50;
+	uint32_t moving = 20;
+	uint32_t frames = 300;
+	Options options;
+	options.add("--instances", sizes);
+	options.add("--lights", lights);
+	options.add("--moving", moving);
+	options.add("--frames", frames);
+	options.parse(args);
+	return run_shadow_cache(sizes, lights, moving, std::max(frames, 1u));
+}
+
+int bench_shadow_atlas(std::vector<std::string> const &args) {
+	uint32_t lights = 64;
+	uint32_t size = 4096;
+	uint32_t budget = 8;
+	uint32_t moving = 8;
+	uint32_t frames = 900;
+	Options options;
+	options.add("--lights", lights);
+	options.add("--size", size);
+	options.add("--budget", budget);
+	options.add("--moving", moving);
+	options.add("--frames", frames);
+	options.parse(args);
+	if (lights == 0 || size < 256 || !std::has_single_bit(size)) {
+		throw UsageError("shadow-atlas needs at least one light and a power-of-two --size of at least 256");
+	}
+	return run_shadow_atlas(lights, size, budget, moving, std::max(frames, 1u));
+}
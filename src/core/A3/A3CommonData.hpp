@@ -23,4 +23,33 @@ namespace A3CommonData
         glm::mat4 MODEL_NORMAL;
     };
     static_assert(sizeof(Transform) == 16*4 + 16*4, "Transform is the expected size.");
+
+    //GPU culling (--gpu-culling), matching A3-cull.comp:
+    //passes an instance can be drawn in (CullInstance::PASS_MASK, CullView::PASS_MASK):
+    enum CullPass : uint32_t {
+        CullLambertian = 1,
+        CullPBR = 2,
+        CullShadow = 4,
+    };
+
+    //one per mesh_tree_data entry; instance i draws with transform (and material) i:
+    struct CullInstance {
+        glm::vec3 BOUNDS_MIN; //world-space bounds
+        uint32_t FIRST_VERTEX;
+        glm::vec3 BOUNDS_MAX;
+        uint32_t VERTEX_COUNT;
+        uint32_t PASS_MASK;
+        uint32_t _pad_[3];
+    };
+    static_assert(sizeof(CullInstance) == 16*3, "CullInstance is the expected size.");
+
+    //one per pass that draws culled instances (main view, every shadow view):
+    struct CullView {
+        glm::vec4 PLANES[6]; //(normal, distance), as CameraManager::Frustum
+        uint32_t PASS_MASK; //instances with one of these bits are drawn in this view
+        uint32_t FIRST_COMMAND; //draw commands of this view start here...
+        uint32_t CAPACITY; //...and hold at most this many
+        uint32_t OCCLUSION_MASK; //this view's bit of the CullVisibility buffer (0: no occlusion culling)
+    };
+    static_assert(sizeof(CullView) == 16*6 + 16, "CullView is the expected size.");
 } // namespace A3CommonData
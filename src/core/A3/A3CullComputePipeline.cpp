@@ -0,0 +1,208 @@
+#include "A3CullComputePipeline.hpp"
+#include "Helpers.hpp"
+#include "VK.hpp"
+
+#include <vector>
+#include <array>
+#include <cassert>
+
+static uint32_t comp_code[] = {
+#include "../../shaders/spv/A3-cull.comp.inl"
+};
+
+void A3CullComputePipeline::create(
+		RTG &rtg, 
+		VkRenderPass render_pass, 
+		uint32_t subpass,
+        const ManagerContext& context
+	) {
+    comp_module = rtg.helpers.create_shader_module(comp_code);
+
+    { // set0_Cull
+        std::array< VkDescriptorSetLayoutBinding, 5 > bindings;
+        for (uint32_t i = 0; i < uint32_t(bindings.size()); ++i) {
+            bindings[i] = VkDescriptorSetLayoutBinding{
+                .binding = i,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            };
+        }
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data(),
+        };
+
+        VK( vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Cull) );
+    }
+
+    { // set1_HiZ
+        VkDescriptorSetLayoutBinding binding{
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        };
+
+        //without --occlusion-culling there is no pyramid, and the shader never reads it:
+        VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = 1,
+            .pBindingFlags = &binding_flags,
+        };
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &flags_info,
+            .bindingCount = 1,
+            .pBindings = &binding,
+        };
+
+        VK( vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set1_HiZ) );
+
+        VkDescriptorPoolSize pool_size{
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+        };
+
+        VkDescriptorPoolCreateInfo pool_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size,
+        };
+
+        VK( vkCreateDescriptorPool(rtg.device, &pool_info, nullptr, &descriptor_pool) );
+
+        VkDescriptorSetAllocateInfo alloc_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &set1_HiZ,
+        };
+
+        VK( vkAllocateDescriptorSets(rtg.device, &alloc_info, &set1_HiZ_instance) );
+    }
+
+    { // pipeline layout
+        VkPushConstantRange push_constant_range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Push),
+        };
+
+        std::array< VkDescriptorSetLayout, 2 > layouts{
+            set0_Cull,
+            set1_HiZ,
+        };
+
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = uint32_t(layouts.size()),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range,
+        };
+
+        VK( vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout) );
+    }
+
+    { // compute pipeline
+        VkComputePipelineCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = comp_module,
+                .pName = "main"
+            },
+            .layout = layout,
+        };
+
+        VK( vkCreateComputePipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline) );
+    }
+
+    vkDestroyShaderModule(rtg.device, comp_module, nullptr);
+    comp_module = VK_NULL_HANDLE;
+
+	block_descriptor_configs.push_back(
+		BlockDescriptorConfig{
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.layout = set0_Cull, 
+		.bindings_count = 5
+	}); // Cull
+
+	block_descriptor_set_name_to_index = {
+        {"Cull", 0}
+    };
+
+	block_binding_name_to_index = {
+        {"CullInstances", 0},
+        {"CullViews", 1},
+        {"DrawCommands", 2},
+        {"DrawCounts", 3},
+        {"CullVisibility", 4},
+    };
+
+    pipeline_name_to_index["A3CullComputePipeline"] = 7;
+}
+
+void A3CullComputePipeline::update_hiz_descriptor(RTG &rtg, HiZBufferManager const &hiz) {
+    VkDescriptorImageInfo image_info{
+        .sampler = hiz.sampler,
+        .imageView = hiz.view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+
+    VkWriteDescriptorSet write{
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set1_HiZ_instance,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+
+    vkUpdateDescriptorSets(rtg.device, 1, &write, 0, nullptr);
+}
+
+void A3CullComputePipeline::destroy(RTG &rtg) {
+    if (layout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(rtg.device, layout, nullptr);
+        layout = VK_NULL_HANDLE;
+    }
+
+    if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(rtg.device, pipeline, nullptr);
+        pipeline = VK_NULL_HANDLE;
+    }
+
+    if (descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(rtg.device, descriptor_pool, nullptr); //(frees set1_HiZ_instance)
+        descriptor_pool = VK_NULL_HANDLE;
+        set1_HiZ_instance = VK_NULL_HANDLE;
+    }
+
+	if(set0_Cull != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(rtg.device, set0_Cull, nullptr);
+		set0_Cull = VK_NULL_HANDLE;
+	}
+
+	if(set1_HiZ != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(rtg.device, set1_HiZ, nullptr);
+		set1_HiZ = VK_NULL_HANDLE;
+	}
+}
+
+A3CullComputePipeline::~A3CullComputePipeline() {
+    assert(layout == VK_NULL_HANDLE);
+    assert(pipeline == VK_NULL_HANDLE);
+	assert(comp_module == VK_NULL_HANDLE);
+	assert(descriptor_pool == VK_NULL_HANDLE);
+	assert(set0_Cull == VK_NULL_HANDLE);
+	assert(set1_HiZ == VK_NULL_HANDLE);
+}
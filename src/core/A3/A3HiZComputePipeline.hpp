@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Pipeline.hpp"
+#include "RTG.hpp"
+#include "buffer/HiZBufferManager.hpp"
+
+#include <array>
+
+// Depth pyramid build for occlusion culling (--occlusion-culling): one dispatch per level,
+// each reading the level before (the depth buffer for level 0) and writing its farthest depth (see A3-hiz.comp)
+struct A3HiZComputePipeline : Pipeline {
+    // source level (sampled), destination level (storage image)
+    VkDescriptorSetLayout set0_Levels = VK_NULL_HANDLE;
+
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    std::array< VkDescriptorSet, HiZBufferManager::MaxLevels > set0_Levels_instances{}; //one per destination level
+
+	VkShaderModule comp_module = VK_NULL_HANDLE;
+
+    struct Push {
+        int32_t SRC_SIZE[2];
+        int32_t DST_SIZE[2];
+        uint32_t REVERSE_Z;
+    };
+
+    static constexpr uint32_t WorkgroupSize = 8; //local_size_x and local_size_y of A3-hiz.comp
+
+    void create(
+		RTG &rtg, 
+		VkRenderPass render_pass, 
+		uint32_t subpass,
+        const ManagerContext& context
+	) override;
+    void destroy(RTG &rtg) override;
+
+    //point the per-level sets at a (re)created pyramid and the depth buffer it is built from:
+    void update_level_descriptors(RTG &rtg, VkImageView depth_view, HiZBufferManager const &hiz);
+
+    A3HiZComputePipeline() = default;
+    ~A3HiZComputePipeline();
+};
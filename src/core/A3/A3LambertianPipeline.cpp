@@ -62,14 +62,20 @@ void A3LambertianPipeline::create(
         VK( vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Global) );
     }
 
-    { // the set1_Transforms layout holds an array of Transform structures in a storage buffer used in the vertex shader:
-        std::array< VkDescriptorSetLayoutBinding, 1 > bindings{
+    { // the set1_Transforms layout holds an array of Transform structures and an array of material indices in storage buffers used in the vertex shader:
+        std::array< VkDescriptorSetLayoutBinding, 2 > bindings{
             VkDescriptorSetLayoutBinding{
                 .binding = 0,
                 .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
             },
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1, // material index of each instance
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+            },
         };
         
         VkDescriptorSetLayoutCreateInfo create_info{
@@ -273,13 +279,11 @@ void A3LambertianPipeline::create(
                 }
 
                 std::vector<VkDescriptorImageInfo> spot_shadow_infos(spot_shadow_count);
-                if (shadow_map_manager && !shadow_map_manager->spot_shadow_targets.empty()) {
-                    const size_t available = shadow_map_manager->spot_shadow_targets.size();
+                if (shadow_map_manager && shadow_map_manager->spot_shadow_view(0) != VK_NULL_HANDLE) {
                     for (uint32_t i = 0; i < spot_shadow_count; ++i) {
-                        const auto &target = shadow_map_manager->spot_shadow_targets[i % available];
                         spot_shadow_infos[i] = VkDescriptorImageInfo{
                             .sampler = shadow_map_manager->spot_shadow_sampler,
-                            .imageView = target.depth_target.view,
+                            .imageView = shadow_map_manager->spot_shadow_view(i),
                             .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
                         };
                     }
@@ -341,18 +345,12 @@ void A3LambertianPipeline::create(
             set2_Textures
 		};
 
-        VkPushConstantRange range{
-			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-			.offset = 0,
-			.size = sizeof(Push),
-		};
-
 		VkPipelineLayoutCreateInfo create_info{
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 			.setLayoutCount = uint32_t(layouts.size()),
 			.pSetLayouts = layouts.data(),
-			.pushConstantRangeCount = 1,
-			.pPushConstantRanges = &range,
+			.pushConstantRangeCount = 0,
+			.pPushConstantRanges = nullptr,
 		};
 
 		VK( vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout) );
@@ -379,7 +377,7 @@ void A3LambertianPipeline::create(
         BlockDescriptorConfig{
         .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 
         .layout = set1_Transforms, 
-        .bindings_count = 1
+        .bindings_count = 2
     }); //Transform
 
     block_descriptor_set_name_to_index = {
@@ -406,6 +404,7 @@ void A3LambertianPipeline::create(
         {"ShadowSpotLightIdx", 14},
         // Transforms
         {"Transforms", 0},
+        {"Materials", 1},
     };
     
     pipeline_name_to_index["A3LambertianPipeline"] = 1;
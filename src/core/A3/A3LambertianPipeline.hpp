@@ -14,7 +14,7 @@ struct A3LambertianPipeline : Pipeline {
     // Global PV matrix, light, update per-frame
     VkDescriptorSetLayout set0_Global = VK_NULL_HANDLE;
 
-    // Per-instance transforms matrix, update per-draw
+    // Per-instance transforms matrix and material index, update per-draw
     VkDescriptorSetLayout set1_Transforms = VK_NULL_HANDLE;
 
     // Global IBL and 2D (including all 2d textures, an instance will use the material_index to get the corresponding descriptor for it) texture descriptor sets, no update
@@ -37,11 +37,7 @@ struct A3LambertianPipeline : Pipeline {
         SpotShadowMap
     */
 
-    struct Push{
-        uint32_t MATERIAL_INDEX;
-    };
-
-    //no push constants
+    //no push constants (the material index of each instance is in set1)
     void create(
 		RTG &, 
 		VkRenderPass render_pass, 
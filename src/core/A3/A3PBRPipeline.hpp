@@ -37,11 +37,7 @@ struct A3PBRPipeline : Pipeline {
         SpotShadowMap
     */
 
-    struct Push{
-        uint32_t MATERIAL_INDEX;
-    };
-
-    //no push constants
+    //no push constants (the material index of each instance is in set1)
     void create(
 		RTG &, 
 		VkRenderPass render_pass, 
@@ -10,6 +10,9 @@ struct A3SphereShadowPipeline : Pipeline {
     VkDescriptorSetLayout set0_Global = VK_NULL_HANDLE;
     VkDescriptorSetLayout set1_Transforms = VK_NULL_HANDLE;
 
+    // (--layered-shadows) draws all six faces in one multiview pass, with a face mask per caster ("FaceMasks")
+    VkPipeline layered_pipeline = VK_NULL_HANDLE;
+
     struct Push {
         uint32_t LIGHT_INDEX;
         uint32_t FACE_INDEX;
@@ -22,6 +25,9 @@ struct A3SphereShadowPipeline : Pipeline {
         const ManagerContext& context
     ) override;
 
+    // Create layered_pipeline for 'render_pass' (RenderPassManager::shadow_cube_render_pass), after create()
+    void create_layered(RTG &rtg, VkRenderPass render_pass);
+
     void destroy(RTG &rtg) override;
 
     A3SphereShadowPipeline() = default;
@@ -8,11 +8,15 @@
 #include <GLFW/glfw3.h>
 
 #include <array>
+#include <bit>
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 
 Deferred::Deferred(RTG &rtg) : Deferred(rtg, "origin-check.s72") {
@@ -56,6 +60,20 @@ Deferred::Deferred(RTG &rtg, const std::string &filename) :
 
 	lights_manager.create(doc, light_tree_data, rtg.swapchain_extent);
 
+	if (rtg.configuration.gpu_culling) { //(checked before any pipeline exists, so a refused scene stops cleanly)
+		cull_instance_capacity = std::max< uint32_t >(1, uint32_t(mesh_tree_data.size()));
+		lights_manager.get_shadow_view_frustums(cull_frustums);
+
+		//a view may draw every instance; a shorter run would silently drop draws, so such scenes are refused instead:
+		cull_view_capacity = cull_instance_capacity;
+		const VkDeviceSize command_bytes = VkDeviceSize(CullShadowViewFirst + cull_frustums.size()) * cull_view_capacity * sizeof(VkDrawIndirectCommand);
+		if (command_bytes > CullCommandBudget) {
+			throw std::runtime_error("GPU culling: " + std::to_string(CullShadowViewFirst + cull_frustums.size()) + " views of " + std::to_string(cull_instance_capacity)
+				+ " instances need " + std::to_string(command_bytes >> 20) + " MiB of draw commands per workspace, over the "
+				+ std::to_string(CullCommandBudget >> 20) + " MiB budget; run this scene without --gpu-culling.");
+		}
+	}
+
 	shadow_buffer_manager.create(
 		rtg,
 		render_pass_manager,
@@ -79,13 +97,27 @@ Deferred::Deferred(RTG &rtg, const std::string &filename) :
 	pbr_pipeline.create(rtg, render_pass_manager.hdr_render_pass, 0, pipeline_context);
 
 	sun_shadow_pipeline.create(rtg, render_pass_manager.shadow_render_pass, 0, pipeline_context);
+	if (rtg.configuration.layered_shadows) {
+		sun_shadow_pipeline.create_layered(rtg, render_pass_manager.shadow_cascade_render_pass);
+	}
 
 	spot_shadow_pipeline.create(rtg, render_pass_manager.shadow_render_pass, 0, pipeline_context);
 
 	sphere_shadow_pipeline.create(rtg, render_pass_manager.shadow_render_pass, 0, pipeline_context);
+	if (rtg.configuration.layered_shadows) {
+		sphere_shadow_pipeline.create_layered(rtg, render_pass_manager.shadow_cube_render_pass);
+	}
 
 	tiled_compute_pipeline.create(rtg, VK_NULL_HANDLE, 0, pipeline_context);
 
+	if (rtg.configuration.gpu_culling) {
+		cull_compute_pipeline.create(rtg, VK_NULL_HANDLE, 0, pipeline_context);
+	}
+	if (rtg.configuration.occlusion_culling != OcclusionCullingMode::Disabled) {
+		hiz_compute_pipeline.create(rtg, VK_NULL_HANDLE, 0, pipeline_context);
+		hiz_buffer_manager.create(rtg);
+	}
+
 	// Tone mapping pipeline renders to swapchain
 	tonemapping_pipeline.create(rtg, render_pass_manager.tonemap_render_pass, 0, pipeline_context);
 
@@ -99,6 +131,9 @@ Deferred::Deferred(RTG &rtg, const std::string &filename) :
 	block_descriptor_configs_by_pipeline[pipeline_name_to_index["DeferredSpotShadowPipeline"]] = spot_shadow_pipeline.block_descriptor_configs;
 	block_descriptor_configs_by_pipeline[pipeline_name_to_index["DeferredSphereShadowPipeline"]] = sphere_shadow_pipeline.block_descriptor_configs;
 	block_descriptor_configs_by_pipeline[pipeline_name_to_index["DeferredTiledLightingComputePipeline"]] = tiled_compute_pipeline.block_descriptor_configs;
+	if (rtg.configuration.gpu_culling) {
+		block_descriptor_configs_by_pipeline[pipeline_name_to_index["DeferredCullComputePipeline"]] = cull_compute_pipeline.block_descriptor_configs;
+	}
 
 	// const uint32_t max_light_instances = static_cast<uint32_t>(light_tree_data.empty() ? 1 : light_tree_data.size());
 	VkDeviceSize sun_lights_buffer_capacity = lights_manager.get_sun_lights_buffer_capacity();
@@ -200,6 +235,69 @@ Deferred::Deferred(RTG &rtg, const std::string &filename) :
 		},
 	};
 
+	if (rtg.configuration.gpu_culling) {
+		cull_views.resize(CullShadowViewFirst + cull_frustums.size());
+		const VkDeviceSize command_bytes = VkDeviceSize(cull_views.size()) * cull_view_capacity * sizeof(VkDrawIndirectCommand);
+		for (uint32_t v = 0; v < uint32_t(cull_views.size()); ++v) {
+			cull_views[v].PASS_MASK = DeferredCommonData::CullShadow;
+			cull_views[v].FIRST_COMMAND = v * cull_view_capacity;
+			cull_views[v].CAPACITY = cull_view_capacity;
+		}
+		cull_views[CullWriteView].PASS_MASK = DeferredCommonData::CullWrite;
+		if (rtg.configuration.occlusion_culling != OcclusionCullingMode::Disabled) {
+			cull_views[CullWriteView].OCCLUSION_MASK = 1; //(shadow views are only frustum culled)
+		}
+
+		const VkDeviceSize instance_capacity = cull_instance_capacity;
+		global_buffer_configs.insert(global_buffer_configs.end(), {
+			WorkspaceManager::GlobalBufferConfig{
+				.name = "Transforms",
+				.size = instance_capacity * sizeof(DeferredCommonData::Transform),
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			},
+			WorkspaceManager::GlobalBufferConfig{
+				.name = "Materials",
+				.size = instance_capacity * sizeof(uint32_t),
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			},
+			WorkspaceManager::GlobalBufferConfig{
+				.name = "CullInstances",
+				.size = instance_capacity * sizeof(DeferredCommonData::CullInstance),
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			},
+			WorkspaceManager::GlobalBufferConfig{
+				.name = "CullViews",
+				.size = cull_views.size() * sizeof(DeferredCommonData::CullView),
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			},
+			WorkspaceManager::GlobalBufferConfig{
+				.name = "DrawCommands",
+				.size = command_bytes,
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				.device_only = true,
+			},
+			WorkspaceManager::GlobalBufferConfig{
+				.name = "DrawCounts",
+				.size = cull_views.size() * sizeof(uint32_t),
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				.device_only = true,
+			},
+			WorkspaceManager::GlobalBufferConfig{
+				.name = "CullVisibility",
+				.size = instance_capacity * sizeof(uint32_t),
+				.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				.device_only = true,
+			},
+		});
+	} else {
+		//(grown by render() when the visible instances and casters need more commands)
+		global_buffer_configs.emplace_back(WorkspaceManager::GlobalBufferConfig{
+			.name = "DrawCommands",
+			.size = std::max< VkDeviceSize >(1, mesh_tree_data.size()) * sizeof(VkDrawIndirectCommand),
+			.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+		});
+	}
+
 	workspace_manager.create(rtg, std::move(block_descriptor_configs_by_pipeline), std::move(global_buffer_configs), {}, 2);
 	auto update_pipeline_descriptors = [&](const char *pipeline_name, auto &pipeline, const char *descriptor_set_name, const std::vector<const char *> &binding_names) {
 		for (const char *binding_name : binding_names) {
@@ -249,6 +347,20 @@ Deferred::Deferred(RTG &rtg, const std::string &filename) :
 	compute_bindings.insert(compute_bindings.end(), tiled_light_bindings.begin(), tiled_light_bindings.end());
 	update_pipeline_descriptors("DeferredTiledLightingComputePipeline", tiled_compute_pipeline, "Global", compute_bindings);
 
+	if (rtg.configuration.gpu_culling) {
+		//every pipeline draws from the same scene buffers, selecting an instance with firstInstance:
+		update_pipeline_descriptors("DeferredWritePipeline", deferred_write_pipeline, "Transforms", {"Transforms", "Materials"});
+		update_pipeline_descriptors("DeferredSunShadowPipeline", sun_shadow_pipeline, "Transforms", {"Transforms"});
+		update_pipeline_descriptors("DeferredSpotShadowPipeline", spot_shadow_pipeline, "Transforms", {"Transforms"});
+		update_pipeline_descriptors("DeferredSphereShadowPipeline", sphere_shadow_pipeline, "Transforms", {"Transforms"});
+		update_pipeline_descriptors("DeferredCullComputePipeline", cull_compute_pipeline, "Cull", {"CullInstances", "CullViews", "DrawCommands", "DrawCounts", "CullVisibility"});
+		gpu_scene_uploaded.assign(workspace_manager.workspaces.size(), 0);
+		cull_visibility_cleared.assign(workspace_manager.workspaces.size(), 0);
+	}
+
+	visibility_cache.max_translation = rtg.configuration.visibility_cache_distance;
+	visibility_cache.max_rotation = glm::radians(rtg.configuration.visibility_cache_degrees);
+
 	scene_manager.create(rtg, doc);
 }
 
@@ -265,6 +377,7 @@ Deferred::~Deferred() {
 
 	hdrbuffer_manager.destroy(rtg);
 	shadow_buffer_manager.destroy(rtg);
+	hiz_buffer_manager.destroy(rtg);
 
 	background_pipeline.destroy(rtg);
 
@@ -284,6 +397,10 @@ Deferred::~Deferred() {
 
     tiled_compute_pipeline.destroy(rtg);
 
+	cull_compute_pipeline.destroy(rtg);
+
+	hiz_compute_pipeline.destroy(rtg);
+
 	workspace_manager.destroy(rtg);
 
 	render_pass_manager.destroy(rtg);
@@ -349,6 +466,14 @@ void Deferred::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain) {
 
 		vkUpdateDescriptorSets(rtg_.device, 1, &write, 0, nullptr);
 	}
+
+	if (rtg.configuration.occlusion_culling != OcclusionCullingMode::Disabled) {
+		//the depth pyramid follows the gbuffer depth, and has no previous frame to offer until it is built again:
+		hiz_buffer_manager.on_swapchain(rtg_, swapchain.extent);
+		hiz_compute_pipeline.update_level_descriptors(rtg_, gbuffer_manager.depth_target.view, hiz_buffer_manager);
+		cull_compute_pipeline.update_hiz_descriptor(rtg_, hiz_buffer_manager);
+		hiz_valid = false;
+	}
 }
 
 
@@ -364,7 +489,9 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 	//record (into `workspace.command_buffer`) commands that run a `render_pass` that just clears `framebuffer`:
 	workspace.reset_recording();
 	
+	double recording_ms = 0.0; //CPU time spent recording this frame's commands (reported in --headless runs)
 	{ //begin recording:
+		Timer recording_timer([&](double elapsed) { recording_ms = elapsed * 1000.0; });
 		workspace.begin_recording();
 
 		query_pool_manager.begin_frame(workspace.command_buffer, render_params.workspace_index);
@@ -415,14 +542,30 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 			// Tile data will be generated by compute shader, so we skip host writes.
 		}
 
-		{ //upload transforms for all pipelines
-			auto upload_transforms = [&](const char* pipeline_name, auto& instances, const auto& pipeline) {
-				if (instances.empty()) return;
+		if (rtg.configuration.gpu_culling) { //upload the scene (if this workspace's copy is out of date) and the views for the culling pass
+			if (gpu_scene_uploaded[render_params.workspace_index] != gpu_scene_version && !gpu_instances.empty()) {
+				workspace.write_global_buffer(rtg, "Transforms", (void*)gpu_transforms.data(), gpu_transforms.size() * sizeof(DeferredCommonData::Transform));
+				workspace.write_global_buffer(rtg, "Materials", (void*)gpu_materials.data(), gpu_materials.size() * sizeof(uint32_t));
+				workspace.write_global_buffer(rtg, "CullInstances", (void*)gpu_instances.data(), gpu_instances.size() * sizeof(DeferredCommonData::CullInstance));
+				gpu_scene_uploaded[render_params.workspace_index] = gpu_scene_version;
+			}
+			workspace.write_global_buffer(rtg, "CullViews", (void*)cull_views.data(), cull_views.size() * sizeof(DeferredCommonData::CullView));
+
+			//the culling pass counts each view's draws up from zero:
+			vkCmdFillBuffer(workspace.command_buffer, workspace.global_buffer_pairs["DrawCounts"]->device.handle, 0, VK_WHOLE_SIZE, 0);
+
+			if (!cull_visibility_cleared[render_params.workspace_index]) { //(two-phase culling reads visibility before writing it)
+				vkCmdFillBuffer(workspace.command_buffer, workspace.global_buffer_pairs["CullVisibility"]->device.handle, 0, VK_WHOLE_SIZE, 0);
+				cull_visibility_cleared[render_params.workspace_index] = 1;
+			}
+		} else { //upload transforms for all pipelines
+			auto upload_binding_data = [&](const char* pipeline_name, const char* binding_name, const auto& data, const auto& pipeline) {
+				if (data.empty()) return;
 				
-				size_t needed_bytes = instances.size() * sizeof(DeferredCommonData::Transform);
+				size_t needed_bytes = data.size() * sizeof(data[0]);
 				uint32_t pipeline_idx = pipeline_name_to_index[pipeline_name];
 				uint32_t set_idx = pipeline.block_descriptor_set_name_to_index.at("Transforms");
-				uint32_t binding_idx = pipeline.block_binding_name_to_index.at("Transforms");
+				uint32_t binding_idx = pipeline.block_binding_name_to_index.at(binding_name);
 
 				auto& buffer_pair = workspace.pipeline_descriptor_set_groups[pipeline_idx][set_idx].buffer_pairs[binding_idx];
 				if (buffer_pair->host.handle == VK_NULL_HANDLE || buffer_pair->host.size < needed_bytes) {
@@ -435,19 +578,125 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 				assert(buffer_pair->host.size >= needed_bytes);
 				assert(buffer_pair->host.allocation.mapped);
 
+				workspace.write_buffer(rtg, pipeline_idx, set_idx, binding_idx, (void*)data.data(), needed_bytes);
+			};
+
+			//the write pipeline gets a transform and a material index per instance:
+			auto upload_instances = [&](const char* pipeline_name, auto& instances, const auto& pipeline) {
 				std::vector<DeferredCommonData::Transform> transform_data;
+				std::vector<uint32_t> material_data;
 				transform_data.reserve(instances.size());
+				material_data.reserve(instances.size());
 				for (const auto& inst : instances) {
 					transform_data.push_back(inst.object_transform);
+					material_data.push_back(static_cast<uint32_t>(inst.material_index));
 				}
-				
-				workspace.write_buffer(rtg, pipeline_idx, set_idx, binding_idx, transform_data.data(), needed_bytes);
+				upload_binding_data(pipeline_name, "Transforms", transform_data, pipeline);
+				upload_binding_data(pipeline_name, "Materials", material_data, pipeline);
+			};
+
+			//shadow pipelines get the casters of each of their views, back to back (see LightsManager::ShadowCasters):
+			auto upload_casters = [&](const char* pipeline_name, const LightsManager::ShadowCasters& casters, const auto& pipeline) {
+				std::vector<DeferredCommonData::Transform> transform_data;
+				transform_data.reserve(casters.instances.size());
+				for (uint32_t i : casters.instances) {
+					transform_data.push_back(shadow_object_instances[i].object_transform);
+				}
+				upload_binding_data(pipeline_name, "Transforms", transform_data, pipeline);
+			};
+
+			upload_instances("DeferredWritePipeline", deferred_object_instances, deferred_write_pipeline);
+			upload_casters("DeferredSpotShadowPipeline", spot_casters, spot_shadow_pipeline);
+			if (rtg.configuration.layered_shadows) { //(each caster once per light, with the cascades or faces it reaches)
+				upload_casters("DeferredSunShadowPipeline", layered_sun_casters, sun_shadow_pipeline);
+				upload_binding_data("DeferredSunShadowPipeline", "CascadeMasks", layered_sun_masks, sun_shadow_pipeline);
+				upload_casters("DeferredSphereShadowPipeline", layered_sphere_casters, sphere_shadow_pipeline);
+				upload_binding_data("DeferredSphereShadowPipeline", "FaceMasks", layered_sphere_masks, sphere_shadow_pipeline);
+			} else {
+				upload_casters("DeferredSunShadowPipeline", sun_casters, sun_shadow_pipeline);
+				upload_casters("DeferredSphereShadowPipeline", sphere_casters, sphere_shadow_pipeline);
+			}
+
+			//one draw command per run of instances that share a mesh (instances i .. i + N - 1 select transforms
+			//  and materials i .. i + N - 1) and per run of a view's casters that share a mesh (selecting transforms k .. k + N - 1):
+			cpu_draw_commands.clear();
+			for (uint32_t i = 0; i < uint32_t(deferred_object_instances.size()); ) {
+				DeferredInstance const &inst = deferred_object_instances[i];
+				uint32_t end = i + 1;
+				while (end < uint32_t(deferred_object_instances.size()) && deferred_object_instances[end].mesh_index == inst.mesh_index) ++end;
+				cpu_draw_commands.emplace_back(VkDrawIndirectCommand{
+					.vertexCount = inst.object_ranges.count,
+					.instanceCount = end - i,
+					.firstVertex = inst.object_ranges.first,
+					.firstInstance = i,
+				});
+				i = end;
+			}
+			deferred_draw_count = uint32_t(cpu_draw_commands.size());
+			//(views not drawn this frame, see ShadowBufferManager::draws_view, get no commands; with --shadow-cache each view's static
+			//  casters are followed by its dynamic ones)
+			auto append_caster_runs = [&](LightsManager::ShadowCasters const &casters, uint32_t from, uint32_t to) {
+				for (uint32_t k = from; k < to; ) {
+					ShadowInstance const &caster = shadow_object_instances[casters.instances[k]];
+					uint32_t end = k + 1;
+					while (end < to && shadow_object_instances[casters.instances[end]].mesh_index == caster.mesh_index) ++end;
+					cpu_draw_commands.emplace_back(VkDrawIndirectCommand{
+						.vertexCount = caster.object_ranges.count,
+						.instanceCount = end - k,
+						.firstVertex = caster.object_ranges.first,
+						.firstInstance = k,
+					});
+					k = end;
+				}
+			};
+			auto append_caster_commands = [&](LightsManager::ShadowCasters const &casters, ShadowCache::Kind kind,
+				std::vector< uint32_t > &view_first, std::vector< uint32_t > &dynamic_view_first) {
+				std::vector< ShadowCache::View > const &cache_views = shadow_buffer_manager.cache.views[kind];
+				const bool cached = (rtg.configuration.shadow_cache != ShadowCacheMode::NoShadowCache);
+				view_first.assign(casters.view_count() + 1, 0);
+				dynamic_view_first.assign(casters.view_count(), 0);
+				for (uint32_t view = 0; view < casters.view_count(); ++view) {
+					view_first[view] = uint32_t(cpu_draw_commands.size());
+					if (!shadow_buffer_manager.draws_view(rtg, kind, view)) {
+						dynamic_view_first[view] = view_first[view];
+						continue;
+					}
+					const uint32_t view_end = casters.first(view) + casters.count(view);
+					const uint32_t dynamic_first = (cached ? cache_views[view].dynamic_first : view_end);
+					append_caster_runs(casters, casters.first(view), dynamic_first);
+					dynamic_view_first[view] = uint32_t(cpu_draw_commands.size());
+					append_caster_runs(casters, dynamic_first, view_end);
+				}
+				view_first.back() = uint32_t(cpu_draw_commands.size());
+			};
+			//(--layered-shadows: one view per light, drawn whole if any of its 'layer_count' views is drawn this frame)
+			auto append_layered_caster_commands = [&](LightsManager::ShadowCasters const &casters, ShadowCache::Kind kind,
+				uint32_t layer_count, std::vector< uint32_t > &view_first) {
+				view_first.assign(casters.view_count() + 1, 0);
+				for (uint32_t view = 0; view < casters.view_count(); ++view) {
+					view_first[view] = uint32_t(cpu_draw_commands.size());
+					if (!shadow_buffer_manager.draws_layers(rtg, kind, view * layer_count, layer_count)) continue;
+					append_caster_runs(casters, casters.first(view), casters.first(view) + casters.count(view));
+				}
+				view_first.back() = uint32_t(cpu_draw_commands.size());
 			};
+			if (rtg.configuration.layered_shadows) {
+				append_layered_caster_commands(layered_sun_casters, ShadowCache::Sun, LightsManager::SunCascadeCount, sun_draw_first);
+				append_layered_caster_commands(layered_sphere_casters, ShadowCache::Sphere, LightsManager::SphereShadowFaceCount, sphere_draw_first);
+			} else {
+				append_caster_commands(sun_casters, ShadowCache::Sun, sun_draw_first, sun_dynamic_draw_first);
+				append_caster_commands(sphere_casters, ShadowCache::Sphere, sphere_draw_first, sphere_dynamic_draw_first);
+			}
+			append_caster_commands(spot_casters, ShadowCache::Spot, spot_draw_first, spot_dynamic_draw_first);
 
-			upload_transforms("DeferredWritePipeline", deferred_object_instances, deferred_write_pipeline);
-			upload_transforms("DeferredSunShadowPipeline", shadow_object_instances, sun_shadow_pipeline);
-			upload_transforms("DeferredSpotShadowPipeline", shadow_object_instances, spot_shadow_pipeline);
-			upload_transforms("DeferredSphereShadowPipeline", shadow_object_instances, sphere_shadow_pipeline);
+			if (rtg.max_draw_indirect_count != 0 && !cpu_draw_commands.empty()) {
+				const VkDeviceSize needed_bytes = cpu_draw_commands.size() * sizeof(VkDrawIndirectCommand);
+				if (workspace.global_buffer_pairs["DrawCommands"]->host.size < needed_bytes) {
+					//(grow by half again, so slowly growing counts don't re-allocate every frame)
+					workspace.update_global_buffer(rtg, "DrawCommands", needed_bytes + needed_bytes / 2);
+				}
+				workspace.write_global_buffer(rtg, "DrawCommands", (void*)cpu_draw_commands.data(), needed_bytes);
+			}
 		}
 
 		{ //memory barrier to make sure copies complete before rendering happens:
@@ -459,7 +708,7 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 
 			vkCmdPipelineBarrier( workspace.command_buffer,
 				VK_PIPELINE_STAGE_TRANSFER_BIT, //srcStageMask
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, //dstStageMask
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, //dstStageMask
 				0, //dependencyFlags
 				1, &memory_barrier, //memoryBarriers (count, data)
 				0, nullptr, //bufferMemoryBarriers (count, data)
@@ -513,239 +762,484 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 			);
 		}
 
-		// =====================================================================
-		// Sun cascade shadow pass: render depth per shadow sun light and cascade
-		// =====================================================================
-		{
-			const uint32_t sun_shadow_count = std::min(
-				static_cast<uint32_t>(shadow_buffer_manager.sun_shadow_targets.size()),
-				static_cast<uint32_t>(lights_manager.get_shadow_sun_lights().size())
+		//make 'src_access' writes by 'src_stage' visible to 'dst_access' in 'dst_stage':
+		auto memory_barrier = [&](VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+			VkMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = src_access,
+				.dstAccessMask = dst_access,
+			};
+			vkCmdPipelineBarrier(workspace.command_buffer,
+				src_stage,
+				dst_stage,
+				0,
+				1, &barrier,
+				0, nullptr,
+				0, nullptr
 			);
+		};
 
-			for (uint32_t light_index = 0; light_index < sun_shadow_count; ++light_index) {
-				auto const &shadow_target = shadow_buffer_manager.sun_shadow_targets[light_index];
-
-				VkExtent2D shadow_extent{
-					.width = shadow_target.resolution,
-					.height = shadow_target.resolution,
-				};
+		//culling pass over the first 'view_count' views, testing the main views against the depth pyramid as 'phase' says:
+		auto dispatch_cull = [&](DeferredCullComputePipeline::Phase phase, uint32_t view_count, glm::mat4 const &clip_from_world, bool hiz_ready) {
+			vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_compute_pipeline.pipeline);
 
-				for (uint32_t cascade_index = 0; cascade_index < ShadowBufferManager::SunCascadeCount; ++cascade_index) {
-					VkRenderPassBeginInfo begin_info{
-						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-						.renderPass = render_pass_manager.shadow_render_pass,
-						.framebuffer = shadow_target.depth_target.layer_framebuffers[cascade_index],
-						.renderArea{
-							.offset = {.x = 0, .y = 0},
-							.extent = shadow_extent,
-						},
-						.clearValueCount = 1,
-						.pClearValues = &shadow_buffer_manager.shadow_clear_value,
-					};
+			std::array< VkDescriptorSet, 2 > descriptor_sets{
+				workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredCullComputePipeline"]][cull_compute_pipeline.block_descriptor_set_name_to_index["Cull"]].descriptor_set, //0: Cull
+				cull_compute_pipeline.set1_HiZ_instance, //1: HiZ
+			};
 
-					vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
-					{
-						const VkRect2D shadow_scissor = ShadowBufferManager::get_shadow_scissor(shadow_target.resolution);
-						const VkViewport shadow_viewport = ShadowBufferManager::get_shadow_viewport(shadow_target.resolution);
-						vkCmdSetScissor(workspace.command_buffer, 0, 1, &shadow_scissor);
-						vkCmdSetViewport(workspace.command_buffer, 0, 1, &shadow_viewport);
+			vkCmdBindDescriptorSets(
+				workspace.command_buffer,
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				cull_compute_pipeline.layout,
+				0,
+				uint32_t(descriptor_sets.size()), descriptor_sets.data(),
+				0, nullptr
+			);
 
-						if (!shadow_object_instances.empty()) {
-							vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sun_shadow_pipeline.pipeline);
+			DeferredCullComputePipeline::Push push{
+				.CLIP_FROM_WORLD = clip_from_world,
+				.HIZ_SIZE = glm::vec2(float(hiz_buffer_manager.level_extents[0].width), float(hiz_buffer_manager.level_extents[0].height)),
+				.INSTANCE_COUNT = uint32_t(gpu_instances.size()),
+				.PHASE = phase,
+				.REVERSE_Z = rtg.configuration.reverse_z ? 1u : 0u,
+				.HIZ_LEVELS = hiz_ready ? hiz_buffer_manager.level_count : 0u,
+			};
+			vkCmdPushConstants(workspace.command_buffer, cull_compute_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
 
-							std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
-							std::array< VkDeviceSize, 1 > offsets{ 0 };
-							vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
+			const uint32_t groups_x = (push.INSTANCE_COUNT + DeferredCullComputePipeline::WorkgroupSize - 1) / DeferredCullComputePipeline::WorkgroupSize;
+			vkCmdDispatch(workspace.command_buffer, groups_x, view_count, 1);
+		};
 
-							auto &global_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredSunShadowPipeline"]][sun_shadow_pipeline.block_descriptor_set_name_to_index["Global"]].descriptor_set;
-							auto &transform_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredSunShadowPipeline"]][sun_shadow_pipeline.block_descriptor_set_name_to_index["Transforms"]].descriptor_set;
+		const glm::mat4 clip_from_world = camera_manager.get_camera_pv().PERSPECTIVE * camera_manager.get_camera_pv().VIEW;
 
-							std::array< VkDescriptorSet, 2 > descriptor_sets{
-								global_descriptor_set,
-								transform_descriptor_set,
-							};
+		if (rtg.configuration.gpu_culling) { // culling pass: test every instance against every view, writing each view's draw commands and count
+			//counts (and visibility) were just cleared; with last-frame occlusion culling, the previous frame built the pyramid:
+			memory_barrier(
+				VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+			);
 
-							vkCmdBindDescriptorSets(
-								workspace.command_buffer,
-								VK_PIPELINE_BIND_POINT_GRAPHICS,
-								sun_shadow_pipeline.layout,
-								0,
-								uint32_t(descriptor_sets.size()), descriptor_sets.data(),
-								0, nullptr
-							);
+			switch (rtg.configuration.occlusion_culling) {
+				case OcclusionCullingMode::TwoPhase:
+					dispatch_cull(DeferredCullComputePipeline::TwoPhaseFirst, uint32_t(cull_views.size()), clip_from_world, false);
+					break;
+				case OcclusionCullingMode::LastFrame:
+					dispatch_cull(DeferredCullComputePipeline::AgainstLastFrame, uint32_t(cull_views.size()), hiz_clip_from_world, hiz_valid);
+					break;
+				default:
+					dispatch_cull(DeferredCullComputePipeline::FrustumOnly, uint32_t(cull_views.size()), clip_from_world, false);
+					break;
+			}
 
-							DeferredSunShadowPipeline::Push push{
-								.LIGHT_INDEX = light_index,
-								.CASCADE_INDEX = cascade_index,
-							};
-							vkCmdPushConstants(workspace.command_buffer, sun_shadow_pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+			// Draw commands and counts are read by the indirect draws below
+			memory_barrier(
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+			);
+		}
 
-							for (uint32_t i = 0; i < shadow_object_instances.size(); ++i) {
-								vkCmdDraw(workspace.command_buffer, shadow_object_instances[i].object_ranges.count, 1, shadow_object_instances[i].object_ranges.first, i);
-							}
-						}
-					}
-					vkCmdEndRenderPass(workspace.command_buffer);
+		//(buffers and descriptor sets used while drawing are looked up here, before any recording:
+		//  with more than one job thread, passes are recorded in parallel into secondary command buffers)
+		const bool record_in_parallel = (rtg.jobs.thread_count() > 1);
+		const VkBuffer draw_commands_buffer = workspace.global_buffer_pairs["DrawCommands"]->device.handle;
+		const VkBuffer draw_counts_buffer = (rtg.configuration.gpu_culling ? workspace.global_buffer_pairs["DrawCounts"]->device.handle : VK_NULL_HANDLE);
+
+		//draw GPU culling view 'view' with the bound pipeline (the culling pass wrote its commands and count):
+		auto draw_culled = [&](VkCommandBuffer command_buffer, uint32_t view) {
+			vkCmdDrawIndirectCount(
+				command_buffer,
+				draw_commands_buffer, VkDeviceSize(cull_views[view].FIRST_COMMAND) * sizeof(VkDrawIndirectCommand),
+				draw_counts_buffer, VkDeviceSize(view) * sizeof(uint32_t),
+				cull_view_capacity,
+				sizeof(VkDrawIndirectCommand)
+			);
+		};
+		//draw 'count' of the CPU culling path's draw commands, starting at 'first', with the bound pipeline:
+		auto draw_cpu_commands = [&](VkCommandBuffer command_buffer, uint32_t first, uint32_t count) {
+			if (rtg.max_draw_indirect_count == 0) { //(the device can't pick instances from indirect draws)
+				for (uint32_t d = first; d < first + count; ++d) {
+					VkDrawIndirectCommand const &command = cpu_draw_commands[d];
+					vkCmdDraw(command_buffer, command.vertexCount, command.instanceCount, command.firstVertex, command.firstInstance);
 				}
+				return;
 			}
-		}
+			for (uint32_t done = 0; done < count; ) {
+				const uint32_t batch = std::min(count - done, rtg.max_draw_indirect_count);
+				vkCmdDrawIndirect(
+					command_buffer,
+					draw_commands_buffer, VkDeviceSize(first + done) * sizeof(VkDrawIndirectCommand),
+					batch,
+					sizeof(VkDrawIndirectCommand)
+				);
+				done += batch;
+			}
+		};
+		const uint32_t cull_sun_view_first = CullShadowViewFirst;
+		const uint32_t cull_sphere_view_first = cull_sun_view_first + uint32_t(lights_manager.get_shadow_sun_lights().size()) * LightsManager::SunCascadeCount;
+		const uint32_t cull_spot_view_first = cull_sphere_view_first + uint32_t(lights_manager.get_shadow_sphere_lights().size()) * LightsManager::SphereShadowFaceCount;
 
 		// =====================================================================
-		// Sphere shadow pass: render depth cubemap for each shadow-casting sphere light
+		// Shadow passes: render depth per sun light cascade, sphere light cube face and spot light
 		// =====================================================================
 		{
+			auto shadow_descriptor_sets = [&](const char *pipeline_name, auto &pipeline) {
+				auto const &groups = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index[pipeline_name]];
+				return std::array< VkDescriptorSet, 2 >{
+					groups[pipeline.block_descriptor_set_name_to_index["Global"]].descriptor_set,
+					groups[pipeline.block_descriptor_set_name_to_index["Transforms"]].descriptor_set,
+				};
+			};
+
+			//gather the views (sun cascades, then sphere faces, then spot lights):
+			shadow_views.clear();
+
+			//views the cache kept (--shadow-cache) or the atlas left for later (--shadow-atlas) are left out; with split caching,
+			//  a view draws its static casters into its static map (if that changed), then its dynamic casters over a copy of it:
+			const bool split_cache = (rtg.configuration.shadow_cache == ShadowCacheMode::SplitShadowCache);
+			auto add_shadow_view = [&](ShadowView shadow_view, ShadowCache::Kind kind, uint32_t view,
+				std::vector< uint32_t > const &draw_first, std::vector< uint32_t > const &dynamic_draw_first,
+				VkImage image, VkImage static_image, VkFramebuffer static_framebuffer, uint32_t layer) {
+				if (!shadow_buffer_manager.draws_view(rtg, kind, view)) return;
+				if (rtg.configuration.gpu_culling) {
+					shadow_views.emplace_back(shadow_view);
+					return;
+				}
+				auto with_commands = [&](ShadowView part, uint32_t first_command, uint32_t end_command) {
+					part.first_command = first_command;
+					part.command_count = end_command - first_command;
+					if (part.command_count == 0) part.pipeline = VK_NULL_HANDLE; //(no casters: the pass only clears, or copies)
+					return part;
+				};
+				if (!split_cache) {
+					shadow_views.emplace_back(with_commands(shadow_view, draw_first[view], draw_first[view + 1]));
+					return;
+				}
+				if (shadow_buffer_manager.cache.views[kind][view].draw_static) {
+					ShadowView static_view = with_commands(shadow_view, draw_first[view], dynamic_draw_first[view]);
+					static_view.framebuffer = static_framebuffer;
+					shadow_views.emplace_back(static_view);
+				}
+				ShadowView dynamic_view = with_commands(shadow_view, dynamic_draw_first[view], draw_first[view + 1]);
+				dynamic_view.render_pass = render_pass_manager.shadow_load_render_pass;
+				dynamic_view.copy_from = static_image;
+				dynamic_view.copy_to = image;
+				dynamic_view.copy_layer = layer;
+				shadow_views.emplace_back(dynamic_view);
+			};
+
+			const uint32_t sun_shadow_count = std::min(
+				static_cast<uint32_t>(shadow_buffer_manager.sun_shadow_targets.size()),
+				static_cast<uint32_t>(lights_manager.get_shadow_sun_lights().size())
+			);
+			const std::array< VkDescriptorSet, 2 > sun_descriptor_sets = shadow_descriptor_sets("DeferredSunShadowPipeline", sun_shadow_pipeline);
+			for (uint32_t light_index = 0; light_index < sun_shadow_count; ++light_index) {
+				auto const &shadow_target = shadow_buffer_manager.sun_shadow_targets[light_index];
+				if (rtg.configuration.layered_shadows) { //(all cascades in one multiview pass)
+					if (!shadow_buffer_manager.draws_layers(rtg, ShadowCache::Sun, light_index * LightsManager::SunCascadeCount, LightsManager::SunCascadeCount)) continue;
+					const uint32_t first_command = sun_draw_first[light_index];
+					const uint32_t command_count = sun_draw_first[light_index + 1] - first_command;
+					shadow_views.emplace_back(ShadowView{
+						.render_pass = render_pass_manager.shadow_cascade_render_pass,
+						.framebuffer = shadow_target.depth_target.layered_framebuffer,
+						.offset = {.x = 0, .y = 0},
+						.resolution = shadow_target.resolution,
+						.pipeline = (command_count == 0 ? VK_NULL_HANDLE : sun_shadow_pipeline.layered_pipeline),
+						.layout = sun_shadow_pipeline.layout,
+						.descriptor_sets = sun_descriptor_sets,
+						.push{ light_index, 0 },
+						.push_size = sizeof(DeferredSunShadowPipeline::Push),
+						.cull_view = 0,
+						.first_command = first_command,
+						.command_count = command_count,
+						.copy_from = VK_NULL_HANDLE,
+						.copy_to = VK_NULL_HANDLE,
+						.copy_layer = 0,
+					});
+					continue;
+				}
+				for (uint32_t cascade_index = 0; cascade_index < ShadowBufferManager::SunCascadeCount; ++cascade_index) {
+					const uint32_t view = light_index * LightsManager::SunCascadeCount + cascade_index;
+					add_shadow_view(ShadowView{
+						.render_pass = render_pass_manager.shadow_render_pass,
+						.framebuffer = shadow_target.depth_target.layer_framebuffers[cascade_index],
+						.offset = {.x = 0, .y = 0},
+						.resolution = shadow_target.resolution,
+						.pipeline = sun_shadow_pipeline.pipeline,
+						.layout = sun_shadow_pipeline.layout,
+						.descriptor_sets = sun_descriptor_sets,
+						.push{ light_index, cascade_index },
+						.push_size = sizeof(DeferredSunShadowPipeline::Push),
+						.cull_view = cull_sun_view_first + view,
+						.first_command = 0,
+						.command_count = 0,
+						.copy_from = VK_NULL_HANDLE,
+						.copy_to = VK_NULL_HANDLE,
+						.copy_layer = 0,
+					}, ShadowCache::Sun, view, sun_draw_first, sun_dynamic_draw_first,
+						shadow_target.depth_target.image.handle, shadow_target.static_depth_target.image.handle,
+						(split_cache ? shadow_target.static_depth_target.layer_framebuffers[cascade_index] : VK_NULL_HANDLE), cascade_index);
+				}
+			}
+
 			const uint32_t sphere_shadow_count = std::min(
 				static_cast<uint32_t>(shadow_buffer_manager.sphere_shadow_targets.size()),
 				static_cast<uint32_t>(lights_manager.get_shadow_sphere_lights().size())
 			);
-
+			const std::array< VkDescriptorSet, 2 > sphere_descriptor_sets = shadow_descriptor_sets("DeferredSphereShadowPipeline", sphere_shadow_pipeline);
 			for (uint32_t light_index = 0; light_index < sphere_shadow_count; ++light_index) {
 				auto const &shadow_target = shadow_buffer_manager.sphere_shadow_targets[light_index];
-
-				VkExtent2D shadow_extent{
-					.width = shadow_target.resolution,
-					.height = shadow_target.resolution,
-				};
-
+				if (rtg.configuration.layered_shadows) { //(all six faces in one multiview pass)
+					if (!shadow_buffer_manager.draws_layers(rtg, ShadowCache::Sphere, light_index * LightsManager::SphereShadowFaceCount, LightsManager::SphereShadowFaceCount)) continue;
+					const uint32_t first_command = sphere_draw_first[light_index];
+					const uint32_t command_count = sphere_draw_first[light_index + 1] - first_command;
+					shadow_views.emplace_back(ShadowView{
+						.render_pass = render_pass_manager.shadow_cube_render_pass,
+						.framebuffer = shadow_target.depth_target.layered_framebuffer,
+						.offset = {.x = 0, .y = 0},
+						.resolution = shadow_target.resolution,
+						.pipeline = (command_count == 0 ? VK_NULL_HANDLE : sphere_shadow_pipeline.layered_pipeline),
+						.layout = sphere_shadow_pipeline.layout,
+						.descriptor_sets = sphere_descriptor_sets,
+						.push{ light_index, 0 },
+						.push_size = sizeof(DeferredSphereShadowPipeline::Push),
+						.cull_view = 0,
+						.first_command = first_command,
+						.command_count = command_count,
+						.copy_from = VK_NULL_HANDLE,
+						.copy_to = VK_NULL_HANDLE,
+						.copy_layer = 0,
+					});
+					continue;
+				}
 				for (uint32_t face_index = 0; face_index < ShadowBufferManager::SphereFaceCount; ++face_index) {
-					VkRenderPassBeginInfo begin_info{
-						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-						.renderPass = render_pass_manager.shadow_render_pass,
+					const uint32_t view = light_index * LightsManager::SphereShadowFaceCount + face_index;
+					add_shadow_view(ShadowView{
+						.render_pass = render_pass_manager.shadow_render_pass,
 						.framebuffer = shadow_target.depth_target.face_framebuffers[face_index],
-						.renderArea{
-							.offset = {.x = 0, .y = 0},
-							.extent = shadow_extent,
-						},
-						.clearValueCount = 1,
-						.pClearValues = &shadow_buffer_manager.shadow_clear_value,
-					};
-
-					vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
-					{
-						const VkRect2D shadow_scissor = ShadowBufferManager::get_shadow_scissor(shadow_target.resolution);
-						const VkViewport shadow_viewport = ShadowBufferManager::get_shadow_viewport(shadow_target.resolution);
-						vkCmdSetScissor(workspace.command_buffer, 0, 1, &shadow_scissor);
-						vkCmdSetViewport(workspace.command_buffer, 0, 1, &shadow_viewport);
+						.offset = {.x = 0, .y = 0},
+						.resolution = shadow_target.resolution,
+						.pipeline = sphere_shadow_pipeline.pipeline,
+						.layout = sphere_shadow_pipeline.layout,
+						.descriptor_sets = sphere_descriptor_sets,
+						.push{ light_index, face_index },
+						.push_size = sizeof(DeferredSphereShadowPipeline::Push),
+						.cull_view = cull_sphere_view_first + view,
+						.first_command = 0,
+						.command_count = 0,
+						.copy_from = VK_NULL_HANDLE,
+						.copy_to = VK_NULL_HANDLE,
+						.copy_layer = 0,
+					}, ShadowCache::Sphere, view, sphere_draw_first, sphere_dynamic_draw_first,
+						shadow_target.depth_target.image.handle, shadow_target.static_depth_target.image.handle,
+						shadow_target.static_depth_target.face_framebuffers[face_index], face_index);
+				}
+			}
 
-						if (!shadow_object_instances.empty()) {
-							vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sphere_shadow_pipeline.pipeline);
+			//(with --shadow-atlas, each spot light's map is its tile of the atlas)
+			const bool spot_atlas = (shadow_buffer_manager.spot_atlas.size != 0);
+			const uint32_t spot_shadow_count = std::min(
+				static_cast<uint32_t>(spot_atlas ? shadow_buffer_manager.spot_atlas.lights.size() : shadow_buffer_manager.spot_shadow_targets.size()),
+				static_cast<uint32_t>(lights_manager.get_shadow_spot_lights().size())
+			);
+			const std::array< VkDescriptorSet, 2 > spot_descriptor_sets = shadow_descriptor_sets("DeferredSpotShadowPipeline", spot_shadow_pipeline);
+			for (uint32_t light_index = 0; light_index < spot_shadow_count; ++light_index) {
+				const uint32_t view = light_index;
+				ShadowView shadow_view{
+					.render_pass = render_pass_manager.shadow_render_pass,
+					.framebuffer = VK_NULL_HANDLE,
+					.offset = {.x = 0, .y = 0},
+					.resolution = 0,
+					.pipeline = spot_shadow_pipeline.pipeline,
+					.layout = spot_shadow_pipeline.layout,
+					.descriptor_sets = spot_descriptor_sets,
+					.push{ light_index, 0 },
+					.push_size = sizeof(DeferredSpotShadowPipeline::Push),
+					.cull_view = cull_spot_view_first + view,
+					.first_command = 0,
+					.command_count = 0,
+					.copy_from = VK_NULL_HANDLE,
+					.copy_to = VK_NULL_HANDLE,
+					.copy_layer = 0,
+				};
+				if (spot_atlas) {
+					ShadowAtlas::Tile const &tile = shadow_buffer_manager.spot_atlas.lights[light_index].tile;
+					shadow_view.render_pass = render_pass_manager.shadow_atlas_render_pass;
+					shadow_view.framebuffer = shadow_buffer_manager.spot_atlas_target.framebuffer;
+					shadow_view.offset = VkOffset2D{.x = int32_t(tile.x), .y = int32_t(tile.y)};
+					shadow_view.resolution = tile.size;
+					add_shadow_view(shadow_view, ShadowCache::Spot, view, spot_draw_first, spot_dynamic_draw_first,
+						VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, 0);
+				} else {
+					auto const &shadow_target = shadow_buffer_manager.spot_shadow_targets[light_index];
+					shadow_view.framebuffer = shadow_target.depth_target.framebuffer;
+					shadow_view.resolution = shadow_target.resolution;
+					add_shadow_view(shadow_view, ShadowCache::Spot, view, spot_draw_first, spot_dynamic_draw_first,
+						shadow_target.depth_target.image.handle, shadow_target.static_depth_target.image.handle,
+						shadow_target.static_depth_target.framebuffer, 0);
+				}
+			}
 
-							std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
-							std::array< VkDeviceSize, 1 > offsets{ 0 };
-							vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
+			//the contents of one view's render pass:
+			auto record_shadow_view = [&](ShadowView const &shadow_view, VkCommandBuffer command_buffer) {
+				const VkRect2D shadow_scissor = ShadowBufferManager::get_shadow_scissor(shadow_view.resolution, shadow_view.offset);
+				const VkViewport shadow_viewport = ShadowBufferManager::get_shadow_viewport(shadow_view.resolution, shadow_view.offset);
+				vkCmdSetScissor(command_buffer, 0, 1, &shadow_scissor);
+				vkCmdSetViewport(command_buffer, 0, 1, &shadow_viewport);
 
-							auto &global_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredSphereShadowPipeline"]][sphere_shadow_pipeline.block_descriptor_set_name_to_index["Global"]].descriptor_set;
-							auto &transform_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredSphereShadowPipeline"]][sphere_shadow_pipeline.block_descriptor_set_name_to_index["Transforms"]].descriptor_set;
+				if (shadow_view.pipeline == VK_NULL_HANDLE) return; //(no casters: the pass just clears the map, or keeps the copy in it)
+				vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadow_view.pipeline);
 
-							std::array< VkDescriptorSet, 2 > descriptor_sets{
-								global_descriptor_set,
-								transform_descriptor_set,
-							};
+				std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
+				std::array< VkDeviceSize, 1 > offsets{ 0 };
+				vkCmdBindVertexBuffers(command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
 
-							vkCmdBindDescriptorSets(
-								workspace.command_buffer,
-								VK_PIPELINE_BIND_POINT_GRAPHICS,
-								sphere_shadow_pipeline.layout,
-								0,
-								uint32_t(descriptor_sets.size()), descriptor_sets.data(),
-								0, nullptr
-							);
+				vkCmdBindDescriptorSets(
+					command_buffer,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					shadow_view.layout,
+					0,
+					uint32_t(shadow_view.descriptor_sets.size()), shadow_view.descriptor_sets.data(),
+					0, nullptr
+				);
 
-							DeferredSphereShadowPipeline::Push push{
-								.LIGHT_INDEX = light_index,
-								.FACE_INDEX = face_index,
-							};
-							vkCmdPushConstants(workspace.command_buffer, sphere_shadow_pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+				vkCmdPushConstants(command_buffer, shadow_view.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, shadow_view.push_size, shadow_view.push.data());
 
-							for (uint32_t i = 0; i < shadow_object_instances.size(); ++i) {
-								vkCmdDraw(workspace.command_buffer, shadow_object_instances[i].object_ranges.count, 1, shadow_object_instances[i].object_ranges.first, i);
-							}
-						}
-					}
-					vkCmdEndRenderPass(workspace.command_buffer);
+				if (rtg.configuration.gpu_culling) {
+					draw_culled(command_buffer, shadow_view.cull_view);
+				} else {
+					//(casters are uploaded view after view, so entry k of a pipeline's casters.instances has transform k)
+					draw_cpu_commands(command_buffer, shadow_view.first_command, shadow_view.command_count);
 				}
-			}
-		}
+			};
 
-		// =====================================================================
-		// Spot shadow pass: render depth for each shadow-casting spot light
-		// =====================================================================
-		{
-			const uint32_t shadow_count = std::min(
-				static_cast<uint32_t>(shadow_buffer_manager.spot_shadow_targets.size()),
-				static_cast<uint32_t>(lights_manager.get_shadow_spot_lights().size())
-			);
+			if (record_in_parallel) {
+				workspace.record_secondaries(
+					rtg, shadow_views.size(),
+					[&](size_t v) {
+						return VkCommandBufferInheritanceInfo{
+							.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+							.renderPass = shadow_views[v].render_pass,
+							.subpass = 0,
+							.framebuffer = shadow_views[v].framebuffer,
+						};
+					},
+					[&](size_t v, VkCommandBuffer command_buffer) { record_shadow_view(shadow_views[v], command_buffer); },
+					shadow_command_buffers
+				);
+			}
 
-			for (uint32_t light_index = 0; light_index < shadow_count; ++light_index) {
-				auto const &shadow_target = shadow_buffer_manager.spot_shadow_targets[light_index];
-				
-				VkExtent2D shadow_extent{
-					.width = shadow_target.resolution,
-					.height = shadow_target.resolution,
-				};
+			shadow_buffer_manager.prepare_atlas(workspace.command_buffer);
+			for (size_t v = 0; v < shadow_views.size(); ++v) {
+				if (shadow_views[v].copy_from != VK_NULL_HANDLE) {
+					ShadowBufferManager::copy_static_layer(workspace.command_buffer, shadow_views[v].copy_from, shadow_views[v].copy_to,
+						shadow_views[v].copy_layer, shadow_views[v].resolution);
+				}
 
 				VkRenderPassBeginInfo begin_info{
 					.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-					.renderPass = render_pass_manager.shadow_render_pass,
-					.framebuffer = shadow_target.depth_target.framebuffer,
+					.renderPass = shadow_views[v].render_pass,
+					.framebuffer = shadow_views[v].framebuffer,
 					.renderArea{
-						.offset = {.x = 0, .y = 0},
-						.extent = shadow_extent,
+						.offset = shadow_views[v].offset,
+						.extent = {.width = shadow_views[v].resolution, .height = shadow_views[v].resolution},
 					},
 					.clearValueCount = 1,
 					.pClearValues = &shadow_buffer_manager.shadow_clear_value,
 				};
 
-				vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
-				{
-					const VkRect2D shadow_scissor = ShadowBufferManager::get_shadow_scissor(shadow_target.resolution);
-					const VkViewport shadow_viewport = ShadowBufferManager::get_shadow_viewport(shadow_target.resolution);
-					vkCmdSetScissor(workspace.command_buffer, 0, 1, &shadow_scissor);
-					vkCmdSetViewport(workspace.command_buffer, 0, 1, &shadow_viewport);
-
-					if (!shadow_object_instances.empty()) {
-						vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spot_shadow_pipeline.pipeline);
+				if (record_in_parallel) {
+					vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					vkCmdExecuteCommands(workspace.command_buffer, 1, &shadow_command_buffers[v]);
+				} else {
+					vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+					record_shadow_view(shadow_views[v], workspace.command_buffer);
+				}
+				vkCmdEndRenderPass(workspace.command_buffer);
+			}
+		}
 
-						std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
-						std::array< VkDeviceSize, 1 > offsets{ 0 };
-						vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
 
-						auto &global_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredSpotShadowPipeline"]][spot_shadow_pipeline.block_descriptor_set_name_to_index["Global"]].descriptor_set;
-						auto &transform_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredSpotShadowPipeline"]][spot_shadow_pipeline.block_descriptor_set_name_to_index["Transforms"]].descriptor_set;
+		//the deferred write pipeline's descriptor sets:
+		const std::array< VkDescriptorSet, 3 > gbuffer_descriptor_sets{
+			workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredWritePipeline"]][deferred_write_pipeline.block_descriptor_set_name_to_index["PV"]].descriptor_set,
+			workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredWritePipeline"]][deferred_write_pipeline.block_descriptor_set_name_to_index["Transforms"]].descriptor_set,
+			deferred_write_pipeline.set2_Textures_instance,
+		};
 
-						std::array< VkDescriptorSet, 2 > descriptor_sets{
-							global_descriptor_set,
-							transform_descriptor_set,
-						};
+		//write 'count' of the CPU culling path's draw commands, starting at 'first', to the gbuffer (or, with GPU culling, the whole write view):
+		auto draw_gbuffer_range = [&](VkCommandBuffer command_buffer, uint32_t first, uint32_t count) {
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferred_write_pipeline.pipeline);
 
-						vkCmdBindDescriptorSets(
-							workspace.command_buffer,
-							VK_PIPELINE_BIND_POINT_GRAPHICS,
-							spot_shadow_pipeline.layout,
-							0,
-							uint32_t(descriptor_sets.size()), descriptor_sets.data(),
-							0, nullptr
-						);
+			std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
+			std::array< VkDeviceSize, 1 > offsets{ 0 };
+			vkCmdBindVertexBuffers(command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
 
-						DeferredSpotShadowPipeline::Push push{
-							.LIGHT_INDEX = light_index,
-						};
-						vkCmdPushConstants(workspace.command_buffer, spot_shadow_pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+			vkCmdBindDescriptorSets(
+				command_buffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				deferred_write_pipeline.layout,
+				0,
+				uint32_t(gbuffer_descriptor_sets.size()), gbuffer_descriptor_sets.data(),
+				0, nullptr
+			);
 
-						for (uint32_t i = 0; i < shadow_object_instances.size(); ++i) {
-							vkCmdDraw(workspace.command_buffer, shadow_object_instances[i].object_ranges.count, 1, shadow_object_instances[i].object_ranges.first, i);
-						}
-					}
-				}
-				vkCmdEndRenderPass(workspace.command_buffer);
+			if (rtg.configuration.gpu_culling) {
+				draw_culled(command_buffer, CullWriteView);
+			} else {
+				//(instance i has transform and material index i)
+				draw_cpu_commands(command_buffer, first, count);
 			}
-		}
+		};
 
+		//write the objects to the gbuffer (in the second pass of two-phase occlusion culling):
+		auto draw_gbuffer_objects = [&](VkCommandBuffer command_buffer) {
+			if (rtg.configuration.gpu_culling || !deferred_object_instances.empty()) {
+				draw_gbuffer_range(command_buffer, 0, deferred_draw_count);
+			}
+		};
 
 		// =====================================================================
 		// Deferred write pass: Render scene geometry to GBuffer
 		// =====================================================================
 		{
+			//the pass is recorded in ranges of the draws (so that, recorded in parallel, long runs of vkCmdDraw calls are shared between threads):
+			main_draw_ranges.clear();
+			if (rtg.configuration.gpu_culling) {
+				main_draw_ranges.emplace_back(DrawRange{ .first_command = 0, .command_count = 0 });
+			} else if (!deferred_object_instances.empty()) {
+				const uint32_t range_commands = uint32_t(std::min< uint64_t >(uint64_t(MainPassRangeDraws) * std::max(rtg.max_draw_indirect_count, 1u), UINT32_MAX));
+				for (uint32_t done = 0; done < deferred_draw_count; ) {
+					const uint32_t count = std::min(range_commands, deferred_draw_count - done);
+					main_draw_ranges.emplace_back(DrawRange{ .first_command = done, .command_count = count });
+					done += count;
+				}
+			}
+
+			auto record_write_pass = [&](size_t r, VkCommandBuffer command_buffer) {
+				vkCmdSetScissor(command_buffer, 0, 1, &hdrbuffer_manager.full_scissor);
+				vkCmdSetViewport(command_buffer, 0, 1, &hdrbuffer_manager.full_viewport);
+
+				draw_gbuffer_range(command_buffer, main_draw_ranges[r].first_command, main_draw_ranges[r].command_count);
+			};
+			const bool write_in_parallel = (record_in_parallel && !main_draw_ranges.empty()); //(an empty pass is just cleared)
+
+			if (write_in_parallel) {
+				workspace.record_secondaries(
+					rtg, main_draw_ranges.size(),
+					[&](size_t) {
+						return VkCommandBufferInheritanceInfo{
+							.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+							.renderPass = render_pass_manager.gbuffer_render_pass,
+							.subpass = 0,
+							.framebuffer = gbuffer_manager.gbuffer_framebuffer,
+						};
+					},
+					record_write_pass,
+					main_command_buffers
+				);
+			}
+
 			VkRenderPassBeginInfo begin_info{
 				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
 				.renderPass = render_pass_manager.gbuffer_render_pass,
@@ -758,48 +1252,132 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 				.pClearValues = gbuffer_manager.gbuffer_clears.data(),
 			};
 
-			vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
-			{
-				vkCmdSetScissor(workspace.command_buffer, 0, 1, &hdrbuffer_manager.full_scissor);
-				vkCmdSetViewport(workspace.command_buffer, 0, 1, &hdrbuffer_manager.full_viewport);
-
-				if (!deferred_object_instances.empty()) {
-					vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferred_write_pipeline.pipeline);
+			if (write_in_parallel) {
+				vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				vkCmdExecuteCommands(workspace.command_buffer, uint32_t(main_command_buffers.size()), main_command_buffers.data());
+			} else {
+				vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+				for (size_t r = 0; r < main_draw_ranges.size(); ++r) {
+					record_write_pass(r, workspace.command_buffer);
+				}
+			}
+			vkCmdEndRenderPass(workspace.command_buffer);
+		}
 
-					std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
-					std::array< VkDeviceSize, 1 > offsets{ 0 };
-					vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
+		// =====================================================================
+		// Occlusion culling: depth pyramid of the gbuffer (and, for two-phase culling, a second write pass)
+		// =====================================================================
+		if (rtg.configuration.occlusion_culling != OcclusionCullingMode::Disabled) {
+			{ //depth written by the write pass (and the pyramid read by culling) before the build:
+				VkImageMemoryBarrier depth_barrier{
+					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+					.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+					.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+					.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.image = gbuffer_manager.depth_target.image.handle,
+					.subresourceRange{
+						.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+						.baseMipLevel = 0,
+						.levelCount = 1,
+						.baseArrayLayer = 0,
+						.layerCount = 1,
+					},
+				};
 
-					auto &pv_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredWritePipeline"]][deferred_write_pipeline.block_descriptor_set_name_to_index["PV"]].descriptor_set;
-					auto &transform_descriptor_set = workspace.pipeline_descriptor_set_groups[pipeline_name_to_index["DeferredWritePipeline"]][deferred_write_pipeline.block_descriptor_set_name_to_index["Transforms"]].descriptor_set;
+				vkCmdPipelineBarrier(
+					workspace.command_buffer,
+					VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // srcStageMask
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,          // dstStageMask
+					0,                                             // dependencyFlags
+					0, nullptr,                                    // memoryBarriers
+					0, nullptr,                                    // bufferMemoryBarriers
+					1, &depth_barrier                              // imageMemoryBarriers
+				);
+			}
 
-					std::array< VkDescriptorSet, 3 > descriptor_sets{
-						pv_descriptor_set,
-						transform_descriptor_set,
-						deferred_write_pipeline.set2_Textures_instance,
-					};
+			{ //build the pyramid, each level from the one before:
+				vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiz_compute_pipeline.pipeline);
+				for (uint32_t level = 0; level < hiz_buffer_manager.level_count; ++level) {
+					if (level != 0) {
+						memory_barrier(
+							VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+							VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+						);
+					}
 
 					vkCmdBindDescriptorSets(
 						workspace.command_buffer,
-						VK_PIPELINE_BIND_POINT_GRAPHICS,
-						deferred_write_pipeline.layout,
+						VK_PIPELINE_BIND_POINT_COMPUTE,
+						hiz_compute_pipeline.layout,
 						0,
-						uint32_t(descriptor_sets.size()), descriptor_sets.data(),
+						1, &hiz_compute_pipeline.set0_Levels_instances[level],
 						0, nullptr
 					);
 
-					for (uint32_t i = 0; i < deferred_object_instances.size(); ++i) {
-						DeferredWritePipeline::Push push{
-							// Textures[0] is BRDF LUT; each material occupies 5 consecutive slots.
-							.MATERIAL_INDEX = uint32_t(1 + deferred_object_instances[i].material_index * 5),
-						};
+					VkExtent2D const &src = hiz_buffer_manager.level_extents[level == 0 ? 0 : level - 1];
+					VkExtent2D const &dst = hiz_buffer_manager.level_extents[level];
+					DeferredHiZComputePipeline::Push push{
+						.SRC_SIZE = { int32_t(src.width), int32_t(src.height) },
+						.DST_SIZE = { int32_t(dst.width), int32_t(dst.height) },
+						.REVERSE_Z = rtg.configuration.reverse_z ? 1u : 0u,
+					};
+					vkCmdPushConstants(workspace.command_buffer, hiz_compute_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
 
-						vkCmdPushConstants(workspace.command_buffer, deferred_write_pipeline.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
-						vkCmdDraw(workspace.command_buffer, deferred_object_instances[i].object_ranges.count, 1, deferred_object_instances[i].object_ranges.first, i);
-					}
+					vkCmdDispatch(workspace.command_buffer,
+						(dst.width + DeferredHiZComputePipeline::WorkgroupSize - 1) / DeferredHiZComputePipeline::WorkgroupSize,
+						(dst.height + DeferredHiZComputePipeline::WorkgroupSize - 1) / DeferredHiZComputePipeline::WorkgroupSize,
+						1
+					);
 				}
+
+				//pyramid read by culling (now, or at the start of the next frame):
+				memory_barrier(
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+				);
+			}
+
+			if (rtg.configuration.occlusion_culling == OcclusionCullingMode::LastFrame) {
+				hiz_clip_from_world = clip_from_world;
+				hiz_valid = true;
+			} else { //second phase: cull the main views against the pyramid, then write what the first phase missed
+				//the first phase's draws have read the counts before they are counted again:
+				memory_barrier(
+					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+				);
+				vkCmdFillBuffer(workspace.command_buffer, workspace.global_buffer_pairs["DrawCounts"]->device.handle, 0, CullShadowViewFirst * sizeof(uint32_t), 0);
+				memory_barrier(
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+				);
+
+				dispatch_cull(DeferredCullComputePipeline::TwoPhaseSecond, CullShadowViewFirst, clip_from_world, true);
+
+				memory_barrier(
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+				);
+
+				VkRenderPassBeginInfo begin_info{
+					.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+					.renderPass = render_pass_manager.gbuffer_load_render_pass,
+					.framebuffer = gbuffer_manager.gbuffer_framebuffer, //(compatible: only load/store ops differ)
+					.renderArea{
+						.offset = {.x = 0, .y = 0},
+						.extent = rtg.swapchain_extent,
+					},
+				};
+
+				vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdSetScissor(workspace.command_buffer, 0, 1, &hdrbuffer_manager.full_scissor);
+				vkCmdSetViewport(workspace.command_buffer, 0, 1, &hdrbuffer_manager.full_viewport);
+				draw_gbuffer_objects(workspace.command_buffer);
+				vkCmdEndRenderPass(workspace.command_buffer);
 			}
-			vkCmdEndRenderPass(workspace.command_buffer);
 		}
 
 		// =====================================================================
@@ -1081,6 +1659,12 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 		VK( vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, render_params.workspace_available) );
 	}
 
+	if (rtg.configuration.headless) { //(compare --threads 1, which records inline, with parallel secondary recording)
+		std::cout << "Command recording: " << recording_ms << " ms (" << shadow_views.size() << " shadow views, ";
+		if (rtg.jobs.thread_count() > 1) std::cout << "secondary command buffers on " << rtg.jobs.thread_count() << " threads)" << std::endl;
+		else std::cout << "inline)" << std::endl;
+	}
+
 	if (rtg.configuration.headless &&  query_pool_manager.is_enabled()) {
 		double frame_ms = 0.0;
         if (query_pool_manager.fetch_frame_ms(rtg, render_params.workspace_index, frame_ms)) {
@@ -1095,8 +1679,8 @@ void Deferred::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 void Deferred::update(float dt) {
 	time = std::fmod(time + dt, 8.0f);
 
-	SceneTree::update_animation(doc, time);
-	SceneTree::traverse_scene(doc, mesh_tree_data, light_tree_data, camera_tree_data, environment_tree_data);
+	SceneTree::update_animation(doc, time, &rtg.jobs);
+	SceneTree::traverse_scene(doc, mesh_tree_data, light_tree_data, camera_tree_data, environment_tree_data, tree_changes, &rtg.jobs);
 
 	{ // update global data
 		camera_manager.update(dt, camera_tree_data, rtg.configuration);
@@ -1108,74 +1692,327 @@ void Deferred::update(float dt) {
 		);
 	}
 
+	if (rtg.configuration.gpu_culling) { // instances are culled on the GPU; only the scene arrays and views are needed
+		update_gpu_scene();
+		update_shadow_atlas();
+		return;
+	}
+
 	{ // update object instances with frustum culling
-		deferred_object_instances.clear();
-		shadow_object_instances.clear();
 		// Get frustum for culling
 		auto frustum = camera_manager.get_frustum();
 
-		for(auto &mtd : mesh_tree_data){
-			const size_t mesh_index = mtd.mesh_index;
-			const size_t material_index = mtd.material_index;
+		// shadow instances and world bounds only change for meshes traverse_scene reports as moved
+		auto update_mesh = [&](size_t i) {
+			const SceneTree::MeshTreeData &mtd = mesh_tree_data[i];
 			const glm::mat4 MODEL = BLENDER_TO_VULKAN_4 * mtd.model_matrix;
-			const glm::mat4 MODEL_NORMAL = glm::transpose(glm::inverse(MODEL));
-			const auto& object_range = doc->meshes[mesh_index].range;
-			std::optional<S72Loader::Material> material = doc->materials[material_index];
+			const auto& object_range = doc->meshes[mtd.mesh_index].range;
 
-			ShadowInstance shadow_inst{
+			shadow_object_instances[i] = ShadowInstance{
 				.object_ranges = object_range,
 				.object_transform{
 					.MODEL = MODEL,
-					.MODEL_NORMAL = MODEL_NORMAL,
+					.MODEL_NORMAL = glm::transpose(glm::inverse(MODEL)),
 				},
+				.mesh_index = uint32_t(mtd.mesh_index),
 			};
-			shadow_object_instances.emplace_back(std::move(shadow_inst));
-
-			// Transform local AABB to world AABB (8 corners method)
-			const glm::vec3& bmin = object_range.aabb_min;
-			const glm::vec3& bmax = object_range.aabb_max;
-			glm::vec3 corners[8] = {
-				{bmin.x, bmin.y, bmin.z}, {bmax.x, bmin.y, bmin.z}, {bmin.x, bmax.y, bmin.z}, {bmax.x, bmax.y, bmin.z},
-				{bmin.x, bmin.y, bmax.z}, {bmax.x, bmin.y, bmax.z}, {bmin.x, bmax.y, bmax.z}, {bmax.x, bmax.y, bmax.z}
-			};
-			glm::vec3 world_min(std::numeric_limits<float>::max());
-			glm::vec3 world_max(std::numeric_limits<float>::lowest());
-			for (int c = 0; c < 8; ++c) {
-				glm::vec3 wp = glm::vec3(MODEL * glm::vec4(corners[c], 1.0f));
-				world_min = glm::min(world_min, wp);
-				world_max = glm::max(world_max, wp);
+			mesh_bounds[i] = BVH::transform_box(MODEL, object_range.aabb_min, object_range.aabb_max);
+		};
+		const bool rebuild_bvh = (tree_changes.all || shadow_object_instances.size() != mesh_tree_data.size());
+		if (rebuild_bvh) {
+			shadow_object_instances.resize(mesh_tree_data.size());
+			mesh_bounds.resize(mesh_tree_data.size());
+			rtg.jobs.parallel_for(mesh_tree_data.size(), InstanceChunkSize, [&](size_t, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) update_mesh(i);
+			});
+			mesh_bvh.build(mesh_bounds);
+		} else {
+			rtg.jobs.parallel_for(tree_changes.meshes.size(), InstanceChunkSize, [&](size_t, size_t begin, size_t end) {
+				for (size_t k = begin; k < end; ++k) update_mesh(tree_changes.meshes[k]);
+			});
+			for (uint32_t i : tree_changes.meshes) {
+				mesh_bvh.update(i, mesh_bounds[i]);
 			}
+			mesh_bvh.refit();
+		}
 
-			// Frustum culling check with world-space AABB
-			if (!frustum.is_box_visible(world_min, world_max)) {
-				continue;
+		// Frustum culling, descending the BVH (or mostly reusing the last frame's result)
+		if (rtg.configuration.visibility_cache) {
+			visibility_cache.cull(mesh_bvh, frustum, camera_manager.get_culling_perspective(), camera_manager.get_culling_view(), tree_changes.meshes, rebuild_bvh, mesh_visible);
+			if (rtg.configuration.headless) {
+				std::cout << "CPU visibility cache hit rate: " << visibility_cache.last.hit_rate() * 100.0 << "% ("
+				          << visibility_cache.total.hit_rate() * 100.0 << "% overall, " << visibility_cache.total.rebuilds << " rebuilds)\n";
 			}
+		} else {
+			mesh_bvh.cull(frustum, mesh_visible);
+		}
 
-			// Lambertian material instance
-			// if(material.has_value() && material->lambertian) {
-			// 	DeferredInstance deferred_inst{
-			// 		.object_ranges = object_range,
-			// 		.object_transform{
-			// 			.MODEL = MODEL,
-			// 			.MODEL_NORMAL = MODEL_NORMAL,
-			// 		},
-			// 		.material_index = material_index,
-			// 	};
-			// 	deferred_object_instances.emplace_back(std::move(deferred_inst));
-			// }
-
-			// PBR material instance
-			if(material.has_value() && material->lambertian || material.has_value() && material->pbr) {
-				DeferredInstance deferred_inst{
-					.object_ranges = object_range,
-					.object_transform{
-						.MODEL = MODEL,
-						.MODEL_NORMAL = MODEL_NORMAL,
-					},
-					.material_index = material_index,
-				};
-				deferred_object_instances.emplace_back(std::move(deferred_inst));
+		// Shadow casters of each shadow view, culled from the same BVH
+		lights_manager.cull_shadow_casters(mesh_bvh, sun_casters, sphere_casters, spot_casters, &rtg.jobs);
+
+		// Shadow views whose light and casters haven't changed keep their maps
+		if (rtg.configuration.shadow_cache != ShadowCacheMode::NoShadowCache) {
+			shadow_buffer_manager.update_cache(rtg, lights_manager, sun_casters, sphere_casters, spot_casters, tree_changes.meshes, rebuild_bvh, mesh_tree_data.size());
+			if (rtg.configuration.headless) {
+				ShadowCache const &cache = shadow_buffer_manager.cache;
+				std::cout << "Shadow cache: " << cache.last.drawn << " of " << cache.last.views << " views drawn ("
+				          << cache.last.static_drawn << " static; " << cache.total.hit_rate() * 100.0 << "% kept overall)\n";
+			}
+		}
+		update_shadow_atlas();
+		if (rtg.configuration.layered_shadows) {
+			layer_shadow_casters(sun_casters, LightsManager::SunCascadeCount, layered_sun_casters, layered_sun_masks);
+			layer_shadow_casters(sphere_casters, LightsManager::SphereShadowFaceCount, layered_sphere_casters, layered_sphere_masks);
+			if (rtg.configuration.headless) { //(against one pass per face, as without --layered-shadows)
+				std::cout << "Layered sphere shadows: " << layered_sphere_casters.view_count() << " passes (not " << sphere_casters.view_count() << "), "
+				          << layered_sphere_casters.instances.size() << " caster entries (not " << sphere_casters.instances.size() << ")\n";
 			}
+		} else {
+			group_shadow_casters(sun_casters, ShadowCache::Sun);
+			group_shadow_casters(sphere_casters, ShadowCache::Sphere);
+		}
+		group_shadow_casters(spot_casters, ShadowCache::Spot);
+
+		// Occluders for the main view (shadow casters aren't occlusion culled: they may still cast into view)
+		const bool occlusion = (rtg.configuration.software_occlusion > 0);
+		if (occlusion) render_software_occlusion();
+
+		// chunks of mesh_tree_data are processed in parallel; each chunk collects its own visible
+		// instances, and the chunks are appended in order so the list matches a serial loop
+		// (each instance also gets its draw sort key, from the view depth of its bounds center)
+		const glm::mat4 culling_view = camera_manager.get_culling_view();
+		instance_chunks.resize(JobSystem::chunk_count(mesh_tree_data.size(), InstanceChunkSize));
+		rtg.jobs.parallel_for(mesh_tree_data.size(), InstanceChunkSize, [&](size_t chunk, size_t begin, size_t end) {
+			InstanceChunk &out = instance_chunks[chunk];
+			out.deferred.clear();
+			out.deferred_keys.clear();
+
+			for (size_t word = begin / 64; word < (end + 63) / 64; ++word) {
+				for (uint64_t bits = mesh_visible[word]; bits != 0; bits &= bits - 1) {
+					const size_t i = word * 64 + size_t(std::countr_zero(bits));
+					if (occlusion && !(mesh_occluder[word] & (uint64_t(1) << (i % 64)))
+					 && !cpu_occlusion.is_box_visible(mesh_bounds[i].min, mesh_bounds[i].max)) continue;
+					const ShadowInstance &shadow = shadow_object_instances[i];
+					const size_t material_index = mesh_tree_data[i].material_index;
+					const S72Loader::Material &material = doc->materials[material_index];
+
+					// Lambertian and PBR materials both go through the deferred path
+					if(material.lambertian || material.pbr) {
+						DeferredInstance deferred_inst{
+							.object_ranges = shadow.object_ranges,
+							.object_transform = shadow.object_transform,
+							.material_index = material_index,
+							.mesh_index = shadow.mesh_index,
+						};
+						out.deferred.emplace_back(std::move(deferred_inst));
+
+						const glm::vec3 center = 0.5f * (mesh_bounds[i].min + mesh_bounds[i].max);
+						const float depth = -(culling_view * glm::vec4(center, 1.0f)).z;
+						out.deferred_keys.emplace_back(DrawSort::key(0, shadow.mesh_index, depth));
+					}
+				}
+			}
+		});
+
+		deferred_object_instances.clear();
+		deferred_keys.clear();
+		for (auto const &chunk : instance_chunks) {
+			deferred_object_instances.insert(deferred_object_instances.end(), chunk.deferred.begin(), chunk.deferred.end());
+			deferred_keys.insert(deferred_keys.end(), chunk.deferred_keys.begin(), chunk.deferred_keys.end());
+		}
+
+		// sort by mesh, then depth: instances that share a mesh become adjacent (for render()'s instanced draws,
+		// which take each instance's material from its own slot) and go front to back within their draw
+		draw_sort.sort(deferred_keys, draw_order);
+		deferred_scratch.resize(deferred_object_instances.size());
+		for (size_t i = 0; i < deferred_object_instances.size(); ++i) {
+			deferred_scratch[i] = deferred_object_instances[draw_order[i]];
+		}
+		deferred_object_instances.swap(deferred_scratch);
+	}
+}
+
+
+void Deferred::update_shadow_atlas() {
+	// spot light tiles to draw this frame, and what lighting samples until they are
+	if (shadow_buffer_manager.spot_atlas.size == 0) return;
+	shadow_buffer_manager.update_atlas(rtg, lights_manager, camera_manager);
+	if (rtg.configuration.headless) {
+		ShadowAtlas const &atlas = shadow_buffer_manager.spot_atlas;
+		std::cout << "Shadow atlas: " << atlas.last.drawn << " of " << atlas.last.lights << " tiles drawn (" << atlas.last.waiting << " waiting, "
+		          << atlas.last.unmapped << " unmapped; " << double(atlas.last.texels) * 100.0 / (double(atlas.size) * double(atlas.size)) << "% of the atlas used)\n";
+	}
+}
+
+
+void Deferred::group_shadow_casters(LightsManager::ShadowCasters &casters, ShadowCache::Kind kind) {
+	// each view's casters that share a mesh become adjacent (views stay in place, so first() and count() still hold)
+	std::vector< ShadowCache::View > const &cache_views = shadow_buffer_manager.cache.views[kind];
+	const bool split = (rtg.configuration.shadow_cache == ShadowCacheMode::SplitShadowCache);
+	auto group = [&](uint32_t *first, uint32_t *last) {
+		instance_grouper.group(
+			first, last, doc->meshes.size(),
+			[&](uint32_t i) { return shadow_object_instances[i].mesh_index; }, caster_scratch
+		);
+	};
+	for (uint32_t view = 0; view < casters.view_count(); ++view) {
+		uint32_t *first = casters.instances.data() + casters.first(view);
+		uint32_t *last = first + casters.count(view);
+		if (split) {
+			uint32_t *dynamic_first = casters.instances.data() + cache_views[view].dynamic_first;
+			group(first, dynamic_first);
+			group(dynamic_first, last);
+		} else {
+			group(first, last);
+		}
+	}
+}
+
+
+void Deferred::layer_shadow_casters(LightsManager::ShadowCasters const &casters, uint32_t layer_count,
+	LightsManager::ShadowCasters &layered, std::vector< uint32_t > &layer_masks) {
+	// each caster once per light, in order of first appearance, collecting the layers it was culled into as it repeats
+	caster_layer_masks.resize(shadow_object_instances.size(), 0);
+	layered.instances.clear();
+	layered.view_first.assign(1, 0);
+	layer_masks.clear();
+	const uint32_t light_count = casters.view_count() / layer_count;
+	for (uint32_t light = 0; light < light_count; ++light) {
+		const size_t first = layered.instances.size();
+		for (uint32_t layer = 0; layer < layer_count; ++layer) {
+			const uint32_t view = light * layer_count + layer;
+			for (uint32_t k = casters.first(view); k < casters.first(view) + casters.count(view); ++k) {
+				const uint32_t item = casters.instances[k];
+				if (caster_layer_masks[item] == 0) layered.instances.emplace_back(item);
+				caster_layer_masks[item] |= 1u << layer;
+			}
+		}
+
+		uint32_t *begin = layered.instances.data() + first;
+		uint32_t *end = layered.instances.data() + layered.instances.size();
+		instance_grouper.group(
+			begin, end, doc->meshes.size(),
+			[&](uint32_t i) { return shadow_object_instances[i].mesh_index; }, caster_scratch
+		);
+		for (uint32_t const *item = begin; item != end; ++item) {
+			layer_masks.emplace_back(caster_layer_masks[*item]);
+			caster_layer_masks[*item] = 0;
+		}
+		layered.view_first.emplace_back(uint32_t(layered.instances.size()));
+	}
+}
+
+
+void Deferred::render_software_occlusion() {
+	const glm::mat4 clip_from_world = camera_manager.get_culling_clip_from_world();
+
+	// rank the visible instances by bounds area over squared view depth (roughly, how much of the screen they can cover)
+	occluder_ranking.clear();
+	for (size_t word = 0; word < mesh_visible.size(); ++word) {
+		for (uint64_t bits = mesh_visible[word]; bits != 0; bits &= bits - 1) {
+			const uint32_t i = uint32_t(word * 64 + size_t(std::countr_zero(bits)));
+			if (doc->meshes[mesh_tree_data[i].mesh_index].count > MaxOccluderVertices) continue;
+			BVH::Box const &box = mesh_bounds[i];
+			const glm::vec3 size = box.max - box.min;
+			const float depth = std::max((clip_from_world * glm::vec4((box.min + box.max) * 0.5f, 1.0f)).w, 1e-3f);
+			occluder_ranking.emplace_back((size.x * size.y + size.y * size.z + size.z * size.x) / (depth * depth), i);
+		}
+	}
+	const size_t count = std::min< size_t >(occluder_ranking.size(), rtg.configuration.software_occlusion);
+	std::partial_sort(occluder_ranking.begin(), occluder_ranking.begin() + count, occluder_ranking.end(), std::greater<>());
+
+	occluder_positions.resize(doc->meshes.size());
+	occluder_positions_loaded.resize(doc->meshes.size(), 0);
+	occluders.clear();
+	mesh_occluder.assign(mesh_visible.size(), 0);
+	for (size_t k = 0; k < count; ++k) {
+		const uint32_t i = occluder_ranking[k].second;
+		const size_t mesh_index = mesh_tree_data[i].mesh_index;
+		if (!occluder_positions_loaded[mesh_index]) {
+			occluder_positions_loaded[mesh_index] = 1;
+			const S72Loader::Mesh &mesh = doc->meshes[mesh_index];
+			try {
+				occluder_positions[mesh_index] = S72Loader::extract_mesh_positions(S72Loader::load_mesh_data(s72_dir, mesh), mesh.count);
+			} catch (const std::exception &e) {
+				std::cerr << "Warning: Failed to load occluder mesh '" << mesh.name << "': " << e.what() << std::endl;
+			}
+		}
+		if (occluder_positions[mesh_index].empty()) continue;
+
+		occluders.emplace_back(SoftwareOcclusion::Occluder{
+			.positions = &occluder_positions[mesh_index],
+			.world_from_local = BLENDER_TO_VULKAN_4 * mesh_tree_data[i].model_matrix,
+		});
+		mesh_occluder[i / 64] |= uint64_t(1) << (i % 64);
+	}
+
+	cpu_occlusion.render(clip_from_world, occluders, rtg.jobs);
+	if (!rtg.configuration.software_occlusion_dump.empty()) {
+		cpu_occlusion.save_pgm(rtg.configuration.software_occlusion_dump);
+	}
+}
+
+
+void Deferred::update_gpu_scene() {
+	if (mesh_tree_data.size() > cull_instance_capacity) {
+		throw std::runtime_error("GPU culling: scene has " + std::to_string(mesh_tree_data.size()) + " mesh instances, buffers were sized for " + std::to_string(cull_instance_capacity) + ".");
+	}
+
+	{ // scene arrays, in mesh_tree_data order; like the CPU path, only moved meshes are rewritten
+		auto update_mesh = [&](size_t i) {
+			const SceneTree::MeshTreeData &mtd = mesh_tree_data[i];
+			const glm::mat4 MODEL = BLENDER_TO_VULKAN_4 * mtd.model_matrix;
+			const auto& object_range = doc->meshes[mtd.mesh_index].range;
+			const S72Loader::Material &material = doc->materials[mtd.material_index];
+			const BVH::Box bounds = BVH::transform_box(MODEL, object_range.aabb_min, object_range.aabb_max);
+
+			gpu_transforms[i] = DeferredCommonData::Transform{
+				.MODEL = MODEL,
+				.MODEL_NORMAL = glm::transpose(glm::inverse(MODEL)),
+			};
+			gpu_materials[i] = static_cast<uint32_t>(mtd.material_index);
+			gpu_instances[i] = DeferredCommonData::CullInstance{
+				.BOUNDS_MIN = bounds.min,
+				.FIRST_VERTEX = object_range.first,
+				.BOUNDS_MAX = bounds.max,
+				.VERTEX_COUNT = object_range.count,
+				//(lambertian and PBR materials both go through the deferred path)
+				.PASS_MASK = DeferredCommonData::CullShadow
+					| (material.lambertian || material.pbr ? uint32_t(DeferredCommonData::CullWrite) : 0u),
+				._pad_{},
+			};
+		};
+		if (tree_changes.all || gpu_instances.size() != mesh_tree_data.size()) {
+			gpu_transforms.resize(mesh_tree_data.size());
+			gpu_materials.resize(mesh_tree_data.size());
+			gpu_instances.resize(mesh_tree_data.size());
+			rtg.jobs.parallel_for(mesh_tree_data.size(), InstanceChunkSize, [&](size_t, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) update_mesh(i);
+			});
+			++gpu_scene_version;
+		} else if (!tree_changes.meshes.empty()) {
+			rtg.jobs.parallel_for(tree_changes.meshes.size(), InstanceChunkSize, [&](size_t, size_t begin, size_t end) {
+				for (size_t k = begin; k < end; ++k) update_mesh(tree_changes.meshes[k]);
+			});
+			++gpu_scene_version;
+		}
+	}
+
+	{ // view planes (pass masks and command runs were set at creation)
+		auto set_planes = [](DeferredCommonData::CullView &view, CameraManager::Frustum const &frustum) {
+			for (uint32_t p = 0; p < 6; ++p) {
+				view.PLANES[p] = glm::vec4(frustum.planes[p].normal, frustum.planes[p].distance);
+			}
+		};
+		set_planes(cull_views[CullWriteView], camera_manager.get_frustum());
+
+		cull_frustums.clear();
+		lights_manager.get_shadow_view_frustums(cull_frustums);
+		if (CullShadowViewFirst + cull_frustums.size() != cull_views.size()) {
+			throw std::runtime_error("GPU culling: number of shadow views changed since creation.");
+		}
+		for (uint32_t v = 0; v < uint32_t(cull_frustums.size()); ++v) {
+			set_planes(cull_views[CullShadowViewFirst + v], cull_frustums[v]);
 		}
 	}
 }
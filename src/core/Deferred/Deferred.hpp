@@ -17,11 +17,14 @@
 #include "DeferredBackgroundPipeline.hpp"
 #include "DeferredWritePipeline.hpp"
 #include "buffer/GBufferManager.hpp"
+#include "buffer/HiZBufferManager.hpp"
 #include "DeferredPBRPipeline.hpp"
 #include "DeferredSunShadowPipeline.hpp"
 #include "DeferredSpotShadowPipeline.hpp"
 #include "DeferredSphereShadowPipeline.hpp"
 #include "DeferredTiledLightingComputePipeline.hpp"
+#include "DeferredCullComputePipeline.hpp"
+#include "DeferredHiZComputePipeline.hpp"
 #include "DeferredToneMappingPipeline.hpp"
 #include "DeferredCommonData.hpp"
 #include "SceneManager.hpp"
@@ -31,6 +34,12 @@
 #include "LightsManager.hpp"
 #include "VK.hpp"
 #include "SceneTree.hpp"
+#include "BVH.hpp"
+#include "SoftwareOcclusion.hpp"
+#include "VisibilityCache.hpp"
+#include "InstanceGrouper.hpp"
+#include "DrawSort.hpp"
+#include "ShadowCache.hpp"
 #include "QueryPoolManager.hpp"
 
 #include "RTG.hpp"
@@ -62,6 +71,8 @@ struct Deferred : RTG::Application {
 	DeferredSpotShadowPipeline spot_shadow_pipeline;
 	DeferredSphereShadowPipeline sphere_shadow_pipeline;
 	DeferredTiledLightingComputePipeline tiled_compute_pipeline;
+	DeferredCullComputePipeline cull_compute_pipeline; //(only with --gpu-culling)
+	DeferredHiZComputePipeline hiz_compute_pipeline; //(only with --occlusion-culling)
 	DeferredToneMappingPipeline tonemapping_pipeline;
 
 	//-------------------------------------------------------------------
@@ -78,6 +89,7 @@ struct Deferred : RTG::Application {
 	
 	HDRBufferManager hdrbuffer_manager;
 	ShadowBufferManager shadow_buffer_manager;
+	HiZBufferManager hiz_buffer_manager; //(only with --occlusion-culling)
 	//--------------------------------------------------------------------
 	//Resources that change when time passes or the user interacts:
 
@@ -94,14 +106,145 @@ struct Deferred : RTG::Application {
 		S72Loader::Mesh::ObjectRange object_ranges;
 		DeferredCommonData::Transform object_transform;
 		size_t material_index;
+		uint32_t mesh_index; //(runs of instances with the same mesh are drawn together, see below)
 	};
 	std::vector< DeferredInstance > deferred_object_instances;
 
 	struct ShadowInstance {
 		S72Loader::Mesh::ObjectRange object_ranges;
 		DeferredCommonData::Transform object_transform;
+		uint32_t mesh_index;
 	};
 	std::vector< ShadowInstance > shadow_object_instances;
+
+	//automatic instancing: update() makes instances that share a mesh adjacent in deferred_object_instances (and
+	//  casters that share a mesh adjacent within each shadow view), so their transforms and materials are contiguous
+	//  and render() can draw each run with one command of instanceCount N:
+	InstanceGrouper instance_grouper; //(shadow casters)
+	std::vector< uint32_t > caster_scratch;
+
+	//draw sorting: deferred_object_instances is sorted by DrawSort keys (mesh, then view depth), which groups it
+	//  as above and orders each group front to back:
+	DrawSort draw_sort;
+	std::vector< uint64_t > deferred_keys; //(scratch) per instance in deferred_object_instances
+	std::vector< uint32_t > draw_order; //(scratch) from draw_sort
+	std::vector< DeferredInstance > deferred_scratch;
+
+	//(each view's static and dynamic casters, for split shadow caching, are grouped separately)
+	void group_shadow_casters(LightsManager::ShadowCasters &casters, ShadowCache::Kind kind);
+	void update_shadow_atlas(); //(--shadow-atlas) after the shadow cache
+
+	//world-space bounds of each mesh_tree_data entry, and a BVH over them for culling
+	//  (rebuilt when traverse_scene refills mesh_tree_data, refit for entries it reports as moved):
+	std::vector< BVH::Box > mesh_bounds;
+	BVH mesh_bvh;
+	std::vector< uint64_t > mesh_visible; //frustum culling result, one bit per mesh_tree_data entry
+	SceneTree::TreeChanges tree_changes;
+	VisibilityCache visibility_cache; //(--visibility-cache) reuses mesh_visible across frames
+
+	//software occlusion (--software-occlusion): after frustum culling, the largest visible instances are rasterized
+	//  on the CPU and the other visible instances are tested against them while the instance lists are built:
+	static constexpr uint32_t MaxOccluderVertices = 3 * 4096; //(bigger meshes cost too much to rasterize every frame)
+	SoftwareOcclusion cpu_occlusion;
+	std::vector< std::vector< glm::vec3 > > occluder_positions; //per mesh, loaded the first time it is picked as an occluder
+	std::vector< uint8_t > occluder_positions_loaded; //per mesh
+	std::vector< std::pair< float, uint32_t > > occluder_ranking; //(scratch) score, mesh_tree_data index
+	std::vector< SoftwareOcclusion::Occluder > occluders; //(scratch)
+	std::vector< uint64_t > mesh_occluder; //one bit per mesh_tree_data entry: rasterized this update (never tested)
+
+	void render_software_occlusion();
+
+	//casters of each shadow view, as indices into shadow_object_instances (culled in update()):
+	LightsManager::ShadowCasters sun_casters; //view light * SunCascadeCount + cascade
+	LightsManager::ShadowCasters sphere_casters; //view light * SphereShadowFaceCount + face
+	LightsManager::ShadowCasters spot_casters; //view light
+
+	//--layered-shadows: each sun's and sphere light's casters once (view light), with the cascades (faces) each was culled into:
+	LightsManager::ShadowCasters layered_sun_casters;
+	LightsManager::ShadowCasters layered_sphere_casters;
+	std::vector< uint32_t > layered_sun_masks; //per entry of layered_sun_casters.instances: bit c for cascade c
+	std::vector< uint32_t > layered_sphere_masks; //per entry of layered_sphere_casters.instances: bit f for face f
+	std::vector< uint32_t > caster_layer_masks; //(scratch) per shadow_object_instances entry, all 0 between calls
+	//merge each light's 'layer_count' views of 'casters' into one view of 'layered' (grouped by mesh), with layer masks:
+	void layer_shadow_casters(LightsManager::ShadowCasters const &casters, uint32_t layer_count,
+		LightsManager::ShadowCasters &layered, std::vector< uint32_t > &layer_masks);
+
+	//per-chunk instance lists built in parallel by update() (then appended, in chunk order, to deferred_object_instances):
+	static constexpr size_t InstanceChunkSize = 1024; //(a multiple of 64, so chunks cover whole words of mesh_visible)
+	struct InstanceChunk {
+		std::vector< DeferredInstance > deferred;
+		std::vector< uint64_t > deferred_keys; //DrawSort keys of the instances above
+	};
+	std::vector< InstanceChunk > instance_chunks;
+
+	//CPU culling path: render() turns the lists above into one draw command per run of grouped instances or casters
+	//  (deferred, then sun, sphere and spot casters), uploads them as "DrawCommands",
+	//  and draws the GBuffer pass or a shadow view with a single vkCmdDrawIndirect over its run of them
+	std::vector< VkDrawIndirectCommand > cpu_draw_commands;
+	uint32_t deferred_draw_count = 0; //(deferred commands start at 0)
+	std::vector< uint32_t > sun_draw_first; //per view: first command (like ShadowCasters::view_first, one past the last view)
+	std::vector< uint32_t > sphere_draw_first; //(--layered-shadows: these two are per light, over layered_*_casters)
+	std::vector< uint32_t > spot_draw_first;
+	std::vector< uint32_t > sun_dynamic_draw_first; //per view: first command of its dynamic casters (split shadow caching)
+	std::vector< uint32_t > sphere_dynamic_draw_first;
+	std::vector< uint32_t > spot_dynamic_draw_first;
+
+	//parallel recording: with more than one job thread, render() records each shadow view, and ranges of the gbuffer
+	//  write pass, into secondary command buffers on the job threads (WorkspaceManager::Workspace::record_secondaries):
+	struct ShadowView { //one shadow map render pass
+		VkRenderPass render_pass; //shadow_render_pass, shadow_load_render_pass to draw over a copy of a static map, or shadow_atlas_render_pass
+		VkFramebuffer framebuffer;
+		VkOffset2D offset; //of the map in the framebuffer (an atlas tile's, with --shadow-atlas)
+		uint32_t resolution;
+		VkPipeline pipeline; //(VK_NULL_HANDLE when it has no casters: the pass only clears)
+		VkPipelineLayout layout;
+		std::array< VkDescriptorSet, 2 > descriptor_sets; //Global, Transforms
+		std::array< uint32_t, 2 > push; //the pipeline's Push: light index, then cascade or face index (if any)
+		uint32_t push_size;
+		uint32_t cull_view; //(GPU culling) view of its draws
+		uint32_t first_command, command_count; //(CPU culling) its draws in cpu_draw_commands
+		VkImage copy_from, copy_to; //(load passes) static map layer copied into the shadow map layer first
+		uint32_t copy_layer;
+	};
+	std::vector< ShadowView > shadow_views; //sun cascades, sphere faces, then spot lights (--shadow-cache, --shadow-atlas: those to draw; --layered-shadows: one per sun and sphere light)
+	std::vector< VkCommandBuffer > shadow_command_buffers; //per shadow view
+
+	struct DrawRange { //a piece of the gbuffer write pass
+		uint32_t first_command, command_count; //(CPU culling) in cpu_draw_commands
+	};
+	static constexpr uint32_t MainPassRangeDraws = 256; //draw calls per range
+	std::vector< DrawRange > main_draw_ranges;
+	std::vector< VkCommandBuffer > main_command_buffers; //per range
+
+	//GPU culling (--gpu-culling): update() keeps the whole scene in mesh_tree_data order (instance i uses
+	//  transform i and material i) and the view planes current, instead of building the lists above;
+	//  render() uploads them, culls on the GPU and draws each view with one vkCmdDrawIndirectCount
+	std::vector< DeferredCommonData::Transform > gpu_transforms;
+	std::vector< uint32_t > gpu_materials;
+	std::vector< DeferredCommonData::CullInstance > gpu_instances;
+	uint64_t gpu_scene_version = 0; //bumped whenever the scene arrays change
+	std::vector< uint64_t > gpu_scene_uploaded; //per workspace: gpu_scene_version its buffers hold
+
+	//views: the gbuffer write view, then the shadow views (LightsManager::get_shadow_view_frustums order):
+	static constexpr uint32_t CullWriteView = 0;
+	static constexpr uint32_t CullShadowViewFirst = 1;
+	std::vector< DeferredCommonData::CullView > cull_views;
+	std::vector< CameraManager::Frustum > cull_frustums; //(scratch)
+
+	//each view owns a fixed run of draw commands (vkCmdDrawIndirectCount takes the offset from the CPU), room for every
+	//  instance, so command memory is views * instances * 16 bytes (device-only, per workspace); scenes over budget are refused:
+	static constexpr VkDeviceSize CullCommandBudget = VkDeviceSize(256) << 20;
+	uint32_t cull_instance_capacity = 0; //instances the scene buffers hold
+	uint32_t cull_view_capacity = 0; //draw commands per view (cull_instance_capacity)
+
+	//occlusion culling (--occlusion-culling): the gbuffer write view is also tested against a depth pyramid of the gbuffer depth;
+	//  'two-phase' writes last frame's visible set, builds the pyramid, then culls and writes the rest in a second pass,
+	//  'last-frame' tests against the pyramid built at the end of the previous frame
+	std::vector< uint8_t > cull_visibility_cleared; //per workspace: its CullVisibility buffer has been zeroed
+	glm::mat4 hiz_clip_from_world = glm::mat4(1.0f); //main view the pyramid was last built from
+	bool hiz_valid = false; //the pyramid holds a previous frame's depth (cleared on swapchain changes)
+
+	void update_gpu_scene();
 	
 	std::vector< SceneTree::MeshTreeData > mesh_tree_data;
 	std::vector< SceneTree::LightTreeData > light_tree_data;
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Pipeline.hpp"
+#include "RTG.hpp"
+#include "buffer/HiZBufferManager.hpp"
+
+#include <glm/glm.hpp>
+
+// GPU culling pre-pass (--gpu-culling): frustum-tests every CullInstance against every CullView
+// and writes the visible ones as VkDrawIndirectCommands, for vkCmdDrawIndirectCount (see Deferred-cull.comp)
+struct DeferredCullComputePipeline : Pipeline {
+    // CullInstances, CullViews, DrawCommands, DrawCounts, CullVisibility
+    VkDescriptorSetLayout set0_Cull = VK_NULL_HANDLE;
+
+    // depth pyramid for occlusion culling (partially bound: only written with --occlusion-culling)
+    VkDescriptorSetLayout set1_HiZ = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet set1_HiZ_instance = VK_NULL_HANDLE;
+
+	VkShaderModule comp_module = VK_NULL_HANDLE;
+
+    //culling phases (see Deferred-cull.comp):
+    enum Phase : uint32_t {
+        FrustumOnly = 0,
+        TwoPhaseFirst = 1,
+        TwoPhaseSecond = 2,
+        AgainstLastFrame = 3,
+    };
+
+    struct Push {
+        glm::mat4 CLIP_FROM_WORLD; //view the depth pyramid was built from
+        glm::vec2 HIZ_SIZE;
+        uint32_t INSTANCE_COUNT;
+        uint32_t PHASE;
+        uint32_t REVERSE_Z;
+        uint32_t HIZ_LEVELS; //0: no pyramid to test against
+    };
+    static_assert(sizeof(Push) == 16*4 + 24, "Push is the expected size.");
+
+    static constexpr uint32_t WorkgroupSize = 64; //local_size_x of Deferred-cull.comp
+
+    void create(
+		RTG &rtg, 
+		VkRenderPass render_pass, 
+		uint32_t subpass,
+        const ManagerContext& context
+	) override;
+    void destroy(RTG &rtg) override;
+
+    //point set1_HiZ at a (re)created depth pyramid:
+    void update_hiz_descriptor(RTG &rtg, HiZBufferManager const &hiz);
+
+    DeferredCullComputePipeline() = default;
+    ~DeferredCullComputePipeline();
+};
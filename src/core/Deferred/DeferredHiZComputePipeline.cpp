@@ -0,0 +1,191 @@
+#include "DeferredHiZComputePipeline.hpp"
+#include "Helpers.hpp"
+#include "VK.hpp"
+
+#include <vector>
+#include <array>
+#include <cassert>
+
+static uint32_t comp_code[] = {
+#include "../../shaders/spv/Deferred-hiz.comp.inl"
+};
+
+void DeferredHiZComputePipeline::create(
+		RTG &rtg, 
+		VkRenderPass, 
+		uint32_t,
+        const ManagerContext&
+	) {
+    comp_module = rtg.helpers.create_shader_module(comp_code);
+
+    { // set0_Levels
+        std::array< VkDescriptorSetLayoutBinding, 2 > bindings{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+        };
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data(),
+        };
+
+        VK( vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Levels) );
+    }
+
+    { // descriptor pool and one set per level (not workspace-managed: the pyramid is shared by all workspaces)
+        std::array< VkDescriptorPoolSize, 2 > pool_sizes{
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = HiZBufferManager::MaxLevels,
+            },
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = HiZBufferManager::MaxLevels,
+            },
+        };
+
+        VkDescriptorPoolCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = HiZBufferManager::MaxLevels,
+            .poolSizeCount = uint32_t(pool_sizes.size()),
+            .pPoolSizes = pool_sizes.data(),
+        };
+
+        VK( vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &descriptor_pool) );
+
+        std::array< VkDescriptorSetLayout, HiZBufferManager::MaxLevels > layouts;
+        layouts.fill(set0_Levels);
+
+        VkDescriptorSetAllocateInfo alloc_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = uint32_t(layouts.size()),
+            .pSetLayouts = layouts.data(),
+        };
+
+        VK( vkAllocateDescriptorSets(rtg.device, &alloc_info, set0_Levels_instances.data()) );
+    }
+
+    { // pipeline layout
+        VkPushConstantRange push_constant_range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Push),
+        };
+
+        std::array< VkDescriptorSetLayout, 1 > layouts{
+            set0_Levels
+        };
+
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = uint32_t(layouts.size()),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range,
+        };
+
+        VK( vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout) );
+    }
+
+    { // compute pipeline
+        VkComputePipelineCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = comp_module,
+                .pName = "main"
+            },
+            .layout = layout,
+        };
+
+        VK( vkCreateComputePipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline) );
+    }
+
+    vkDestroyShaderModule(rtg.device, comp_module, nullptr);
+    comp_module = VK_NULL_HANDLE;
+}
+
+void DeferredHiZComputePipeline::update_level_descriptors(RTG &rtg, VkImageView depth_view, HiZBufferManager const &hiz) {
+    std::vector< VkDescriptorImageInfo > source_infos(hiz.level_count);
+    std::vector< VkDescriptorImageInfo > destination_infos(hiz.level_count);
+    std::vector< VkWriteDescriptorSet > writes;
+    writes.reserve(2 * hiz.level_count);
+
+    for (uint32_t level = 0; level < hiz.level_count; ++level) {
+        source_infos[level] = VkDescriptorImageInfo{
+            .sampler = hiz.sampler,
+            .imageView = (level == 0 ? depth_view : hiz.level_views[level - 1]),
+            .imageLayout = (level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL),
+        };
+        destination_infos[level] = VkDescriptorImageInfo{
+            .sampler = VK_NULL_HANDLE,
+            .imageView = hiz.level_views[level],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+
+        writes.emplace_back(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set0_Levels_instances[level],
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &source_infos[level],
+        });
+        writes.emplace_back(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set0_Levels_instances[level],
+            .dstBinding = 1,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo = &destination_infos[level],
+        });
+    }
+
+    vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+}
+
+void DeferredHiZComputePipeline::destroy(RTG &rtg) {
+    if (layout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(rtg.device, layout, nullptr);
+        layout = VK_NULL_HANDLE;
+    }
+
+    if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(rtg.device, pipeline, nullptr);
+        pipeline = VK_NULL_HANDLE;
+    }
+
+    if (descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(rtg.device, descriptor_pool, nullptr); //(frees set0_Levels_instances)
+        descriptor_pool = VK_NULL_HANDLE;
+        set0_Levels_instances.fill(VK_NULL_HANDLE);
+    }
+
+	if(set0_Levels != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(rtg.device, set0_Levels, nullptr);
+		set0_Levels = VK_NULL_HANDLE;
+	}
+}
+
+DeferredHiZComputePipeline::~DeferredHiZComputePipeline() {
+    assert(layout == VK_NULL_HANDLE);
+    assert(pipeline == VK_NULL_HANDLE);
+	assert(comp_module == VK_NULL_HANDLE);
+	assert(descriptor_pool == VK_NULL_HANDLE);
+	assert(set0_Levels == VK_NULL_HANDLE);
+}
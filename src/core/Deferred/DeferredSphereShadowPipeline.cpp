@@ -4,9 +4,14 @@ static uint32_t vert_code[] = {
 #include "../../shaders/spv/Deferred-sphere-shadow.vert.inl"
 };
 
+static uint32_t layered_vert_code[] = {
+#include "../../shaders/spv/Deferred-sphere-shadow-layered.vert.inl"
+};
+
 DeferredSphereShadowPipeline::~DeferredSphereShadowPipeline() {
     assert(layout == VK_NULL_HANDLE);
     assert(pipeline == VK_NULL_HANDLE);
+    assert(layered_pipeline == VK_NULL_HANDLE);
     assert(vert_module == VK_NULL_HANDLE);
     assert(frag_module == VK_NULL_HANDLE);
     assert(set0_Global == VK_NULL_HANDLE);
@@ -49,14 +54,20 @@ void DeferredSphereShadowPipeline::create(
         VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Global));
     }
 
-    {
-        std::array< VkDescriptorSetLayoutBinding, 1 > bindings{
+    { // transforms, and (layered_pipeline only) face masks, one per caster
+        std::array< VkDescriptorSetLayoutBinding, 2 > bindings{
             VkDescriptorSetLayoutBinding{
                 .binding = 0,
                 .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
             },
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+            },
         };
 
         VkDescriptorSetLayoutCreateInfo create_info{
@@ -111,7 +122,7 @@ void DeferredSphereShadowPipeline::create(
         BlockDescriptorConfig{
             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
             .layout = set1_Transforms,
-            .bindings_count = 1,
+            .bindings_count = 2,
         }
     );
 
@@ -124,17 +135,33 @@ void DeferredSphereShadowPipeline::create(
         {"ShadowSphereLights", 0},
         {"ShadowSphereMatrices", 1},
         {"Transforms", 0},
+        {"FaceMasks", 1},
     };
 
     pipeline_name_to_index["DeferredSphereShadowPipeline"] = 5;
 }
 
+void DeferredSphereShadowPipeline::create_layered(RTG &rtg, VkRenderPass render_pass) {
+    assert(layout != VK_NULL_HANDLE);
+    assert(layered_pipeline == VK_NULL_HANDLE);
+
+    VkShaderModule layered_vert_module = rtg.helpers.create_shader_module(layered_vert_code);
+    layered_pipeline = build_pipeline(rtg, layered_vert_module, render_pass, 0, true, true, false, 0, false);
+
+    vkDestroyShaderModule(rtg.device, layered_vert_module, nullptr);
+}
+
 void DeferredSphereShadowPipeline::destroy(RTG &rtg) {
     if (pipeline != VK_NULL_HANDLE) {
         vkDestroyPipeline(rtg.device, pipeline, nullptr);
         pipeline = VK_NULL_HANDLE;
     }
 
+    if (layered_pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(rtg.device, layered_pipeline, nullptr);
+        layered_pipeline = VK_NULL_HANDLE;
+    }
+
     if (layout != VK_NULL_HANDLE) {
         vkDestroyPipelineLayout(rtg.device, layout, nullptr);
         layout = VK_NULL_HANDLE;
@@ -10,6 +10,9 @@ struct DeferredSunShadowPipeline : Pipeline {
     VkDescriptorSetLayout set0_Global = VK_NULL_HANDLE;
     VkDescriptorSetLayout set1_Transforms = VK_NULL_HANDLE;
 
+    // (--layered-shadows) draws all cascades in one multiview pass, with a cascade mask per caster ("CascadeMasks")
+    VkPipeline layered_pipeline = VK_NULL_HANDLE;
+
     struct Push {
         uint32_t LIGHT_INDEX;
         uint32_t CASCADE_INDEX;
@@ -22,6 +25,9 @@ struct DeferredSunShadowPipeline : Pipeline {
         const ManagerContext& context
     ) override;
 
+    // Create layered_pipeline for 'render_pass' (RenderPassManager::shadow_cascade_render_pass), after create()
+    void create_layered(RTG &rtg, VkRenderPass render_pass);
+
     void destroy(RTG &rtg) override;
 
     DeferredSunShadowPipeline() = default;
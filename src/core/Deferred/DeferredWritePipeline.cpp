@@ -51,14 +51,20 @@ void DeferredWritePipeline::create(
         VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_PV));
     }
 
-    { // set1: transform SSBO
-        std::array< VkDescriptorSetLayoutBinding, 1 > bindings{
+    { // set1: transform and material index SSBOs
+        std::array< VkDescriptorSetLayoutBinding, 2 > bindings{
             VkDescriptorSetLayoutBinding{
                 .binding = 0,
                 .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
             },
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1, // material index of each instance
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+            },
         };
 
         VkDescriptorSetLayoutCreateInfo create_info{
@@ -150,18 +156,12 @@ void DeferredWritePipeline::create(
             set2_Textures,
         };
 
-        VkPushConstantRange range{
-            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .offset = 0,
-            .size = sizeof(Push),
-        };
-
         VkPipelineLayoutCreateInfo create_info{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .setLayoutCount = uint32_t(layouts.size()),
             .pSetLayouts = layouts.data(),
-            .pushConstantRangeCount = 1,
-            .pPushConstantRanges = &range,
+            .pushConstantRangeCount = 0,
+            .pPushConstantRanges = nullptr,
         };
 
         VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout));
@@ -186,7 +186,7 @@ void DeferredWritePipeline::create(
         BlockDescriptorConfig{
             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
             .layout = set1_Transforms,
-            .bindings_count = 1,
+            .bindings_count = 2,
         }
     ); // Transforms
 
@@ -198,6 +198,7 @@ void DeferredWritePipeline::create(
     block_binding_name_to_index = {
         {"PV", 0},
         {"Transforms", 0},
+        {"Materials", 1},
     };
 
     pipeline_name_to_index["DeferredWritePipeline"] = 1;
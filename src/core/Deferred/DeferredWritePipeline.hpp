@@ -12,14 +12,10 @@
 
 struct DeferredWritePipeline : Pipeline {
     VkDescriptorSetLayout set0_PV = VK_NULL_HANDLE;
-    VkDescriptorSetLayout set1_Transforms = VK_NULL_HANDLE;
+    VkDescriptorSetLayout set1_Transforms = VK_NULL_HANDLE; // transforms and material indices, per instance
     VkDescriptorSetLayout set2_Textures = VK_NULL_HANDLE;
     VkDescriptorSet set2_Textures_instance = VK_NULL_HANDLE;
 
-    struct Push {
-        uint32_t MATERIAL_INDEX;
-    };
-
     void create(
         RTG &,
         VkRenderPass render_pass,
@@ -33,6 +33,7 @@
 #include "LightsManager.hpp"
 #include "VK.hpp"
 #include "SceneTree.hpp"
+#include "BVH.hpp"
 #include "QueryPoolManager.hpp"
 
 #include "RTG.hpp"
@@ -108,6 +109,25 @@ struct SSAO : RTG::Application {
 		SSAOCommonData::Transform object_transform;
 	};
 	std::vector< ShadowInstance > shadow_object_instances;
+
+	//world-space bounds of each mesh_tree_data entry, and a BVH over them for culling
+	//  (rebuilt when traverse_scene refills mesh_tree_data, refit for entries it reports as moved):
+	std::vector< BVH::Box > mesh_bounds;
+	BVH mesh_bvh;
+	std::vector< uint64_t > mesh_visible; //frustum culling result, one bit per mesh_tree_data entry
+	SceneTree::TreeChanges tree_changes;
+
+	//casters of each shadow view, as indices into shadow_object_instances (culled in update()):
+	LightsManager::ShadowCasters sun_casters; //view light * SunCascadeCount + cascade
+	LightsManager::ShadowCasters sphere_casters; //view light * SphereShadowFaceCount + face
+	LightsManager::ShadowCasters spot_casters; //view light
+
+	//per-chunk instance lists built in parallel by update() (then appended, in chunk order, to deferred_object_instances):
+	static constexpr size_t InstanceChunkSize = 1024; //(a multiple of 64, so chunks cover whole words of mesh_visible)
+	struct InstanceChunk {
+		std::vector< DeferredInstance > deferred;
+	};
+	std::vector< InstanceChunk > instance_chunks;
 	
 	std::vector< SceneTree::MeshTreeData > mesh_tree_data;
 	std::vector< SceneTree::LightTreeData > light_tree_data;
@@ -361,13 +361,11 @@ void SSAOPBRPipeline::create(
                 }
 
                 std::vector<VkDescriptorImageInfo> spot_shadow_infos(spot_shadow_count);
-                if (shadow_map_manager && !shadow_map_manager->spot_shadow_targets.empty()) {
-                    const size_t available = shadow_map_manager->spot_shadow_targets.size();
+                if (shadow_map_manager && shadow_map_manager->spot_shadow_view(0) != VK_NULL_HANDLE) {
                     for (uint32_t i = 0; i < spot_shadow_count; ++i) {
-                        const auto &target = shadow_map_manager->spot_shadow_targets[i % available];
                         spot_shadow_infos[i] = VkDescriptorImageInfo{
                             .sampler = shadow_map_manager->spot_shadow_sampler,
-                            .imageView = target.depth_target.view,
+                            .imageView = shadow_map_manager->spot_shadow_view(i),
                             .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
                         };
                     }
@@ -8,11 +8,13 @@
 #include <GLFW/glfw3.h>
 
 #include <array>
+#include <bit>
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
 #include <type_traits>
 
 namespace {
@@ -74,6 +76,19 @@ SSDO::SSDO(RTG &rtg, const std::string &filename) :
 	camera_tree_data{},
 	environment_tree_data{}
 {
+	//SSDO draws each spot light into its own shadow map:
+	if (rtg.configuration.shadow_atlas != 0) {
+		throw std::runtime_error("--shadow-atlas is only supported by A3 and Deferred.");
+	}
+	//...and redraws every shadow map every frame:
+	if (rtg.configuration.shadow_cache != ShadowCacheMode::NoShadowCache) {
+		throw std::runtime_error("--shadow-cache is only supported by A3 and Deferred.");
+	}
+	//...one pass per cube face and per cascade:
+	if (rtg.configuration.layered_shadows) {
+		throw std::runtime_error("--layered-shadows is only supported by A3 and Deferred.");
+	}
+
 	SceneTree::traverse_scene(doc, mesh_tree_data, light_tree_data, camera_tree_data, environment_tree_data);
 
 	camera_manager.create(doc, rtg.swapchain_extent.width, rtg.swapchain_extent.height, this->camera_tree_data, rtg.configuration);
@@ -578,10 +593,10 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 		}
 
 		{ //upload transforms for all pipelines
-			auto upload_transforms = [&](const char* pipeline_name, auto& instances, const auto& pipeline) {
-				if (instances.empty()) return;
+			auto upload_transform_data = [&](const char* pipeline_name, const std::vector<SSDOCommonData::Transform>& transform_data, const auto& pipeline) {
+				if (transform_data.empty()) return;
 				
-				size_t needed_bytes = instances.size() * sizeof(SSDOCommonData::Transform);
+				size_t needed_bytes = transform_data.size() * sizeof(SSDOCommonData::Transform);
 				uint32_t pipeline_idx = pipeline_name_to_index[pipeline_name];
 				uint32_t set_idx = pipeline.block_descriptor_set_name_to_index.at("Transforms");
 				uint32_t binding_idx = pipeline.block_binding_name_to_index.at("Transforms");
@@ -597,19 +612,32 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 				assert(buffer_pair->host.size >= needed_bytes);
 				assert(buffer_pair->host.allocation.mapped);
 
+				workspace.write_buffer(rtg, pipeline_idx, set_idx, binding_idx, (void*)transform_data.data(), needed_bytes);
+			};
+
+			auto upload_transforms = [&](const char* pipeline_name, auto& instances, const auto& pipeline) {
 				std::vector<SSDOCommonData::Transform> transform_data;
 				transform_data.reserve(instances.size());
 				for (const auto& inst : instances) {
 					transform_data.push_back(inst.object_transform);
 				}
-				
-				workspace.write_buffer(rtg, pipeline_idx, set_idx, binding_idx, transform_data.data(), needed_bytes);
+				upload_transform_data(pipeline_name, transform_data, pipeline);
+			};
+
+			//shadow pipelines get the casters of each of their views, back to back (see LightsManager::ShadowCasters):
+			auto upload_casters = [&](const char* pipeline_name, const LightsManager::ShadowCasters& casters, const auto& pipeline) {
+				std::vector<SSDOCommonData::Transform> transform_data;
+				transform_data.reserve(casters.instances.size());
+				for (uint32_t i : casters.instances) {
+					transform_data.push_back(shadow_object_instances[i].object_transform);
+				}
+				upload_transform_data(pipeline_name, transform_data, pipeline);
 			};
 
 			upload_transforms("SSDODeferredWritePipeline", deferred_object_instances, deferred_write_pipeline);
-			upload_transforms("SSDOSunShadowPipeline", shadow_object_instances, sun_shadow_pipeline);
-			upload_transforms("SSDOSpotShadowPipeline", shadow_object_instances, spot_shadow_pipeline);
-			upload_transforms("SSDOSphereShadowPipeline", shadow_object_instances, sphere_shadow_pipeline);
+			upload_casters("SSDOSunShadowPipeline", sun_casters, sun_shadow_pipeline);
+			upload_casters("SSDOSpotShadowPipeline", spot_casters, spot_shadow_pipeline);
+			upload_casters("SSDOSphereShadowPipeline", sphere_casters, sphere_shadow_pipeline);
 		}
 
 		{ //memory barrier to make sure copies complete before rendering happens:
@@ -712,7 +740,8 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 						vkCmdSetScissor(workspace.command_buffer, 0, 1, &shadow_scissor);
 						vkCmdSetViewport(workspace.command_buffer, 0, 1, &shadow_viewport);
 
-						if (!shadow_object_instances.empty()) {
+						const uint32_t view = light_index * LightsManager::SunCascadeCount + cascade_index;
+						if (sun_casters.count(view) != 0) {
 							vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sun_shadow_pipeline.pipeline);
 
 							std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
@@ -742,8 +771,10 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 							};
 							vkCmdPushConstants(workspace.command_buffer, sun_shadow_pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
 
-							for (uint32_t i = 0; i < shadow_object_instances.size(); ++i) {
-								vkCmdDraw(workspace.command_buffer, shadow_object_instances[i].object_ranges.count, 1, shadow_object_instances[i].object_ranges.first, i);
+							//(casters are uploaded view after view, so entry k of sun_casters.instances has transform k)
+							for (uint32_t k = sun_casters.first(view); k < sun_casters.first(view) + sun_casters.count(view); ++k) {
+								auto const &range = shadow_object_instances[sun_casters.instances[k]].object_ranges;
+								vkCmdDraw(workspace.command_buffer, range.count, 1, range.first, k);
 							}
 						}
 					}
@@ -789,7 +820,8 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 						vkCmdSetScissor(workspace.command_buffer, 0, 1, &shadow_scissor);
 						vkCmdSetViewport(workspace.command_buffer, 0, 1, &shadow_viewport);
 
-						if (!shadow_object_instances.empty()) {
+						const uint32_t view = light_index * LightsManager::SphereShadowFaceCount + face_index;
+						if (sphere_casters.count(view) != 0) {
 							vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sphere_shadow_pipeline.pipeline);
 
 							std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
@@ -819,8 +851,10 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 							};
 							vkCmdPushConstants(workspace.command_buffer, sphere_shadow_pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
 
-							for (uint32_t i = 0; i < shadow_object_instances.size(); ++i) {
-								vkCmdDraw(workspace.command_buffer, shadow_object_instances[i].object_ranges.count, 1, shadow_object_instances[i].object_ranges.first, i);
+							//(casters are uploaded view after view, so entry k of sphere_casters.instances has transform k)
+							for (uint32_t k = sphere_casters.first(view); k < sphere_casters.first(view) + sphere_casters.count(view); ++k) {
+								auto const &range = shadow_object_instances[sphere_casters.instances[k]].object_ranges;
+								vkCmdDraw(workspace.command_buffer, range.count, 1, range.first, k);
 							}
 						}
 					}
@@ -865,7 +899,8 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 					vkCmdSetScissor(workspace.command_buffer, 0, 1, &shadow_scissor);
 					vkCmdSetViewport(workspace.command_buffer, 0, 1, &shadow_viewport);
 
-					if (!shadow_object_instances.empty()) {
+					const uint32_t view = light_index;
+					if (spot_casters.count(view) != 0) {
 						vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spot_shadow_pipeline.pipeline);
 
 						std::array< VkBuffer, 1 > vertex_buffers{ scene_manager.vertex_buffer.handle };
@@ -894,8 +929,10 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 						};
 						vkCmdPushConstants(workspace.command_buffer, spot_shadow_pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
 
-						for (uint32_t i = 0; i < shadow_object_instances.size(); ++i) {
-							vkCmdDraw(workspace.command_buffer, shadow_object_instances[i].object_ranges.count, 1, shadow_object_instances[i].object_ranges.first, i);
+						//(casters are uploaded view after view, so entry k of spot_casters.instances has transform k)
+						for (uint32_t k = spot_casters.first(view); k < spot_casters.first(view) + spot_casters.count(view); ++k) {
+							auto const &range = shadow_object_instances[spot_casters.instances[k]].object_ranges;
+							vkCmdDraw(workspace.command_buffer, range.count, 1, range.first, k);
 						}
 					}
 				}
@@ -1441,8 +1478,8 @@ void SSDO::render(RTG &rtg_, RTG::RenderParams const &render_params) {
 void SSDO::update(float dt) {
 	time = std::fmod(time + dt, 8.0f);
 
-	SceneTree::update_animation(doc, time);
-	SceneTree::traverse_scene(doc, mesh_tree_data, light_tree_data, camera_tree_data, environment_tree_data);
+	SceneTree::update_animation(doc, time, &rtg.jobs);
+	SceneTree::traverse_scene(doc, mesh_tree_data, light_tree_data, camera_tree_data, environment_tree_data, tree_changes, &rtg.jobs);
 
 	{ // update global data
 		camera_manager.update(dt, camera_tree_data, rtg.configuration);
@@ -1455,73 +1492,77 @@ void SSDO::update(float dt) {
 	}
 
 	{ // update object instances with frustum culling
-		deferred_object_instances.clear();
-		shadow_object_instances.clear();
 		// Get frustum for culling
 		auto frustum = camera_manager.get_frustum();
 
-		for(auto &mtd : mesh_tree_data){
-			const size_t mesh_index = mtd.mesh_index;
-			const size_t material_index = mtd.material_index;
+		// shadow instances and world bounds only change for meshes traverse_scene reports as moved
+		auto update_mesh = [&](size_t i) {
+			const SceneTree::MeshTreeData &mtd = mesh_tree_data[i];
 			const glm::mat4 MODEL = BLENDER_TO_VULKAN_4 * mtd.model_matrix;
-			const glm::mat4 MODEL_NORMAL = glm::transpose(glm::inverse(MODEL));
-			const auto& object_range = doc->meshes[mesh_index].range;
-			std::optional<S72Loader::Material> material = doc->materials[material_index];
+			const auto& object_range = doc->meshes[mtd.mesh_index].range;
 
-			ShadowInstance shadow_inst{
+			shadow_object_instances[i] = ShadowInstance{
 				.object_ranges = object_range,
 				.object_transform{
 					.MODEL = MODEL,
-					.MODEL_NORMAL = MODEL_NORMAL,
+					.MODEL_NORMAL = glm::transpose(glm::inverse(MODEL)),
 				},
 			};
-			shadow_object_instances.emplace_back(std::move(shadow_inst));
-
-			// Transform local AABB to world AABB (8 corners method)
-			const glm::vec3& bmin = object_range.aabb_min;
-			const glm::vec3& bmax = object_range.aabb_max;
-			glm::vec3 corners[8] = {
-				{bmin.x, bmin.y, bmin.z}, {bmax.x, bmin.y, bmin.z}, {bmin.x, bmax.y, bmin.z}, {bmax.x, bmax.y, bmin.z},
-				{bmin.x, bmin.y, bmax.z}, {bmax.x, bmin.y, bmax.z}, {bmin.x, bmax.y, bmax.z}, {bmax.x, bmax.y, bmax.z}
-			};
-			glm::vec3 world_min(std::numeric_limits<float>::max());
-			glm::vec3 world_max(std::numeric_limits<float>::lowest());
-			for (int c = 0; c < 8; ++c) {
-				glm::vec3 wp = glm::vec3(MODEL * glm::vec4(corners[c], 1.0f));
-				world_min = glm::min(world_min, wp);
-				world_max = glm::max(world_max, wp);
+			mesh_bounds[i] = BVH::transform_box(MODEL, object_range.aabb_min, object_range.aabb_max);
+		};
+		if (tree_changes.all || shadow_object_instances.size() != mesh_tree_data.size()) {
+			shadow_object_instances.resize(mesh_tree_data.size());
+			mesh_bounds.resize(mesh_tree_data.size());
+			rtg.jobs.parallel_for(mesh_tree_data.size(), InstanceChunkSize, [&](size_t, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) update_mesh(i);
+			});
+			mesh_bvh.build(mesh_bounds);
+		} else {
+			rtg.jobs.parallel_for(tree_changes.meshes.size(), InstanceChunkSize, [&](size_t, size_t begin, size_t end) {
+				for (size_t k = begin; k < end; ++k) update_mesh(tree_changes.meshes[k]);
+			});
+			for (uint32_t i : tree_changes.meshes) {
+				mesh_bvh.update(i, mesh_bounds[i]);
 			}
+			mesh_bvh.refit();
+		}
 
-			// Frustum culling check with world-space AABB
-			if (!frustum.is_box_visible(world_min, world_max)) {
-				continue;
+		// Frustum culling, descending the BVH
+		mesh_bvh.cull(frustum, mesh_visible);
+
+		// Shadow casters of each shadow view, culled from the same BVH
+		lights_manager.cull_shadow_casters(mesh_bvh, sun_casters, sphere_casters, spot_casters, &rtg.jobs);
+
+		// chunks of mesh_tree_data are processed in parallel; each chunk collects its own visible
+		// instances, and the chunks are appended in order so the list matches a serial loop
+		instance_chunks.resize(JobSystem::chunk_count(mesh_tree_data.size(), InstanceChunkSize));
+		rtg.jobs.parallel_for(mesh_tree_data.size(), InstanceChunkSize, [&](size_t chunk, size_t begin, size_t end) {
+			InstanceChunk &out = instance_chunks[chunk];
+			out.deferred.clear();
+
+			for (size_t word = begin / 64; word < (end + 63) / 64; ++word) {
+				for (uint64_t bits = mesh_visible[word]; bits != 0; bits &= bits - 1) {
+					const size_t i = word * 64 + size_t(std::countr_zero(bits));
+					const ShadowInstance &shadow = shadow_object_instances[i];
+					const size_t material_index = mesh_tree_data[i].material_index;
+					const S72Loader::Material &material = doc->materials[material_index];
+
+					// Lambertian and PBR materials both go through the deferred path
+					if(material.lambertian || material.pbr) {
+						DeferredInstance deferred_inst{
+							.object_ranges = shadow.object_ranges,
+							.object_transform = shadow.object_transform,
+							.material_index = material_index,
+						};
+						out.deferred.emplace_back(std::move(deferred_inst));
+					}
+				}
 			}
+		});
 
-			// Lambertian material instance
-			// if(material.has_value() && material->lambertian) {
-			// 	DeferredInstance deferred_inst{
-			// 		.object_ranges = object_range,
-			// 		.object_transform{
-			// 			.MODEL = MODEL,
-			// 			.MODEL_NORMAL = MODEL_NORMAL,
-			// 		},
-			// 		.material_index = material_index,
-			// 	};
-			// 	deferred_object_instances.emplace_back(std::move(deferred_inst));
-			// }
-
-			// PBR material instance
-			if(material.has_value() && material->lambertian || material.has_value() && material->pbr) {
-				DeferredInstance deferred_inst{
-					.object_ranges = object_range,
-					.object_transform{
-						.MODEL = MODEL,
-						.MODEL_NORMAL = MODEL_NORMAL,
-					},
-					.material_index = material_index,
-				};
-				deferred_object_instances.emplace_back(std::move(deferred_inst));
-			}
+		deferred_object_instances.clear();
+		for (auto const &chunk : instance_chunks) {
+			deferred_object_instances.insert(deferred_object_instances.end(), chunk.deferred.begin(), chunk.deferred.end());
 		}
 	}
 }
@@ -0,0 +1,44 @@
+#include "MappedFile.hpp"
+#include "S72Binary.hpp"
+#include "S72Loader.hpp"
+#include "Timer.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static void print_usage(const char *prog) {
+    std::cerr << "Usage:\n"
+              << "  " << prog << " <scene.s72> [out.s72b]   (default output: <scene.s72>b, which load_file picks up)\n"
+              << "\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc != 2 && argc != 3) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        std::string in_path = argv[1];
+        std::string out_path = (argc == 3 ? std::string(argv[2]) : in_path + "b");
+
+        // mesh data is found relative to the scene, as in RTG's --scene handling:
+        std::string base_path = std::filesystem::path(in_path).parent_path().generic_string();
+
+        double elapsed = 0.0;
+        {
+            Timer timer([&](double e) { elapsed = e; });
+            MappedFile source(in_path);
+            auto doc = S72Loader::load_string(source.bytes());
+            S72Loader::cook(*doc, source.bytes(), base_path, out_path);
+        }
+        std::cout << "Cooked '" << in_path << "' -> '" << out_path << "' ("
+                  << std::filesystem::file_size(out_path) << " bytes) in " << elapsed * 1000.0 << " ms." << std::endl;
+        return 0;
+
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
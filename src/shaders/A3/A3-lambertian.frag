@@ -8,14 +8,11 @@
 layout(set=2,binding=0) uniform samplerCube irradiance_map;
 layout(set=2,binding=1) uniform sampler2D Textures[];
 
-layout(push_constant) uniform Push {
-    uint MATERIAL_INDEX;
-} push;
-
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec2 texCoord;
 layout(location=3) in vec3 viewPosition;
+layout(location=4) flat in uint materialIndex;
 
 layout(location=0) out vec4 outColor;
 
@@ -23,7 +20,7 @@ const float PI = 3.14159265359;
 
 void main() {
 	// material properties
-	vec3 albedo = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 2)], texCoord).xyz;
+	vec3 albedo = texture(Textures[nonuniformEXT(materialIndex + 2)], texCoord).xyz;
 
 	// input lighting data
 	vec3 N = normalize(normal);
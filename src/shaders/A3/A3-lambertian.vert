@@ -21,12 +21,18 @@ layout(set=1, binding=0, std430) readonly buffer Transforms {
 	Transform TRANSFORMS[];
 };
 
+layout(set=1, binding=1, std430) readonly buffer Materials {
+	uint MATERIALS[];
+};
+
 layout(location=0) out vec3 position;
 layout(location=1) out vec3 normal;
 layout(location=2) out vec2 texCoord;
 layout(location=3) out vec3 viewPosition;
+layout(location=4) flat out uint materialIndex;
 
 void main() {
+	materialIndex = MATERIALS[gl_InstanceIndex] * 5u;
 	position = mat4x3(TRANSFORMS[gl_InstanceIndex].MODEL) * vec4(Position, 1.0);
 	normal = mat3(TRANSFORMS[gl_InstanceIndex].MODEL_NORMAL) * Normal;
 	texCoord = TexCoord;
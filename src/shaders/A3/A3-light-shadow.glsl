@@ -53,12 +53,20 @@ float getRandomAngle(vec2 fragCoord) {
 // }
 
 // ================= PCSS =================
+// Where point 'uv' of a spot light's map is in its shadow map: the map is the tile atlas_rect of it (all of it, unless
+// it is an atlas), and points stay half a texel inside the tile, so filtering never reads a neighboring tile
+vec2 spotShadowMapUv(SpotLight spotLight, vec2 uv) {
+    vec2 halfTexel = vec2(0.5 / max(float(spotLight.shadow), 1.0));
+    return spotLight.atlas_rect.xy + clamp(uv, halfTexel, vec2(1.0) - halfTexel) * spotLight.atlas_rect.zw;
+}
+
 float computeSpotLightShadow(SpotLight spotLight, vec3 fragPosition, float NoL, sampler2D shadowMapTexture) {
     vec4 lightSpace = spotLight.perspective * vec4(fragPosition, 1.0);
     vec3 projected = lightSpace.xyz / lightSpace.w;
     vec2 uv = projected.xy * 0.5 + vec2(0.5);
 
     if (projected.z <= 0.0 || projected.z >= 1.0 || uv.x <= 0.0 || uv.x >= 1.0 || uv.y <= 0.0 || uv.y >= 1.0) return 1.0;
+    if (spotLight.atlas_rect.z <= 0.0) return 1.0; // (no atlas tile yet)
 
     float receiverDepth = projected.z; 
     float receiverLinearDepth = linearizePerspectiveDepth(receiverDepth, spotLight.near_plane, spotLight.far_plane);
@@ -75,7 +83,7 @@ float computeSpotLightShadow(SpotLight spotLight, vec3 fragPosition, float NoL,
     int blockerCount = 0;
     for (int i = 0; i < 20; ++i) {
         vec2 sampleUv = uv + (rotationMat * spotShadowSampleOffsets[i]) * searchRadius;
-        float sampleDepth01 = texture(shadowMapTexture, sampleUv).r;
+        float sampleDepth01 = texture(shadowMapTexture, spotShadowMapUv(spotLight, sampleUv)).r;
         
         if (receiverDepth + bias < sampleDepth01) { 
             blockerDepthSum += linearizePerspectiveDepth(sampleDepth01, spotLight.near_plane, spotLight.far_plane);
@@ -95,7 +103,7 @@ float computeSpotLightShadow(SpotLight spotLight, vec3 fragPosition, float NoL,
     float shadowed = 0.0;
     for (int i = 0; i < 20; ++i) {
         vec2 sampleUv = uv + (rotationMat * spotShadowSampleOffsets[i]) * filterRadius;
-        float sampleDepth01 = texture(shadowMapTexture, sampleUv).r;
+        float sampleDepth01 = texture(shadowMapTexture, spotShadowMapUv(spotLight, sampleUv)).r;
         shadowed += (receiverDepth + bias < sampleDepth01) ? 1.0 : 0.0;
     }
 
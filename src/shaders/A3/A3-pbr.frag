@@ -8,15 +8,12 @@
 layout(set=2,binding=0) uniform samplerCube ibl_cubemaps[2];
 layout(set=2,binding=1) uniform sampler2D Textures[];
 
-layout(push_constant) uniform Push {
-    uint MATERIAL_INDEX;
-} push;
-
 layout(location=0) in vec3 fragPos;
 layout(location=1) in vec2 texCoord;
 layout(location=2) flat in vec3 cameraPos;
 layout(location=3) in vec3 viewFragPos;
 layout(location=4) in mat3 TBN;
+layout(location=7) flat in uint materialIndex;
 
 layout(location=0) out vec4 outColor;
 
@@ -39,14 +36,14 @@ vec2 ParallaxMapping(vec3 viewDir)
   
     // get initial values
     vec2  currentTexCoords = texCoord;
-    float currentDepthMapValue = scale * texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 1)], currentTexCoords).r;
+    float currentDepthMapValue = scale * texture(Textures[nonuniformEXT(materialIndex + 1)], currentTexCoords).r;
       
     while(currentLayerDepth < currentDepthMapValue)
     {
         // shift texture coordinates along direction of P
         currentTexCoords -= deltaTexCoords;
         // get depthmap value at current texture coordinates
-        currentDepthMapValue = scale * texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 1)], currentTexCoords).r;  
+        currentDepthMapValue = scale * texture(Textures[nonuniformEXT(materialIndex + 1)], currentTexCoords).r;  
         // get depth of next layer
         currentLayerDepth += layerDepth;  
     }
@@ -56,7 +53,7 @@ vec2 ParallaxMapping(vec3 viewDir)
 
     // get depth after and before collision for linear interpolation
     float afterDepth  = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = scale * texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 1)], prevTexCoords).r - currentLayerDepth + layerDepth;
+    float beforeDepth = scale * texture(Textures[nonuniformEXT(materialIndex + 1)], prevTexCoords).r - currentLayerDepth + layerDepth;
  
     // interpolation of texture coordinates
     float weight = afterDepth / (afterDepth - beforeDepth);
@@ -67,7 +64,7 @@ vec2 ParallaxMapping(vec3 viewDir)
 
 vec3 getNormalFromMap(vec2 mappedTexCoord)
 {
-    vec3 tangentNormal = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX)], mappedTexCoord).xyz * 2.0 - 1.0;
+    vec3 tangentNormal = texture(Textures[nonuniformEXT(materialIndex)], mappedTexCoord).xyz * 2.0 - 1.0;
     return normalize(TBN * tangentNormal);
 }
 
@@ -136,9 +133,9 @@ void main() {
 	// }
 
 	// material properties
-	vec3 albedo = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 2)], mappedTexCoord).xyz;
-	float roughness = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 3)], mappedTexCoord).x;
-	float metallic = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 4)], mappedTexCoord).x;
+	vec3 albedo = texture(Textures[nonuniformEXT(materialIndex + 2)], mappedTexCoord).xyz;
+	float roughness = texture(Textures[nonuniformEXT(materialIndex + 3)], mappedTexCoord).x;
+	float metallic = texture(Textures[nonuniformEXT(materialIndex + 4)], mappedTexCoord).x;
 
 	// input lighting data
 	vec3 N = getNormalFromMap(mappedTexCoord);
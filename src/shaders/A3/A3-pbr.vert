@@ -22,13 +22,19 @@ layout(set=1, binding=0, std430) readonly buffer Transforms {
 	Transform TRANSFORMS[];
 };
 
+layout(set=1, binding=1, std430) readonly buffer Materials {
+	uint MATERIALS[];
+};
+
 layout(location=0) out vec3 fragPos;
 layout(location=1) out vec2 texCoord;
 layout(location=2) out vec3 cameraPos;
 layout(location=3) out vec3 viewFragPos;
 layout(location=4) out mat3 TBN;
+layout(location=7) flat out uint materialIndex;
 
 void main() {
+	materialIndex = 1u + MATERIALS[gl_InstanceIndex] * 5u;
 	fragPos = mat4x3(TRANSFORMS[gl_InstanceIndex].MODEL) * vec4(Position, 1.0);
 	vec3 normal = normalize(mat3(TRANSFORMS[gl_InstanceIndex].MODEL_NORMAL) * Normal);
 	viewFragPos = vec3(VIEW * vec4(fragPos, 1.0));
@@ -22,6 +22,7 @@ struct SpotLight {
     int shadow;
     float near_plane;
     float far_plane;
+    vec4 atlas_rect;
 };
 
 layout(set=0, binding=0, std430) readonly buffer ShadowSpotLightsBuf {
@@ -3,21 +3,18 @@
 
 layout(set=2,binding=1) uniform sampler2D Textures[];
 
-layout(push_constant) uniform Push {
-    uint MATERIAL_INDEX;
-} push;
-
 layout(location=0) in vec2 texCoord;
 layout(location=1) in mat3 TBN;
+layout(location=4) flat in uint materialIndex;
 
 layout(location=0) out vec4 outGBufferAlbedo;
 layout(location=1) out vec4 outGBufferNormal;
 
 void main() {
-    vec3 N = normalize(TBN * (texture(Textures[nonuniformEXT(push.MATERIAL_INDEX)], texCoord).xyz * 2.0 - 1.0));
-    vec3 albedo = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 2)], texCoord).xyz;
-    float roughness = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 3)], texCoord).x;
-    float metallic = texture(Textures[nonuniformEXT(push.MATERIAL_INDEX + 4)], texCoord).x;
+    vec3 N = normalize(TBN * (texture(Textures[nonuniformEXT(materialIndex)], texCoord).xyz * 2.0 - 1.0));
+    vec3 albedo = texture(Textures[nonuniformEXT(materialIndex + 2)], texCoord).xyz;
+    float roughness = texture(Textures[nonuniformEXT(materialIndex + 3)], texCoord).x;
+    float metallic = texture(Textures[nonuniformEXT(materialIndex + 4)], texCoord).x;
     // RT0: albedo in rgb, metallic in a.
     outGBufferAlbedo = vec4(albedo, metallic);
 
@@ -22,10 +22,16 @@ layout(set=1, binding=0, std430) readonly buffer Transforms {
 	Transform TRANSFORMS[];
 };
 
+layout(set=1, binding=1, std430) readonly buffer Materials {
+	uint MATERIALS[];
+};
+
 layout(location=0) out vec2 texCoord;
 layout(location=1) out mat3 TBN;
+layout(location=4) flat out uint materialIndex;
 
 void main() {
+	materialIndex = 1u + MATERIALS[gl_InstanceIndex] * 5u;
 	vec3 normal = normalize(mat3(TRANSFORMS[gl_InstanceIndex].MODEL_NORMAL) * Normal);
 
 	vec3 T = normalize(vec3(TRANSFORMS[gl_InstanceIndex].MODEL_NORMAL * vec4(Tangent.xyz, 0.0)));
@@ -33,6 +33,7 @@ struct SpotLight {
 	int shadow; // Shadow map size
 	float near_plane;
 	float far_plane;
+	vec4 atlas_rect; // (offset, size) of its map in the shadow map's uv (a tile of an atlas, or all of it)
 };
 
 layout(set=0, binding=1, std430) readonly buffer SunLightsBuf {
@@ -0,0 +1,361 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace {
+	constexpr uint32_t Bins = 16; //SAH split candidates per axis
+	constexpr uint32_t MaxSAHDepth = 48; //deeper than this, split at the median (keeps depth bounded)
+
+	float half_area(glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 size = max - min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	//false if the box is outside one of the planes in 'planes' (bit p = frustum.planes[p]);
+	//  otherwise clears the bits of the planes the box is fully inside of
+	bool test_box(CameraManager::Frustum const &frustum, glm::vec3 const &min, glm::vec3 const &max, uint32_t &planes) {
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+		for (uint32_t p = 0; p < 6; ++p) {
+			if (!(planes & (1u << p))) continue;
+			const auto &plane = frustum.planes[p];
+			const float d = glm::dot(plane.normal, center) + plane.distance;
+			const float r = glm::dot(glm::abs(plane.normal), extent);
+			if (d + r < 0.0f) return false;
+			if (d - r >= 0.0f) planes &= ~(1u << p);
+		}
+		return true;
+	}
+
+	//test_box for every frustum whose planes, over this box, are within 'slack' of the planes in 'frustum':
+	//  false if the box is outside one of them for all; clears the bits of the planes it is inside of for all
+	bool test_box_slack(CameraManager::Frustum const &frustum, glm::vec3 const &min, glm::vec3 const &max, float slack, uint32_t &planes) {
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+		for (uint32_t p = 0; p < 6; ++p) {
+			if (!(planes & (1u << p))) continue;
+			const auto &plane = frustum.planes[p];
+			const float d = glm::dot(plane.normal, center) + plane.distance;
+			const float r = glm::dot(glm::abs(plane.normal), extent);
+			if (d + r + slack < 0.0f) return false;
+			if (d - r - slack >= 0.0f) planes &= ~(1u << p);
+		}
+		return true;
+	}
+}
+
+BVH::Box BVH::transform_box(glm::mat4 const &transform, glm::vec3 const &min, glm::vec3 const &max) {
+	const glm::vec3 center = (min + max) * 0.5f;
+	const glm::vec3 extent = (max - min) * 0.5f;
+	const glm::vec3 world_center = glm::vec3(transform * glm::vec4(center, 1.0f));
+	const glm::vec3 world_extent = glm::abs(glm::vec3(transform[0])) * extent.x
+	                             + glm::abs(glm::vec3(transform[1])) * extent.y
+	                             + glm::abs(glm::vec3(transform[2])) * extent.z;
+	return Box{world_center - world_extent, world_center + world_extent};
+}
+
+void BVH::build(std::vector< Box > const &item_bounds) {
+	bounds = item_bounds;
+	nodes.clear();
+	parents.clear();
+	stale.clear();
+	stale_nodes.clear();
+	items.resize(bounds.size());
+	item_leaf.assign(bounds.size(), 0);
+	if (bounds.empty()) return;
+
+	//items are partitioned along with their bounds, so the build reads memory in order:
+	std::vector< BuildItem > work(bounds.size());
+	for (uint32_t i = 0; i < uint32_t(bounds.size()); ++i) {
+		work[i].box = bounds[i];
+		work[i].centroid = (bounds[i].min + bounds[i].max) * 0.5f;
+		work[i].item = i;
+	}
+
+	nodes.reserve(2 * (bounds.size() / LeafSize) + 1);
+	parents.reserve(nodes.capacity());
+	build_node(work, 0, uint32_t(work.size()), NoParent, 0);
+	stale.assign(nodes.size(), 0);
+}
+
+uint32_t BVH::build_node(std::vector< BuildItem > &work, uint32_t first, uint32_t count, uint32_t parent, uint32_t depth) {
+	const uint32_t index = uint32_t(nodes.size());
+	nodes.emplace_back();
+	parents.emplace_back(parent);
+
+	Node node;
+	node.min = glm::vec3(std::numeric_limits< float >::max());
+	node.max = glm::vec3(std::numeric_limits< float >::lowest());
+	node.first = first;
+	node.count = count;
+	node.right = 0;
+	glm::vec3 centroid_min = node.min;
+	glm::vec3 centroid_max = node.max;
+	for (uint32_t k = first; k < first + count; ++k) {
+		node.min = glm::min(node.min, work[k].box.min);
+		node.max = glm::max(node.max, work[k].box.max);
+		centroid_min = glm::min(centroid_min, work[k].centroid);
+		centroid_max = glm::max(centroid_max, work[k].centroid);
+	}
+	nodes[index] = node;
+
+	if (count <= LeafSize) {
+		for (uint32_t k = first; k < first + count; ++k) {
+			items[k] = work[k].item;
+			item_leaf[work[k].item] = index;
+		}
+		return index;
+	}
+
+	auto begin = work.begin() + first;
+	auto end = begin + count;
+	uint32_t mid = first + count / 2;
+
+	int axis = 0;
+	const glm::vec3 centroid_size = centroid_max - centroid_min;
+	if (centroid_size.y > centroid_size[axis]) axis = 1;
+	if (centroid_size.z > centroid_size[axis]) axis = 2;
+
+	bool split = false;
+	if (centroid_size[axis] > 0.0f && depth < MaxSAHDepth) {
+		//binned SAH along the widest axis:
+		//  cost of a split ~ half_area(left) * left count + half_area(right) * right count
+		const float scale = float(Bins) / centroid_size[axis];
+		auto bin_of = [&](BuildItem const &entry) {
+			return std::min(Bins - 1, uint32_t((entry.centroid[axis] - centroid_min[axis]) * scale));
+		};
+
+		uint32_t bin_count[Bins] = {};
+		Box bin_bounds[Bins];
+		for (auto &b : bin_bounds) {
+			b.min = glm::vec3(std::numeric_limits< float >::max());
+			b.max = glm::vec3(std::numeric_limits< float >::lowest());
+		}
+		for (auto k = begin; k != end; ++k) {
+			const uint32_t b = bin_of(*k);
+			bin_count[b] += 1;
+			bin_bounds[b].min = glm::min(bin_bounds[b].min, k->box.min);
+			bin_bounds[b].max = glm::max(bin_bounds[b].max, k->box.max);
+		}
+
+		//sweep from the right to get the cost of everything at or after each bin:
+		float right_cost[Bins];
+		Box right = bin_bounds[Bins - 1];
+		uint32_t right_count = 0;
+		for (uint32_t b = Bins - 1; b > 0; --b) {
+			right.min = glm::min(right.min, bin_bounds[b].min);
+			right.max = glm::max(right.max, bin_bounds[b].max);
+			right_count += bin_count[b];
+			right_cost[b] = (right_count ? half_area(right.min, right.max) * float(right_count) : 0.0f);
+		}
+		float best_cost = std::numeric_limits< float >::max();
+		uint32_t best_bin = 0;
+		Box left = bin_bounds[0];
+		uint32_t left_count = 0;
+		for (uint32_t b = 1; b < Bins; ++b) {
+			left.min = glm::min(left.min, bin_bounds[b - 1].min);
+			left.max = glm::max(left.max, bin_bounds[b - 1].max);
+			left_count += bin_count[b - 1];
+			if (left_count == 0 || left_count == count) continue;
+			const float cost = half_area(left.min, left.max) * float(left_count) + right_cost[b];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_bin = b;
+			}
+		}
+
+		if (best_bin != 0) {
+			auto split_at = std::partition(begin, end, [&](BuildItem const &entry) {
+				return bin_of(entry) < best_bin;
+			});
+			mid = first + uint32_t(split_at - begin);
+			split = (mid != first && mid != first + count);
+		}
+	}
+	if (!split) {
+		//median split on the widest axis (or, for coincident centroids, any halving):
+		mid = first + count / 2;
+		std::nth_element(begin, work.begin() + mid, end, [&](BuildItem const &a, BuildItem const &b) {
+			return a.centroid[axis] < b.centroid[axis];
+		});
+	}
+
+	build_node(work, first, mid - first, index, depth + 1); //(left child is index + 1)
+	const uint32_t right = build_node(work, mid, first + count - mid, index, depth + 1);
+	nodes[index].right = right;
+	return index;
+}
+
+void BVH::update(uint32_t item, Box const &item_bounds) {
+	bounds[item] = item_bounds;
+	for (uint32_t n = item_leaf[item]; n != NoParent && !stale[n]; n = parents[n]) {
+		stale[n] = 1;
+		stale_nodes.emplace_back(n);
+	}
+}
+
+void BVH::refit() {
+	//children come after their parents, so refit from the highest index down:
+	std::sort(stale_nodes.begin(), stale_nodes.end(), std::greater< uint32_t >());
+	for (uint32_t n : stale_nodes) {
+		Node &node = nodes[n];
+		if (node.right == 0) {
+			node.min = glm::vec3(std::numeric_limits< float >::max());
+			node.max = glm::vec3(std::numeric_limits< float >::lowest());
+			for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+				node.min = glm::min(node.min, bounds[items[k]].min);
+				node.max = glm::max(node.max, bounds[items[k]].max);
+			}
+		} else {
+			Node const &left = nodes[n + 1];
+			Node const &right = nodes[node.right];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+		stale[n] = 0;
+	}
+	stale_nodes.clear();
+}
+
+template< typename Accept >
+void BVH::descend(CameraManager::Frustum const &frustum, Accept const &accept) const {
+	if (nodes.empty()) return;
+
+	struct Entry {
+		uint32_t node;
+		uint32_t planes; //planes the node isn't yet known to be inside of
+	};
+	std::vector< Entry > stack;
+	stack.reserve(64);
+	stack.emplace_back(Entry{0, 0x3f});
+
+	while (!stack.empty()) {
+		const Entry entry = stack.back();
+		stack.pop_back();
+		Node const &node = nodes[entry.node];
+
+		uint32_t planes = entry.planes;
+		if (!test_box(frustum, node.min, node.max, planes)) continue;
+
+		if (planes == 0) {
+			//fully inside: accept the whole subtree
+			accept(node.first, node.count);
+		} else if (node.right == 0) {
+			for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+				const uint32_t item = items[k];
+				uint32_t item_planes = planes;
+				if (!test_box(frustum, bounds[item].min, bounds[item].max, item_planes)) continue;
+				accept(k, 1);
+			}
+		} else {
+			stack.emplace_back(Entry{node.right, planes});
+			stack.emplace_back(Entry{entry.node + 1, planes});
+		}
+	}
+}
+
+size_t BVH::cull(CameraManager::Frustum const &frustum, std::vector< uint64_t > &visible) const {
+	visible.assign((bounds.size() + 63) / 64, 0);
+
+	size_t total = 0;
+	descend(frustum, [&](uint32_t first, uint32_t count) {
+		for (uint32_t k = first; k < first + count; ++k) {
+			visible[items[k] / 64] |= uint64_t(1) << (items[k] % 64);
+		}
+		total += count;
+	});
+	return total;
+}
+
+void BVH::cull(CameraManager::Frustum const &frustum, std::vector< uint32_t > &out) const {
+	descend(frustum, [&](uint32_t first, uint32_t count) {
+		out.insert(out.end(), items.begin() + first, items.begin() + first + count);
+	});
+}
+
+void BVH::classify_for_motion(CameraManager::Frustum const &frustum, glm::vec3 const &eye, float translation, float rotation,
+	std::vector< uint64_t > &inside, std::vector< uint32_t > &straddling) const {
+	inside.assign((bounds.size() + 63) / 64, 0);
+	straddling.clear();
+	if (nodes.empty()) return;
+
+	//every plane is fixed to the camera (normal n, through a point at a fixed offset from the eye); moving the eye by t
+	//  and turning by an angle a changes n . x + distance by at most |t| + a * |x - eye| (|n' - n| <= a), so over a box:
+	auto slack = [&](glm::vec3 const &min, glm::vec3 const &max) {
+		return translation + rotation * (glm::length((min + max) * 0.5f - eye) + 0.5f * glm::length(max - min));
+	};
+
+	struct Entry {
+		uint32_t node;
+		uint32_t planes; //planes the node isn't yet known to be inside of for every camera
+	};
+	std::vector< Entry > stack;
+	stack.reserve(64);
+	stack.emplace_back(Entry{0, 0x3f});
+
+	//(a node's slack bounds its children's, so a node's result holds for everything under it)
+	while (!stack.empty()) {
+		const Entry entry = stack.back();
+		stack.pop_back();
+		Node const &node = nodes[entry.node];
+
+		uint32_t planes = entry.planes;
+		if (!test_box_slack(frustum, node.min, node.max, slack(node.min, node.max), planes)) continue;
+
+		if (planes == 0) {
+			for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+				inside[items[k] / 64] |= uint64_t(1) << (items[k] % 64);
+			}
+		} else if (node.right == 0) {
+			for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+				const uint32_t item = items[k];
+				uint32_t item_planes = planes;
+				if (!test_box_slack(frustum, bounds[item].min, bounds[item].max, slack(bounds[item].min, bounds[item].max), item_planes)) continue;
+				if (item_planes == 0) {
+					inside[item / 64] |= uint64_t(1) << (item % 64);
+				} else {
+					straddling.emplace_back(item);
+				}
+			}
+		} else {
+			stack.emplace_back(Entry{node.right, planes});
+			stack.emplace_back(Entry{entry.node + 1, planes});
+		}
+	}
+}
+
+void BVH::overlap_sphere(glm::vec3 const &center, float radius, std::vector< uint32_t > &out) const {
+	if (nodes.empty()) return;
+	const float radius2 = radius * radius;
+
+	//squared distance from the center to the nearest point of the box:
+	auto near2 = [&](glm::vec3 const &min, glm::vec3 const &max) {
+		const glm::vec3 d = glm::max(glm::max(min - center, center - max), glm::vec3(0.0f));
+		return glm::dot(d, d);
+	};
+
+	std::vector< uint32_t > stack;
+	stack.reserve(64);
+	stack.emplace_back(0);
+	while (!stack.empty()) {
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		Node const &node = nodes[index];
+		if (near2(node.min, node.max) > radius2) continue;
+
+		//farthest corner inside the sphere: accept the whole subtree
+		const glm::vec3 farthest = glm::max(glm::abs(node.min - center), glm::abs(node.max - center));
+		if (glm::dot(farthest, farthest) <= radius2) {
+			out.insert(out.end(), items.begin() + node.first, items.begin() + node.first + node.count);
+		} else if (node.right == 0) {
+			for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+				if (near2(bounds[items[k]].min, bounds[items[k]].max) <= radius2) out.emplace_back(items[k]);
+			}
+		} else {
+			stack.emplace_back(node.right);
+			stack.emplace_back(index + 1);
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+//Bounding volume hierarchy over world-space instance bounds, for frustum culling.
+// - built once (binned SAH), then kept up to date by refitting the ancestors of moved items
+//   (the tree shape is kept; rebuild when everything changes)
+// - nodes are stored depth-first, so every subtree covers a contiguous run of 'items':
+//   a node fully inside the frustum accepts its whole run without testing the items
+
+#include "CameraManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BVH {
+	struct Box {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	//world-space bounds of a local box under an affine transform (center +- |transform| * extent):
+	static Box transform_box(glm::mat4 const &transform, glm::vec3 const &min, glm::vec3 const &max);
+
+	//(re)build over items 0 .. item_bounds.size()-1:
+	void build(std::vector< Box > const &item_bounds);
+
+	//change an item's bounds; its ancestors are refit by the next refit():
+	void update(uint32_t item, Box const &item_bounds);
+	void refit();
+
+	//bit (i % 64) of visible[i / 64] is set if item i may be visible (same test as Frustum::is_box_visible);
+	//  returns the number of visible items
+	size_t cull(CameraManager::Frustum const &frustum, std::vector< uint64_t > &visible) const;
+
+	//append the items that may be visible (same test) to 'out', in tree order:
+	void cull(CameraManager::Frustum const &frustum, std::vector< uint32_t > &out) const;
+
+	//classify items for every camera within 'translation' (world units) and 'rotation' (radians) of the camera at 'eye'
+	//  that 'frustum' belongs to (same projection): bit i of 'inside' is set if item i passes the frustum test for all of
+	//  them, 'straddling' gets the items that may pass for some of them and not for others; the rest fail for all
+	void classify_for_motion(CameraManager::Frustum const &frustum, glm::vec3 const &eye, float translation, float rotation,
+		std::vector< uint64_t > &inside, std::vector< uint32_t > &straddling) const;
+
+	//append the items whose bounds come within 'radius' of 'center' to 'out', in tree order:
+	void overlap_sphere(glm::vec3 const &center, float radius, std::vector< uint32_t > &out) const;
+
+	Box const &item_bounds(uint32_t item) const { return bounds[item]; }
+	size_t size() const { return bounds.size(); }
+	size_t node_count() const { return nodes.size(); }
+
+private:
+	struct Node {
+		glm::vec3 min;
+		uint32_t first; //first entry of 'items' under this node
+		glm::vec3 max;
+		uint32_t count; //number of entries of 'items' under this node
+		uint32_t right; //right child (the left child is the next node); 0 for leaves
+	};
+	static constexpr uint32_t LeafSize = 4;
+	static constexpr uint32_t NoParent = ~0u;
+
+	std::vector< Box > bounds; //per item
+	std::vector< uint32_t > items; //item indices, in subtree order
+	std::vector< Node > nodes; //depth-first; nodes[0] is the root
+	std::vector< uint32_t > parents; //per node
+	std::vector< uint32_t > item_leaf; //per item
+
+	std::vector< uint8_t > stale; //per node: bounds need refitting
+	std::vector< uint32_t > stale_nodes;
+
+	struct BuildItem {
+		Box box;
+		glm::vec3 centroid;
+		uint32_t item;
+	};
+	//calls accept(first, count) for runs of 'items' that may be visible:
+	template< typename Accept >
+	void descend(CameraManager::Frustum const &frustum, Accept const &accept) const;
+
+	uint32_t build_node(std::vector< BuildItem > &work, uint32_t first, uint32_t count, uint32_t parent, uint32_t depth);
+};
@@ -0,0 +1,171 @@
+#include "DrawSort.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DRAWSORT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DRAWSORT_TARGET_BMI2
+#else
+#include <cpuid.h>
+#define DRAWSORT_TARGET_BMI2 __attribute__((target("bmi2")))
+#endif
+#endif
+
+namespace {
+	//widest radix digit: the keys are split into as few digits as this allows, of equal width, since each pass scatters
+	//  every key once and (on a 26-bit scene key) two 13-bit passes beat three 11-bit ones:
+	constexpr uint32_t MaxDigitBits = 13;
+
+	constexpr uint64_t field(size_t value, uint32_t bits) {
+		return uint64_t(std::min< size_t >(value, (size_t(1) << bits) - 1));
+	}
+
+	//a run of adjacent varying key bits, and where it goes in the packed key:
+	struct BitRun {
+		uint32_t shift; //lowest bit in the key
+		uint64_t mask; //(after shifting down)
+		uint32_t packed_shift; //lowest bit in the packed key
+	};
+
+	//pack each key's 'varying' bits (as 'runs' describe them) above its position (if carry_index), counting the buckets
+	//  of every 'digit_bits'-wide digit in the same read:
+	void pack_runs(std::vector< uint64_t > const &keys, std::vector< BitRun > const &runs, uint32_t first_shift, bool carry_index,
+		uint32_t digits, uint32_t digit_bits, uint64_t *packed, uint32_t *counts) {
+		const uint64_t digit_mask = (uint64_t(1) << digit_bits) - 1;
+		for (size_t i = 0; i < keys.size(); ++i) {
+			uint64_t value = 0;
+			for (BitRun const &run : runs) value |= ((keys[i] >> run.shift) & run.mask) << run.packed_shift;
+			packed[i] = (value << first_shift) | (carry_index ? uint64_t(i) : 0);
+			for (uint32_t d = 0; d < digits; ++d) ++counts[(d << digit_bits) + uint32_t((value >> (d * digit_bits)) & digit_mask)];
+		}
+	}
+
+	#ifdef DRAWSORT_X86
+	//the same with one bit-extract instruction per key:
+	DRAWSORT_TARGET_BMI2 void pack_pext(std::vector< uint64_t > const &keys, uint64_t varying, uint32_t first_shift, bool carry_index,
+		uint32_t digits, uint32_t digit_bits, uint64_t *packed, uint32_t *counts) {
+		const uint64_t digit_mask = (uint64_t(1) << digit_bits) - 1;
+		for (size_t i = 0; i < keys.size(); ++i) {
+			const uint64_t value = _pext_u64(keys[i], varying);
+			packed[i] = (value << first_shift) | (carry_index ? uint64_t(i) : 0);
+			for (uint32_t d = 0; d < digits; ++d) ++counts[(d << digit_bits) + uint32_t((value >> (d * digit_bits)) & digit_mask)];
+		}
+	}
+
+	//BMI2, where pext is fast (AMD before Zen 3 runs it in microcode, slower than the shifts it replaces):
+	bool cpu_has_fast_pext() {
+		int info[4] = {0, 0, 0, 0};
+		#ifdef _MSC_VER
+		__cpuid(info, 0);
+		#else
+		__cpuid(0, info[0], info[1], info[2], info[3]);
+		#endif
+		if (info[0] < 7) return false;
+		char vendor[12];
+		std::memcpy(vendor + 0, &info[1], 4);
+		std::memcpy(vendor + 4, &info[3], 4);
+		std::memcpy(vendor + 8, &info[2], 4);
+		#ifdef _MSC_VER
+		__cpuid(info, 1);
+		#else
+		__cpuid(1, info[0], info[1], info[2], info[3]);
+		#endif
+		const uint32_t family = ((uint32_t(info[0]) >> 8) & 0xf) + ((uint32_t(info[0]) >> 20) & 0xff);
+		if (std::memcmp(vendor, "AuthenticAMD", 12) == 0 && family < 0x19) return false;
+		#ifdef _MSC_VER
+		__cpuidex(info, 7, 0);
+		#else
+		__cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+		#endif
+		return (info[1] & (1 << 8)) != 0;
+	}
+	#endif
+}
+
+uint64_t DrawSort::key(uint32_t pipeline, size_t mesh, float depth) {
+	const uint64_t depth_bits = std::bit_cast< uint32_t >(std::max(depth, 0.0f)) >> (32 - DepthBits);
+	return (field(pipeline, PipelineBits) << (MeshBits + DepthBits))
+	     | (field(mesh, MeshBits) << DepthBits)
+	     | depth_bits;
+}
+
+void DrawSort::sort(std::vector< uint64_t > const &keys, std::vector< uint32_t > &order) {
+	order.resize(keys.size());
+
+	//bits that are the same in every key can't change the order:
+	uint64_t varying = 0;
+	for (uint64_t key : keys) varying |= key ^ keys[0];
+	if (varying == 0) {
+		std::iota(order.begin(), order.end(), 0u);
+		return;
+	}
+
+	std::vector< BitRun > runs;
+	uint32_t bits = 0;
+	for (uint64_t rest = varying; rest != 0; ) {
+		const uint32_t shift = uint32_t(std::countr_zero(rest));
+		const uint32_t length = uint32_t(std::countr_one(rest >> shift));
+		runs.emplace_back(BitRun{
+			.shift = shift,
+			.mask = (length == 64 ? ~uint64_t(0) : (uint64_t(1) << length) - 1),
+			.packed_shift = bits,
+		});
+		bits += length;
+		rest &= (length + shift == 64 ? 0 : ~uint64_t(0) << (shift + length));
+	}
+
+	//pack the varying bits together (in the same order), above the key's position when both fit in 64 bits:
+	const uint32_t index_bits = uint32_t(std::bit_width(keys.size() - 1));
+	const bool carry_index = (bits + index_bits <= 64);
+	const uint32_t first_shift = (carry_index ? index_bits : 0);
+	const uint32_t digits = (bits + MaxDigitBits - 1) / MaxDigitBits;
+	const uint32_t digit_bits = (bits + digits - 1) / digits;
+	const uint32_t buckets = 1u << digit_bits;
+
+	digit_counts.assign(size_t(digits) * buckets, 0);
+	packed.resize(keys.size());
+	#ifdef DRAWSORT_X86
+	static const bool fast_pext = cpu_has_fast_pext();
+	if (fast_pext) pack_pext(keys, varying, first_shift, carry_index, digits, digit_bits, packed.data(), digit_counts.data());
+	else pack_runs(keys, runs, first_shift, carry_index, digits, digit_bits, packed.data(), digit_counts.data());
+	#else
+	pack_runs(keys, runs, first_shift, carry_index, digits, digit_bits, packed.data(), digit_counts.data());
+	#endif
+	if (!carry_index) std::iota(order.begin(), order.end(), 0u);
+
+	packed_scratch.resize(keys.size());
+	if (!carry_index) order_scratch.resize(keys.size());
+	for (uint32_t d = 0; d < digits; ++d) {
+		uint32_t *count = digit_counts.data() + size_t(d) * buckets;
+		const uint32_t shift = first_shift + d * digit_bits;
+
+		uint32_t offset = 0;
+		for (uint32_t b = 0; b < buckets; ++b) {
+			const uint32_t size = count[b];
+			count[b] = offset;
+			offset += size;
+		}
+		if (carry_index) {
+			for (uint64_t value : packed) packed_scratch[count[uint32_t((value >> shift) & (buckets - 1))]++] = value;
+		} else {
+			for (size_t i = 0; i < packed.size(); ++i) {
+				const uint32_t slot = count[uint32_t((packed[i] >> shift) & (buckets - 1))]++;
+				packed_scratch[slot] = packed[i];
+				order_scratch[slot] = order[i];
+			}
+			order.swap(order_scratch);
+		}
+		packed.swap(packed_scratch);
+	}
+
+	if (carry_index) {
+		const uint64_t index_mask = (uint64_t(1) << index_bits) - 1;
+		for (size_t i = 0; i < packed.size(); ++i) order[i] = uint32_t(packed[i] & index_mask);
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+//Orders draws by a packed 64-bit state key, most significant field first:
+//  pipeline (4 bits) | mesh (24 bits) | view depth (16 bits), in the low 44 bits
+// - draws that share pipeline and mesh end up adjacent (so they can be one instanced draw), and front to back
+//   within that, for early-Z (material is left out: instances read it from per-instance data, not bound state)
+// - the depth field is the top 16 bits of the (non-negative) float depth (about 1% steps), which order like
+//   the float itself, so no depth range is needed; indices too large for their field are clamped
+//   (they only group less well)
+// - keys are sorted by an LSD radix sort over just the bits that differ between them, packed together first:
+//   a scene's few pipelines and meshes leave most of the state bits constant; when there is room, each
+//   packed key also carries its position in its low bits, so the passes move one array
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct DrawSort {
+	static constexpr uint32_t PipelineBits = 4;
+	static constexpr uint32_t MeshBits = 24;
+	static constexpr uint32_t DepthBits = 16;
+	static_assert(PipelineBits + MeshBits + DepthBits <= 64, "fields fit in the key");
+
+	//key for a draw whose bounds center is 'depth' in front of the camera (depths behind it sort as 0):
+	static uint64_t key(uint32_t pipeline, size_t mesh, float depth);
+
+	//write to 'order' the positions of 'keys' in ascending key order (stable; the keys themselves are left as they are):
+	void sort(std::vector< uint64_t > const &keys, std::vector< uint32_t > &order);
+
+private:
+	std::vector< uint64_t > packed, packed_scratch; //(scratch) varying bits (above the key's position, if it fits)
+	std::vector< uint32_t > order_scratch; //(scratch) positions, when they don't fit in the packed keys
+	std::vector< uint32_t > digit_counts; //per digit, per bucket
+};
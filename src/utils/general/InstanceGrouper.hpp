@@ -0,0 +1,70 @@
+#pragma once
+
+//Makes draws that share a key (e.g. a mesh and material) adjacent, so each run can be one instanced draw.
+// - a counting sort that only visits the keys actually present, so it costs O(items) however many keys exist
+//   (which keeps it cheap on short ranges, like the casters of one shadow view)
+// - runs come out in order of each key's first appearance, and items keep their order within a run
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct InstanceGrouper {
+	//reorder [begin, end) so items with equal key_of(item) (in [0, key_count)) are adjacent;
+	//  'scratch' holds a copy of the range while it is scattered (kept by the caller to reuse its allocation)
+	template< typename T, typename KeyOf >
+	void group(T *begin, T *end, size_t key_count, KeyOf const &key_of, std::vector< T > &scratch) {
+		if (scatter(begin, end, key_count, key_of, scratch)) {
+			std::move(scratch.begin(), scratch.begin() + (end - begin), begin);
+		}
+	}
+
+	//the same for a whole list, which trades places with 'scratch' instead of being copied back:
+	template< typename T, typename KeyOf >
+	void group(std::vector< T > &items, size_t key_count, KeyOf const &key_of, std::vector< T > &scratch) {
+		if (scatter(items.data(), items.data() + items.size(), key_count, key_of, scratch)) {
+			scratch.resize(items.size());
+			items.swap(scratch);
+		}
+	}
+
+private:
+	std::vector< uint32_t > slots; //per key: 0 between calls; item count, then next position, during one
+	std::vector< uint32_t > keys; //keys present in the current range
+
+	//scatter [begin, end) into 'scratch' in grouped order; false (and 'scratch' untouched) if it already is:
+	template< typename T, typename KeyOf >
+	bool scatter(T *begin, T *end, size_t key_count, KeyOf const &key_of, std::vector< T > &scratch) {
+		const size_t count = size_t(end - begin);
+		if (count < 2) return false;
+		if (slots.size() < key_count) slots.resize(key_count, 0);
+
+		//count items per key, noting keys as they first appear:
+		keys.clear();
+		for (T const *item = begin; item != end; ++item) {
+			const uint32_t key = uint32_t(key_of(*item));
+			if (slots[key]++ == 0) keys.emplace_back(key);
+		}
+		if (keys.size() == 1 || keys.size() == count) { //(already grouped)
+			for (uint32_t key : keys) slots[key] = 0;
+			return false;
+		}
+
+		//turn counts into each key's next position:
+		uint32_t offset = 0;
+		for (uint32_t key : keys) {
+			const uint32_t run = slots[key];
+			slots[key] = offset;
+			offset += run;
+		}
+
+		if (scratch.size() < count) scratch.resize(count);
+		for (T *item = begin; item != end; ++item) {
+			scratch[slots[key_of(*item)]++] = std::move(*item);
+		}
+		for (uint32_t key : keys) slots[key] = 0;
+		return true;
+	}
+};
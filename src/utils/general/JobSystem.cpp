@@ -0,0 +1,119 @@
+#include "JobSystem.hpp"
+
+//which JobSystem (if any) the current thread is a worker of, and its queue:
+static thread_local JobSystem const *current_system = nullptr;
+static thread_local uint32_t current_queue = 0;
+
+JobSystem::JobSystem(uint32_t threads) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	queues.reserve(threads);
+	for (uint32_t i = 0; i < threads; ++i) {
+		queues.emplace_back(std::make_unique< Queue >());
+	}
+	workers.reserve(threads - 1);
+	for (uint32_t i = 1; i < threads; ++i) {
+		workers.emplace_back(&JobSystem::worker_main, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard< std::mutex > lock(sleep_mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+uint32_t JobSystem::own_queue() const {
+	return (current_system == this ? current_queue : 0);
+}
+
+void JobSystem::spawn(Group &group, Job const &job) {
+	group.pending.fetch_add(1);
+	queued.fetch_add(1); //(counted before it is visible, so the count never dips below zero)
+	{
+		Queue &queue = *queues[own_queue()];
+		std::lock_guard< std::mutex > lock(queue.mutex);
+		queue.entries.push_back(Entry{job, &group});
+	}
+	//(a worker about to sleep either sees 'queued' change or is counted in 'sleeping' -- see worker_main)
+	if (sleeping.load() > 0) {
+		std::lock_guard< std::mutex > lock(sleep_mutex);
+		wake.notify_one();
+	}
+}
+
+bool JobSystem::take(uint32_t own, Entry &entry) {
+	if (queued.load() == 0) return false;
+	{ //newest job from our own queue:
+		Queue &queue = *queues[own];
+		std::lock_guard< std::mutex > lock(queue.mutex);
+		if (!queue.entries.empty()) {
+			entry = queue.entries.back();
+			queue.entries.pop_back();
+			queued.fetch_sub(1);
+			return true;
+		}
+	}
+	//oldest job from someone else's:
+	for (uint32_t offset = 1; offset < uint32_t(queues.size()); ++offset) {
+		Queue &queue = *queues[(own + offset) % queues.size()];
+		std::lock_guard< std::mutex > lock(queue.mutex);
+		if (!queue.entries.empty()) {
+			entry = queue.entries.front();
+			queue.entries.pop_front();
+			queued.fetch_sub(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(Entry const &entry) {
+	try {
+		entry.job.call(entry.job.context, entry.job.begin, entry.job.end);
+	} catch (...) {
+		std::lock_guard< std::mutex > lock(entry.group->error_mutex);
+		if (!entry.group->error) entry.group->error = std::current_exception();
+	}
+	entry.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::wait(Group &group) {
+	uint32_t own = own_queue();
+	while (group.pending.load(std::memory_order_acquire) > 0) {
+		Entry entry;
+		if (take(own, entry)) {
+			execute(entry);
+		} else {
+			//remaining jobs are running on other threads
+			std::this_thread::yield();
+		}
+	}
+	if (group.error) {
+		std::exception_ptr error = group.error;
+		group.error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void JobSystem::worker_main(uint32_t queue) {
+	current_system = this;
+	current_queue = queue;
+	while (true) {
+		Entry entry;
+		if (take(queue, entry)) {
+			execute(entry);
+			continue;
+		}
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+		sleeping.fetch_add(1);
+		wake.wait(lock, [this]() { return quit || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+		if (quit) break;
+	}
+}
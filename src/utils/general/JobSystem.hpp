@@ -0,0 +1,135 @@
+#pragma once
+
+//Work-stealing thread pool for per-frame CPU work.
+// - every thread (workers, and the thread that calls wait()) has its own job queue:
+//   it pushes and pops at the back, and idle threads steal from the front of the others
+// - wait() doesn't block while there is work to do; the waiting thread runs queued jobs,
+//   so jobs may spawn (and wait on) more jobs without deadlocking
+// - with one thread (no workers) everything runs on the caller, in order
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct JobSystem {
+	//threads: how many threads run jobs, counting the one that waits (0 means one per hardware thread)
+	explicit JobSystem(uint32_t threads = 0);
+	~JobSystem();
+	JobSystem(JobSystem const &) = delete;
+	JobSystem &operator=(JobSystem const &) = delete;
+
+	uint32_t thread_count() const { return uint32_t(workers.size()) + 1; }
+
+	//which thread is calling, in [0, thread_count()), e.g. to pick per-thread resources in a job:
+	//  workers are 1 and up, and every other thread is 0 (so only one of those should use the system at a time)
+	uint32_t thread_index() const { return own_queue(); }
+
+	//a unit of work, run as call(context, begin, end):
+	struct Job {
+		void (*call)(void *context, size_t begin, size_t end) = nullptr;
+		void *context = nullptr;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+
+	//jobs spawned into a group are waited on together:
+	struct Group {
+		std::atomic< size_t > pending{0};
+		std::mutex error_mutex;
+		std::exception_ptr error; //first exception thrown by one of the group's jobs
+	};
+
+	//queue a job (on the calling thread's queue, so it tends to run soon and stay cache-warm):
+	void spawn(Group &group, Job const &job);
+
+	//run jobs until every job in 'group' (including ones they spawned) has finished;
+	//  rethrows the first exception any of them threw
+	void wait(Group &group);
+
+	//number of chunks parallel_for splits [0, count) into:
+	static size_t chunk_count(size_t count, size_t grain) {
+		grain = std::max< size_t >(grain, 1);
+		return (count + grain - 1) / grain;
+	}
+
+	//call fn(chunk, begin, end) for each chunk [chunk * grain, min(count, (chunk + 1) * grain)), in parallel,
+	//returning when all are done. Chunk boundaries depend only on count and grain, so per-chunk
+	//results can be merged in chunk order to get the same output as a serial loop.
+	template< typename F >
+	void parallel_for(size_t count, size_t grain, F const &fn);
+
+private:
+	struct Entry {
+		Job job;
+		Group *group = nullptr;
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque< Entry > entries;
+	};
+
+	//queues[0] is shared by threads that aren't workers; queues[1 + i] belongs to workers[i]
+	std::vector< std::unique_ptr< Queue > > queues;
+	std::vector< std::thread > workers;
+
+	std::atomic< size_t > queued{0}; //entries in all queues
+	std::atomic< uint32_t > sleeping{0}; //workers waiting on 'wake'
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool quit = false; //(guarded by sleep_mutex)
+
+	uint32_t own_queue() const;
+	bool take(uint32_t queue, Entry &entry); //pop own queue, else steal
+	static void execute(Entry const &entry);
+	void worker_main(uint32_t queue);
+
+	template< typename F >
+	struct ForContext {
+		JobSystem *jobs;
+		Group *group;
+		F const *fn;
+		size_t count;
+		size_t grain;
+	};
+	template< typename F >
+	static void run_chunks(void *context, size_t first, size_t last);
+};
+
+template< typename F >
+void JobSystem::run_chunks(void *context, size_t first, size_t last) {
+	ForContext< F > &ctx = *static_cast< ForContext< F > * >(context);
+	//leave the upper half of the chunks for other threads to steal, down to single chunks:
+	while (last - first > 1) {
+		size_t mid = first + (last - first) / 2;
+		ctx.jobs->spawn(*ctx.group, Job{&run_chunks< F >, context, mid, last});
+		last = mid;
+	}
+	size_t begin = first * ctx.grain;
+	(*ctx.fn)(first, begin, std::min(ctx.count, begin + ctx.grain));
+}
+
+template< typename F >
+void JobSystem::parallel_for(size_t count, size_t grain, F const &fn) {
+	grain = std::max< size_t >(grain, 1);
+	size_t chunks = chunk_count(count, grain);
+	if (chunks == 0) return;
+	if (chunks == 1 || workers.empty()) {
+		for (size_t chunk = 0; chunk < chunks; ++chunk) {
+			fn(chunk, chunk * grain, std::min(count, (chunk + 1) * grain));
+		}
+		return;
+	}
+
+	Group group;
+	ForContext< F > context{this, &group, &fn, count, grain};
+	spawn(group, Job{&run_chunks< F >, &context, 0, chunks});
+	wait(group);
+}
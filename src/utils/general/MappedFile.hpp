@@ -0,0 +1,29 @@
+#pragma once
+
+//Read-only memory mapping of a whole file.
+// - the mapping lives as long as the MappedFile object
+// - empty files map to an empty view
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+struct MappedFile {
+	explicit MappedFile(std::string const &filename); //throws on failure
+	~MappedFile();
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	std::string_view bytes() const { return std::string_view(data, size); }
+
+	char const *data = nullptr;
+	size_t size = 0;
+
+private:
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#else
+	int fd = -1;
+#endif
+};
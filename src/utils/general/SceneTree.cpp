@@ -2,7 +2,10 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
-#include <algorithm> // for std::upper_bound
+#include <algorithm> // for std::upper_bound, std::sort
+#include <cmath>
+#include <limits>
+#include <utility>
 
 namespace SceneTree {
 
@@ -22,106 +25,278 @@ glm::mat4 compute_local_matrix(const glm::vec3 &translation, const glm::vec4 &ro
     return T * R * S;
 }
 
-// Compute local matrix for a node, using cache if available
-glm::mat4 compute_cached_local_matrix(std::shared_ptr<S72Loader::Document> doc,
-                                size_t node_index) {
-    S72Loader::Node &node = doc->nodes[node_index];
+// instances (or nodes) per job when spreading work over a JobSystem:
+constexpr size_t Grain = 2048;
 
-    if (!node.model_matrix_is_dirty) {
-        auto cache_it = local_matrix_cache.find(node_index);
-        if (cache_it != local_matrix_cache.end()) {
-            return cache_it->second;
-        }
+// world matrices of [begin, end), a run of whole subtrees whose parents (if outside the run) are up to date
+void update_world(S72Loader::Hierarchy &h, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+        uint32_t parent = h.parent[i];
+        const glm::mat4 &local = h.local[h.node[i]];
+        h.world[i] = (parent == S72Loader::NoIndex ? local : h.world[parent] * local);
     }
+}
 
-    glm::mat4 local_matrix = compute_local_matrix(node.translation, node.rotation, node.scale);
-    local_matrix_cache[node_index] = local_matrix;
-    node.model_matrix_is_dirty = false;
+struct WorldJobs {
+    JobSystem *jobs;
+    JobSystem::Group *group;
+    S72Loader::Hierarchy *h;
+};
 
-    return local_matrix;
+// update_world as a job: hands runs of small subtrees to other threads, and descends into big ones
+// (their root first, then their children as another run) so deep or wide hierarchies still split up
+void update_world_job(void *context, size_t begin_, size_t end_) {
+    WorldJobs &ctx = *static_cast<WorldJobs *>(context);
+    S72Loader::Hierarchy &h = *ctx.h;
+    uint32_t begin = uint32_t(begin_);
+    uint32_t end = uint32_t(end_);
+    while (end - begin > Grain) {
+        uint32_t batch = begin; // start of the current run of small subtrees
+        uint32_t i = begin;
+        while (i < end && h.subtree_end[i] - i <= Grain) {
+            i = h.subtree_end[i];
+            if (i - batch >= Grain && i < end) {
+                ctx.jobs->spawn(*ctx.group, JobSystem::Job{&update_world_job, context, batch, i});
+                batch = i;
+            }
+        }
+        if (i == end) {
+            // (only small subtrees left; the last run is done here)
+            begin = batch;
+            break;
+        }
+        // i roots a big subtree:
+        if (batch < i) ctx.jobs->spawn(*ctx.group, JobSystem::Job{&update_world_job, context, batch, i});
+        update_world(h, i, i + 1);
+        if (h.subtree_end[i] < end) {
+            ctx.jobs->spawn(*ctx.group, JobSystem::Job{&update_world_job, context, h.subtree_end[i], end});
+        }
+        begin = i + 1;
+        end = h.subtree_end[i];
+    }
+    update_world(h, begin, end);
 }
 
-// Compute world matrix for a node (no world cache; safe for instancing)
-glm::mat4 compute_world_matrix(std::shared_ptr<S72Loader::Document> doc, 
-                                size_t node_index, 
-                                const glm::mat4 &parent_matrix) {
-    glm::mat4 local_matrix = compute_cached_local_matrix(doc, node_index);
-    return parent_matrix * local_matrix;
+using Ranges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+struct RangeBatch {
+    void (*call)(void *context, size_t begin, size_t end);
+    void *context;
+    Ranges const *ranges;
+};
+
+void run_range_batch(void *context, size_t first, size_t last) {
+    RangeBatch &batch = *static_cast<RangeBatch *>(context);
+    for (size_t r = first; r < last; ++r) {
+        batch.call(batch.context, (*batch.ranges)[r].first, (*batch.ranges)[r].second);
+    }
 }
 
-// Recursive traversal helper
-void traverse_node(std::shared_ptr<S72Loader::Document> doc,
-                   size_t node_index,
-                   const glm::mat4 &parent_matrix,
-                   std::vector<MeshTreeData> &out_meshes,
-                   std::vector<LightTreeData> &out_lights,
-                   std::vector<CameraTreeData> &out_cameras,
-                   std::vector<EnvironmentTreeData> &out_environments
-                   ) {
-    S72Loader::Node &node = doc->nodes[node_index];
-
-    // Compute world matrix for this node (handles caching internally)
-    glm::mat4 world_matrix = compute_world_matrix(doc, node_index, parent_matrix);
-    
-    // --- Collect Data ---
-    if (node.mesh.has_value()) {
-        const std::string &mesh_name = node.mesh.value();
-        auto mesh_it = S72Loader::mesh_map.find(mesh_name);
-        
-        if (mesh_it != S72Loader::mesh_map.end()) {
-            size_t mesh_index = mesh_it->second;
-            const S72Loader::Mesh &mesh = doc->meshes[mesh_index];
-            
-            size_t material_index = 0;
-            if (mesh.material.has_value()) {
-                auto mat_it = S72Loader::material_map.find(mesh.material.value());
-                if (mat_it != S72Loader::material_map.end()) {
-                    material_index = mat_it->second;
+// call(context, begin, end) for every range, spread over jobs' threads: runs of small ranges are
+// batched into jobs of about Grain instances; big ranges are cut into Grain-sized pieces
+// (or, if !cut, passed whole -- for calls that split up their own work)
+void for_ranges(JobSystem &jobs, Ranges const &ranges, void (*call)(void *, size_t, size_t), void *context, bool cut) {
+    JobSystem::Group group;
+    RangeBatch batch{call, context, &ranges};
+    size_t first = 0; // start of the current run of small ranges
+    size_t instances = 0; // instances in that run
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        auto [begin, end] = ranges[r];
+        if (end - begin > Grain) {
+            if (first < r) jobs.spawn(group, JobSystem::Job{&run_range_batch, &batch, first, r});
+            if (cut) {
+                for (size_t b = begin; b < end; b += Grain) {
+                    jobs.spawn(group, JobSystem::Job{call, context, b, std::min<size_t>(end, b + Grain)});
                 }
+            } else {
+                jobs.spawn(group, JobSystem::Job{call, context, begin, end});
+            }
+            first = r + 1;
+            instances = 0;
+        } else {
+            instances += end - begin;
+            if (instances >= Grain) {
+                jobs.spawn(group, JobSystem::Job{&run_range_batch, &batch, first, r + 1});
+                first = r + 1;
+                instances = 0;
             }
-            out_meshes.push_back({world_matrix, mesh_index, material_index});
         }
-    } 
-    else if(node.light.has_value()) {
-        auto it = S72Loader::light_map.find(node.light.value());
-        if (it != S72Loader::light_map.end()) {
-            out_lights.push_back({world_matrix, it->second});
+    }
+    if (first < ranges.size()) jobs.spawn(group, JobSystem::Job{&run_range_batch, &batch, first, ranges.size()});
+    jobs.wait(group);
+}
+
+// Recompute dirty local matrices, then the world matrices of every instance under a dirty node
+// (or of all instances, on rebuild). Recomputed instance ranges are appended to out_ranges in order;
+// parents come before children, so each parent's world matrix is up to date when it is used.
+void update_transforms(S72Loader::Hierarchy &h, Ranges &out_ranges, JobSystem *jobs) {
+    out_ranges.clear();
+
+    auto update_locals = [&h](size_t, size_t begin, size_t end) {
+        for (size_t d = begin; d < end; ++d) {
+            uint32_t n = h.dirty_nodes[d];
+            h.local[n] = compute_local_matrix(h.translation[n], h.rotation[n], h.scale[n]);
+            h.local_dirty[n] = 0;
         }
-    } 
-    else if(node.camera.has_value()) {
-        auto it = S72Loader::camera_map.find(node.camera.value());
-        if (it != S72Loader::camera_map.end()) {
-            out_cameras.push_back({world_matrix, it->second});
+    };
+    if (jobs) jobs->parallel_for(h.dirty_nodes.size(), Grain, update_locals);
+    else update_locals(0, 0, h.dirty_nodes.size());
+
+    if (h.rebuild) {
+        out_ranges.emplace_back(0, uint32_t(h.node.size()));
+        h.rebuild = false;
+    } else {
+        // subtrees of every instance of a dirty node, merged (nested and overlapping ranges collapse)
+        Ranges subtrees;
+        for (uint32_t n : h.dirty_nodes) {
+            for (uint32_t k = h.node_instances_first[n]; k < h.node_instances_first[n + 1]; ++k) {
+                uint32_t instance = h.node_instances[k];
+                subtrees.emplace_back(instance, h.subtree_end[instance]);
+            }
         }
-    } 
-    else if(node.environment.has_value()) {
-        auto it = S72Loader::environment_map.find(node.environment.value());
-        if (it != S72Loader::environment_map.end()) {
-            out_environments.push_back({world_matrix, it->second});
+        std::sort(subtrees.begin(), subtrees.end());
+        for (auto const &range : subtrees) {
+            if (!out_ranges.empty() && range.first <= out_ranges.back().second) {
+                out_ranges.back().second = std::max(out_ranges.back().second, range.second);
+            } else {
+                out_ranges.push_back(range);
+            }
         }
     }
-    
-    // Recursively traverse children
-    for (const auto &child_name : node.children) {
-        auto it = S72Loader::node_map.find(child_name);
-        if (it != S72Loader::node_map.end()) {
-            traverse_node(doc, it->second, world_matrix, out_meshes, out_lights, out_cameras, out_environments);
+    h.dirty_nodes.clear();
+
+    if (jobs && jobs->thread_count() > 1) {
+        JobSystem::Group group;
+        WorldJobs context{jobs, &group, &h};
+        for_ranges(*jobs, out_ranges, &update_world_job, &context, false);
+        jobs->wait(group); //(jobs that update_world_job spawned)
+    } else {
+        for (auto const &[begin, end] : out_ranges) {
+            update_world(h, begin, end);
         }
     }
 }
 
-// recursive helper to mark a node and all its descendants as dirty
-void mark_children_dirty_recursive(std::shared_ptr<S72Loader::Document> doc, size_t node_index) {
-    S72Loader::Node &node = doc->nodes[node_index];
+void fill_outputs(const S72Loader::Document &doc,
+                  std::vector<MeshTreeData> &out_meshes,
+                  std::vector<LightTreeData> &out_lights,
+                  std::vector<CameraTreeData> &out_cameras,
+                  std::vector<EnvironmentTreeData> &out_environments,
+                  JobSystem *jobs) {
+    const S72Loader::Hierarchy &h = doc.hierarchy;
 
-    node.model_matrix_is_dirty = true;
+    out_meshes.resize(h.mesh_instances.size());
+    auto fill_meshes = [&](size_t, size_t begin, size_t end) {
+        for (size_t slot = begin; slot < end; ++slot) {
+            uint32_t instance = h.mesh_instances[slot];
+            const S72Loader::Node &node = doc.nodes[h.node[instance]];
+            const S72Loader::Mesh &mesh = doc.meshes[node.mesh_index];
 
-    local_matrix_cache.erase(node_index);
-    
-    for (const auto &child_name : node.children) {
-        auto it = S72Loader::node_map.find(child_name);
-        if (it != S72Loader::node_map.end()) {
-            mark_children_dirty_recursive(doc, it->second);
+            size_t material_index = 0;
+            if (mesh.material_index != S72Loader::NoIndex) {
+                material_index = mesh.material_index;
+            }
+            out_meshes[slot] = {h.world[instance], node.mesh_index, material_index};
+        }
+    };
+    if (jobs) jobs->parallel_for(out_meshes.size(), Grain, fill_meshes);
+    else fill_meshes(0, 0, out_meshes.size());
+
+    out_lights.clear();
+    out_lights.reserve(h.light_instances.size());
+    for (uint32_t instance : h.light_instances) {
+        out_lights.push_back({h.world[instance], doc.nodes[h.node[instance]].light_index});
+    }
+
+    out_cameras.clear();
+    out_cameras.reserve(h.camera_instances.size());
+    for (uint32_t instance : h.camera_instances) {
+        out_cameras.push_back({h.world[instance], doc.nodes[h.node[instance]].camera_index});
+    }
+
+    out_environments.clear();
+    out_environments.reserve(h.environment_instances.size());
+    for (uint32_t instance : h.environment_instances) {
+        out_environments.push_back({h.world[instance], doc.nodes[h.node[instance]].environment_index});
+    }
+}
+
+struct Outputs {
+    S72Loader::Hierarchy const *h;
+    std::vector<MeshTreeData> *meshes;
+    std::vector<LightTreeData> *lights;
+    std::vector<CameraTreeData> *cameras;
+    std::vector<EnvironmentTreeData> *environments;
+};
+
+// copy recomputed world matrices of instances [begin, end) into their cached output entries
+void patch_outputs(void *context, size_t begin, size_t end) {
+    Outputs &out = *static_cast<Outputs *>(context);
+    S72Loader::Hierarchy const &h = *out.h;
+    for (size_t i = begin; i < end; ++i) {
+        uint32_t slot = h.slot[i];
+        switch (h.kind[i]) {
+            case S72Loader::Hierarchy::Kind::None: break;
+            case S72Loader::Hierarchy::Kind::Mesh: (*out.meshes)[slot].model_matrix = h.world[i]; break;
+            case S72Loader::Hierarchy::Kind::Light: (*out.lights)[slot].model_matrix = h.world[i]; break;
+            case S72Loader::Hierarchy::Kind::Camera: (*out.cameras)[slot].model_matrix = h.world[i]; break;
+            case S72Loader::Hierarchy::Kind::Environment: (*out.environments)[slot].model_matrix = h.world[i]; break;
+        }
+    }
+}
+
+void traverse(std::shared_ptr<S72Loader::Document> doc, 
+              std::vector<MeshTreeData> &out_meshes,
+              std::vector<LightTreeData> &out_lights,
+              std::vector<CameraTreeData> &out_cameras,
+              std::vector<EnvironmentTreeData> &out_environments,
+              TreeChanges *out_changes,
+              JobSystem *jobs) {
+    S72Loader::Hierarchy &h = doc->hierarchy;
+
+    bool rebuild = h.rebuild
+        || out_meshes.size() != h.mesh_instances.size()
+        || out_lights.size() != h.light_instances.size()
+        || out_cameras.size() != h.camera_instances.size()
+        || out_environments.size() != h.environment_instances.size();
+
+    Ranges ranges;
+    update_transforms(h, ranges, jobs);
+
+    if (out_changes) {
+        out_changes->all = rebuild;
+        out_changes->meshes.clear();
+        out_changes->lights.clear();
+        out_changes->cameras.clear();
+        out_changes->environments.clear();
+    }
+
+    if (rebuild) {
+        fill_outputs(*doc, out_meshes, out_lights, out_cameras, out_environments, jobs);
+        return;
+    }
+
+    // --- Patch cached entries of recomputed instances ---
+    Outputs outputs{&h, &out_meshes, &out_lights, &out_cameras, &out_environments};
+    if (jobs && jobs->thread_count() > 1) {
+        for_ranges(*jobs, ranges, &patch_outputs, &outputs, true);
+    } else {
+        for (auto const &[begin, end] : ranges) {
+            patch_outputs(&outputs, begin, end);
+        }
+    }
+
+    if (out_changes) {
+        for (auto const &[begin, end] : ranges) {
+            for (uint32_t i = begin; i < end; ++i) {
+                switch (h.kind[i]) {
+                    case S72Loader::Hierarchy::Kind::None: break;
+                    case S72Loader::Hierarchy::Kind::Mesh: out_changes->meshes.push_back(h.slot[i]); break;
+                    case S72Loader::Hierarchy::Kind::Light: out_changes->lights.push_back(h.slot[i]); break;
+                    case S72Loader::Hierarchy::Kind::Camera: out_changes->cameras.push_back(h.slot[i]); break;
+                    case S72Loader::Hierarchy::Kind::Environment: out_changes->environments.push_back(h.slot[i]); break;
+                }
+            }
         }
     }
 }
@@ -129,104 +304,175 @@ void mark_children_dirty_recursive(std::shared_ptr<S72Loader::Document> doc, siz
 } // anonymous namespace
 
 void mark_dirty(std::shared_ptr<S72Loader::Document> doc, size_t node_index) {
-    mark_children_dirty_recursive(doc, node_index);
+    // take the node's (possibly edited) transform; descendants pick up the change when world matrices are recomputed
+    S72Loader::Hierarchy &h = doc->hierarchy;
+    S72Loader::Node const &node = doc->nodes[node_index];
+    h.translation[node_index] = node.translation;
+    h.rotation[node_index] = node.rotation;
+    h.scale[node_index] = node.scale;
+    if (!h.local_dirty[node_index]) {
+        h.local_dirty[node_index] = 1;
+        h.dirty_nodes.push_back(uint32_t(node_index));
+    }
 }
 
 void traverse_scene(std::shared_ptr<S72Loader::Document> doc, 
                     std::vector<MeshTreeData> &out_meshes,
                     std::vector<LightTreeData> &out_lights,
                     std::vector<CameraTreeData> &out_cameras,
-                    std::vector<EnvironmentTreeData> &out_environments) {
-    out_meshes.clear();
-    out_lights.clear();
-    out_cameras.clear();
-    out_environments.clear();
-    
-    glm::mat4 identity(1.0f);
-    
-    for (const auto &root_name : doc->scene.roots) {
-        auto it = S72Loader::node_map.find(root_name);
-        if (it != S72Loader::node_map.end()) {
-            traverse_node(doc, it->second, identity, out_meshes, out_lights, out_cameras, out_environments);
+                    std::vector<EnvironmentTreeData> &out_environments,
+                    JobSystem *jobs) {
+    traverse(doc, out_meshes, out_lights, out_cameras, out_environments, nullptr, jobs);
+}
+
+void traverse_scene(std::shared_ptr<S72Loader::Document> doc, 
+                    std::vector<MeshTreeData> &out_meshes,
+                    std::vector<LightTreeData> &out_lights,
+                    std::vector<CameraTreeData> &out_cameras,
+                    std::vector<EnvironmentTreeData> &out_environments,
+                    TreeChanges &out_changes,
+                    JobSystem *jobs) {
+    traverse(doc, out_meshes, out_lights, out_cameras, out_environments, &out_changes, jobs);
+}
+
+// moves track k's cursor to the keyframe interval containing 'time' and caches that interval's endpoints
+static void seek_track(S72Loader::Animation &a, uint32_t k, float time) {
+    const float *times = a.times.data() + a.key_first[k];
+    const glm::vec4 *values = a.values.data() + a.key_first[k];
+    uint32_t count = a.key_count[k];
+
+    uint32_t pre;
+    uint32_t tail;
+    if (time < times[0]) {
+        // hold the first value
+        pre = tail = 0;
+        a.interval_begin[k] = -std::numeric_limits<float>::infinity();
+        a.interval_end[k] = times[0];
+    } else if (time >= times[count - 1]) {
+        // hold the last value
+        pre = tail = count - 1;
+        a.interval_begin[k] = times[count - 1];
+        a.interval_end[k] = std::numeric_limits<float>::infinity();
+    } else {
+        // times[0] <= time < times[count-1], so some key in [0, count-1) starts the interval
+        pre = a.cursor[k];
+        if (pre < count - 1 && times[pre] <= time) {
+            // time moved forward (the usual case): step a few keys before falling back to a search
+            for (uint32_t step = 0; step < 4 && times[pre + 1] <= time; ++step) ++pre;
         }
+        if (!(pre < count - 1 && times[pre] <= time && time < times[pre + 1])) {
+            pre = uint32_t(std::upper_bound(times, times + count, time) - times) - 1;
+        }
+        tail = pre + 1;
+        a.interval_begin[k] = times[pre];
+        a.interval_end[k] = times[tail];
     }
-}
 
-void update_animation(std::shared_ptr<S72Loader::Document> doc, float time) {
-    for (const auto& driver : doc->drivers) {
-        // Find the target node for this driver
-        auto node_it = S72Loader::node_map.find(driver.node);
-        if (node_it == S72Loader::node_map.end()) continue;
-        
-        size_t node_index = node_it->second;
-        S72Loader::Node& target_node = doc->nodes[node_index];
-
-        // Find the appropriate keyframe interval for the current time
-        size_t pre_index;
-        size_t tail_index;
-        
-        if(driver.times.empty()) continue;
-
-        if(time < driver.times.front()){
-            pre_index = tail_index = 0;
-        } else if(time > driver.times.back()){
-            pre_index = tail_index = driver.times.size() - 1;
-        } else {
-            auto upper = std::upper_bound(driver.times.begin(), driver.times.end(), time);
-            tail_index = std::distance(driver.times.begin(), upper);
-            pre_index = tail_index > 0 ? tail_index - 1 : 0;
-        }
-        
-        float ratio = 0.0f;
-        if (pre_index != tail_index) {
-            float duration = driver.times[tail_index] - driver.times[pre_index];
-            if (duration > std::numeric_limits<float>::epsilon())
-                ratio = (time - driver.times[pre_index]) / duration;
-        }
-
-        bool changed = false;
-
-        // calculate interpolation and directly update Node data
-        if (driver.channel == "rotation") {
-            glm::quat q1(driver.values[4*pre_index+3], driver.values[4*pre_index+0], driver.values[4*pre_index+1], driver.values[4*pre_index+2]);
-            glm::quat q_result = q1;
-            
-            if (pre_index != tail_index) {
-                glm::quat q2(driver.values[4*tail_index+3], driver.values[4*tail_index+0], driver.values[4*tail_index+1], driver.values[4*tail_index+2]);
-                q_result = glm::slerp(q1, q2, ratio);
-            }
-            
-            glm::vec4 new_rot(q_result.x, q_result.y, q_result.z, q_result.w);
-            if (target_node.rotation != new_rot) {
-                target_node.rotation = new_rot;
-                changed = true;
-            }
+    a.cursor[k] = pre;
+    a.key_time[k] = times[pre];
+    a.key_duration[k] = times[tail] - times[pre];
+    a.from[k] = values[pre];
+    a.to[k] = values[tail];
+
+    if (a.mode[k] == S72Loader::Animation::Mode::Slerp) {
+        // same steps as glm::slerp, done once per interval instead of once per frame
+        glm::quat q1(a.from[k].w, a.from[k].x, a.from[k].y, a.from[k].z);
+        glm::quat q2(a.to[k].w, a.to[k].x, a.to[k].y, a.to[k].z);
+        float cos_angle = glm::dot(q1, q2);
+        if (cos_angle < 0.0f) {
+            q2 = -q2;
+            cos_angle = -cos_angle;
+        }
+        a.to[k] = glm::vec4(q2.x, q2.y, q2.z, q2.w);
+        if (pre == tail || cos_angle > 1.0f - std::numeric_limits<float>::epsilon()) {
+            a.angle[k] = 0.0f;
+            a.sin_angle[k] = 0.0f;
         } else {
-            glm::vec3 v1(driver.values[3*pre_index+0], driver.values[3*pre_index+1], driver.values[3*pre_index+2]);
-            glm::vec3 v_result = v1;
+            a.angle[k] = std::acos(cos_angle);
+            a.sin_angle[k] = std::sin(a.angle[k]);
+        }
+    }
+}
+
+void update_animation(std::shared_ptr<S72Loader::Document> doc, float time, JobSystem *jobs) {
+    using Animation = S72Loader::Animation;
+    Animation &a = doc->animation;
+    S72Loader::Hierarchy &h = doc->hierarchy;
+    const uint32_t tracks = uint32_t(a.node.size());
+    const float epsilon = std::numeric_limits<float>::epsilon();
 
-            if (pre_index != tail_index && driver.interpolation == "LINEAR") {
-                glm::vec3 v2(driver.values[3*tail_index+0], driver.values[3*tail_index+1], driver.values[3*tail_index+2]);
-                v_result = glm::mix(v1, v2, ratio);
+    // evaluate tracks [begin, end), write their values to the hierarchy (and, when they change, to the nodes),
+    //  and list nodes that changed (each node channel has at most one track, so chunks never write the same value)
+    auto evaluate = [&](size_t chunk, size_t begin, size_t end) {
+        std::vector<uint32_t> &changed = a.changed[chunk];
+
+        auto apply = [&](uint32_t k, glm::vec4 const &value) {
+            uint32_t node_index = a.node[k];
+            S72Loader::Node &node = doc->nodes[node_index];
+            switch (a.channel[k]) {
+                case Animation::Channel::Translation: {
+                    glm::vec3 v(value);
+                    if (h.translation[node_index] == v) return;
+                    h.translation[node_index] = node.translation = v;
+                } break;
+                case Animation::Channel::Scale: {
+                    glm::vec3 v(value);
+                    if (h.scale[node_index] == v) return;
+                    h.scale[node_index] = node.scale = v;
+                } break;
+                case Animation::Channel::Rotation: {
+                    if (h.rotation[node_index] == value) return;
+                    h.rotation[node_index] = node.rotation = value;
+                } break;
             }
+            changed.push_back(node_index);
+        };
 
-            if (driver.channel == "translation") {
-                if (target_node.translation != v_result) {
-                    target_node.translation = v_result;
-                    changed = true;
-                }
-            } else if (driver.channel == "scale") {
-                if (target_node.scale != v_result) {
-                    target_node.scale = v_result;
-                    changed = true;
-                }
+        // each mode in its own loop (tracks are sorted by mode, then channel), first moving any track whose
+        // cursor interval no longer contains 'time' (with time running forward, most tracks stay put):
+        uint32_t first = uint32_t(begin);
+        uint32_t last = uint32_t(end);
+        for (uint32_t k = first; k < std::min(last, a.linear_begin); ++k) {
+            if (!(a.interval_begin[k] <= time && time < a.interval_end[k])) seek_track(a, k, time);
+            apply(k, a.from[k]);
+        }
+        for (uint32_t k = std::max(first, a.linear_begin); k < std::min(last, a.slerp_begin); ++k) {
+            if (!(a.interval_begin[k] <= time && time < a.interval_end[k])) seek_track(a, k, time);
+            float ratio = (a.key_duration[k] > epsilon ? (time - a.key_time[k]) / a.key_duration[k] : 0.0f);
+            apply(k, a.from[k] * (1.0f - ratio) + a.to[k] * ratio); //(as glm::mix)
+        }
+        for (uint32_t k = std::max(first, a.slerp_begin); k < last; ++k) {
+            if (!(a.interval_begin[k] <= time && time < a.interval_end[k])) seek_track(a, k, time);
+            float ratio = (a.key_duration[k] > epsilon ? (time - a.key_time[k]) / a.key_duration[k] : 0.0f);
+            glm::quat q1(a.from[k].w, a.from[k].x, a.from[k].y, a.from[k].z);
+            glm::quat q2(a.to[k].w, a.to[k].x, a.to[k].y, a.to[k].z);
+            glm::quat q;
+            if (a.angle[k] == 0.0f) {
+                q = glm::quat(glm::mix(q1.w, q2.w, ratio), glm::mix(q1.x, q2.x, ratio), glm::mix(q1.y, q2.y, ratio), glm::mix(q1.z, q2.z, ratio));
+            } else {
+                q = (std::sin((1.0f - ratio) * a.angle[k]) * q1 + std::sin(ratio * a.angle[k]) * q2) / a.sin_angle[k];
             }
+            apply(k, glm::vec4(q.x, q.y, q.z, q.w));
         }
+    };
 
-        // if changed, mark this node and all its descendants as dirty to ensure world matrix will be updated
-        if (changed) {
-            mark_children_dirty_recursive(doc, node_index);
+    if (jobs) {
+        a.changed.resize(std::max<size_t>(1, JobSystem::chunk_count(tracks, Grain)));
+        jobs->parallel_for(tracks, Grain, evaluate);
+    } else {
+        a.changed.resize(1);
+        evaluate(0, 0, tracks);
+    }
+
+    // mark changed nodes dirty (in track order, whichever way the work was split):
+    for (auto &changed : a.changed) {
+        for (uint32_t node_index : changed) {
+            if (!h.local_dirty[node_index]) {
+                h.local_dirty[node_index] = 1;
+                h.dirty_nodes.push_back(node_index);
+            }
         }
+        changed.clear();
     }
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "VK.hpp"
+#include "JobSystem.hpp"
 #include "S72Loader.hpp"
 #include "SceneManager.hpp"
 
@@ -34,17 +35,41 @@ struct EnvironmentTreeData
     size_t environment_index;
 };
 
-inline std::unordered_map<size_t, glm::mat4> local_matrix_cache;
+// entries of traverse_scene's outputs whose model_matrix changed in that call:
+struct TreeChanges {
+    bool all = false; // outputs were filled from scratch (the lists below are then left empty)
+    std::vector<uint32_t> meshes; // indices into out_meshes
+    std::vector<uint32_t> lights; // indices into out_lights
+    std::vector<uint32_t> cameras; // indices into out_cameras
+    std::vector<uint32_t> environments; // indices into out_environments
+};
+
+// brings the output vectors up to date with the document's transforms:
+//  the outputs act as a per-instance cache; after the first call only entries under nodes
+//  changed by update_animation or mark_dirty are rewritten (pass the same vectors every time)
+//  if 'jobs' is given, the work is spread over its threads (with the same results as without)
+void traverse_scene(std::shared_ptr<S72Loader::Document> doc, 
+                    std::vector<MeshTreeData> &out_meshes,
+                    std::vector<LightTreeData> &out_lights,
+                    std::vector<CameraTreeData> &out_cameras,
+                    std::vector<EnvironmentTreeData> &out_environments,
+                    JobSystem *jobs = nullptr);
 
+// same, also reporting which entries changed:
 void traverse_scene(std::shared_ptr<S72Loader::Document> doc, 
                     std::vector<MeshTreeData> &out_meshes,
                     std::vector<LightTreeData> &out_lights,
                     std::vector<CameraTreeData> &out_cameras,
-                    std::vector<EnvironmentTreeData> &out_environments);
+                    std::vector<EnvironmentTreeData> &out_environments,
+                    TreeChanges &out_changes,
+                    JobSystem *jobs = nullptr);
 
-void update_animation(std::shared_ptr<S72Loader::Document> doc, float time);
+// poses animated nodes at 'time' from doc->animation (the drivers, compiled at load):
+//  cheapest when time only moves forward between calls, but any time works
+void update_animation(std::shared_ptr<S72Loader::Document> doc, float time, JobSystem *jobs = nullptr);
 
-// helper function to mark a node and all its descendants as dirty
+// helper function to mark a node's transform as changed after editing doc->nodes[node_index]'s translation, rotation,
+//  or scale (it and its descendants follow the edit on the next traverse_scene)
 void mark_dirty(std::shared_ptr<S72Loader::Document> doc, size_t node_index);
 
 }
\ No newline at end of file
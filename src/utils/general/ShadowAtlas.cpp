@@ -0,0 +1,180 @@
+#include "ShadowAtlas.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+void ShadowAtlas::configure(uint32_t size_, uint32_t min_tile_, uint32_t budget_) {
+	size = std::bit_floor(size_);
+	min_tile = std::clamp(std::bit_floor(min_tile_), 1u, std::max(size, 1u));
+	max_tile = std::max(size / 2, min_tile);
+	budget = budget_;
+	lights.clear();
+	total = Stats{};
+	reset_nodes();
+}
+
+ShadowAtlas::Request ShadowAtlas::coverage_request(float distance, float reach, float fov, float screen_width, float screen_height, uint32_t max_resolution) {
+	screen_width = std::max(screen_width, 1.0f);
+	screen_height = std::max(screen_height, 1.0f);
+	float diameter = screen_width + screen_height;
+	if (distance > reach) {
+		const float pixels_per_unit = screen_height * 0.5f / std::tan(fov * 0.5f); //(at unit distance)
+		diameter = std::min(diameter, 2.0f * reach / std::sqrt(distance * distance - reach * reach) * pixels_per_unit);
+	}
+	return Request{
+		.resolution = std::min(uint32_t(diameter), max_resolution),
+		.importance = std::min(1.0f, diameter * diameter / (screen_width * screen_height)) + 1e-3f, //(never quite 0, so a visible light is still drawn eventually)
+		.dirty = true,
+	};
+}
+
+void ShadowAtlas::update(std::vector< Request > const &requests) {
+	last = Stats{};
+	if (lights.size() != requests.size()) {
+		lights.assign(requests.size(), Light{});
+		reset_nodes();
+	}
+	if (size == 0) return;
+
+	//lights that need drawing: those without a map (that matter at all) first, then by priority:
+	candidates.clear();
+	priorities.resize(lights.size());
+	wanted.resize(lights.size());
+	for (uint32_t i = 0; i < uint32_t(lights.size()); ++i) {
+		Light &light = lights[i];
+		light.draw = false;
+		light.dirty = light.dirty || requests[i].dirty;
+		wanted[i] = std::clamp(std::bit_floor(requests[i].resolution), min_tile, max_tile);
+		priorities[i] = requests[i].importance * float(1 + light.waited);
+		if (!light.valid || light.dirty || light.tile.size != wanted[i]) candidates.emplace_back(i);
+	}
+	auto unmapped = [&](uint32_t i) { return !lights[i].valid && priorities[i] > 0.0f; };
+	std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+		if (unmapped(a) != unmapped(b)) return unmapped(a);
+		if (priorities[a] != priorities[b]) return priorities[a] > priorities[b];
+		return a < b;
+	});
+
+	for (uint32_t i : candidates) {
+		Light &light = lights[i];
+		if (budget != 0 && last.drawn == budget) {
+			light.waited += 1;
+			last.waiting += 1;
+			continue;
+		}
+
+		//(re)place the tile, falling back to smaller ones (the old tile is given back first, so its size always fits):
+		if (light.tile.size != wanted[i]) {
+			release(light);
+			for (uint32_t side = wanted[i]; side >= min_tile && light.tile.size == 0; side /= 2) {
+				const uint32_t level = uint32_t(std::countr_zero(size / side));
+				uint32_t node = 0;
+				if (!take(level, node)) continue;
+				const uint32_t per_side = 1u << level;
+				light.level = level;
+				light.node = node;
+				light.tile = Tile{
+					.x = (node % per_side) * side,
+					.y = (node / per_side) * side,
+					.size = side,
+				};
+			}
+			if (light.tile.size == 0) continue; //(no room: unshadowed until some frees up)
+		}
+
+		light.draw = true;
+		light.valid = true;
+		light.dirty = false;
+		light.waited = 0;
+		last.drawn += 1;
+	}
+
+	last.lights = lights.size();
+	for (Light const &light : lights) {
+		if (!light.valid) last.unmapped += 1;
+		last.texels += uint64_t(light.tile.size) * light.tile.size;
+	}
+	total.lights += last.lights;
+	total.drawn += last.drawn;
+	total.waiting += last.waiting;
+	total.unmapped += last.unmapped;
+	total.texels += last.texels;
+}
+
+void ShadowAtlas::clear() {
+	for (Light &light : lights) light = Light{};
+	reset_nodes();
+}
+
+bool ShadowAtlas::take(uint32_t level, uint32_t &node) {
+	if (free_nodes[level] != 0) {
+		std::vector< uint8_t > &level_nodes = nodes[level];
+		node = uint32_t(std::find(level_nodes.begin(), level_nodes.end(), uint8_t(Free)) - level_nodes.begin());
+		level_nodes[node] = Used;
+		free_nodes[level] -= 1;
+		return true;
+	}
+
+	//split a free square of the level above:
+	uint32_t parent = 0;
+	if (level == 0 || !take(level - 1, parent)) return false;
+	nodes[level - 1][parent] = Split;
+	const uint32_t per_side = 1u << level;
+	const uint32_t x = (parent % (per_side / 2)) * 2;
+	const uint32_t y = (parent / (per_side / 2)) * 2;
+	for (uint32_t dy = 0; dy < 2; ++dy) {
+		for (uint32_t dx = 0; dx < 2; ++dx) nodes[level][(y + dy) * per_side + x + dx] = Free;
+	}
+	node = y * per_side + x;
+	nodes[level][node] = Used;
+	free_nodes[level] += 3;
+	return true;
+}
+
+void ShadowAtlas::give_back(uint32_t level, uint32_t node) {
+	nodes[level][node] = Free;
+	free_nodes[level] += 1;
+
+	//merge four free siblings into their parent, as far up as that goes:
+	while (level > 0) {
+		const uint32_t per_side = 1u << level;
+		const uint32_t x = (node % per_side) & ~1u;
+		const uint32_t y = (node / per_side) & ~1u;
+		std::vector< uint8_t > &level_nodes = nodes[level];
+		for (uint32_t dy = 0; dy < 2; ++dy) {
+			for (uint32_t dx = 0; dx < 2; ++dx) {
+				if (level_nodes[(y + dy) * per_side + x + dx] != Free) return;
+			}
+		}
+		for (uint32_t dy = 0; dy < 2; ++dy) {
+			for (uint32_t dx = 0; dx < 2; ++dx) level_nodes[(y + dy) * per_side + x + dx] = Absent;
+		}
+		free_nodes[level] -= 4;
+
+		level -= 1;
+		node = (y / 2) * (per_side / 2) + x / 2;
+		nodes[level][node] = Free;
+		free_nodes[level] += 1;
+	}
+}
+
+void ShadowAtlas::release(Light &light) {
+	if (light.tile.size == 0) return;
+	give_back(light.level, light.node);
+	light.tile = Tile{};
+	light.valid = false;
+}
+
+void ShadowAtlas::reset_nodes() {
+	const uint32_t levels = (size == 0 ? 0 : uint32_t(std::countr_zero(size / min_tile)) + 1);
+	nodes.resize(levels);
+	free_nodes.assign(levels, 0);
+	for (uint32_t level = 0; level < levels; ++level) {
+		nodes[level].assign(size_t(1) << (2 * level), uint8_t(Absent));
+	}
+	if (levels != 0) {
+		nodes[0][0] = Free;
+		free_nodes[0] = 1;
+	}
+}
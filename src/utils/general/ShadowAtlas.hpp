@@ -0,0 +1,91 @@
+#pragma once
+
+//Packs many lights' shadow maps into square tiles of one fixed-size depth image, and picks which to redraw each update.
+// - tiles have power-of-two sides and come from a quadtree (buddy) allocator: a free square is split into four to make
+//   smaller ones, and four free siblings merge back into their parent
+// - each update, every light asks for a tile size (e.g. from its projected screen coverage), says how important it is,
+//   and whether its map went out of date; at most 'budget' lights are drawn, lights that have no map yet first, then
+//   by importance times (1 + updates waited)
+// - a light whose tile size changed moves to a new tile when it is next drawn, and keeps its old map until then;
+//   one that doesn't fit gets a smaller tile, and one that can't get any is left without a map
+// - memory is the atlas' whatever the light count; too many lights just get smaller tiles
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ShadowAtlas {
+	uint32_t size = 0; //side of the atlas, in texels (a power of two; 0 until configured)
+	uint32_t min_tile = 0; //side of the smallest tile
+	uint32_t max_tile = 0; //side of the largest tile (half the atlas, so no light takes all of it)
+	uint32_t budget = 0; //lights drawn per update (0: every light that needs it)
+
+	//forget every light and tile:
+	void configure(uint32_t size, uint32_t min_tile, uint32_t budget);
+
+	struct Request {
+		uint32_t resolution = 0; //tile side wanted (rounded down to a power of two, within [min_tile, max_tile])
+		float importance = 0.0f; //(e.g. screen coverage; lights with none only get drawn when nothing else waits)
+		bool dirty = true; //the light's map is out of date (e.g. it or its casters moved)
+	};
+
+	//request for a light that reaches 'reach' (a sphere) from a point 'distance' from the camera, on a screen_width x
+	//  screen_height screen with a vertical field of view of 'fov' radians: a tile about as many texels across as the
+	//  pixels the sphere covers (all of the screen from inside it), at most max_resolution, as important as the fraction
+	//  of the screen it covers (lights out of view should instead ask for no resolution, with no importance)
+	static Request coverage_request(float distance, float reach, float fov, float screen_width, float screen_height, uint32_t max_resolution);
+
+	struct Tile {
+		uint32_t x = 0; //texel offset in the atlas
+		uint32_t y = 0;
+		uint32_t size = 0; //side, in texels (0: no tile)
+	};
+
+	struct Light {
+		Tile tile;
+		bool valid = false; //the tile holds a map of the light (drawn this update, if 'draw')
+		bool draw = false; //(this update) draw the light's map into its tile
+		bool dirty = true; //the map is out of date (requested since it was last drawn)
+		uint32_t waited = 0; //updates the light needed drawing without being drawn
+
+		uint32_t level = 0; //(allocator) tile depth in the quadtree, and index within that level
+		uint32_t node = 0;
+	};
+	std::vector< Light > lights; //one per request, in the same order
+
+	//decide this update's tiles and draws, one request per light (a different light count starts over):
+	void update(std::vector< Request > const &requests);
+
+	//forget every map, keeping the lights (e.g. because the image was re-created):
+	void clear();
+
+	//counts for the last update and since the atlas was configured:
+	struct Stats {
+		uint64_t lights = 0;
+		uint64_t drawn = 0; //lights whose map was drawn
+		uint64_t waiting = 0; //lights that needed drawing, left for a later update
+		uint64_t unmapped = 0; //lights without a map (after the update)
+		uint64_t texels = 0; //texels in tiles
+	};
+	Stats last;
+	Stats total;
+
+private:
+	enum Node : uint8_t {
+		Absent = 0, //part of a larger square
+		Free = 1,
+		Used = 2,
+		Split = 3, //made of four smaller squares
+	};
+	std::vector< std::vector< uint8_t > > nodes; //per level, per node (row-major, 1 << level to a side)
+	std::vector< uint32_t > free_nodes; //per level
+
+	std::vector< uint32_t > candidates; //(scratch) lights that need drawing
+	std::vector< float > priorities; //(scratch) per light
+	std::vector< uint32_t > wanted; //(scratch) per light: tile side
+
+	bool take(uint32_t level, uint32_t &node);
+	void give_back(uint32_t level, uint32_t node);
+	void release(Light &light);
+	void reset_nodes();
+};
@@ -0,0 +1,122 @@
+#include "ShadowCache.hpp"
+
+#include <algorithm>
+
+namespace {
+	bool any_set(std::vector< uint64_t > const &bits, uint32_t const *begin, uint32_t const *end) {
+		for (uint32_t const *item = begin; item != end; ++item) {
+			if (bits[*item / 64] & (uint64_t(1) << (*item % 64))) return true;
+		}
+		return false;
+	}
+}
+
+void ShadowCache::begin_update(bool split_, std::vector< uint32_t > const &moved, bool all_moved_, size_t item_count) {
+	split = split_;
+	frame += 1;
+	last = Stats{};
+
+	const size_t words = (item_count + 63) / 64;
+	all_moved = all_moved_ || last_moved.size() != item_count;
+	any_moved = false;
+	any_changed = false;
+	if (all_moved) {
+		moved_bits.assign(words, 0);
+		changed_bits.assign(words, 0);
+		dynamic_bits.assign(words, 0);
+		last_moved.assign(item_count, 0);
+		dynamic_items.clear();
+		return;
+	}
+
+	std::fill(moved_bits.begin(), moved_bits.end(), 0);
+	std::fill(changed_bits.begin(), changed_bits.end(), 0);
+	for (uint32_t i : moved) {
+		const uint64_t bit = uint64_t(1) << (i % 64);
+		moved_bits[i / 64] |= bit;
+		any_moved = true;
+		if (!split) continue;
+		last_moved[i] = frame;
+		if (!(dynamic_bits[i / 64] & bit)) {
+			dynamic_bits[i / 64] |= bit;
+			changed_bits[i / 64] |= bit;
+			dynamic_items.emplace_back(i);
+			any_changed = true;
+		}
+	}
+
+	//items that have been still for long enough become static again:
+	size_t kept = 0;
+	for (uint32_t i : dynamic_items) {
+		if (frame - last_moved[i] < dynamic_frames) {
+			dynamic_items[kept++] = i;
+			continue;
+		}
+		dynamic_bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+		changed_bits[i / 64] |= uint64_t(1) << (i % 64);
+		any_changed = true;
+	}
+	dynamic_items.resize(kept);
+}
+
+void ShadowCache::update_views(Kind kind, std::vector< glm::mat4 > const &clip_from_world,
+	std::vector< uint32_t > &casters, std::vector< uint32_t > const &view_first) {
+	std::vector< View > &kind_views = views[kind];
+	std::vector< uint32_t > const &previous = previous_casters[kind];
+	std::vector< uint32_t > const &previous_first = previous_view_first[kind];
+
+	const uint32_t view_count = (view_first.empty() ? 0 : uint32_t(view_first.size() - 1));
+	const bool reset = all_moved || kind_views.size() != view_count || previous_first.size() != view_first.size();
+	if (kind_views.size() != view_count) kind_views.assign(view_count, View{});
+
+	for (uint32_t v = 0; v < view_count; ++v) {
+		View &view = kind_views[v];
+		uint32_t *begin = casters.data() + view_first[v];
+		uint32_t *end = casters.data() + view_first[v + 1];
+
+		//what changed since the map was drawn:
+		const bool moved_projection = (view.clip_from_world != clip_from_world[v]);
+		bool touched = false;
+		bool resettled = false;
+		if (!reset) {
+			uint32_t const *previous_begin = previous.data() + previous_first[v];
+			uint32_t const *previous_end = previous.data() + previous_first[v + 1];
+			touched = any_moved && (any_set(moved_bits, begin, end) || any_set(moved_bits, previous_begin, previous_end));
+			resettled = any_changed && (any_set(changed_bits, begin, end) || any_set(changed_bits, previous_begin, previous_end));
+		}
+
+		view.draw_static = split && (reset || moved_projection || !view.static_valid || resettled);
+		view.draw = reset || moved_projection || !view.valid || touched || view.draw_static;
+		view.valid = true;
+		view.static_valid = split;
+		view.clip_from_world = clip_from_world[v];
+
+		//static casters first (keeping their order), then dynamic ones:
+		view.dynamic_first = view_first[v + 1];
+		if (split && !dynamic_items.empty()) {
+			dynamic_scratch.clear();
+			uint32_t *kept = begin;
+			for (uint32_t *item = begin; item != end; ++item) {
+				if (dynamic_bits[*item / 64] & (uint64_t(1) << (*item % 64))) dynamic_scratch.emplace_back(*item);
+				else *kept++ = *item;
+			}
+			std::copy(dynamic_scratch.begin(), dynamic_scratch.end(), kept);
+			view.dynamic_first = uint32_t(kept - casters.data());
+		}
+
+		last.views += 1;
+		if (view.draw) last.drawn += 1;
+		if (view.draw_static) last.static_drawn += 1;
+	}
+
+	previous_casters[kind].assign(casters.begin(), casters.end());
+	previous_view_first[kind].assign(view_first.begin(), view_first.end());
+
+	total.views += last.views;
+	total.drawn += last.drawn;
+	total.static_drawn += last.static_drawn;
+}
+
+void ShadowCache::invalidate() {
+	for (std::vector< View > &kind_views : views) kind_views.clear();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+//Keeps shadow maps from being redrawn while nothing they show changes.
+// - a shadow view (sun cascade, sphere face or spot light) stays valid until its clip_from_world matrix changes
+//   (compared exactly: sun cascades are texel-snapped, but follow the camera) or an item among its casters moves,
+//   counting both this update's casters and the previous update's (so items that leave a view also redraw it);
+//   a change to the scene's structure invalidates every view
+// - split mode also keeps a static map per view, holding only its static casters; items that moved within the
+//   last dynamic_frames updates are dynamic, and a view with dynamic casters is redrawn as a copy of its static
+//   map with them drawn on top, so a moving item doesn't redraw the whole scene into every map it touches;
+//   the static map itself is redrawn when the projection changes or one of its casters turns dynamic or settles
+// - views are numbered like LightsManager::ShadowCasters' views, one list per kind of light
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ShadowCache {
+	enum Kind : uint32_t {
+		Sun = 0,
+		Sphere = 1,
+		Spot = 2,
+	};
+	static constexpr uint32_t KindCount = 3;
+
+	//updates an item stays dynamic after it last moved (split mode):
+	uint32_t dynamic_frames = 30;
+
+	struct View {
+		bool valid = false; //the map holds this view, drawn with clip_from_world
+		bool static_valid = false; //(split mode) the static map holds its static casters
+		glm::mat4 clip_from_world = glm::mat4(0.0f);
+
+		//what the last update_views decided:
+		bool draw = true; //the map must be drawn (otherwise it is left as it is)
+		bool draw_static = false; //(split mode) the static map must be drawn first, from casters first .. dynamic_first - 1
+		uint32_t dynamic_first = 0; //casters from here to the end of the view are dynamic (none unless split)
+	};
+	std::array< std::vector< View >, KindCount > views;
+
+	//start an update: 'moved' lists items whose transforms changed since the last one, 'all_moved' means any may have
+	//  (e.g. the scene was rebuilt, which also makes every item static again); 'split' chooses split mode
+	void begin_update(bool split, std::vector< uint32_t > const &moved, bool all_moved, size_t item_count);
+
+	//decide which views of one kind to draw this update, given each view's clip_from_world and its casters (items,
+	//  listed view after view, view v's starting at view_first[v], like LightsManager::ShadowCasters);
+	//  in split mode each view's casters are reordered, static ones first
+	void update_views(Kind kind, std::vector< glm::mat4 > const &clip_from_world,
+		std::vector< uint32_t > &casters, std::vector< uint32_t > const &view_first);
+
+	//forget every map (e.g. because the images were re-created):
+	void invalidate();
+
+	//counts for the last update and since the cache was created:
+	struct Stats {
+		uint64_t views = 0; //views updated
+		uint64_t drawn = 0; //views whose map was drawn
+		uint64_t static_drawn = 0; //(split mode) views whose static map was drawn
+
+		//fraction of views left as they were:
+		double hit_rate() const { return (views ? double(views - drawn) / double(views) : 0.0); }
+	};
+	Stats last;
+	Stats total;
+
+private:
+	bool split = false;
+	bool all_moved = true;
+	uint32_t frame = 0;
+
+	std::vector< uint64_t > moved_bits; //per item: moved this update
+	std::vector< uint64_t > changed_bits; //per item: (split mode) turned dynamic or static this update
+	std::vector< uint64_t > dynamic_bits; //per item: (split mode) moved within dynamic_frames updates
+	std::vector< uint32_t > last_moved; //per item: frame it last moved, for dynamic items
+	std::vector< uint32_t > dynamic_items;
+	bool any_moved = false;
+	bool any_changed = false;
+
+	//each kind's casters as of the previous update:
+	std::array< std::vector< uint32_t >, KindCount > previous_casters;
+	std::array< std::vector< uint32_t >, KindCount > previous_view_first;
+
+	std::vector< uint32_t > dynamic_scratch;
+};
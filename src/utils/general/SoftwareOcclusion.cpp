@@ -0,0 +1,253 @@
+#include "SoftwareOcclusion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_OCCLUSION_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+	//pixel coordinates (x right, y down the rows) and depth of a clip-space point in front of the near plane:
+	glm::vec3 to_screen(glm::vec4 const &clip) {
+		const float inv_w = 1.0f / clip.w;
+		return glm::vec3(
+			(clip.x * inv_w * 0.5f + 0.5f) * float(SoftwareOcclusion::Width),
+			(clip.y * inv_w * 0.5f + 0.5f) * float(SoftwareOcclusion::Height),
+			clip.z * inv_w
+		);
+	}
+
+	//first and one-past-last pixel whose center lies in [min, max], clamped to [0, size]:
+	void center_span(float min, float max, uint32_t size, uint32_t &begin, uint32_t &end) {
+		begin = uint32_t(std::clamp(std::ceil(min - 0.5f), 0.0f, float(size)));
+		end = uint32_t(std::clamp(std::floor(max - 0.5f) + 1.0f, 0.0f, float(size)));
+	}
+
+	//depth = min(depth, triangle depth) for the pixels of row 'row' in [x_begin, x_end) whose centers
+	//  are inside the triangle; x_begin is a multiple of 4 and x_end <= Width, so groups of 4 stay in the row
+	template< typename Triangle >
+	void fill_span(float *row, uint32_t x_begin, uint32_t x_end, float y, Triangle const &tri) {
+#if defined(SOFTWARE_OCCLUSION_SIMD)
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 a[3], row_c[3];
+		for (int e = 0; e < 3; ++e) {
+			a[e] = _mm_set1_ps(tri.edge[e].x);
+			row_c[e] = _mm_set1_ps(tri.edge[e].y * y + tri.edge[e].z);
+		}
+		const __m128 depth_a = _mm_set1_ps(tri.depth.x);
+		const __m128 depth_c = _mm_set1_ps(tri.depth.y * y + tri.depth.z);
+		for (uint32_t x = x_begin; x < x_end; x += 4) {
+			const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[0], px), row_c[0]), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[1], px), row_c[1]), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[2], px), row_c[2]), zero));
+			if (_mm_movemask_ps(inside) == 0) continue;
+			const __m128 z = _mm_add_ps(_mm_mul_ps(depth_a, px), depth_c);
+			const __m128 old = _mm_loadu_ps(row + x);
+			const __m128 nearest = _mm_min_ps(old, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+#else
+		//(same operations as the SIMD path, one pixel at a time)
+		for (uint32_t x = x_begin; x < x_end; ++x) {
+			const float px = float(x) + 0.5f;
+			bool inside = true;
+			for (int e = 0; e < 3; ++e) {
+				inside = inside && (tri.edge[e].x * px + (tri.edge[e].y * y + tri.edge[e].z) >= 0.0f);
+			}
+			if (!inside) continue;
+			row[x] = std::min(row[x], tri.depth.x * px + (tri.depth.y * y + tri.depth.z));
+		}
+#endif
+	}
+
+	//true if any of the pixels in [x_begin, x_end) of 'row' has depth >= z (x_begin a multiple of 4, x_end <= Width):
+	bool any_at_or_behind(float const *row, uint32_t x_begin, uint32_t x_end, float z) {
+#if defined(SOFTWARE_OCCLUSION_SIMD)
+		const __m128 box_z = _mm_set1_ps(z);
+		for (uint32_t x = x_begin; x < x_end; x += 4) {
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), box_z)) != 0) return true;
+		}
+		return false;
+#else
+		for (uint32_t x = x_begin; x < x_end; ++x) {
+			if (row[x] >= z) return true;
+		}
+		return false;
+#endif
+	}
+}
+
+void SoftwareOcclusion::render(glm::mat4 const &clip_from_world_, std::vector< Occluder > const &occluders, JobSystem &jobs) {
+	clip_from_world = clip_from_world_;
+
+	//clip and set up each occluder's triangles:
+	occluder_triangles.resize(occluders.size());
+	jobs.parallel_for(occluders.size(), 1, [&](size_t, size_t begin, size_t end) {
+		for (size_t o = begin; o < end; ++o) {
+			occluder_triangles[o].clear();
+			setup_occluder(occluders[o], occluder_triangles[o]);
+		}
+	});
+	triangles = 0;
+	for (auto const &list : occluder_triangles) {
+		triangles += list.size();
+	}
+
+	//every band clears and fills its own rows:
+	jobs.parallel_for(Height, BandHeight, [&](size_t, size_t begin, size_t end) {
+		rasterize_band(uint32_t(begin), uint32_t(end));
+	});
+	empty = (triangles == 0);
+}
+
+void SoftwareOcclusion::setup_occluder(Occluder const &occluder, std::vector< ScreenTriangle > &out) const {
+	const glm::mat4 clip_from_local = clip_from_world * occluder.world_from_local;
+	std::vector< glm::vec3 > const &positions = *occluder.positions;
+
+	auto add = [&](glm::vec3 const &a, glm::vec3 b, glm::vec3 c) {
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (!(std::abs(area) > 1e-8f)) return; //(also rejects NaN)
+		if (area < 0.0f) { //both facings occlude; wind every triangle the same way
+			std::swap(b, c);
+			area = -area;
+		}
+
+		ScreenTriangle tri;
+		tri.min = glm::min(glm::vec2(a), glm::min(glm::vec2(b), glm::vec2(c)));
+		tri.max = glm::max(glm::vec2(a), glm::max(glm::vec2(b), glm::vec2(c)));
+		if (tri.max.x < 0.0f || tri.min.x > float(Width) || tri.max.y < 0.0f || tri.min.y > float(Height)) return;
+
+		//edge (p, q) is positive on the side of the third vertex:
+		auto edge = [](glm::vec3 const &p, glm::vec3 const &q) {
+			return glm::vec3(p.y - q.y, q.x - p.x, p.x * q.y - p.y * q.x);
+		};
+		tri.edge[0] = edge(a, b);
+		tri.edge[1] = edge(b, c);
+		tri.edge[2] = edge(c, a);
+
+		const float inv_area = 1.0f / area;
+		tri.depth.x = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) * inv_area;
+		tri.depth.y = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) * inv_area;
+		tri.depth.z = a.z - tri.depth.x * a.x - tri.depth.y * a.y;
+		out.emplace_back(tri);
+	};
+
+	for (size_t t = 0; t + 2 < positions.size(); t += 3) {
+		glm::vec4 clip[3];
+		for (int k = 0; k < 3; ++k) {
+			clip[k] = clip_from_local * glm::vec4(positions[t + k], 1.0f);
+		}
+
+		//entirely outside one side of the view volume:
+		auto all = [&](auto const &outside) {
+			return outside(clip[0]) && outside(clip[1]) && outside(clip[2]);
+		};
+		if (all([](glm::vec4 const &v) { return v.x > v.w; })) continue;
+		if (all([](glm::vec4 const &v) { return v.x < -v.w; })) continue;
+		if (all([](glm::vec4 const &v) { return v.y > v.w; })) continue;
+		if (all([](glm::vec4 const &v) { return v.y < -v.w; })) continue;
+		if (all([](glm::vec4 const &v) { return v.z > v.w; })) continue;
+		if (all([](glm::vec4 const &v) { return v.z < 0.0f; })) continue;
+
+		//clip against the near plane (z >= 0), leaving a triangle or a quad:
+		glm::vec3 polygon[4];
+		uint32_t corners = 0;
+		for (int k = 0; k < 3; ++k) {
+			glm::vec4 const &p = clip[k];
+			glm::vec4 const &q = clip[(k + 1) % 3];
+			if (p.z >= 0.0f) polygon[corners++] = to_screen(p);
+			if ((p.z >= 0.0f) != (q.z >= 0.0f)) {
+				const float s = p.z / (p.z - q.z);
+				polygon[corners++] = to_screen(p + (q - p) * s);
+			}
+		}
+		for (uint32_t k = 1; k + 1 < corners; ++k) {
+			add(polygon[0], polygon[k], polygon[k + 1]);
+		}
+	}
+}
+
+void SoftwareOcclusion::rasterize_band(uint32_t y_begin, uint32_t y_end) {
+	std::fill(depth.begin() + size_t(y_begin) * Width, depth.begin() + size_t(y_end) * Width, 1.0f);
+
+	for (auto const &list : occluder_triangles) {
+		for (ScreenTriangle const &tri : list) {
+			uint32_t row_begin, row_end;
+			center_span(tri.min.y, tri.max.y, Height, row_begin, row_end);
+			row_begin = std::max(row_begin, y_begin);
+			row_end = std::min(row_end, y_end);
+			if (row_begin >= row_end) continue;
+
+			uint32_t x_begin, x_end;
+			center_span(tri.min.x, tri.max.x, Width, x_begin, x_end);
+			if (x_begin >= x_end) continue;
+			x_begin &= ~3u;
+
+			for (uint32_t y = row_begin; y < row_end; ++y) {
+				fill_span(&depth[size_t(y) * Width], x_begin, x_end, float(y) + 0.5f, tri);
+			}
+		}
+	}
+}
+
+bool SoftwareOcclusion::is_box_visible(glm::vec3 const &min, glm::vec3 const &max) const {
+	if (empty) return true;
+
+	glm::vec2 rect_min(std::numeric_limits< float >::max());
+	glm::vec2 rect_max(std::numeric_limits< float >::lowest());
+	float nearest = std::numeric_limits< float >::max();
+	for (uint32_t corner = 0; corner < 8; ++corner) {
+		const glm::vec4 clip = clip_from_world * glm::vec4(
+			(corner & 1 ? max.x : min.x),
+			(corner & 2 ? max.y : min.y),
+			(corner & 4 ? max.z : min.z),
+			1.0f
+		);
+		if (!(clip.z >= 0.0f)) return true; //box reaches past the near plane
+		const glm::vec3 screen = to_screen(clip);
+		rect_min = glm::min(rect_min, glm::vec2(screen));
+		rect_max = glm::max(rect_max, glm::vec2(screen));
+		nearest = std::min(nearest, screen.z);
+	}
+
+	//every pixel the rectangle touches (widened to groups of 4 pixels, which only makes the test more conservative):
+	const uint32_t x_begin = uint32_t(std::clamp(std::floor(rect_min.x), 0.0f, float(Width))) & ~3u;
+	const uint32_t x_end = (uint32_t(std::clamp(std::ceil(rect_max.x), 0.0f, float(Width))) + 3u) & ~3u;
+	const uint32_t y_begin = uint32_t(std::clamp(std::floor(rect_min.y), 0.0f, float(Height)));
+	const uint32_t y_end = uint32_t(std::clamp(std::ceil(rect_max.y), 0.0f, float(Height)));
+	if (x_begin >= x_end || y_begin >= y_end) return true; //off screen; that's for frustum culling to decide
+
+	for (uint32_t y = y_begin; y < y_end; ++y) {
+		if (any_at_or_behind(&depth[size_t(y) * Width], x_begin, x_end, nearest)) return true;
+	}
+	return false;
+}
+
+void SoftwareOcclusion::save_pgm(std::string const &path) const {
+	//depth is stretched so the nearest pixel is black and empty pixels are white:
+	float nearest = 1.0f;
+	for (float d : depth) {
+		nearest = std::min(nearest, d);
+	}
+	const float scale = (nearest < 1.0f ? 255.0f / (1.0f - nearest) : 0.0f);
+
+	std::vector< uint8_t > pixels(depth.size());
+	for (size_t i = 0; i < depth.size(); ++i) {
+		pixels[i] = uint8_t(std::clamp((depth[i] - nearest) * scale, 0.0f, 255.0f) + 0.5f);
+		if (depth[i] >= 1.0f) pixels[i] = 255;
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	out << "P5\n" << Width << " " << Height << "\n255\n";
+	out.write(reinterpret_cast< char const * >(pixels.data()), std::streamsize(pixels.size()));
+	if (!out) {
+		throw std::runtime_error("Failed to write occlusion depth image '" + path + "'.");
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+//Software occlusion culling on the CPU, for the CPU culling path.
+// - a few large occluders are rasterized into a small depth buffer (nearest depth per pixel,
+//   sampled at pixel centers), with row bands filled in parallel and 4 pixels per step
+// - instance boxes are then tested against it: a box is hidden if its nearest depth is behind
+//   the buffer at every pixel its screen rectangle touches
+// - depth is clip z / w for a [0, 1] (not reversed) depth range, so 1 is empty
+
+#include "BVH.hpp"
+#include "JobSystem.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SoftwareOcclusion {
+	static constexpr uint32_t Width = 256; //(a multiple of 4)
+	static constexpr uint32_t Height = 128;
+	static constexpr uint32_t BandHeight = 8; //rows per rasterization job
+
+	struct Occluder {
+		std::vector< glm::vec3 > const *positions; //triangle list, three vertices per triangle
+		glm::mat4 world_from_local;
+	};
+
+	//clear the buffer and rasterize 'occluders' as seen through 'clip_from_world':
+	void render(glm::mat4 const &clip_from_world, std::vector< Occluder > const &occluders, JobSystem &jobs);
+
+	//false if the box is certainly hidden behind the occluders of the last render() (world space):
+	bool is_box_visible(glm::vec3 const &min, glm::vec3 const &max) const;
+
+	//write the depth buffer as a binary PGM (near is dark, empty is white):
+	void save_pgm(std::string const &path) const;
+
+	size_t triangle_count() const { return triangles; } //rasterized by the last render()
+
+	std::vector< float > const &depth_buffer() const { return depth; } //Width x Height, row-major, top row first
+
+private:
+	struct ScreenTriangle {
+		glm::vec2 min, max; //pixel bounds
+		glm::vec3 edge[3]; //edge functions (a, b, c): a x + b y + c >= 0 inside
+		glm::vec3 depth; //depth plane: depth.x x + depth.y y + depth.z
+	};
+
+	glm::mat4 clip_from_world = glm::mat4(1.0f);
+	std::vector< float > depth = std::vector< float >(size_t(Width) * Height, 1.0f); //row-major, top row first
+	std::vector< std::vector< ScreenTriangle > > occluder_triangles; //per occluder of the last render()
+	size_t triangles = 0;
+	bool empty = true; //nothing was rasterized, so everything is visible
+
+	void setup_occluder(Occluder const &occluder, std::vector< ScreenTriangle > &out) const;
+	void rasterize_band(uint32_t y_begin, uint32_t y_end);
+};
@@ -81,4 +81,16 @@ enum ToneMapMethod : uint32_t {
     ACES = 1
 };
 
+enum OcclusionCullingMode : uint32_t {
+    Disabled = 0,
+    LastFrame = 1, // test against the previous frame's depth pyramid (objects can pop in for a frame)
+    TwoPhase = 2 // draw what was visible last frame, then test everything else against this frame's depth
+};
+
+enum ShadowCacheMode : uint32_t {
+    NoShadowCache = 0,
+    StaticShadowCache = 1, // keep each shadow map until its projection or one of its casters changes
+    SplitShadowCache = 2 // also keep a map of each view's static casters, and draw only moving casters over a copy of it
+};
+
 inline std::unordered_map<std::string, uint32_t> pipeline_name_to_index; //map pipeline names to indices
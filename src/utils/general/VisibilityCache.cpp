@@ -0,0 +1,80 @@
+#include "VisibilityCache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+	//world-space eye of a rigid world-to-view matrix:
+	glm::vec3 eye_of(glm::mat4 const &view) {
+		return -(glm::transpose(glm::mat3(view)) * glm::vec3(view[3]));
+	}
+}
+
+bool VisibilityCache::covers(glm::mat4 const &perspective, glm::mat4 const &view) const {
+	if (!valid || perspective != cached_perspective) return false;
+	if (glm::length(eye_of(view) - eye_of(cached_view)) > max_translation) return false;
+
+	//angle of the rotation between the two views, from trace(R R_cached^T) = 1 + 2 cos(angle):
+	float trace = 0.0f;
+	for (int c = 0; c < 3; ++c) {
+		trace += glm::dot(glm::vec3(view[c]), glm::vec3(cached_view[c]));
+	}
+	return 0.5f * (trace - 1.0f) >= std::cos(max_rotation);
+}
+
+void VisibilityCache::cull(BVH const &bvh, CameraManager::Frustum const &frustum, glm::mat4 const &perspective, glm::mat4 const &view,
+	std::vector< uint32_t > const &moved, bool all_changed, std::vector< uint64_t > &visible) {
+	last = Stats{};
+	last.items = bvh.size();
+
+	const size_t words = (bvh.size() + 63) / 64;
+	const bool rebuild = all_changed
+		|| inside.size() != words
+		|| !covers(perspective, view)
+		|| dirty_items.size() + moved.size() > std::max< size_t >(straddling.size(), 64); //(then retesting moved items costs more than the boundary)
+
+	if (rebuild) {
+		valid = true;
+		cached_perspective = perspective;
+		cached_view = view;
+		bvh.classify_for_motion(frustum, eye_of(view), max_translation, max_rotation, inside, straddling);
+		straddling_boxes.resize(straddling.size());
+		for (size_t k = 0; k < straddling.size(); ++k) {
+			BVH::Box const &box = bvh.item_bounds(straddling[k]);
+			straddling_boxes.set(k, box.min, box.max, glm::mat4(1.0f));
+		}
+		dirty.assign(words, 0);
+		dirty_items.clear();
+		last.tested = last.items;
+		last.rebuilds = 1;
+	} else {
+		for (uint32_t i : moved) {
+			if (dirty[i / 64] & (uint64_t(1) << (i % 64))) continue;
+			dirty[i / 64] |= uint64_t(1) << (i % 64);
+			dirty_items.emplace_back(i);
+		}
+	}
+
+	//cached answers, then the items that need a fresh test:
+	visible = inside;
+	frustum.are_boxes_visible(straddling_boxes, straddling_visible);
+	for (size_t word = 0; word < straddling_visible.size(); ++word) {
+		for (uint64_t bits = straddling_visible[word]; bits != 0; bits &= bits - 1) {
+			const uint32_t i = straddling[word * 64 + size_t(std::countr_zero(bits))];
+			visible[i / 64] |= uint64_t(1) << (i % 64);
+		}
+	}
+	//(moved items go last, since their boxes in straddling_boxes may be stale)
+	for (uint32_t i : dirty_items) {
+		BVH::Box const &box = bvh.item_bounds(i);
+		const uint64_t bit = uint64_t(1) << (i % 64);
+		if (frustum.is_box_visible(box.min, box.max)) visible[i / 64] |= bit;
+		else visible[i / 64] &= ~bit;
+	}
+	if (!rebuild) last.tested = straddling.size() + dirty_items.size();
+
+	total.items += last.items;
+	total.tested += last.tested;
+	total.rebuilds += last.rebuilds;
+}
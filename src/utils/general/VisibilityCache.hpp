@@ -0,0 +1,55 @@
+#pragma once
+
+//Frame-to-frame cache of BVH frustum culling results, for cameras that move a little and scenes that mostly don't.
+// - a rebuild classifies every item against all cameras within max_translation / max_rotation of the current one:
+//   items that pass the frustum test for all of them are cached as visible, items that fail for all as hidden,
+//   and only the items in between (near the frustum boundary) are tested again while the cache is used
+// - items reported as moved are tested every frame until the next rebuild
+// - the items in between are few but not grouped in the BVH, so they are kept as a BoxBatch and tested 4-16 at a time
+// - the result is always the same as BVH::cull's for the current frustum
+
+#include "BVH.hpp"
+#include "CameraManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct VisibilityCache {
+	//how far the camera may get from the one the cache was built for:
+	float max_translation = 0.5f; //world units
+	float max_rotation = 0.035f; //radians
+
+	//cull 'bvh' against 'frustum' (the frustum of perspective * view) into 'visible' (one bit per item, like BVH::cull);
+	//  'moved' lists items whose bounds changed since the last call, 'all_changed' means the BVH was rebuilt
+	void cull(BVH const &bvh, CameraManager::Frustum const &frustum, glm::mat4 const &perspective, glm::mat4 const &view,
+		std::vector< uint32_t > const &moved, bool all_changed, std::vector< uint64_t > &visible);
+
+	//counts for the last cull() and since the cache was created:
+	struct Stats {
+		uint64_t items = 0; //items culled
+		uint64_t tested = 0; //items whose frustum test actually ran (all of them on rebuilds)
+		uint64_t rebuilds = 0;
+
+		//fraction of items answered from the cache:
+		double hit_rate() const { return (items ? double(items - tested) / double(items) : 0.0); }
+	};
+	Stats last;
+	Stats total;
+
+private:
+	bool valid = false;
+	glm::mat4 cached_perspective = glm::mat4(1.0f);
+	glm::mat4 cached_view = glm::mat4(1.0f);
+
+	std::vector< uint64_t > inside; //per item: visible from every camera the cache covers
+	std::vector< uint32_t > straddling; //items tested every frame
+	CameraManager::BoxBatch straddling_boxes; //their bounds (as of the rebuild), tested in SIMD batches
+	std::vector< uint64_t > straddling_visible; //(scratch) one bit per straddling entry
+	std::vector< uint64_t > dirty; //per item: moved since the rebuild
+	std::vector< uint32_t > dirty_items;
+
+	bool covers(glm::mat4 const &perspective, glm::mat4 const &view) const;
+};
@@ -1,87 +1,321 @@
 #include "sejp.hpp"
 
+#include "MappedFile.hpp"
+
 #include <stdexcept>
+#include <algorithm>
 #include <cassert>
-#include <iostream>
-#include <fstream>
-#include <sstream>
 #include <charconv>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SEJP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SEJP_TARGET_AVX2
+#else
+#define SEJP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifdef __APPLE__
+#include <sstream>
+#include <locale>
+#endif
 
 namespace sejp {
 
-struct parsed {
-	std::vector< std::optional< std::string > > strings;
-	std::vector< std::optional< double > > numbers;
-	//(nothing to store for booleans and nulls)
-	std::vector< std::optional< std::vector< value > > > arrays;
-	std::vector< std::optional< std::map< std::string, value > > > objects;
+enum Types : uint32_t {
+	String        = 0, //text is a range of source
+	EscapedString = 1, //text is a range of parsed::unescaped
+	Number        = 2,
+	True          = 3,
+	False         = 4,
+	Null          = 5,
+	Object        = 6,
+	Array         = 7,
 };
 
-enum Masks : uint32_t {
-	TypeBits  = 0xe0000000,
-	IndexBits = 0x1fffffff
+//one entry of the tape:
+// - scalars take one entry
+// - arrays and objects take a header entry followed by their contents
+// - object contents alternate key (a string entry) and value
+struct node {
+	uint32_t type;
+	uint32_t next; //tape index just past this value (and its contents)
+	union {
+		double number;
+		struct { uint32_t offset, length; } text;
+		uint32_t count; //elements (Array) or members (Object)
+	} as;
 };
+static_assert(sizeof(node) == 16, "tape entries are kept small.");
 
-enum Types : uint32_t {
-	String  = 0x00000000,
-	Number  = 0x20000000,
-	True    = 0x40000000,
-	False   = 0x60000000,
-	Null    = 0x80000000,
-	Object  = 0xa0000000,
-	Array   = 0xc0000000,
-	Empty   = 0xe0000000, //<--- used during parsing
+struct parsed {
+	//backing storage for source (one of these is set):
+	std::shared_ptr< MappedFile const > file;
+	std::string owned;
+
+	std::string_view source;
+	std::string unescaped; //contents of strings that needed un-escaping
+	std::vector< node > tape;
+
+	std::string_view text(node const &n) const {
+		if (n.type == String) return source.substr(n.as.text.offset, n.as.text.length);
+		assert(n.type == EscapedString);
+		return std::string_view(unescaped).substr(n.as.text.offset, n.as.text.length);
+	}
 };
 
-value parse(std::istream &from) {
-	//helpers to read from string:
+namespace {
+
+//------------------------------------------
+//stage 1: find structural characters.
+//
+//Input is classified 64 bytes at a time into bitmasks (with SSE2, AVX2,
+//or plain byte compares), strings are masked out with a prefix-xor over
+//unescaped quotes, and the positions of structural characters, opening
+//quotes, and the first character of every other token (numbers, literals,
+//junk) are appended to an index that stage 2 walks.
+
+struct BlockMasks {
+	uint64_t quote = 0;
+	uint64_t backslash = 0;
+	uint64_t op = 0; //one of {}[]:,
+	uint64_t ws = 0; //one of ' ', \t, \n, \r
+};
+
+using ClassifyFn = void (*)(char const *block, BlockMasks &masks);
+
+void classify_scalar(char const *block, BlockMasks &masks) {
+	masks = BlockMasks{};
+	for (uint32_t i = 0; i < 64; ++i) {
+		uint64_t bit = uint64_t(1) << i;
+		switch (block[i]) {
+			case '"': masks.quote |= bit; break;
+			case '\\': masks.backslash |= bit; break;
+			case '{': case '}': case '[': case ']': case ':': case ',': masks.op |= bit; break;
+			case ' ': case '\t': case '\n': case '\r': masks.ws |= bit; break;
+			default: break;
+		}
+	}
+}
+
+#ifdef SEJP_X86
+
+void classify_sse2(char const *block, BlockMasks &masks) {
+	masks = BlockMasks{};
+	for (uint32_t i = 0; i < 4; ++i) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const * >(block + 16 * i));
+		//'[' | 0x20 == '{' and ']' | 0x20 == '}':
+		__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i op = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(',')))
+		);
+		__m128i ws = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')))
+		);
+		uint32_t shift = 16 * i;
+		masks.quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))))) << shift;
+		masks.backslash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))))) << shift;
+		masks.op |= uint64_t(uint16_t(_mm_movemask_epi8(op))) << shift;
+		masks.ws |= uint64_t(uint16_t(_mm_movemask_epi8(ws))) << shift;
+	}
+}
+
+SEJP_TARGET_AVX2
+void classify_avx2(char const *block, BlockMasks &masks) {
+	masks = BlockMasks{};
+	for (uint32_t i = 0; i < 2; ++i) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(block + 32 * i));
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i op = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')))
+		);
+		__m256i ws = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')))
+		);
+		uint32_t shift = 32 * i;
+		masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))))) << shift;
+		masks.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))))) << shift;
+		masks.op |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << shift;
+		masks.ws |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << shift;
+	}
+}
+
+bool cpu_has_avx2() {
+	#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 6) != 6) return false; //OS saves ymm state
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+	#else
+	return __builtin_cpu_supports("avx2");
+	#endif
+}
+
+#endif //SEJP_X86
+
+ClassifyFn pick_classify(Scan scan) {
+	#ifdef SEJP_X86
+	static const bool has_avx2 = cpu_has_avx2();
+	if (scan == Scan::Auto) scan = (has_avx2 ? Scan::AVX2 : Scan::SSE2);
+	if (scan == Scan::AVX2) {
+		if (!has_avx2) throw std::runtime_error("sejp: AVX2 scanning is not supported on this CPU.");
+		return classify_avx2;
+	}
+	if (scan == Scan::SSE2) return classify_sse2;
+	#else
+	if (scan == Scan::Auto) scan = Scan::Scalar;
+	if (scan != Scan::Scalar) throw std::runtime_error("sejp: SIMD scanning is not supported on this architecture.");
+	#endif
+	return classify_scalar;
+}
+
+//bits set from each bit up to (not including) the next set bit; i.e., "inside quotes":
+uint64_t prefix_xor(uint64_t bits) {
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
+
+uint32_t count_trailing_zeros(uint64_t bits) {
+	#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return uint32_t(index);
+	#else
+	return uint32_t(__builtin_ctzll(bits));
+	#endif
+}
+
+struct Stage1 {
+	static constexpr size_t ChunkBytes = 64 * 1024; //bytes classified per refill (keeps the index in cache)
+
+	char const *begin;
+	size_t size;
+	ClassifyFn classify;
+
+	size_t offset = 0; //next byte to classify
+
+	//state carried between blocks:
+	bool prev_escaped = false; //first byte of next block follows an unescaped backslash
+	uint64_t prev_in_string = 0; //all ones if next block starts inside a string
+	uint64_t prev_scalar = 0; //1 if last byte of previous block was part of a token
+
+	Stage1(std::string_view source, Scan scan) : begin(source.data()), size(source.size()), classify(pick_classify(scan)) { }
+
+	bool done() const { return offset >= size; }
 
-	auto skip_wsp = [&from]() {
-		for(;;) {
-			std::istream::int_type c = from.peek();
-			if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
-				from.get();
+	//classify the next chunk of input, replacing 'index' with the structural positions found:
+	void refill(std::vector< uint32_t > &index) {
+		index.clear();
+		size_t chunk_end = std::min(size, offset + ChunkBytes);
+		while (offset < chunk_end) {
+			BlockMasks masks;
+			if (offset + 64 <= size) {
+				classify(begin + offset, masks);
 			} else {
-				break;
+				//last partial block is padded with whitespace:
+				char padded[64];
+				std::memset(padded, ' ', sizeof(padded));
+				std::memcpy(padded, begin + offset, size - offset);
+				classify(padded, masks);
+			}
+
+			uint64_t escaped = 0;
+			if (masks.backslash != 0 || prev_escaped) {
+				//backslashes are rare in scene files, so resolve runs bit-by-bit:
+				for (uint32_t i = 0; i < 64; ++i) {
+					if (prev_escaped) {
+						escaped |= uint64_t(1) << i;
+						prev_escaped = false;
+					} else if (masks.backslash & (uint64_t(1) << i)) {
+						prev_escaped = true;
+					}
+				}
+			}
+
+			uint64_t quotes = masks.quote & ~escaped;
+			uint64_t in_string = prefix_xor(quotes) ^ prev_in_string; //includes opening quote, excludes closing quote
+			prev_in_string = uint64_t(0) - (in_string >> 63);
+
+			uint64_t scalar = ~(masks.ws | masks.op | quotes | in_string);
+			uint64_t scalar_starts = scalar & ~((scalar << 1) | prev_scalar);
+			prev_scalar = scalar >> 63;
+
+			uint64_t structurals = (masks.op & ~in_string) | (quotes & in_string) | scalar_starts;
+			while (structurals) {
+				index.emplace_back(uint32_t(offset + count_trailing_zeros(structurals)));
+				structurals &= structurals - 1;
 			}
+
+			offset += 64;
 		}
-	};
+		if (offset > size) offset = size;
+	}
+};
 
-	auto read_char = [&from]() -> char {
-		char c;
-		if (!from.get(c)) throw std::runtime_error("parse error: unexpected EOF.");
-		return c;
-	};
-	
-	auto read_exactly = [&read_char](std::string const &expect) {
+//------------------------------------------
+//stage 2: walk the structural index, validating tokens.
+
+//reads individual tokens at p:
+struct Tokens {
+	char const *begin;
+	char const *p;
+	char const *end;
+
+	static bool is_terminator(char c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' || c == ':' || c == ']' || c == '}' || c == '[' || c == '{';
+	}
+
+	//tokens must be followed by whitespace or an operator:
+	void expect_token_end() {
+		if (p < end && !is_terminator(*p)) throw std::runtime_error(std::string("parse error: unexpected '") + *p + "' after value.");
+	}
+
+	char read_char() {
+		if (p == end) throw std::runtime_error("parse error: unexpected EOF.");
+		return *p++;
+	}
+
+	void read_exactly(std::string_view expect) {
 		for (auto e : expect) {
 			char c = read_char();
 			if (c != e) throw std::runtime_error(std::string("parse error: expected '") + e + "', got '" + c + "'.");
 		}
-	};
+	}
 
-	auto read_number = [&from,&read_char](char first) -> double {
-		std::string acc;
-		acc += first;
-	
-		if (first == '-') {
-			//advance to first digit:
-			first = read_char();
-			acc += first;
-		}
+	static bool is_digit(char c) { return '0' <= c && c <= '9'; }
 
-		auto digits = [&acc,&from]() {
-			for(;;) {
-				std::istream::int_type p = from.peek();
-				if ('0' <= p && p <= '9') {
-					acc += char(p);
-					from.get();
-				} else {
-					break;
-				}
-			}
-		};
+	void digits() {
+		while (p < end && is_digit(*p)) ++p;
+	}
 
+	//read a number starting at p:
+	double read_number() {
+		char const *start = p;
+		if (*p == '-') ++p;
+
+		char first = read_char();
 		if (first == '0') {
 			//proceed to fraction
 		} else if ('1' <= first && first <= '9') {
@@ -92,52 +326,67 @@ value parse(std::istream &from) {
 		}
 
 		//fraction:
-		if (from.peek() == '.') {
-			acc += read_char();
+		if (p < end && *p == '.') {
+			++p;
 			char c = read_char();
-			if (!('0' <= c && c <= '9')) throw std::runtime_error(std::string("parse error: wanted fraction digits, got '") + c + "'.");
-			acc += c;
+			if (!is_digit(c)) throw std::runtime_error(std::string("parse error: wanted fraction digits, got '") + c + "'.");
 			digits();
 		}
 
 		//exponent:
-		if (from.peek() == 'E' || from.peek() == 'e') {
-			acc += read_char();
-			if (from.peek() == '-' || from.peek() == '+') {
-				acc += read_char();
-			}
+		if (p < end && (*p == 'E' || *p == 'e')) {
+			++p;
+			if (p < end && (*p == '-' || *p == '+')) ++p;
 			char c = read_char();
-			if (!('0' <= c && c <= '9')) throw std::runtime_error(std::string("parse error: wanted exponent digits, got '") + c + "'.");
-			acc += c;
+			if (!is_digit(c)) throw std::runtime_error(std::string("parse error: wanted exponent digits, got '") + c + "'.");
 			digits();
 		}
 
-		double val;
+		double val = 0.0;
 		#ifdef __APPLE__
 		//parse in the default locale
 		// -- based on https://www.reddit.com/r/cpp/comments/2e68nd/stdstod_is_locale_dependant_but_the_docs_does_not/
-		std::istringstream iss(acc);
+		std::istringstream iss(std::string(start, p));
 		iss.imbue(std::locale("C"));
 		iss >> val;
 		#else
-		const char *begin = acc.data();
-		std::from_chars(begin, begin + acc.size(), val);
+		auto res = std::from_chars(start, p, val);
+		if (res.ec != std::errc()) throw std::runtime_error("parse error: number '" + std::string(start, p) + "' out of range.");
 		#endif
 		return val;
-	};
+	}
+
+	//read a string whose opening '"' has already been consumed:
+	//  (strings with escapes are decoded onto the end of 'unescaped')
+	node read_string(std::string &unescaped) {
+		node ret{};
+		char const *start = p;
+		while (p < end && *p != '"' && *p != '\\') ++p;
+		if (p == end) throw std::runtime_error("parse error: unexpected EOF.");
 
-	auto read_string = [&read_char]() -> std::string {
-		std::string ret;
+		if (*p == '"') {
+			//common case: no escapes, refer directly to source:
+			ret.type = String;
+			ret.as.text.offset = uint32_t(start - begin);
+			ret.as.text.length = uint32_t(p - start);
+			++p;
+			return ret;
+		}
+
+		//string has escapes, so decode a copy:
+		std::string &dst = unescaped;
+		size_t offset = dst.size();
+		dst.append(start, p);
 		for (char c = read_char(); c != '"'; c = read_char()) {
 			if (c == '\\') {
 				//handle escapes:
 				c = read_char();
-				if      (c == '\\' || c == '/' || c == '"') ret += c;
-				else if (c == 'b') ret += '\b';
-				else if (c == 'f') ret += '\f';
-				else if (c == 'n') ret += '\n';
-				else if (c == 'r') ret += '\r';
-				else if (c == 't') ret += '\t';
+				if      (c == '\\' || c == '/' || c == '"') dst += c;
+				else if (c == 'b') dst += '\b';
+				else if (c == 'f') dst += '\f';
+				else if (c == 'n') dst += '\n';
+				else if (c == 'r') dst += '\r';
+				else if (c == 't') dst += '\t';
 				else if (c == 'u') {
 					uint32_t value = 0;
 					for (uint32_t i = 0; i < 4; ++i) {
@@ -154,226 +403,635 @@ value parse(std::istream &from) {
 
 					//re-encode as UTF8:
 					if (value <= 0x007f) {
-						ret += char(value);
+						dst += char(value);
 					} else if (value <= 0x07ff) {
-						ret += char(0xc0 | (value >> 6));
-						ret += char(0x80 | (value & 0x3f));
+						dst += char(0xc0 | (value >> 6));
+						dst += char(0x80 | (value & 0x3f));
 					} else if (value <= 0xffff) {
-						ret += char(0xe0 | (value >> 12));
-						ret += char(0x80 | ((value >> 6) & 0x3f));
-						ret += char(0x80 | (value & 0x3f));
+						dst += char(0xe0 | (value >> 12));
+						dst += char(0x80 | ((value >> 6) & 0x3f));
+						dst += char(0x80 | (value & 0x3f));
 					} else { assert(value <= 0x10ffff);
-						ret += char(0xf0 | (value >> 18));
-						ret += char(0x80 | ((value >> 12) & 0x3f));
-						ret += char(0x80 | ((value >> 6) & 0x3f));
-						ret += char(0x80 | (value & 0x3f));
+						dst += char(0xf0 | (value >> 18));
+						dst += char(0x80 | ((value >> 12) & 0x3f));
+						dst += char(0x80 | ((value >> 6) & 0x3f));
+						dst += char(0x80 | (value & 0x3f));
 					}
 				} else {
 					throw std::runtime_error(std::string("parse error: invalid escape '\\") + c + "'.");
 				}
 			} else {
 				//plain old boring character:
-				ret += c;
+				dst += c;
 			}
 		}
+		if (dst.size() > std::numeric_limits< uint32_t >::max()) throw std::runtime_error("parser error: too much escaped text.");
+		ret.type = EscapedString;
+		ret.as.text.offset = uint32_t(offset);
+		ret.as.text.length = uint32_t(dst.size() - offset);
 		return ret;
-	};
+	}
+};
 
+//position in the source and its structural index (shared by Scanner and Reader):
+struct Cursor : Tokens {
+	Stage1 stage1;
+	Stage1 chunk_start; //stage1 as it was before the current chunk was classified (for rewinding)
+	std::vector< uint32_t > index; //structural positions from the current chunk
+	size_t cursor = 0; //next entry of index
 
-	//-------------------
-	//parsing:
+	Cursor(std::string_view source, Scan scan) : Tokens{source.data(), source.data(), source.data() + source.size()}, stage1(source, scan), chunk_start(stage1) {
+		index.reserve(Stage1::ChunkBytes / 2);
+	}
 
-	std::shared_ptr< sejp::parsed > parsed = std::make_shared< sejp::parsed >();
+	//are there structurals left?
+	bool more_structurals() {
+		while (cursor == index.size()) {
+			if (stage1.done()) return false;
+			chunk_start = stage1;
+			stage1.refill(index);
+			cursor = 0;
+		}
+		return true;
+	}
+
+	//jump to the next structural position (skipping whitespace) and read its character:
+	char next_structural() {
+		if (!more_structurals()) throw std::runtime_error("parse error: unexpected EOF.");
+		p = begin + index[cursor++];
+		return *p++;
+	}
+};
+
+//------------------------------------------
+//tape building.
+
+//scans parsed::source into parsed::tape:
+struct Scanner : Cursor {
+	parsed &out;
 
-	value root = value(parsed, -1U);
-	std::vector< uint32_t > parents; //containing maps/arrays
+	Scanner(parsed &out_, Scan scan) : Cursor(out_.source, scan), out(out_) { }
+
+	node read_string() {
+		return Tokens::read_string(out.unescaped);
+	}
+
+	uint32_t push(node const &n) {
+		if (out.tape.size() >= std::numeric_limits< uint32_t >::max()) throw std::runtime_error("parser error: too many values.");
+		uint32_t at = uint32_t(out.tape.size());
+		out.tape.emplace_back(n);
+		out.tape.back().next = at + 1;
+		return at;
+	}
 
 	//overall parsing idea:
-	//value: (target is empty)
-	// whitespace
-	//  set up next entry if target is object or array:
-	//    (only if) target is object:
-	//         '}' -> finish target, continue
+	//  (same as ever, but values are appended to the tape in document order)
+	//value:
+	// whitespace (skipped by jumping to the next structural)
+	//  set up next entry if parent is object or array:
+	//    (only if) parent is object:
+	//         '}' -> finish parent, continue
 	//         expect ',' if non-empty
-	//         '"' -> expect key, ':', push empty, fall through
-	//    (only if) target is array:
-	//         ']' -> finish target, continue
+	//         '"' -> push key, expect ':', fall through
+	//    (only if) parent is array:
+	//         ']' -> finish parent, continue
 	//         expect ',' if non-empty
-	//         push empty, fall through
-	//  now target is empty, fill with value:
-	//  '{' -> key_or_object_end [new object, set target to object, continue]
-	//  '[' -> value_or_array_end [new array, set target to array, continue]
+	//         fall through
+	//  now push a value:
+	//  '{' -> push object header, make it the parent, continue
+	//  '[' -> push array header, make it the parent, continue
 	//   '"' -> string
 	//   '-', '0'-'9' -> number
 	//   't' -> bool ("true")
 	//   'f' -> bool ("false")
 	//   'n' -> null ("null")
-	//   finish target
-
-	while (root.index == -1U || !parents.empty()) {
-		skip_wsp();
-		char c = read_char(); //first character of value
-
-		//value to be filled in later:
-		value *target = nullptr;
-
-		//figure out which value to fill in:
-		if (parents.empty()) {
-			target = &root;
-		} else if ((parents.back() & TypeBits) == Object) {
-			if (c == '}') {
-				parents.pop_back();
-				continue;
+	void scan() {
+		if (out.source.size() > std::numeric_limits< uint32_t >::max()) throw std::runtime_error("parser error: source larger than 4GB.");
+
+		//rough guess (a number plus separator is rarely shorter than this):
+		out.tape.reserve(out.source.size() / 16 + 1);
+
+		std::vector< uint32_t > parents; //containing objects/arrays
+		bool have_root = false;
+
+		while (!have_root || !parents.empty()) {
+			char c = next_structural(); //first character of value
+
+			if (parents.empty()) {
+				have_root = true;
+			} else if (out.tape[parents.back()].type == Object) {
+				if (c == '}') {
+					out.tape[parents.back()].next = uint32_t(out.tape.size());
+					parents.pop_back();
+					continue;
+				}
+				if (out.tape[parents.back()].as.count != 0) {
+					//consume comma between entries:
+					if (c != ',') throw std::runtime_error("parse error: expected ',' between object members.");
+					c = next_structural();
+				}
+				if (c != '"') throw std::runtime_error("parse error: expecting '\"' at start of key.");
+				push(read_string());
+				c = next_structural();
+				if (c != ':') throw std::runtime_error("parse error: expecting ':' after value.");
+				c = next_structural(); //actual first character of value
+				out.tape[parents.back()].as.count += 1;
+				//(fall through to value-getting code)
+			} else { assert(out.tape[parents.back()].type == Array);
+				if (c == ']') {
+					out.tape[parents.back()].next = uint32_t(out.tape.size());
+					parents.pop_back();
+					continue;
+				}
+				if (out.tape[parents.back()].as.count != 0) {
+					if (c != ',') throw std::runtime_error(std::string("parse error: expected ',' between array entries; got '") + c + "'.");
+					c = next_structural(); //actual first character of value
+				}
+				out.tape[parents.back()].as.count += 1;
+				//(fall through to value-getting code)
 			}
-			std::map< std::string, value > &map = parsed->objects.at( parents.back() & IndexBits ).value();
-			if (!map.empty()) {
-				//consume comma between entries:
-				if (c != ',') throw std::runtime_error("parse error: expected ',' between object members.");
-				skip_wsp();
-				c = read_char();
+
+			//actually push the value:
+			node n{};
+			if (c == '{') { //object
+				n.type = Object;
+				parents.emplace_back(push(n));
+			} else if (c == '[') { //array
+				n.type = Array;
+				parents.emplace_back(push(n));
+			} else if (c == '"') { //string
+				push(read_string());
+				expect_token_end();
+			} else if (c == '-' || is_digit(c)) { //number
+				--p;
+				n.type = Number;
+				n.as.number = read_number();
+				expect_token_end();
+				push(n);
+			} else if (c == 't') { //true
+				read_exactly("rue");
+				expect_token_end();
+				n.type = True;
+				push(n);
+			} else if (c == 'f') { //false
+				read_exactly("alse");
+				expect_token_end();
+				n.type = False;
+				push(n);
+			} else if (c == 'n') { //null
+				read_exactly("ull");
+				expect_token_end();
+				n.type = Null;
+				push(n);
+			} else {
+				throw std::runtime_error(std::string("parse error: value cannot start with '") + c + "'.");
 			}
-			if (c != '"') throw std::runtime_error("parse error: expecting '\"' at start of key.");
-			std::string key = read_string();
-			skip_wsp();
-			c = read_char();
-			if (c != ':') throw std::runtime_error("parse error: expecting ':' after value.");
-			skip_wsp();
-			c = read_char(); //actual first character of value
-			auto ret = map.insert_or_assign(key, value(parsed, -1U));
-			target = &ret.first->second;
-			//(fall through to value-getting code)
-		} else if ((parents.back() & TypeBits) == Array) {
+		}
+
+		if (more_structurals()) throw std::runtime_error("parse error: trailing junk.");
+	}
+};
+
+} //namespace
+
+//------------------------------------------
+
+std::optional< std::string > value::as_string() const {
+	if (auto view = as_string_view()) return std::string(*view);
+	return std::nullopt;
+}
+
+std::optional< std::string_view > value::as_string_view() const {
+	node const &n = data->tape[index];
+	if (n.type == String || n.type == EscapedString) {
+		return data->text(n);
+	} else {
+		return std::nullopt;
+	}
+}
+
+std::optional< double > value::as_number() const {
+	node const &n = data->tape[index];
+	if (n.type == Number) {
+		return n.as.number;
+	} else {
+		return std::nullopt;
+	}
+}
+
+std::optional< bool > value::as_bool() const {
+	node const &n = data->tape[index];
+	if (n.type == True) {
+		return true;
+	} else if (n.type == False) {
+		return false;
+	} else {
+		return std::nullopt;
+	}
+}
+
+std::optional< std::nullptr_t > value::as_null() const {
+	if (data->tape[index].type == Null) {
+		return nullptr;
+	} else {
+		return std::nullopt;
+	}
+}
+
+bool value::is_array() const {
+	return data->tape[index].type == Array;
+}
+
+bool value::is_object() const {
+	return data->tape[index].type == Object;
+}
+
+uint32_t value::size() const {
+	node const &n = data->tape[index];
+	if (n.type == Array || n.type == Object) return n.as.count;
+	return 0;
+}
+
+std::optional< std::vector< value > > value::as_array() const {
+	node const &n = data->tape[index];
+	if (n.type != Array) return std::nullopt;
+
+	std::vector< value > ret;
+	ret.reserve(n.as.count);
+	for (uint32_t i = index + 1; i < n.next; i = data->tape[i].next) {
+		ret.emplace_back(data, i);
+	}
+	return ret;
+}
+
+std::optional< std::map< std::string, value > > value::as_object() const {
+	node const &n = data->tape[index];
+	if (n.type != Object) return std::nullopt;
+
+	std::map< std::string, value > ret;
+	for (uint32_t i = index + 1; i < n.next; i = data->tape[i + 1].next) {
+		ret.insert_or_assign(std::string(data->text(data->tape[i])), value(data, i + 1));
+	}
+	return ret;
+}
+
+std::optional< value > value::find(std::string_view key) const {
+	node const &n = data->tape[index];
+	if (n.type != Object) return std::nullopt;
+
+	std::optional< value > ret;
+	for (uint32_t i = index + 1; i < n.next; i = data->tape[i + 1].next) {
+		if (data->text(data->tape[i]) == key) ret.emplace(data, i + 1);
+	}
+	return ret;
+}
+
+//-------------------------------
+
+value load(std::string const &filename, Scan scan) {
+	std::shared_ptr< parsed > ret = std::make_shared< parsed >();
+	ret->file = std::make_shared< MappedFile const >(filename);
+	ret->source = ret->file->bytes();
+	Scanner(*ret, scan).scan();
+	return value(ret, 0);
+}
+
+value parse(std::string const &string, Scan scan) {
+	std::shared_ptr< parsed > ret = std::make_shared< parsed >();
+	ret->owned = string;
+	ret->source = ret->owned;
+	Scanner(*ret, scan).scan();
+	return value(ret, 0);
+}
+
+uint64_t count_structurals(std::string_view json, Scan scan) {
+	Stage1 stage1(json, scan);
+	std::vector< uint32_t > index;
+	index.reserve(Stage1::ChunkBytes / 2);
+	uint64_t count = 0;
+	while (!stage1.done()) {
+		stage1.refill(index);
+		count += index.size();
+	}
+	return count;
+}
+
+//-------------------------------
+
+namespace {
+
+//numeric arrays at least this long are decoded on several threads:
+constexpr size_t ParallelNumbers = size_t(1) << 18;
+constexpr size_t NumbersPerThread = size_t(1) << 16;
+
+//decode the numbers starting at the given offsets of source:
+template< typename T >
+void decode_numbers(Tokens tokens, uint32_t const *offsets, size_t count, T *out) {
+	for (size_t i = 0; i < count; ++i) {
+		tokens.p = tokens.begin + offsets[i];
+		out[i] = static_cast< T >(tokens.read_number());
+		tokens.expect_token_end();
+	}
+}
+
+} //namespace
+
+struct Reader::State {
+	std::shared_ptr< MappedFile const > file; //keeps the source alive (if loaded from a file)
+	Cursor at;
+
+	struct Frame {
+		bool object; //else array
+		bool started = false; //has a member/element been started?
+	};
+	std::vector< Frame > frames; //containing objects/arrays
+	bool have_root = false;
+	char pending = '\0'; //first character of the next value, if already read
+
+	std::string key_text; //storage for keys that needed un-escaping
+	std::string value_text; //storage for string values that needed un-escaping
+	std::vector< uint32_t > number_offsets; //element positions, for numbers()
+
+	State(std::string_view source, Scan scan) : at(source, scan) {
+		if (source.size() > std::numeric_limits< uint32_t >::max()) throw std::runtime_error("parser error: source larger than 4GB.");
+	}
+
+	//(saved position, for looking ahead)
+	struct Mark {
+		Stage1 chunk_start;
+		size_t stage1_offset;
+		size_t cursor;
+		char const *p;
+		std::vector< Frame > frames;
+	};
+
+	Mark mark() const {
+		return Mark{at.chunk_start, at.stage1.offset, at.cursor, at.p, frames};
+	}
+
+	void rewind(Mark const &mark) {
+		if (at.stage1.offset != mark.stage1_offset) {
+			//index has moved on to later chunks, so re-classify the marked one:
+			at.stage1 = mark.chunk_start;
+			at.chunk_start = mark.chunk_start;
+			at.stage1.refill(at.index);
+		}
+		at.cursor = mark.cursor;
+		at.p = mark.p;
+		frames = mark.frames;
+		pending = '\0';
+	}
+
+	//first character of the next value (read if needed):
+	char next_value() {
+		if (pending == '\0') {
+			if (frames.empty()) {
+				if (have_root) throw std::runtime_error("sejp::Reader: root value was already consumed.");
+				have_root = true;
+			}
+			pending = at.next_structural();
+		}
+		return pending;
+	}
+
+	char take() {
+		char c = next_value();
+		pending = '\0';
+		return c;
+	}
+
+	std::string_view text(node const &n, std::string const &unescaped) const {
+		if (n.type == String) return std::string_view(at.begin + n.as.text.offset, n.as.text.length);
+		return std::string_view(unescaped).substr(n.as.text.offset, n.as.text.length);
+	}
+
+	//numeric arrays are read in two passes: first collect element positions
+	//from the structural index (validating separators), then decode them all
+	//in one tight loop (or several, on threads):
+	template< typename T >
+	bool numbers(std::vector< T > &out) {
+		if (take() != '[') throw std::runtime_error("parse error: expected array.");
+		frames.emplace_back(Frame{false});
+
+		number_offsets.clear();
+		bool closed = false;
+		while (true) {
+			char c = at.next_structural();
 			if (c == ']') {
-				parents.pop_back();
-				continue;
+				frames.pop_back();
+				closed = true;
+				break;
 			}
-			std::vector< value > &array = parsed->arrays.at( parents.back() & IndexBits ).value();
-			if (!array.empty()) {
+			if (frames.back().started) {
 				if (c != ',') throw std::runtime_error(std::string("parse error: expected ',' between array entries; got '") + c + "'.");
-				skip_wsp();
-				c = read_char(); //actual first character of value
+				c = at.next_structural();
 			}
-			array.emplace_back(parsed, -1U);
-			target = &array.back();
-			//(fall through to value-getting code)
+			frames.back().started = true;
+			if (c != '-' && !Tokens::is_digit(c)) {
+				pending = c; //(leave the non-number for the caller)
+				break;
+			}
+			number_offsets.emplace_back(uint32_t(at.p - 1 - at.begin));
 		}
 
-		//actually fill in the value:
-		assert(target && (target->index & TypeBits) == Empty);
-
-		if (c == '{') { //object
-			if (uint32_t(parsed->objects.size()) & ~IndexBits) throw std::runtime_error("parser error: too many objects.");
-			target->index = Object | uint32_t(parsed->objects.size());
-			parents.emplace_back(target->index);
-			parsed->objects.emplace_back(std::in_place);
-			continue;
-		} else if (c == '[') { //array
-			if (uint32_t(parsed->arrays.size()) & ~IndexBits) throw std::runtime_error("parser error: too many arrays.");
-			target->index = Array | uint32_t(parsed->arrays.size());
-			parents.emplace_back(target->index);
-			parsed->arrays.emplace_back(std::in_place);
-			continue;
-		} else if (c == '"') { //string
-			if (uint32_t(parsed->strings.size()) & ~IndexBits) throw std::runtime_error("parser error: too many strings.");
-			target->index = String | uint32_t(parsed->strings.size());
-			parsed->strings.emplace_back(read_string());
-		} else if (c == '-' || (c >= '0' && c <= '9')) { //number
-			if (uint32_t(parsed->numbers.size()) & ~IndexBits) throw std::runtime_error("parser error: too many numbers.");
-			target->index = Number | uint32_t(parsed->numbers.size());
-			parsed->numbers.emplace_back(read_number(c));
-		} else if (c == 't') { //true
-			read_exactly("rue");
-			target->index = True;
-		} else if (c == 'f') { //false
-			read_exactly("alse");
-			target->index = False;
-		} else if (c == 'n') { //null
-			read_exactly("ull");
-			target->index = Null;
+		const size_t count = number_offsets.size();
+		out.resize(count);
+		const Tokens tokens{at.begin, at.begin, at.end};
+		if (count < ParallelNumbers) {
+			decode_numbers(tokens, number_offsets.data(), count, out.data());
 		} else {
-			throw std::runtime_error(std::string("parse error: value cannot start with '") + c + "'.");
+			size_t threads = std::max< size_t >(1, std::min< size_t >(std::thread::hardware_concurrency(), count / NumbersPerThread));
+			std::vector< std::thread > workers;
+			std::vector< std::exception_ptr > errors(threads);
+			for (size_t t = 0; t < threads; ++t) {
+				size_t first = count * t / threads;
+				size_t last = count * (t + 1) / threads;
+				workers.emplace_back([&, t, first, last]() {
+					try {
+						decode_numbers(tokens, number_offsets.data() + first, last - first, out.data() + first);
+					} catch (...) {
+						errors[t] = std::current_exception();
+					}
+				});
+			}
+			for (auto &worker : workers) worker.join();
+			//report the error closest to the start of the array, as a serial decode would:
+			for (auto const &error : errors) {
+				if (error) std::rethrow_exception(error);
+			}
 		}
+		return closed;
 	}
 
-	skip_wsp();
+	Frame &top(bool object) {
+		if (frames.empty() || frames.back().object != object) {
+			throw std::runtime_error(std::string("sejp::Reader: not inside an ") + (object ? "object." : "array."));
+		}
+		return frames.back();
+	}
+};
 
-	if (from.peek() != std::iostream::traits_type::eof()) throw std::runtime_error("parse error: trailing junk.");
+Reader::Reader(std::unique_ptr< State > &&state_) : state(std::move(state_)) { }
+Reader::Reader(Reader &&) = default;
+Reader &Reader::operator=(Reader &&) = default;
+Reader::~Reader() = default;
 
-	return root;
+Reader Reader::load(std::string const &filename, Scan scan) {
+	std::shared_ptr< MappedFile const > file = std::make_shared< MappedFile const >(filename);
+	std::unique_ptr< State > state = std::make_unique< State >(file->bytes(), scan);
+	state->file = file;
+	return Reader(std::move(state));
 }
 
-//------------------------------------------
+Reader Reader::parse(std::string_view json, Scan scan) {
+	return Reader(std::make_unique< State >(json, scan));
+}
 
+Reader::Kind Reader::peek() {
+	char c = state->next_value();
+	if (c == '{') return Kind::Object;
+	if (c == '[') return Kind::Array;
+	if (c == '"') return Kind::String;
+	if (c == '-' || Tokens::is_digit(c)) return Kind::Number;
+	if (c == 't' || c == 'f') return Kind::Bool;
+	if (c == 'n') return Kind::Null;
+	throw std::runtime_error(std::string("parse error: value cannot start with '") + c + "'.");
+}
 
-std::optional< std::string > const &value::as_string() const {
-	static std::optional< std::string > const empty;
-	if ((index & TypeBits) == String) {
-		return data->strings[index & IndexBits];
-	} else {
-		return empty;
-	}
+std::string_view Reader::string() {
+	if (state->take() != '"') throw std::runtime_error("parse error: expected string.");
+	state->value_text.clear();
+	node n = state->at.read_string(state->value_text);
+	state->at.expect_token_end();
+	return state->text(n, state->value_text);
 }
 
-std::optional< double > const &value::as_number() const {
-	static std::optional< double > const empty;
-	if ((index & TypeBits) == Number) {
-		return data->numbers[index & IndexBits];
-	} else {
-		return empty;
-	}
+double Reader::number() {
+	char c = state->take();
+	if (c != '-' && !Tokens::is_digit(c)) throw std::runtime_error("parse error: expected number.");
+	--state->at.p;
+	double val = state->at.read_number();
+	state->at.expect_token_end();
+	return val;
 }
 
-std::optional< bool > const &value::as_bool() const {
-	static std::optional< bool > const true_value(true);
-	static std::optional< bool > const false_value(false);
-	static std::optional< bool > const empty;
-	if ((index & TypeBits) == True) {
-		return true_value;
-	} else if ((index & TypeBits) == False) {
-		return false_value;
+bool Reader::boolean() {
+	char c = state->take();
+	if (c == 't') {
+		state->at.read_exactly("rue");
+	} else if (c == 'f') {
+		state->at.read_exactly("alse");
 	} else {
-		return empty;
+		throw std::runtime_error("parse error: expected bool.");
 	}
+	state->at.expect_token_end();
+	return c == 't';
 }
 
-std::optional< nullptr_t > const &value::as_null() const {
-	static std::optional< nullptr_t > const null_value(nullptr);
-	static std::optional< nullptr_t > const empty;
-	if ((index & TypeBits) == Null) {
-		return null_value;
-	} else {
-		return empty;
+void Reader::null() {
+	if (state->take() != 'n') throw std::runtime_error("parse error: expected null.");
+	state->at.read_exactly("ull");
+	state->at.expect_token_end();
+}
+
+void Reader::skip() {
+	switch (peek()) {
+		case Kind::Object: {
+			begin_object();
+			std::string_view key;
+			while (next_member(key)) skip();
+			break;
+		}
+		case Kind::Array:
+			begin_array();
+			while (next_element()) skip();
+			break;
+		case Kind::String: string(); break;
+		case Kind::Number: number(); break;
+		case Kind::Bool: boolean(); break;
+		case Kind::Null: null(); break;
 	}
 }
 
-std::optional< std::vector< value > > const &value::as_array() const {
-	static std::optional< std::vector< value > > const empty;
-	if ((index & TypeBits) == Array) {
-		return data->arrays[index & IndexBits];
-	} else {
-		return empty;
+bool Reader::numbers(std::vector< float > &out) {
+	return state->numbers(out);
+}
+
+bool Reader::numbers(std::vector< double > &out) {
+	return state->numbers(out);
+}
+
+void Reader::begin_object() {
+	if (state->take() != '{') throw std::runtime_error("parse error: expected object.");
+	state->frames.emplace_back(State::Frame{true});
+}
+
+bool Reader::next_member(std::string_view &key) {
+	State::Frame &frame = state->top(true);
+	Cursor &at = state->at;
+	char c = at.next_structural();
+	if (c == '}') {
+		state->frames.pop_back();
+		return false;
+	}
+	if (frame.started) {
+		if (c != ',') throw std::runtime_error("parse error: expected ',' between object members.");
+		c = at.next_structural();
 	}
+	if (c != '"') throw std::runtime_error("parse error: expecting '\"' at start of key.");
+	state->key_text.clear();
+	key = state->text(at.read_string(state->key_text), state->key_text);
+	c = at.next_structural();
+	if (c != ':') throw std::runtime_error("parse error: expecting ':' after key.");
+	frame.started = true;
+	return true;
 }
 
-std::optional< std::map< std::string, value > > const &value::as_object() const {
-	static std::optional< std::map< std::string, value > > const empty;
-	if ((index & TypeBits) == Object) {
-		return data->objects[index & IndexBits];
-	} else {
-		return empty;
+void Reader::begin_array() {
+	if (state->take() != '[') throw std::runtime_error("parse error: expected array.");
+	state->frames.emplace_back(State::Frame{false});
+}
+
+bool Reader::next_element() {
+	State::Frame &frame = state->top(false);
+	Cursor &at = state->at;
+	char c = at.next_structural();
+	if (c == ']') {
+		state->frames.pop_back();
+		return false;
 	}
+	if (frame.started) {
+		if (c != ',') throw std::runtime_error(std::string("parse error: expected ',' between array entries; got '") + c + "'.");
+		c = at.next_structural();
+	}
+	frame.started = true;
+	state->pending = c; //(first character of the element)
+	return true;
 }
 
-//-------------------------------
+std::optional< std::string > Reader::lookahead_string(std::string_view key) {
+	state->top(true);
+	if (state->pending != '\0') throw std::runtime_error("sejp::Reader: lookahead must start between members.");
 
-value load(std::string const &filename) {
-	std::ifstream in(filename, std::ios::binary);
-	return parse(in);
+	State::Mark mark = state->mark();
+	std::optional< std::string > ret;
+	std::string_view at_key;
+	while (next_member(at_key)) {
+		if (at_key == key && peek() == Kind::String) {
+			ret = std::string(string());
+			break;
+		}
+		skip();
+	}
+	state->rewind(mark);
+	return ret;
 }
 
-value parse(std::string const &string) {
-	std::istringstream in(string, std::ios::binary);
-	return parse(in);
+void Reader::finish() {
+	if (!state->have_root || !state->frames.empty() || state->pending != '\0') {
+		throw std::runtime_error("sejp::Reader: document was not fully consumed.");
+	}
+	if (state->at.more_structurals()) throw std::runtime_error("parse error: trailing junk.");
 }
 
 } //namespace sejp
@@ -1,41 +1,141 @@
 #pragma once
 
 //A "Somewhat Eager JSON Parser" that parses and converts files
-//upon loading into some lists of numbers, objects, bools, nulls;
-//then provides a generic "value" handle to the root.
+//upon loading into a flat "tape" of values (numbers, strings, bools,
+//nulls, and array/object headers); then provides a generic "value"
+//handle to the root.
+//
+//Files are memory-mapped and scanned in place; strings without escapes
+//are kept as views into the mapping instead of being copied.
+//Scanning is two-stage: a (SIMD) pass finds structural characters, then
+//the tape is built by jumping between them.
+//
+//sejp::Reader walks the same structural index without building a tape,
+//for callers that convert values into their own structures as they go.
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <optional>
 #include <memory>
+#include <cstddef>
+#include <cstdint>
 
 namespace sejp {
 	//sejp::parsed represents the results of scanning a JSON file:
 	struct parsed;
-	
+
 	//generic value:
 	struct value {
 		//internals:
 		std::shared_ptr< parsed const > data;
-		uint32_t index; //(opaque) index data's value storage
+		uint32_t index; //(opaque) index of value in data's tape
 		value(std::shared_ptr< parsed const > const &data_, uint32_t index_) : data(data_), index(index_) { }
 
 		//interface:
 		//  NOTE: these functions take O(1) time
-		std::optional< std::string > const &as_string() const;
-		std::optional< double > const &as_number() const;
-		std::optional< bool > const &as_bool() const;
-		std::optional< nullptr_t > const &as_null() const;
-		std::optional< std::vector< value > > const &as_array() const;
-		std::optional< std::map< std::string, value > > const &as_object() const;
+		std::optional< std::string > as_string() const;
+		std::optional< double > as_number() const;
+		std::optional< bool > as_bool() const;
+		std::optional< std::nullptr_t > as_null() const;
+		//  NOTE: these functions build a container of handles; O(size) time
+		std::optional< std::vector< value > > as_array() const;
+		std::optional< std::map< std::string, value > > as_object() const;
+
+		//tape interface (no allocation):
+		//  NOTE: views remain valid as long as some value refers to data
+		std::optional< std::string_view > as_string_view() const;
+		bool is_array() const;
+		bool is_object() const;
+		uint32_t size() const; //element count of arrays, member count of objects, 0 otherwise
+		std::optional< value > find(std::string_view key) const; //O(members) lookup; last duplicate wins
+	};
+
+	//instruction set used to find structural characters:
+	//  Auto picks the widest one the CPU supports; others throw if unsupported
+	enum class Scan {
+		Auto,
+		Scalar,
+		SSE2,
+		AVX2,
 	};
 
 	//how you make values:
 	//  NOTE: O(length of data) time, space.
-	//  NOTE: loaded data is retained via shared_ptr until values referring to it go out of scope
+	//  NOTE: loaded data (and the file mapping) is retained via shared_ptr until values referring to it go out of scope
+	//  NOTE: throws on parse error
+	value load(std::string const &filename, Scan scan = Scan::Auto);
+	value parse(std::string const &string, Scan scan = Scan::Auto);
+
+	//runs only the structural scan (no validation) and returns the number of structurals found:
+	//  (used to benchmark the scanning backends)
+	uint64_t count_structurals(std::string_view json, Scan scan = Scan::Auto);
+
+	//streaming interface:
+	//  walks the document once, in order, without building a tape; the caller
+	//  pulls values out as they arrive and must consume each value exactly once
+	//  (by reading it, entering it, or skip()-ing it).
+	//  NOTE: string views are valid until the next string is read
 	//  NOTE: throws on parse error
-	value load(std::string const &filename);
-	value parse(std::string const &string);
+	struct Reader {
+		enum class Kind {
+			String,
+			Number,
+			Bool,
+			Null,
+			Object,
+			Array,
+		};
+
+		static Reader load(std::string const &filename, Scan scan = Scan::Auto); //memory-maps file
+		static Reader parse(std::string_view json, Scan scan = Scan::Auto); //json must outlive the reader
+
+		Reader(Reader &&);
+		Reader &operator=(Reader &&);
+		~Reader();
+
+		//kind of the next value (does not consume it):
+		Kind peek();
+
+		//consume the next value, which must be of the given kind:
+		std::string_view string();
+		double number();
+		bool boolean();
+		void null();
+
+		//consume the next value, whatever it is:
+		void skip();
+
+		//consume the next value (which must be an array) as a list of numbers, decoded straight into out:
+		//  returns false at the first element that is not a number; out then holds the elements before it,
+		//  and the reader is positioned at that element (still inside the array)
+		//  NOTE: very long arrays are decoded on several threads
+		bool numbers(std::vector< float > &out);
+		bool numbers(std::vector< double > &out);
+
+		//enter an object and step through its members:
+		//  next_member() sets key and returns true (caller then consumes the value) or returns false at the closing '}'
+		//  NOTE: key is valid until the member's value is consumed
+		void begin_object();
+		bool next_member(std::string_view &key);
+
+		//enter an array and step through its elements:
+		//  next_element() returns true (caller then consumes the element) or returns false at the closing ']'
+		void begin_array();
+		bool next_element();
+
+		//look ahead through the rest of the current object for a string member 'key' without consuming anything:
+		//  (cheap when key is the next member; otherwise skims the object and rewinds)
+		std::optional< std::string > lookahead_string(std::string_view key);
+
+		//throws unless the root value has been consumed and only whitespace remains:
+		void finish();
+
+	private:
+		struct State;
+		explicit Reader(std::unique_ptr< State > &&state);
+		std::unique_ptr< State > state;
+	};
 
 } //namespace sejp
@@ -0,0 +1,794 @@
+#include "S72Binary.hpp"
+
+#include "MappedFile.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace S72Loader {
+namespace {
+
+//File layout:
+//  Header, then each Section in order (8-byte aligned) as a flat array of
+//  the record type below. Records only hold 32-bit fields; text lives in
+//  the Strings section and is referred to by (offset, length).
+//  Values are stored in host byte order.
+
+constexpr char Magic[4] = {'s', '7', '2', 'b'};
+constexpr uint32_t Version = 1;
+
+struct Str {
+	uint32_t offset = 0;
+	uint32_t length = 0;
+};
+
+//reference to another object, by index (or, if no object has that name, by name):
+struct Ref {
+	uint32_t present = 0;
+	uint32_t index = NoIndex;
+	Str name; //only used when index == NoIndex
+};
+
+struct StreamRecord {
+	Str src;
+	uint32_t offset = 0;
+	uint32_t has_stride = 0;
+	uint32_t stride = 0;
+	Str format;
+};
+
+struct TextureRecord {
+	uint32_t present = 0;
+	Str src;
+	Str type;
+	Str format;
+};
+
+struct SceneRecord {
+	Str name;
+	uint32_t roots_first = 0; //into Refs
+	uint32_t roots_count = 0;
+};
+
+struct NodeRecord {
+	Str name;
+	float translation[3];
+	float rotation[4];
+	float scale[3];
+	Ref mesh;
+	Ref camera;
+	Ref environment;
+	Ref light;
+	uint32_t children_first = 0; //into Refs
+	uint32_t children_count = 0;
+};
+
+struct MeshRecord {
+	Str name;
+	Str topology;
+	uint32_t count = 0;
+	uint32_t has_indices = 0;
+	StreamRecord indices;
+	Ref material;
+	uint32_t attributes_first = 0; //into Attributes
+	uint32_t attributes_count = 0;
+	float aabb_min[3];
+	float aabb_max[3];
+};
+
+struct AttributeRecord {
+	Str name;
+	StreamRecord stream;
+};
+
+struct CameraRecord {
+	Str name;
+	uint32_t has_perspective = 0;
+	float aspect = 0.0f;
+	float vfov = 0.0f;
+	float near_plane = 0.0f;
+	uint32_t has_far = 0;
+	float far_plane = 0.0f;
+};
+
+//keyframes are kept in two shared tables (Times, Values) rather than per driver:
+struct DriverRecord {
+	Str name;
+	Ref node;
+	Str channel;
+	Str interpolation;
+	uint32_t times_first = 0;
+	uint32_t times_count = 0;
+	uint32_t values_first = 0;
+	uint32_t values_count = 0;
+};
+
+struct MaterialRecord {
+	Str name;
+	TextureRecord normal_map;
+	TextureRecord displacement_map;
+	uint32_t has_pbr = 0;
+	uint32_t has_lambertian = 0;
+	uint32_t mirror = 0;
+	uint32_t environment = 0;
+	//albedo belongs to whichever of pbr/lambertian is present:
+	uint32_t has_albedo_value = 0;
+	float albedo_value[3] = {0.0f, 0.0f, 0.0f};
+	TextureRecord albedo_texture;
+	uint32_t has_roughness_value = 0;
+	float roughness_value = 0.0f;
+	TextureRecord roughness_texture;
+	uint32_t has_metalness_value = 0;
+	float metalness_value = 0.0f;
+	TextureRecord metalness_texture;
+};
+
+struct EnvironmentRecord {
+	Str name;
+	TextureRecord radiance;
+};
+
+struct LightRecord {
+	Str name;
+	float tint[3];
+	uint32_t shadow = 0;
+	uint32_t has_sun = 0;
+	uint32_t has_sphere = 0;
+	uint32_t has_spot = 0;
+	float angle = 0.0f; //sun
+	float strength = 0.0f; //sun
+	float radius = 0.0f; //sphere, spot
+	float power = 0.0f; //sphere, spot
+	uint32_t has_limit = 0; //sphere, spot
+	float limit = 0.0f;
+	float fov = 0.0f; //spot
+	float blend = 0.0f; //spot
+};
+
+//mesh data the bounding boxes were computed from:
+struct DataFileRecord {
+	Str src;
+	uint32_t size = 0;
+	uint32_t hash_lo = 0;
+	uint32_t hash_hi = 0;
+};
+
+enum Section : uint32_t {
+	DataFiles,
+	Scenes,
+	Nodes,
+	Refs,
+	Meshes,
+	Attributes,
+	Cameras,
+	Drivers,
+	Times,
+	Values,
+	Materials,
+	Environments,
+	Lights,
+	Strings,
+	SectionCount
+};
+
+constexpr size_t SectionElementSize[SectionCount] = {
+	sizeof(DataFileRecord),
+	sizeof(SceneRecord),
+	sizeof(NodeRecord),
+	sizeof(Ref),
+	sizeof(MeshRecord),
+	sizeof(AttributeRecord),
+	sizeof(CameraRecord),
+	sizeof(DriverRecord),
+	sizeof(float),
+	sizeof(float),
+	sizeof(MaterialRecord),
+	sizeof(EnvironmentRecord),
+	sizeof(LightRecord),
+	sizeof(char),
+};
+
+struct Header {
+	char magic[4];
+	uint32_t version;
+	uint32_t source_hash_lo;
+	uint32_t source_hash_hi;
+	uint32_t counts[SectionCount]; //elements in each section
+};
+
+size_t align8(size_t offset) {
+	return (offset + 7) & ~size_t(7);
+}
+
+uint32_t to_u32(size_t value, char const *what) {
+	if (value > std::numeric_limits< uint32_t >::max()) throw std::runtime_error(std::string("Too many ") + what + " to cook.");
+	return uint32_t(value);
+}
+
+//- - - - - - - - - - - - - - - - - - - - -
+//writing
+
+struct Cooker {
+	std::vector< DataFileRecord > data_files;
+	std::vector< SceneRecord > scenes;
+	std::vector< NodeRecord > nodes;
+	std::vector< Ref > refs;
+	std::vector< MeshRecord > meshes;
+	std::vector< AttributeRecord > attributes;
+	std::vector< CameraRecord > cameras;
+	std::vector< DriverRecord > drivers;
+	std::vector< float > times;
+	std::vector< float > values;
+	std::vector< MaterialRecord > materials;
+	std::vector< EnvironmentRecord > environments;
+	std::vector< LightRecord > lights;
+	std::string strings;
+
+	std::unordered_map< std::string, Str > interned; //(names of formats, channels, etc. repeat a lot)
+
+	Str str(std::string const &s) {
+		auto it = interned.find(s);
+		if (it != interned.end()) return it->second;
+		Str ret{to_u32(strings.size(), "strings"), to_u32(s.size(), "strings")};
+		strings += s;
+		interned.emplace(s, ret);
+		return ret;
+	}
+
+	using Index = std::unordered_map< std::string, uint32_t >;
+
+	template< typename T >
+	static Index index_names(std::vector< T > const &objects) {
+		Index index;
+		for (size_t i = 0; i < objects.size(); ++i) {
+			index.emplace(objects[i].name, uint32_t(i));
+		}
+		return index;
+	}
+
+	Ref ref(std::optional< std::string > const &name, Index const &index) {
+		Ref r;
+		if (!name) return r;
+		r.present = 1;
+		auto it = index.find(*name);
+		if (it != index.end()) {
+			r.index = it->second;
+		} else {
+			r.name = str(*name);
+		}
+		return r;
+	}
+
+	StreamRecord stream(DataStream const &ds) {
+		StreamRecord s;
+		s.src = str(ds.src);
+		s.offset = ds.offset;
+		s.has_stride = ds.stride.has_value();
+		s.stride = ds.stride.value_or(0);
+		s.format = str(ds.format);
+		return s;
+	}
+
+	TextureRecord texture(std::optional< Texture > const &t) {
+		TextureRecord r;
+		if (!t) return r;
+		r.present = 1;
+		r.src = str(t->src);
+		r.type = str(t->type);
+		r.format = str(t->format);
+		return r;
+	}
+
+	template< typename T >
+	static void append(std::string &out, std::vector< T > const &section) {
+		out.resize(align8(out.size()), '\0');
+		out.append(reinterpret_cast< char const * >(section.data()), section.size() * sizeof(T));
+	}
+
+	std::string serialize(uint64_t source_hash) const {
+		Header header{};
+		std::memcpy(header.magic, Magic, sizeof(Magic));
+		header.version = Version;
+		header.source_hash_lo = uint32_t(source_hash);
+		header.source_hash_hi = uint32_t(source_hash >> 32);
+		header.counts[DataFiles] = to_u32(data_files.size(), "data files");
+		header.counts[Scenes] = to_u32(scenes.size(), "scenes");
+		header.counts[Nodes] = to_u32(nodes.size(), "nodes");
+		header.counts[Refs] = to_u32(refs.size(), "references");
+		header.counts[Meshes] = to_u32(meshes.size(), "meshes");
+		header.counts[Attributes] = to_u32(attributes.size(), "attributes");
+		header.counts[Cameras] = to_u32(cameras.size(), "cameras");
+		header.counts[Drivers] = to_u32(drivers.size(), "drivers");
+		header.counts[Times] = to_u32(times.size(), "keyframes");
+		header.counts[Values] = to_u32(values.size(), "keyframe values");
+		header.counts[Materials] = to_u32(materials.size(), "materials");
+		header.counts[Environments] = to_u32(environments.size(), "environments");
+		header.counts[Lights] = to_u32(lights.size(), "lights");
+		header.counts[Strings] = to_u32(strings.size(), "strings");
+
+		std::string out(reinterpret_cast< char const * >(&header), sizeof(header));
+		append(out, data_files);
+		append(out, scenes);
+		append(out, nodes);
+		append(out, refs);
+		append(out, meshes);
+		append(out, attributes);
+		append(out, cameras);
+		append(out, drivers);
+		append(out, times);
+		append(out, values);
+		append(out, materials);
+		append(out, environments);
+		append(out, lights);
+		out.resize(align8(out.size()), '\0');
+		out += strings;
+		return out;
+	}
+};
+
+void copy3(float *dst, glm::vec3 const &v) {
+	dst[0] = v.x; dst[1] = v.y; dst[2] = v.z;
+}
+
+//- - - - - - - - - - - - - - - - - - - - -
+//reading
+
+struct Cooked {
+	std::string_view bytes;
+	Header header;
+	size_t offsets[SectionCount];
+
+	//returns false if bytes don't start with a current-version header:
+	bool open(std::string_view bytes_) {
+		bytes = bytes_;
+		if (bytes.size() < sizeof(Header)) return false;
+		std::memcpy(&header, bytes.data(), sizeof(Header));
+		if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version) return false;
+
+		uint64_t at = sizeof(Header);
+		for (uint32_t s = 0; s < SectionCount; ++s) {
+			at = align8(size_t(at));
+			offsets[s] = size_t(at);
+			at += uint64_t(header.counts[s]) * SectionElementSize[s];
+		}
+		if (at > bytes.size()) throw std::runtime_error("Cooked scene is truncated.");
+		return true;
+	}
+
+	uint64_t source_hash() const {
+		return uint64_t(header.source_hash_lo) | (uint64_t(header.source_hash_hi) << 32);
+	}
+
+	uint32_t count(Section s) const {
+		return header.counts[s];
+	}
+
+	template< typename T >
+	T get(Section s, uint32_t i) const {
+		if (i >= header.counts[s]) throw std::runtime_error("Cooked scene has an out-of-range index.");
+		T t;
+		std::memcpy(&t, bytes.data() + offsets[s] + size_t(i) * sizeof(T), sizeof(T));
+		return t;
+	}
+
+	std::vector< float > floats(Section s, uint32_t first, uint32_t count) const {
+		if (uint64_t(first) + count > header.counts[s]) throw std::runtime_error("Cooked scene has an out-of-range keyframe table.");
+		std::vector< float > ret(count);
+		std::memcpy(ret.data(), bytes.data() + offsets[s] + size_t(first) * sizeof(float), size_t(count) * sizeof(float));
+		return ret;
+	}
+
+	std::string text(Str s) const {
+		if (uint64_t(s.offset) + s.length > header.counts[Strings]) throw std::runtime_error("Cooked scene has an out-of-range string.");
+		return std::string(bytes.data() + offsets[Strings] + s.offset, s.length);
+	}
+
+	template< typename T >
+	std::optional< std::string > name_of(Ref const &r, std::vector< T > const &objects) const {
+		if (!r.present) return std::nullopt;
+		if (r.index == NoIndex) return text(r.name);
+		if (r.index >= objects.size()) throw std::runtime_error("Cooked scene has an out-of-range reference.");
+		return objects[r.index].name;
+	}
+
+	DataStream stream(StreamRecord const &s) const {
+		DataStream ds;
+		ds.src = text(s.src);
+		ds.offset = s.offset;
+		if (s.has_stride) ds.stride = s.stride;
+		ds.format = text(s.format);
+		return ds;
+	}
+
+	std::optional< Texture > texture(TextureRecord const &r) const {
+		if (!r.present) return std::nullopt;
+		Texture t;
+		t.src = text(r.src);
+		t.type = text(r.type);
+		t.format = text(r.format);
+		return t;
+	}
+};
+
+glm::vec3 vec3(float const *v) {
+	return glm::vec3(v[0], v[1], v[2]);
+}
+
+} // namespace
+
+uint64_t content_hash(std::string_view bytes) {
+	//multiply-xorshift over eight bytes at a time (fast enough to run on every load):
+	const uint64_t K = 0x9e3779b97f4a7c15ull;
+	uint64_t h = 0xcbf29ce484222325ull ^ (uint64_t(bytes.size()) * K);
+	size_t i = 0;
+	for (; i + 8 <= bytes.size(); i += 8) {
+		uint64_t w;
+		std::memcpy(&w, bytes.data() + i, 8);
+		h = (h ^ w) * K;
+		h ^= h >> 29;
+	}
+	uint64_t tail = 0;
+	std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+	h = (h ^ tail) * K;
+	h ^= h >> 32;
+	return h;
+}
+
+void cook(const Document &doc, std::string_view source, const std::string &base_path, const std::string &path) {
+	Cooker c;
+
+	const Cooker::Index node_index = Cooker::index_names(doc.nodes);
+	const Cooker::Index mesh_index = Cooker::index_names(doc.meshes);
+	const Cooker::Index camera_index = Cooker::index_names(doc.cameras);
+	const Cooker::Index material_index = Cooker::index_names(doc.materials);
+	const Cooker::Index environment_index = Cooker::index_names(doc.environments);
+	const Cooker::Index light_index = Cooker::index_names(doc.lights);
+
+	{ //scene:
+		SceneRecord r;
+		r.name = c.str(doc.scene.name);
+		r.roots_first = to_u32(c.refs.size(), "references");
+		for (auto const &root : doc.scene.roots) c.refs.emplace_back(c.ref(root, node_index));
+		r.roots_count = to_u32(doc.scene.roots.size(), "roots");
+		c.scenes.emplace_back(r);
+	}
+
+	for (auto const &node : doc.nodes) {
+		NodeRecord r;
+		r.name = c.str(node.name);
+		copy3(r.translation, node.translation);
+		r.rotation[0] = node.rotation.x; r.rotation[1] = node.rotation.y; r.rotation[2] = node.rotation.z; r.rotation[3] = node.rotation.w;
+		copy3(r.scale, node.scale);
+		r.mesh = c.ref(node.mesh, mesh_index);
+		r.camera = c.ref(node.camera, camera_index);
+		r.environment = c.ref(node.environment, environment_index);
+		r.light = c.ref(node.light, light_index);
+		r.children_first = to_u32(c.refs.size(), "references");
+		for (auto const &child : node.children) c.refs.emplace_back(c.ref(child, node_index));
+		r.children_count = to_u32(node.children.size(), "children");
+		c.nodes.emplace_back(r);
+	}
+
+	//mesh data is read once per file (meshes may share one) to hash it and compute bounding boxes:
+	std::unordered_map< std::string, std::vector< uint8_t > > data_files;
+	for (auto const &mesh : doc.meshes) {
+		MeshRecord r;
+		r.name = c.str(mesh.name);
+		r.topology = c.str(mesh.topology);
+		r.count = mesh.count;
+		if (mesh.indices) {
+			r.has_indices = 1;
+			r.indices = c.stream(*mesh.indices);
+		}
+		r.material = c.ref(mesh.material, material_index);
+		r.attributes_first = to_u32(c.attributes.size(), "attributes");
+		for (auto const &[name, stream] : mesh.attributes) {
+			c.attributes.emplace_back(AttributeRecord{c.str(name), c.stream(stream)});
+		}
+		r.attributes_count = to_u32(mesh.attributes.size(), "attributes");
+
+		//(same file SceneManager uploads for this mesh)
+		std::string src;
+		if (mesh.indices) src = mesh.indices->src;
+		else if (!mesh.attributes.empty()) src = mesh.attributes.begin()->second.src;
+		glm::vec3 aabb_min = mesh.range.aabb_min;
+		glm::vec3 aabb_max = mesh.range.aabb_max;
+		if (!src.empty()) {
+			try {
+				auto data = data_files.find(src);
+				if (data == data_files.end()) {
+					data = data_files.emplace(src, load_mesh_data(base_path, src)).first;
+					std::string_view bytes(reinterpret_cast< char const * >(data->second.data()), data->second.size());
+					uint64_t hash = content_hash(bytes);
+					c.data_files.emplace_back(DataFileRecord{c.str(src), to_u32(bytes.size(), "bytes of mesh data"), uint32_t(hash), uint32_t(hash >> 32)});
+				}
+				std::tie(aabb_min, aabb_max) = compute_mesh_aabb(data->second, mesh.count);
+			} catch (std::runtime_error &e) {
+				//leave the bounding box to be computed at load time:
+				std::cerr << "Warning: not precomputing bounds of mesh '" << mesh.name << "': " << e.what() << std::endl;
+			}
+		}
+		copy3(r.aabb_min, aabb_min);
+		copy3(r.aabb_max, aabb_max);
+		c.meshes.emplace_back(r);
+	}
+
+	for (auto const &cam : doc.cameras) {
+		CameraRecord r;
+		r.name = c.str(cam.name);
+		if (cam.perspective) {
+			r.has_perspective = 1;
+			r.aspect = cam.perspective->aspect;
+			r.vfov = cam.perspective->vfov;
+			r.near_plane = cam.perspective->near;
+			r.has_far = cam.perspective->far.has_value();
+			r.far_plane = cam.perspective->far.value_or(0.0f);
+		}
+		c.cameras.emplace_back(r);
+	}
+
+	for (auto const &driver : doc.drivers) {
+		DriverRecord r;
+		r.name = c.str(driver.name);
+		r.node = c.ref(driver.node, node_index);
+		r.channel = c.str(driver.channel);
+		r.interpolation = c.str(driver.interpolation);
+		r.times_first = to_u32(c.times.size(), "keyframes");
+		r.times_count = to_u32(driver.times.size(), "keyframes");
+		c.times.insert(c.times.end(), driver.times.begin(), driver.times.end());
+		r.values_first = to_u32(c.values.size(), "keyframe values");
+		r.values_count = to_u32(driver.values.size(), "keyframe values");
+		c.values.insert(c.values.end(), driver.values.begin(), driver.values.end());
+		c.drivers.emplace_back(r);
+	}
+
+	for (auto const &mat : doc.materials) {
+		MaterialRecord r;
+		r.name = c.str(mat.name);
+		r.normal_map = c.texture(mat.normal_map);
+		r.displacement_map = c.texture(mat.displacement_map);
+		r.mirror = mat.mirror;
+		r.environment = mat.environment;
+		std::optional< glm::vec3 > albedo_value;
+		std::optional< Texture > albedo_texture;
+		if (mat.pbr) {
+			r.has_pbr = 1;
+			albedo_value = mat.pbr->albedo_value;
+			albedo_texture = mat.pbr->albedo_texture;
+			r.has_roughness_value = mat.pbr->roughness_value.has_value();
+			r.roughness_value = mat.pbr->roughness_value.value_or(0.0f);
+			r.roughness_texture = c.texture(mat.pbr->roughness_texture);
+			r.has_metalness_value = mat.pbr->metalness_value.has_value();
+			r.metalness_value = mat.pbr->metalness_value.value_or(0.0f);
+			r.metalness_texture = c.texture(mat.pbr->metalness_texture);
+		} else if (mat.lambertian) {
+			r.has_lambertian = 1;
+			albedo_value = mat.lambertian->albedo_value;
+			albedo_texture = mat.lambertian->albedo_texture;
+		}
+		if (albedo_value) {
+			r.has_albedo_value = 1;
+			copy3(r.albedo_value, *albedo_value);
+		}
+		r.albedo_texture = c.texture(albedo_texture);
+		c.materials.emplace_back(r);
+	}
+
+	for (auto const &env : doc.environments) {
+		c.environments.emplace_back(EnvironmentRecord{c.str(env.name), c.texture(env.radiance)});
+	}
+
+	for (auto const &light : doc.lights) {
+		LightRecord r;
+		r.name = c.str(light.name);
+		copy3(r.tint, light.tint);
+		r.shadow = light.shadow;
+		if (light.sun) {
+			r.has_sun = 1;
+			r.angle = light.sun->angle;
+			r.strength = light.sun->strength;
+		}
+		if (light.sphere) {
+			r.has_sphere = 1;
+			r.radius = light.sphere->radius;
+			r.power = light.sphere->power;
+			r.has_limit = light.sphere->limit.has_value();
+			r.limit = light.sphere->limit.value_or(0.0f);
+		}
+		if (light.spot) {
+			r.has_spot = 1;
+			r.radius = light.spot->radius;
+			r.power = light.spot->power;
+			r.has_limit = light.spot->limit.has_value();
+			r.limit = light.spot->limit.value_or(0.0f);
+			r.fov = light.spot->fov;
+			r.blend = light.spot->blend;
+		}
+		c.lights.emplace_back(r);
+	}
+
+	std::string bytes = c.serialize(content_hash(source));
+
+	//write to a temporary and rename, so a partially-written file is never picked up:
+	std::string temp_path = path + ".tmp";
+	{
+		std::ofstream out(temp_path, std::ios::binary);
+		if (!out) throw std::runtime_error("Failed to open '" + temp_path + "' for writing.");
+		out.write(bytes.data(), std::streamsize(bytes.size()));
+		if (!out) throw std::runtime_error("Failed to write '" + temp_path + "'.");
+	}
+	std::filesystem::rename(temp_path, path);
+}
+
+std::shared_ptr<Document> load_cooked(const std::string &path, std::optional<std::string_view> source) {
+	MappedFile file(path);
+	Cooked in;
+	if (!in.open(file.bytes())) {
+		if (source) return nullptr; //(cooked by some other version; just parse the source)
+		throw std::runtime_error("'" + path + "' is not a cooked scene (or was cooked by a different version).");
+	}
+
+	if (source) {
+		if (in.source_hash() != content_hash(*source)) return nullptr;
+
+		std::string base_path = std::filesystem::path(path).parent_path().generic_string();
+		if (!base_path.empty()) base_path += '/';
+		for (uint32_t i = 0; i < in.count(DataFiles); ++i) {
+			DataFileRecord r = in.get< DataFileRecord >(DataFiles, i);
+			std::string data_path = base_path + in.text(r.src);
+			if (!std::filesystem::exists(data_path)) return nullptr;
+			MappedFile data(data_path);
+			uint64_t hash = uint64_t(r.hash_lo) | (uint64_t(r.hash_hi) << 32);
+			if (data.size != r.size || content_hash(data.bytes()) != hash) return nullptr;
+		}
+	}
+
+	auto doc = std::make_shared<Document>();
+
+	//objects that are only referred to come first, so references can be turned back into names:
+	doc->materials.resize(in.count(Materials));
+	for (uint32_t i = 0; i < in.count(Materials); ++i) {
+		MaterialRecord r = in.get< MaterialRecord >(Materials, i);
+		Material &mat = doc->materials[i];
+		mat.name = in.text(r.name);
+		mat.normal_map = in.texture(r.normal_map);
+		mat.displacement_map = in.texture(r.displacement_map);
+		mat.mirror = r.mirror != 0;
+		mat.environment = r.environment != 0;
+		std::optional< glm::vec3 > albedo_value;
+		if (r.has_albedo_value) albedo_value = vec3(r.albedo_value);
+		if (r.has_pbr) {
+			Material::PBR pbr;
+			pbr.albedo_value = albedo_value;
+			pbr.albedo_texture = in.texture(r.albedo_texture);
+			if (r.has_roughness_value) pbr.roughness_value = r.roughness_value;
+			pbr.roughness_texture = in.texture(r.roughness_texture);
+			if (r.has_metalness_value) pbr.metalness_value = r.metalness_value;
+			pbr.metalness_texture = in.texture(r.metalness_texture);
+			mat.pbr = pbr;
+		}
+		if (r.has_lambertian) {
+			Material::Lambertian lambertian;
+			lambertian.albedo_value = albedo_value;
+			lambertian.albedo_texture = in.texture(r.albedo_texture);
+			mat.lambertian = lambertian;
+		}
+	}
+
+	doc->cameras.resize(in.count(Cameras));
+	for (uint32_t i = 0; i < in.count(Cameras); ++i) {
+		CameraRecord r = in.get< CameraRecord >(Cameras, i);
+		Camera &cam = doc->cameras[i];
+		cam.name = in.text(r.name);
+		if (r.has_perspective) {
+			Camera::Perspective p;
+			p.aspect = r.aspect;
+			p.vfov = r.vfov;
+			p.near = r.near_plane;
+			if (r.has_far) p.far = r.far_plane;
+			cam.perspective = p;
+		}
+	}
+
+	doc->environments.resize(in.count(Environments));
+	for (uint32_t i = 0; i < in.count(Environments); ++i) {
+		EnvironmentRecord r = in.get< EnvironmentRecord >(Environments, i);
+		doc->environments[i].name = in.text(r.name);
+		doc->environments[i].radiance = in.texture(r.radiance).value_or(Texture{});
+	}
+
+	doc->lights.resize(in.count(Lights));
+	for (uint32_t i = 0; i < in.count(Lights); ++i) {
+		LightRecord r = in.get< LightRecord >(Lights, i);
+		Light &light = doc->lights[i];
+		light.name = in.text(r.name);
+		light.tint = vec3(r.tint);
+		light.shadow = r.shadow;
+		std::optional< float > limit;
+		if (r.has_limit) limit = r.limit;
+		if (r.has_sun) light.sun = Light::Sun{r.angle, r.strength};
+		if (r.has_sphere) light.sphere = Light::Sphere{r.radius, r.power, limit};
+		if (r.has_spot) light.spot = Light::Spot{r.radius, r.power, limit, r.fov, r.blend};
+	}
+
+	doc->meshes.resize(in.count(Meshes));
+	for (uint32_t i = 0; i < in.count(Meshes); ++i) {
+		MeshRecord r = in.get< MeshRecord >(Meshes, i);
+		Mesh &mesh = doc->meshes[i];
+		mesh.name = in.text(r.name);
+		mesh.topology = in.text(r.topology);
+		mesh.count = r.count;
+		if (r.has_indices) mesh.indices = in.stream(r.indices);
+		for (uint32_t a = 0; a < r.attributes_count; ++a) {
+			AttributeRecord attribute = in.get< AttributeRecord >(Attributes, r.attributes_first + a);
+			mesh.attributes.emplace(in.text(attribute.name), in.stream(attribute.stream));
+		}
+		mesh.material = in.name_of(r.material, doc->materials);
+		mesh.material_index = r.material.index;
+		mesh.range.aabb_min = vec3(r.aabb_min);
+		mesh.range.aabb_max = vec3(r.aabb_max);
+	}
+
+	doc->nodes.resize(in.count(Nodes));
+	for (uint32_t i = 0; i < in.count(Nodes); ++i) {
+		doc->nodes[i].name = in.text(in.get< NodeRecord >(Nodes, i).name);
+	}
+	for (uint32_t i = 0; i < in.count(Nodes); ++i) {
+		NodeRecord r = in.get< NodeRecord >(Nodes, i);
+		Node &node = doc->nodes[i];
+		node.translation = vec3(r.translation);
+		node.rotation = glm::vec4(r.rotation[0], r.rotation[1], r.rotation[2], r.rotation[3]);
+		node.scale = vec3(r.scale);
+		node.children.reserve(r.children_count);
+		for (uint32_t c = 0; c < r.children_count; ++c) {
+			Ref child = in.get< Ref >(Refs, r.children_first + c);
+			node.children.emplace_back(*in.name_of(child, doc->nodes));
+			if (child.index != NoIndex) node.child_indices.emplace_back(child.index);
+		}
+		node.mesh = in.name_of(r.mesh, doc->meshes);
+		node.mesh_index = r.mesh.index;
+		node.camera = in.name_of(r.camera, doc->cameras);
+		node.camera_index = r.camera.index;
+		node.environment = in.name_of(r.environment, doc->environments);
+		node.environment_index = r.environment.index;
+		node.light = in.name_of(r.light, doc->lights);
+		node.light_index = r.light.index;
+		node.aabb_min = glm::vec3(-std::numeric_limits<float>::infinity());
+		node.aabb_max = glm::vec3(std::numeric_limits<float>::infinity());
+	}
+
+	doc->drivers.resize(in.count(Drivers));
+	for (uint32_t i = 0; i < in.count(Drivers); ++i) {
+		DriverRecord r = in.get< DriverRecord >(Drivers, i);
+		Driver &driver = doc->drivers[i];
+		driver.name = in.text(r.name);
+		driver.node = in.name_of(r.node, doc->nodes).value_or("");
+		driver.node_index = r.node.index;
+		driver.channel = in.text(r.channel);
+		driver.interpolation = in.text(r.interpolation);
+		driver.times = in.floats(Times, r.times_first, r.times_count);
+		driver.values = in.floats(Values, r.values_first, r.values_count);
+	}
+
+	if (in.count(Scenes) != 1) throw std::runtime_error("Cooked scene must contain exactly one SCENE.");
+	SceneRecord scene = in.get< SceneRecord >(Scenes, 0);
+	doc->scene.name = in.text(scene.name);
+	for (uint32_t c = 0; c < scene.roots_count; ++c) {
+		Ref root = in.get< Ref >(Refs, scene.roots_first + c);
+		doc->scene.roots.emplace_back(*in.name_of(root, doc->nodes));
+		if (root.index != NoIndex) doc->scene.root_indices.emplace_back(root.index);
+	}
+
+	build_hierarchy(*doc);
+	compile_animation(*doc);
+
+	return doc;
+}
+
+} // namespace S72Loader
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "S72Loader.hpp"
+
+#include <optional>
+#include <string_view>
+
+//Cooked (binary) scenes.
+//
+//An '.s72b' file holds an already-parsed Document: references between
+//objects are resolved to indices, keyframes sit in flat time/value tables,
+//and per-mesh bounding boxes are precomputed from mesh data. Loading one
+//is a handful of copies out of a memory mapping -- no JSON involved.
+//
+//A cooked file records content hashes of the '.s72' it came from and of
+//the mesh data files its bounding boxes were computed from; load_file()
+//only uses a cooked file while all of those still match.
+
+namespace S72Loader {
+
+//64-bit hash of file contents (not cryptographic; used to detect stale cooked files):
+uint64_t content_hash(std::string_view bytes);
+
+//write doc (parsed from 'source', whose mesh data lives in 'base_path') as a cooked file:
+//  NOTE: reads every mesh's data to compute its bounding box
+void cook(const Document &doc, std::string_view source, const std::string &base_path, const std::string &path);
+
+//read a cooked file:
+//  if 'source' is given, returns nullptr unless the file was cooked from exactly that source
+//  (and the mesh data next to it is unchanged); throws if the file is malformed
+std::shared_ptr<Document> load_cooked(const std::string &path, std::optional<std::string_view> source = std::nullopt);
+
+} // namespace S72Loader
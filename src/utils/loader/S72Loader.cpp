@@ -1,9 +1,12 @@
 #include "S72Loader.hpp"
 
+#include "MappedFile.hpp"
+#include "S72Binary.hpp"
 #include "sejp.hpp"
 
 #include <cmath>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <limits>
 #include <map>
@@ -11,50 +14,39 @@
 #include <set>
 #include <stdexcept>
 #include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <iostream>
 
 namespace S72Loader {
 namespace {
 
-using Object = std::map< std::string, sejp::value >;
+using Reader = sejp::Reader;
+using Kind = sejp::Reader::Kind;
 
-Object const expect_object(sejp::value const &v, std::string_view ctx) {
-	auto obj = v.as_object();
-	if (!obj) S72_ERROR(ctx, "expected object");
-	return obj.value();
-}
+//Members are read straight off the stream into the structs below.
+//Required members are collected as optionals and checked once the
+//object's closing '}' has been reached; unknown members are skipped.
 
-std::string expect_string(Object const &obj, std::string_view key, std::string_view ctx) {
-	auto it = obj.find(std::string(key));
-	if (it == obj.end()) S72_ERROR(ctx, std::string("missing '") + std::string(key) + "'");
-	auto s = it->second.as_string();
-	if (!s) S72_ERROR(ctx, std::string("'") + std::string(key) + "' must be string");
-	return *s;
+template< typename T >
+T required(std::optional< T > &&value, std::string_view key, std::string_view ctx) {
+	if (!value) S72_ERROR(ctx, std::string("missing '") + std::string(key) + "'");
+	return std::move(*value);
 }
 
-std::optional< std::string > optional_string(Object const &obj, std::string_view key) {
-	auto it = obj.find(std::string(key));
-	if (it == obj.end()) return std::nullopt;
-	auto s = it->second.as_string();
-	if (!s) S72_ERROR(key, "must be string");
-	return *s;
+void expect_object(Reader &r, std::string_view ctx) {
+	if (r.peek() != Kind::Object) S72_ERROR(ctx, "expected object");
+	r.begin_object();
 }
 
-float expect_number(Object const &obj, std::string_view key, std::string_view ctx) {
-	auto it = obj.find(std::string(key));
-	if (it == obj.end()) S72_ERROR(ctx, std::string("missing '") + std::string(key) + "'");
-	auto n = it->second.as_number();
-	if (!n) S72_ERROR(ctx, std::string("'") + std::string(key) + "' must be number");
-	return static_cast< float >(*n);
+std::string read_string(Reader &r, std::string_view key, std::string_view ctx) {
+	if (r.peek() != Kind::String) S72_ERROR(ctx, std::string("'") + std::string(key) + "' must be string");
+	return std::string(r.string());
 }
 
-std::optional< float > optional_number(Object const &obj, std::string_view key) {
-	auto it = obj.find(std::string(key));
-	if (it == obj.end()) return std::nullopt;
-	auto n = it->second.as_number();
-	if (!n) S72_ERROR(key, "must be number");
-	return static_cast< float >(*n);
+float read_number(Reader &r, std::string_view key, std::string_view ctx) {
+	if (r.peek() != Kind::Number) S72_ERROR(ctx, std::string("'") + std::string(key) + "' must be number");
+	return static_cast< float >(r.number());
 }
 
 uint32_t to_u32(float value, std::string_view ctx) {
@@ -67,204 +59,261 @@ uint32_t to_u32(float value, std::string_view ctx) {
 }
 
 template< size_t N >
-glm::vec<N, float> parse_vec(sejp::value const &v, std::string_view ctx) {
-	auto arr = v.as_array();
-	if (!arr || arr->size() != N) S72_ERROR(ctx, "expected array of correct length");
+glm::vec<N, float> read_vec(Reader &r, std::string_view ctx) {
+	if (r.peek() != Kind::Array) S72_ERROR(ctx, "expected array of correct length");
+	r.begin_array();
 	glm::vec<N, float, glm::defaultp> out{};
-	for (size_t i = 0; i < N; ++i) {
-		auto n = (*arr)[i].as_number();
-		if (!n) S72_ERROR(ctx, "vector elements must be numbers");
-		out[static_cast<typename glm::vec<N, float>::length_type>(i)] = static_cast< float >(*n);
+	size_t i = 0;
+	while (r.next_element()) {
+		if (i == N) S72_ERROR(ctx, "expected array of correct length");
+		if (r.peek() != Kind::Number) S72_ERROR(ctx, "vector elements must be numbers");
+		out[static_cast<typename glm::vec<N, float>::length_type>(i)] = static_cast< float >(r.number());
+		++i;
 	}
+	if (i != N) S72_ERROR(ctx, "expected array of correct length");
 	return out;
 }
 
-template< size_t N >
-glm::vec<N, float> vec_or_default(Object const &obj, std::string_view key, glm::vec<N, float> def, std::string_view ctx) {
-	auto it = obj.find(std::string(key));
-	if (it == obj.end()) return def;
-	return parse_vec<N>(it->second, ctx);
-}
-
-std::vector< float > parse_number_array(sejp::value const &v, std::string_view ctx) {
-	auto arr = v.as_array();
-	if (!arr) S72_ERROR(ctx, "expected array");
+std::vector< float > read_number_array(Reader &r, std::string_view ctx) {
+	if (r.peek() != Kind::Array) S72_ERROR(ctx, "expected array");
 	std::vector< float > out;
-	out.reserve(arr->size());
-	for (auto const &entry : *arr) {
-		auto n = entry.as_number();
-		if (!n) S72_ERROR(ctx, "array entries must be numbers");
-		out.push_back(static_cast< float >(*n));
-	}
+	if (!r.numbers(out)) S72_ERROR(ctx, "array entries must be numbers");
 	return out;
 }
 
-std::vector< std::string > parse_string_array(sejp::value const &v, std::string_view ctx) {
-	auto arr = v.as_array();
-	if (!arr) S72_ERROR(ctx, "expected array");
+std::vector< std::string > read_string_array(Reader &r, std::string_view ctx) {
+	if (r.peek() != Kind::Array) S72_ERROR(ctx, "expected array");
+	r.begin_array();
 	std::vector< std::string > out;
-	out.reserve(arr->size());
-	for (auto const &entry : *arr) {
-		auto s = entry.as_string();
-		if (!s) S72_ERROR(ctx, "array entries must be strings");
-		out.push_back(static_cast< std::string >(*s));
+	while (r.next_element()) {
+		if (r.peek() != Kind::String) S72_ERROR(ctx, "array entries must be strings");
+		out.emplace_back(r.string());
 	}
 	return out;
 }
 
-Texture parse_texture(sejp::value const &v, std::string_view ctx) {
-	auto const &obj = expect_object(v, ctx);
+Texture parse_texture(Reader &r, std::string_view ctx) {
+	expect_object(r, ctx);
 	Texture t;
-	t.src = expect_string(obj, "src", ctx);
-	t.type = optional_string(obj, "type").value_or("2D");
-	t.format = optional_string(obj, "format").value_or("linear");
+	std::optional< std::string > src;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "src") src = read_string(r, key, ctx);
+		else if (key == "type") t.type = read_string(r, key, ctx);
+		else if (key == "format") t.format = read_string(r, key, ctx);
+		else r.skip();
+	}
+	t.src = required(std::move(src), "src", ctx);
 	return t;
 }
 
-Material::PBR parse_pbr(sejp::value const &v, std::string_view ctx) {
-	auto const &obj = expect_object(v, ctx);
+Material::PBR parse_pbr(Reader &r, std::string_view ctx) {
+	expect_object(r, ctx);
 	Material::PBR p;
-	auto it = obj.find("albedo");
-	if (it != obj.end()) {
-		auto arr = it->second.as_array();
-		if (arr) {
-			p.albedo_value = parse_vec<3>(it->second, std::string(ctx) + ".albedo");
-		} else {
-			p.albedo_texture = parse_texture(it->second, std::string(ctx) + ".albedo");
-		}
-	}
-	it = obj.find("roughness");
-	if (it != obj.end()) {
-		auto n = it->second.as_number();
-		if (n) {
-			p.roughness_value = static_cast<float>(*n);
-		} else {
-			p.roughness_texture = parse_texture(it->second, std::string(ctx) + ".roughness");
-		}
-	}
-	it = obj.find("metalness");
-	if (it != obj.end()) {
-		auto n = it->second.as_number();
-		if (n) {
-			p.metalness_value = static_cast<float>(*n);
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "albedo") {
+			p.albedo_value.reset();
+			p.albedo_texture.reset();
+			if (r.peek() == Kind::Array) {
+				p.albedo_value = read_vec<3>(r, std::string(ctx) + ".albedo");
+			} else {
+				p.albedo_texture = parse_texture(r, std::string(ctx) + ".albedo");
+			}
+		} else if (key == "roughness") {
+			p.roughness_value.reset();
+			p.roughness_texture.reset();
+			if (r.peek() == Kind::Number) {
+				p.roughness_value = static_cast< float >(r.number());
+			} else {
+				p.roughness_texture = parse_texture(r, std::string(ctx) + ".roughness");
+			}
+		} else if (key == "metalness") {
+			p.metalness_value.reset();
+			p.metalness_texture.reset();
+			if (r.peek() == Kind::Number) {
+				p.metalness_value = static_cast< float >(r.number());
+			} else {
+				p.metalness_texture = parse_texture(r, std::string(ctx) + ".metalness");
+			}
 		} else {
-			p.metalness_texture = parse_texture(it->second, std::string(ctx) + ".metalness");
+			r.skip();
 		}
 	}
 	return p;
 }
 
-Material::Lambertian parse_lambertian(sejp::value const &v, std::string_view ctx) {
-	auto const &obj = expect_object(v, ctx);
+Material::Lambertian parse_lambertian(Reader &r, std::string_view ctx) {
+	expect_object(r, ctx);
 	Material::Lambertian m;
-	auto it = obj.find("albedo");
-	if (it != obj.end()) {
-		auto arr = it->second.as_array();
-		if (arr) {
-			m.albedo_value = parse_vec<3>(it->second, std::string(ctx) + ".albedo");
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "albedo") {
+			m.albedo_value.reset();
+			m.albedo_texture.reset();
+			if (r.peek() == Kind::Array) {
+				m.albedo_value = read_vec<3>(r, std::string(ctx) + ".albedo");
+			} else {
+				m.albedo_texture = parse_texture(r, std::string(ctx) + ".albedo");
+			}
 		} else {
-			m.albedo_texture = parse_texture(it->second, std::string(ctx) + ".albedo");
+			r.skip();
 		}
 	}
 	return m;
 }
 
-DataStream parse_data_stream(sejp::value const &v, std::string_view ctx, bool allow_stride, bool require_stride) {
-	auto const &obj = expect_object(v, ctx);
+DataStream parse_data_stream(Reader &r, std::string_view ctx, bool allow_stride, bool require_stride) {
+	expect_object(r, ctx);
 	DataStream ds;
-	ds.src = expect_string(obj, "src", ctx);
-	ds.offset = to_u32(expect_number(obj, "offset", ctx), ctx);
-	auto stride_number = optional_number(obj, "stride");
-	if (stride_number) {
+	std::optional< std::string > src, format;
+	std::optional< float > offset, stride;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "src") src = read_string(r, key, ctx);
+		else if (key == "offset") offset = read_number(r, key, ctx);
+		else if (key == "stride") stride = read_number(r, key, ctx);
+		else if (key == "format") format = read_string(r, key, ctx);
+		else r.skip();
+	}
+	ds.src = required(std::move(src), "src", ctx);
+	ds.offset = to_u32(required(std::move(offset), "offset", ctx), ctx);
+	if (stride) {
 		if (!allow_stride) S72_ERROR(ctx, "stride not allowed here");
-		ds.stride = to_u32(*stride_number, ctx);
+		ds.stride = to_u32(*stride, ctx);
 	} else if (require_stride) {
 		S72_ERROR(ctx, "missing 'stride'");
 	}
-	ds.format = expect_string(obj, "format", ctx);
+	ds.format = required(std::move(format), "format", ctx);
 	return ds;
 }
 
-Scene parse_scene(Object const &obj) {
+Scene parse_scene(Reader &r) {
 	Scene scene;
-	scene.name = expect_string(obj, "name", "SCENE");
-	auto it = obj.find("roots");
-	if (it != obj.end()) {
-		scene.roots = parse_string_array(it->second, "SCENE.roots");
+	std::optional< std::string > name;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") name = read_string(r, key, "SCENE");
+		else if (key == "roots") scene.roots = read_string_array(r, "SCENE.roots");
+		else r.skip();
 	}
+	scene.name = required(std::move(name), "name", "SCENE");
 	return scene;
 }
 
-Node parse_node(Object const &obj) {
+Node parse_node(Reader &r) {
 	Node node;
-	node.name = expect_string(obj, "name", "NODE");
-	node.translation = vec_or_default<3>(obj, "translation", {0.0, 0.0, 0.0}, "NODE.translation");
-	node.rotation = vec_or_default<4>(obj, "rotation", {0.0, 0.0, 0.0, 1.0}, "NODE.rotation");
-	node.scale = vec_or_default<3>(obj, "scale", {1.0, 1.0, 1.0}, "NODE.scale");
-	if (auto it = obj.find("children"); it != obj.end()) {
-		node.children = parse_string_array(it->second, "NODE.children");
-	}
-	node.mesh = optional_string(obj, "mesh");
-	node.camera = optional_string(obj, "camera");
-	node.environment = optional_string(obj, "environment");
-	node.light = optional_string(obj, "light");
+	std::optional< std::string > name;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") name = read_string(r, key, "NODE");
+		else if (key == "translation") node.translation = read_vec<3>(r, "NODE.translation");
+		else if (key == "rotation") node.rotation = read_vec<4>(r, "NODE.rotation");
+		else if (key == "scale") node.scale = read_vec<3>(r, "NODE.scale");
+		else if (key == "children") node.children = read_string_array(r, "NODE.children");
+		else if (key == "mesh") node.mesh = read_string(r, key, "NODE");
+		else if (key == "camera") node.camera = read_string(r, key, "NODE");
+		else if (key == "environment") node.environment = read_string(r, key, "NODE");
+		else if (key == "light") node.light = read_string(r, key, "NODE");
+		else r.skip();
+	}
+	node.name = required(std::move(name), "name", "NODE");
 	node.aabb_min = {-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
 	node.aabb_max = {std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
-	node.model_matrix_is_dirty = true;
 	return node;
 }
 
-Mesh parse_mesh(Object const &obj) {
+Mesh parse_mesh(Reader &r) {
 	Mesh mesh;
-	mesh.name = expect_string(obj, "name", "MESH");
-	mesh.topology = expect_string(obj, "topology", "MESH");
-	mesh.count = to_u32(expect_number(obj, "count", "MESH"), "MESH.count");
-	if (auto it = obj.find("indices"); it != obj.end()) {
-		mesh.indices = parse_data_stream(it->second, "MESH.indices", false, false);
-	}
-	auto it = obj.find("attributes");
-	if (it == obj.end()) S72_ERROR("", "MESH: missing 'attributes'");
-	auto const &attrs = expect_object(it->second, "MESH.attributes");
-	for (auto const &entry : attrs) {
-		mesh.attributes.emplace(entry.first, parse_data_stream(entry.second, "MESH.attributes." + entry.first, true, true));
+	std::optional< std::string > name, topology;
+	std::optional< float > count;
+	bool have_attributes = false;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") name = read_string(r, key, "MESH");
+		else if (key == "topology") topology = read_string(r, key, "MESH");
+		else if (key == "count") count = read_number(r, key, "MESH");
+		else if (key == "indices") mesh.indices = parse_data_stream(r, "MESH.indices", false, false);
+		else if (key == "material") mesh.material = read_string(r, key, "MESH");
+		else if (key == "attributes") {
+			expect_object(r, "MESH.attributes");
+			mesh.attributes.clear();
+			have_attributes = true;
+			std::string_view attribute;
+			while (r.next_member(attribute)) {
+				std::string attribute_name(attribute);
+				DataStream ds = parse_data_stream(r, "MESH.attributes." + attribute_name, true, true);
+				mesh.attributes.insert_or_assign(std::move(attribute_name), std::move(ds));
+			}
+		} else {
+			r.skip();
+		}
 	}
+	mesh.name = required(std::move(name), "name", "MESH");
+	mesh.topology = required(std::move(topology), "topology", "MESH");
+	mesh.count = to_u32(required(std::move(count), "count", "MESH"), "MESH.count");
+	if (!have_attributes) S72_ERROR("", "MESH: missing 'attributes'");
 	if (mesh.attributes.empty()) S72_ERROR("", "MESH: attributes must not be empty");
-	mesh.material = optional_string(obj, "material");
 	return mesh;
 }
 
-Camera parse_camera(Object const &obj) {
+Camera parse_camera(Reader &r) {
 	Camera cam;
-	cam.name = expect_string(obj, "name", "CAMERA");
-	if (auto it = obj.find("perspective"); it != obj.end()) {
-		Camera::Perspective p;
-		auto const &per = expect_object(it->second, "CAMERA.perspective");
-		p.aspect = expect_number(per, "aspect", "CAMERA.perspective");
-		p.vfov = expect_number(per, "vfov", "CAMERA.perspective");
-		p.near = expect_number(per, "near", "CAMERA.perspective");
-		p.far = optional_number(per, "far");
-		cam.perspective = p;
+	std::optional< std::string > name;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") {
+			name = read_string(r, key, "CAMERA");
+		} else if (key == "perspective") {
+			expect_object(r, "CAMERA.perspective");
+			Camera::Perspective p;
+			std::optional< float > aspect, vfov, znear;
+			std::string_view per_key;
+			while (r.next_member(per_key)) {
+				if (per_key == "aspect") aspect = read_number(r, per_key, "CAMERA.perspective");
+				else if (per_key == "vfov") vfov = read_number(r, per_key, "CAMERA.perspective");
+				else if (per_key == "near") znear = read_number(r, per_key, "CAMERA.perspective");
+				else if (per_key == "far") p.far = read_number(r, per_key, "CAMERA.perspective");
+				else r.skip();
+			}
+			p.aspect = required(std::move(aspect), "aspect", "CAMERA.perspective");
+			p.vfov = required(std::move(vfov), "vfov", "CAMERA.perspective");
+			p.near = required(std::move(znear), "near", "CAMERA.perspective");
+			cam.perspective = p;
+		} else {
+			r.skip();
+		}
 	}
+	cam.name = required(std::move(name), "name", "CAMERA");
 	if (!cam.perspective) S72_ERROR("", "CAMERA: must specify projection");
 	return cam;
 }
 
-Driver parse_driver(Object const &obj) {
+Driver parse_driver(Reader &r) {
 	Driver driver;
-	driver.name = expect_string(obj, "name", "DRIVER");
-	driver.node = expect_string(obj, "node", "DRIVER");
-	driver.channel = expect_string(obj, "channel", "DRIVER");
-	driver.interpolation = optional_string(obj, "interpolation").value_or("LINEAR");
-	{
-		auto it = obj.find("times");
-		if (it == obj.end()) S72_ERROR("", "DRIVER: missing 'times'");
-		driver.times = parse_number_array(it->second, "DRIVER.times");
-	}
-	{
-		auto it = obj.find("values");
-		if (it == obj.end()) S72_ERROR("", "DRIVER: missing 'values'");
-		driver.values = parse_number_array(it->second, "DRIVER.values");
+	std::optional< std::string > name, node, channel;
+	bool have_times = false, have_values = false;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") name = read_string(r, key, "DRIVER");
+		else if (key == "node") node = read_string(r, key, "DRIVER");
+		else if (key == "channel") channel = read_string(r, key, "DRIVER");
+		else if (key == "interpolation") driver.interpolation = read_string(r, key, "DRIVER");
+		else if (key == "times") {
+			driver.times = read_number_array(r, "DRIVER.times");
+			have_times = true;
+		} else if (key == "values") {
+			driver.values = read_number_array(r, "DRIVER.values");
+			have_values = true;
+		} else {
+			r.skip();
+		}
 	}
+	driver.name = required(std::move(name), "name", "DRIVER");
+	driver.node = required(std::move(node), "node", "DRIVER");
+	driver.channel = required(std::move(channel), "channel", "DRIVER");
+	if (!have_times) S72_ERROR("", "DRIVER: missing 'times'");
+	if (!have_values) S72_ERROR("", "DRIVER: missing 'values'");
 	if (driver.channel == "translation" || driver.channel == "scale") {
 		if (driver.values.size() != driver.times.size() * 3) S72_ERROR("", "DRIVER: channel expects 3D values");
 	} else if (driver.channel == "rotation") {
@@ -273,167 +322,425 @@ Driver parse_driver(Object const &obj) {
 	return driver;
 }
 
-Material parse_material(Object const &obj) {
+Material parse_material(Reader &r) {
 	Material mat;
-	mat.name = expect_string(obj, "name", "MATERIAL");
-	if (auto it = obj.find("normalMap"); it != obj.end()) {
-		mat.normal_map = parse_texture(it->second, "MATERIAL.normalMap");
-	}
-	if (auto it = obj.find("displacementMap"); it != obj.end()) {
-		mat.displacement_map = parse_texture(it->second, "MATERIAL.displacementMap");
-	}
-	size_t shading_count = 0;
-	if (auto it = obj.find("pbr"); it != obj.end()) {
-		mat.pbr = parse_pbr(it->second, "MATERIAL.pbr");
-		++shading_count;
-	}
-	if (auto it = obj.find("lambertian"); it != obj.end()) {
-		mat.lambertian = parse_lambertian(it->second, "MATERIAL.lambertian");
-		++shading_count;
-	}
-	if (auto it = obj.find("mirror"); it != obj.end()) {
-		expect_object(it->second, "MATERIAL.mirror");
-		mat.mirror = true;
-		++shading_count;
-	}
-	if (auto it = obj.find("environment"); it != obj.end()) {
-		expect_object(it->second, "MATERIAL.environment");
-		mat.environment = true;
-		++shading_count;
+	std::optional< std::string > name;
+	bool pbr = false, lambertian = false;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") {
+			name = read_string(r, key, "MATERIAL");
+		} else if (key == "normalMap") {
+			mat.normal_map = parse_texture(r, "MATERIAL.normalMap");
+		} else if (key == "displacementMap") {
+			mat.displacement_map = parse_texture(r, "MATERIAL.displacementMap");
+		} else if (key == "pbr") {
+			mat.pbr = parse_pbr(r, "MATERIAL.pbr");
+			pbr = true;
+		} else if (key == "lambertian") {
+			mat.lambertian = parse_lambertian(r, "MATERIAL.lambertian");
+			lambertian = true;
+		} else if (key == "mirror") {
+			if (r.peek() != Kind::Object) S72_ERROR("MATERIAL.mirror", "expected object");
+			r.skip();
+			mat.mirror = true;
+		} else if (key == "environment") {
+			if (r.peek() != Kind::Object) S72_ERROR("MATERIAL.environment", "expected object");
+			r.skip();
+			mat.environment = true;
+		} else {
+			r.skip();
+		}
 	}
+	mat.name = required(std::move(name), "name", "MATERIAL");
+	size_t shading_count = size_t(pbr) + size_t(lambertian) + size_t(mat.mirror) + size_t(mat.environment);
 	if (shading_count != 1) S72_ERROR("", "MATERIAL: exactly one shading model required");
 	return mat;
 }
 
-Environment parse_environment(Object const &obj) {
+Environment parse_environment(Reader &r) {
 	Environment env;
-	env.name = expect_string(obj, "name", "ENVIRONMENT");
-	auto it = obj.find("radiance");
-	if (it == obj.end()) S72_ERROR("", "ENVIRONMENT: missing 'radiance'");
-	env.radiance = parse_texture(it->second, "ENVIRONMENT.radiance");
+	std::optional< std::string > name;
+	bool have_radiance = false;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") {
+			name = read_string(r, key, "ENVIRONMENT");
+		} else if (key == "radiance") {
+			env.radiance = parse_texture(r, "ENVIRONMENT.radiance");
+			have_radiance = true;
+		} else {
+			r.skip();
+		}
+	}
+	env.name = required(std::move(name), "name", "ENVIRONMENT");
+	if (!have_radiance) S72_ERROR("", "ENVIRONMENT: missing 'radiance'");
 	return env;
 }
 
-Light parse_light(Object const &obj) {
+Light parse_light(Reader &r) {
 	Light light;
-	light.name = expect_string(obj, "name", "LIGHT");
-	light.tint = vec_or_default<3>(obj, "tint", {1.0, 1.0, 1.0}, "LIGHT.tint");
-	if (auto n = optional_number(obj, "shadow")) {
-		light.shadow = to_u32(*n, "LIGHT.shadow");
-	}
-	size_t kind = 0;
-	if (auto it = obj.find("sun"); it != obj.end()) {
-		auto const &sun_obj = expect_object(it->second, "LIGHT.sun");
-		Light::Sun sun;
-		sun.angle = expect_number(sun_obj, "angle", "LIGHT.sun");
-		sun.strength = expect_number(sun_obj, "strength", "LIGHT.sun");
-		light.sun = sun;
-		++kind;
-	}
-	if (auto it = obj.find("sphere"); it != obj.end()) {
-		auto const &sphere_obj = expect_object(it->second, "LIGHT.sphere");
-		Light::Sphere sphere;
-		sphere.radius = expect_number(sphere_obj, "radius", "LIGHT.sphere");
-		sphere.power = expect_number(sphere_obj, "power", "LIGHT.sphere");
-		sphere.limit = optional_number(sphere_obj, "limit");
-		light.sphere = sphere;
-		++kind;
-	}
-	if (auto it = obj.find("spot"); it != obj.end()) {
-		auto const &spot_obj = expect_object(it->second, "LIGHT.spot");
-		Light::Spot spot;
-		spot.radius = expect_number(spot_obj, "radius", "LIGHT.spot");
-		spot.power = expect_number(spot_obj, "power", "LIGHT.spot");
-		spot.limit = optional_number(spot_obj, "limit");
-		spot.fov = expect_number(spot_obj, "fov", "LIGHT.spot");
-		spot.blend = expect_number(spot_obj, "blend", "LIGHT.spot");
-		light.spot = spot;
-		++kind;
+	std::optional< std::string > name;
+	std::string_view key;
+	while (r.next_member(key)) {
+		if (key == "name") {
+			name = read_string(r, key, "LIGHT");
+		} else if (key == "tint") {
+			light.tint = read_vec<3>(r, "LIGHT.tint");
+		} else if (key == "shadow") {
+			light.shadow = to_u32(read_number(r, key, "LIGHT"), "LIGHT.shadow");
+		} else if (key == "sun") {
+			expect_object(r, "LIGHT.sun");
+			std::optional< float > angle, strength;
+			std::string_view sun_key;
+			while (r.next_member(sun_key)) {
+				if (sun_key == "angle") angle = read_number(r, sun_key, "LIGHT.sun");
+				else if (sun_key == "strength") strength = read_number(r, sun_key, "LIGHT.sun");
+				else r.skip();
+			}
+			Light::Sun sun;
+			sun.angle = required(std::move(angle), "angle", "LIGHT.sun");
+			sun.strength = required(std::move(strength), "strength", "LIGHT.sun");
+			light.sun = sun;
+		} else if (key == "sphere") {
+			expect_object(r, "LIGHT.sphere");
+			Light::Sphere sphere;
+			std::optional< float > radius, power;
+			std::string_view sphere_key;
+			while (r.next_member(sphere_key)) {
+				if (sphere_key == "radius") radius = read_number(r, sphere_key, "LIGHT.sphere");
+				else if (sphere_key == "power") power = read_number(r, sphere_key, "LIGHT.sphere");
+				else if (sphere_key == "limit") sphere.limit = read_number(r, sphere_key, "LIGHT.sphere");
+				else r.skip();
+			}
+			sphere.radius = required(std::move(radius), "radius", "LIGHT.sphere");
+			sphere.power = required(std::move(power), "power", "LIGHT.sphere");
+			light.sphere = sphere;
+		} else if (key == "spot") {
+			expect_object(r, "LIGHT.spot");
+			Light::Spot spot;
+			std::optional< float > radius, power, fov, blend;
+			std::string_view spot_key;
+			while (r.next_member(spot_key)) {
+				if (spot_key == "radius") radius = read_number(r, spot_key, "LIGHT.spot");
+				else if (spot_key == "power") power = read_number(r, spot_key, "LIGHT.spot");
+				else if (spot_key == "limit") spot.limit = read_number(r, spot_key, "LIGHT.spot");
+				else if (spot_key == "fov") fov = read_number(r, spot_key, "LIGHT.spot");
+				else if (spot_key == "blend") blend = read_number(r, spot_key, "LIGHT.spot");
+				else r.skip();
+			}
+			spot.radius = required(std::move(radius), "radius", "LIGHT.spot");
+			spot.power = required(std::move(power), "power", "LIGHT.spot");
+			spot.fov = required(std::move(fov), "fov", "LIGHT.spot");
+			spot.blend = required(std::move(blend), "blend", "LIGHT.spot");
+			light.spot = spot;
+		} else {
+			r.skip();
+		}
 	}
+	light.name = required(std::move(name), "name", "LIGHT");
+	size_t kind = size_t(light.sun.has_value()) + size_t(light.sphere.has_value()) + size_t(light.spot.has_value());
 	if (kind != 1) S72_ERROR("", "LIGHT: exactly one light definition required");
 	return light;
 }
 
-std::shared_ptr<Document> parse_document(sejp::value const &root) {
+//name -> index tables, only needed while loading:
+using NameIndex = std::unordered_map< std::string, uint32_t >;
+
+template< typename T >
+void add_object(std::vector< T > &objects, NameIndex &names, T &&object, char const *ctx) {
+	if (!names.emplace(object.name, uint32_t(objects.size())).second) {
+		S72_ERROR(ctx, std::string("duplicate name '") + object.name + "'");
+	}
+	objects.push_back(std::move(object));
+}
+
+uint32_t resolve(NameIndex const &names, std::string const &name) {
+	auto it = names.find(name);
+	return it == names.end() ? NoIndex : it->second;
+}
+
+uint32_t resolve(NameIndex const &names, std::optional< std::string > const &name) {
+	return name ? resolve(names, *name) : NoIndex;
+}
+
+std::shared_ptr<Document> parse_document(Reader &r) {
 	// Parse Root
-	auto arr_opt = root.as_array();
-	if (!arr_opt || arr_opt->empty()) S72_ERROR("", "Root must be non-empty array");
-	auto first = (*arr_opt)[0].as_string();
-	if (!first || *first != "s72-v2") S72_ERROR("", "First entry must be 's72-v2'");
+	if (r.peek() != Kind::Array) S72_ERROR("", "Root must be non-empty array");
+	r.begin_array();
+	if (!r.next_element()) S72_ERROR("", "Root must be non-empty array");
+	if (r.peek() != Kind::String || r.string() != "s72-v2") S72_ERROR("", "First entry must be 's72-v2'");
 
 	auto doc = std::make_shared<Document>();
 
 	bool scene_set = false;
-
-	for (size_t i = 1; i < arr_opt->size(); ++i) {
-		auto const &entry = (*arr_opt)[i];
-		auto const &obj = expect_object(entry, "object");
-		std::string type = expect_string(obj, "type", "object");
+	NameIndex node_names, mesh_names, camera_names, driver_names, material_names, environment_names, light_names;
+
+	while (r.next_element()) {
+		expect_object(r, "object");
+		// "type" is usually the first member, so this rarely needs to rewind:
+		std::optional< std::string > type_opt = r.lookahead_string("type");
+		if (!type_opt) S72_ERROR("object", "missing string 'type'");
+		std::string const &type = *type_opt;
 		if (type == "SCENE") {
 			if (scene_set) S72_ERROR("", "Multiple SCENE objects not allowed");
-			doc->scene = parse_scene(obj);
+			doc->scene = parse_scene(r);
 			scene_set = true;
 		} else if (type == "NODE") {
-			Node node = parse_node(obj);
-			if (!node_map.emplace(node.name, doc->nodes.size()).second) {
-				S72_ERROR("NODE", std::string("duplicate name '") + node.name + "'");
-			}
-			doc->nodes.push_back(std::move(node));
+			add_object(doc->nodes, node_names, parse_node(r), "NODE");
 		} else if (type == "MESH") {
-			auto mesh = parse_mesh(obj);
-			if (!mesh_map.emplace(mesh.name, doc->meshes.size()).second) {
-				S72_ERROR("MESH", std::string("duplicate name '") + mesh.name + "'");
-			}
-			doc->meshes.push_back(std::move(mesh));
+			add_object(doc->meshes, mesh_names, parse_mesh(r), "MESH");
 		} else if (type == "CAMERA") {
-			auto cam = parse_camera(obj);
-			if (!camera_map.emplace(cam.name, doc->cameras.size()).second) {
-				S72_ERROR("CAMERA", std::string("duplicate name '") + cam.name + "'");
-			}
-			doc->cameras.push_back(std::move(cam));
+			add_object(doc->cameras, camera_names, parse_camera(r), "CAMERA");
 		} else if (type == "DRIVER") {
-			auto driver = parse_driver(obj);
-			if (!driver_map.emplace(driver.name, doc->drivers.size()).second) {
-				S72_ERROR("DRIVER", std::string("duplicate name '") + driver.name + "'");
-			}
-			doc->drivers.push_back(std::move(driver));
+			add_object(doc->drivers, driver_names, parse_driver(r), "DRIVER");
 		} else if (type == "MATERIAL") {
-			auto mat = parse_material(obj);
-			if (!material_map.emplace(mat.name, doc->materials.size()).second) {
-				S72_ERROR("MATERIAL", std::string("duplicate name '") + mat.name + "'");
-			}
-			doc->materials.push_back(std::move(mat));
+			add_object(doc->materials, material_names, parse_material(r), "MATERIAL");
 		} else if (type == "ENVIRONMENT") {
-			auto env = parse_environment(obj);
-			if (!environment_map.emplace(env.name, doc->environments.size()).second) {
-				S72_ERROR("ENVIRONMENT", std::string("duplicate name '") + env.name + "'");
-			}
-			doc->environments.push_back(std::move(env));
+			add_object(doc->environments, environment_names, parse_environment(r), "ENVIRONMENT");
 		} else if (type == "LIGHT") {
-			auto light = parse_light(obj);
-			if (!light_map.emplace(light.name, doc->lights.size()).second) {
-				S72_ERROR("LIGHT", std::string("duplicate name '") + light.name + "'");
-			}
-			doc->lights.push_back(std::move(light));
+			add_object(doc->lights, light_names, parse_light(r), "LIGHT");
 		} else {
 			S72_ERROR("object", std::string("unknown type '") + type + "'");
 		}
 	}
+	r.finish();
 	if (!scene_set) S72_ERROR("", "File must contain exactly one SCENE");
-	
+
+	// Resolve references (objects may refer to ones defined later in the file)
+	for (auto const &root : doc->scene.roots) {
+		uint32_t index = resolve(node_names, root);
+		if (index != NoIndex) doc->scene.root_indices.push_back(index);
+	}
+	for (auto &node : doc->nodes) {
+		for (auto const &child : node.children) {
+			uint32_t index = resolve(node_names, child);
+			if (index != NoIndex) node.child_indices.push_back(index);
+		}
+		node.mesh_index = resolve(mesh_names, node.mesh);
+		node.camera_index = resolve(camera_names, node.camera);
+		node.environment_index = resolve(environment_names, node.environment);
+		node.light_index = resolve(light_names, node.light);
+	}
+	for (auto &mesh : doc->meshes) {
+		mesh.material_index = resolve(material_names, mesh.material);
+	}
+	for (auto &driver : doc->drivers) {
+		driver.node_index = resolve(node_names, driver.node);
+	}
+
+	build_hierarchy(*doc);
+	compile_animation(*doc);
+
 	return doc;
 }
 
 } // namespace S72Loader
 
 std::shared_ptr<Document> load_file(std::string const &path) {
-	auto root = sejp::load(path);
-	return parse_document(root);
+	if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".s72b") == 0) {
+		return load_cooked(path);
+	}
+
+	MappedFile source(path);
+
+	//prefer an up-to-date cooked copy, if one has been made:
+	std::string cooked_path = path + "b";
+	if (std::filesystem::exists(cooked_path)) {
+		try {
+			if (auto doc = load_cooked(cooked_path, source.bytes())) return doc;
+		} catch (std::exception &e) {
+			std::cerr << "Warning: ignoring cooked scene '" << cooked_path << "': " << e.what() << std::endl;
+		}
+	}
+
+	auto reader = sejp::Reader::parse(source.bytes());
+	return parse_document(reader);
 }
 
-std::shared_ptr<Document> load_string(std::string const &contents) {
-	auto root = sejp::parse(contents);
-	return parse_document(root);
+std::shared_ptr<Document> load_string(std::string_view contents) {
+	auto reader = sejp::Reader::parse(contents);
+	return parse_document(reader);
+}
+
+void build_hierarchy(Document &doc) {
+	Hierarchy &h = doc.hierarchy;
+	h = Hierarchy{};
+
+	h.translation.reserve(doc.nodes.size());
+	h.rotation.reserve(doc.nodes.size());
+	h.scale.reserve(doc.nodes.size());
+	for (auto const &node : doc.nodes) {
+		h.translation.push_back(node.translation);
+		h.rotation.push_back(node.rotation);
+		h.scale.push_back(node.scale);
+	}
+	h.local.assign(doc.nodes.size(), glm::mat4(1.0f));
+	h.local_dirty.assign(doc.nodes.size(), 1);
+	h.dirty_nodes.reserve(doc.nodes.size());
+	for (uint32_t n = 0; n < uint32_t(doc.nodes.size()); ++n) {
+		h.dirty_nodes.push_back(n);
+	}
+
+	// Depth-first walk from each root, with an explicit stack (chains of nodes can be very deep)
+	struct Visit {
+		uint32_t instance;
+		uint32_t next_child; // index into the node's child_indices
+	};
+	std::vector< Visit > stack;
+	std::vector< uint8_t > on_path(doc.nodes.size(), 0);
+
+	auto add_instance = [&](uint32_t node_index, uint32_t parent) {
+		Node const &node = doc.nodes[node_index];
+		if (on_path[node_index]) S72_ERROR("NODE", std::string("'") + node.name + "' is its own ancestor");
+		if (h.node.size() >= NoIndex) S72_ERROR("SCENE", "too many node instances");
+		uint32_t instance = uint32_t(h.node.size());
+		h.node.push_back(node_index);
+		h.parent.push_back(parent);
+		h.subtree_end.push_back(instance + 1); // (extended once the subtree is done)
+
+		// (a node contributes at most one of these, checked in this order)
+		Hierarchy::Kind kind = Hierarchy::Kind::None;
+		std::vector< uint32_t > *instances = nullptr;
+		if (node.mesh) {
+			if (node.mesh_index != NoIndex) { kind = Hierarchy::Kind::Mesh; instances = &h.mesh_instances; }
+		} else if (node.light) {
+			if (node.light_index != NoIndex) { kind = Hierarchy::Kind::Light; instances = &h.light_instances; }
+		} else if (node.camera) {
+			if (node.camera_index != NoIndex) { kind = Hierarchy::Kind::Camera; instances = &h.camera_instances; }
+		} else if (node.environment) {
+			if (node.environment_index != NoIndex) { kind = Hierarchy::Kind::Environment; instances = &h.environment_instances; }
+		}
+		h.kind.push_back(kind);
+		h.slot.push_back(instances ? uint32_t(instances->size()) : NoIndex);
+		if (instances) instances->push_back(instance);
+
+		on_path[node_index] = 1;
+		stack.push_back(Visit{instance, 0});
+	};
+
+	for (uint32_t root : doc.scene.root_indices) {
+		add_instance(root, NoIndex);
+		while (!stack.empty()) {
+			Visit &top = stack.back();
+			uint32_t node_index = h.node[top.instance];
+			std::vector< uint32_t > const &children = doc.nodes[node_index].child_indices;
+			if (top.next_child < children.size()) {
+				uint32_t child = children[top.next_child++];
+				add_instance(child, top.instance); //NOTE: invalidates 'top'
+			} else {
+				h.subtree_end[top.instance] = uint32_t(h.node.size());
+				on_path[node_index] = 0;
+				stack.pop_back();
+			}
+		}
+	}
+
+	h.world.assign(h.node.size(), glm::mat4(1.0f));
+
+	// Instances of each node (counting sort by node)
+	h.node_instances_first.assign(doc.nodes.size() + 1, 0);
+	for (uint32_t node_index : h.node) {
+		h.node_instances_first[node_index + 1] += 1;
+	}
+	for (size_t n = 0; n < doc.nodes.size(); ++n) {
+		h.node_instances_first[n + 1] += h.node_instances_first[n];
+	}
+	h.node_instances.resize(h.node.size());
+	std::vector< uint32_t > next(h.node_instances_first.begin(), h.node_instances_first.end() - 1);
+	for (uint32_t i = 0; i < uint32_t(h.node.size()); ++i) {
+		h.node_instances[next[h.node[i]]++] = i;
+	}
+}
+
+void compile_animation(Document &doc) {
+	Animation &a = doc.animation;
+	a = Animation{};
+
+	struct Track {
+		uint32_t driver;
+		Animation::Channel channel;
+		Animation::Mode mode;
+	};
+	std::vector<Track> tracks;
+	for (uint32_t d = 0; d < uint32_t(doc.drivers.size()); ++d) {
+		Driver const &driver = doc.drivers[d];
+		if (driver.node_index == NoIndex || driver.times.empty()) continue;
+
+		Animation::Channel channel;
+		uint32_t components;
+		if (driver.channel == "translation") {
+			channel = Animation::Channel::Translation;
+			components = 3;
+		} else if (driver.channel == "scale") {
+			channel = Animation::Channel::Scale;
+			components = 3;
+		} else if (driver.channel == "rotation") {
+			channel = Animation::Channel::Rotation;
+			components = 4;
+		} else {
+			continue; //(unknown channels animate nothing)
+		}
+		if (driver.values.size() != driver.times.size() * components) {
+			S72_ERROR("DRIVER", std::string("'") + driver.name + "' has the wrong number of values for its channel");
+		}
+
+		// rotations slerp unless told to STEP; translation and scale only interpolate when LINEAR
+		Animation::Mode mode = Animation::Mode::Step;
+		if (channel == Animation::Channel::Rotation) {
+			if (driver.interpolation != "STEP") mode = Animation::Mode::Slerp;
+		} else {
+			if (driver.interpolation == "LINEAR") mode = Animation::Mode::Linear;
+		}
+		tracks.push_back(Track{d, channel, mode});
+	}
+
+	// when several drivers animate the same channel of a node, the last one in the file wins:
+	std::vector<uint8_t> claimed(doc.nodes.size() * 3, 0);
+	std::vector<uint8_t> keep(tracks.size(), 0);
+	for (size_t t = tracks.size(); t-- > 0; ) {
+		size_t slot = size_t(doc.drivers[tracks[t].driver].node_index) * 3 + size_t(tracks[t].channel);
+		keep[t] = !claimed[slot];
+		claimed[slot] = 1;
+	}
+
+	// tracks are stored sorted by mode (so each mode is evaluated in one contiguous loop), then by channel:
+	for (Animation::Mode mode : {Animation::Mode::Step, Animation::Mode::Linear, Animation::Mode::Slerp}) {
+		if (mode == Animation::Mode::Linear) a.linear_begin = uint32_t(a.node.size());
+		if (mode == Animation::Mode::Slerp) a.slerp_begin = uint32_t(a.node.size());
+		for (Animation::Channel channel : {Animation::Channel::Translation, Animation::Channel::Scale, Animation::Channel::Rotation}) {
+			for (size_t t = 0; t < tracks.size(); ++t) {
+				if (!keep[t] || tracks[t].mode != mode || tracks[t].channel != channel) continue;
+				Driver const &driver = doc.drivers[tracks[t].driver];
+				if (a.times.size() + driver.times.size() >= NoIndex) S72_ERROR("DRIVER", "too many keyframes");
+
+				a.node.push_back(driver.node_index);
+				a.channel.push_back(tracks[t].channel);
+				a.mode.push_back(mode);
+				a.key_first.push_back(uint32_t(a.times.size()));
+				a.key_count.push_back(uint32_t(driver.times.size()));
+
+				a.times.insert(a.times.end(), driver.times.begin(), driver.times.end());
+				uint32_t components = (tracks[t].channel == Animation::Channel::Rotation ? 4 : 3);
+				for (size_t k = 0; k < driver.times.size(); ++k) {
+					float const *v = &driver.values[k * components];
+					a.values.emplace_back(v[0], v[1], v[2], components == 4 ? v[3] : 0.0f);
+				}
+			}
+		}
+	}
+
+	size_t count = a.node.size();
+	a.cursor.assign(count, 0);
+	// (an empty interval, so the first evaluation seeks)
+	a.interval_begin.assign(count, std::numeric_limits<float>::infinity());
+	a.interval_end.assign(count, -std::numeric_limits<float>::infinity());
+	a.key_time.assign(count, 0.0f);
+	a.key_duration.assign(count, 0.0f);
+	a.from.assign(count, glm::vec4(0.0f));
+	a.to.assign(count, glm::vec4(0.0f));
+	a.angle.assign(count, 0.0f);
+	a.sin_angle.assign(count, 0.0f);
 }
 
 std::vector<uint8_t> load_mesh_data(const std::string &base_path, const std::string &src){    
@@ -478,4 +785,43 @@ std::vector<uint8_t> load_mesh_data(const std::string &base_path, const Mesh &me
 	
     return load_mesh_data(base_path, src);
 }
+
+std::pair<glm::vec3, glm::vec3> compute_mesh_aabb(const std::vector<uint8_t> &mesh_data, uint32_t count) {
+    glm::vec3 aabb_min(std::numeric_limits<float>::max());
+    glm::vec3 aabb_max(std::numeric_limits<float>::lowest());
+    if (count == 0) return {aabb_min, aabb_max};
+
+    // Assuming vertex format has position at start (3 floats: x, y, z)
+    size_t vertex_stride = mesh_data.size() / count; // bytes per vertex
+    if (vertex_stride < 3 * sizeof(float)) {
+        throw std::runtime_error("Mesh data is too small for " + std::to_string(count) + " vertices");
+    }
+
+    for (uint32_t v = 0; v < count; ++v) {
+        float pos[3];
+        std::memcpy(pos, mesh_data.data() + v * vertex_stride, sizeof(pos));
+        glm::vec3 p(pos[0], pos[1], pos[2]);
+        aabb_min = glm::min(aabb_min, p);
+        aabb_max = glm::max(aabb_max, p);
+    }
+    return {aabb_min, aabb_max};
+}
+
+std::vector<glm::vec3> extract_mesh_positions(const std::vector<uint8_t> &mesh_data, uint32_t count) {
+    std::vector<glm::vec3> positions;
+    if (count == 0) return positions;
+
+    size_t vertex_stride = mesh_data.size() / count; // bytes per vertex
+    if (vertex_stride < 3 * sizeof(float)) {
+        throw std::runtime_error("Mesh data is too small for " + std::to_string(count) + " vertices");
+    }
+
+    positions.resize(count);
+    for (uint32_t v = 0; v < count; ++v) {
+        float pos[3];
+        std::memcpy(pos, mesh_data.data() + v * vertex_stride, sizeof(pos));
+        positions[v] = glm::vec3(pos[0], pos[1], pos[2]);
+    }
+    return positions;
+}
 } // namespace S72Loader
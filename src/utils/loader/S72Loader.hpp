@@ -8,6 +8,8 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -17,13 +19,8 @@
 
 namespace S72Loader {
 
-inline std::unordered_map< std::string, size_t > node_map;  // node name -> index in doc->nodes
-inline std::unordered_map< std::string, size_t > mesh_map;  // mesh name -> index in doc->meshes
-inline std::unordered_map< std::string, size_t > camera_map;
-inline std::unordered_map< std::string, size_t > driver_map;  // driver name -> index in doc->drivers
-inline std::unordered_map< std::string, size_t > material_map;  // material name -> index in doc->materials
-inline std::unordered_map< std::string, size_t > environment_map;  // environment name -> index in doc->environments
-inline std::unordered_map< std::string, size_t > light_map;  // light name -> index in doc->lights
+//index of an object in its Document array; NoIndex marks a missing or unresolved reference:
+inline constexpr uint32_t NoIndex = ~uint32_t(0);
 
 struct DataStream {
 	std::string src;
@@ -35,10 +32,12 @@ struct DataStream {
 struct Scene {
 	std::string name;
 	std::vector<std::string> roots;
+	std::vector<uint32_t> root_indices; // roots resolved to doc->nodes (names that match no node are left out)
 };
 
 struct Node {
 	std::string name;
+	// current transform (kept up to date by SceneTree::update_animation; after editing it, call SceneTree::mark_dirty):
 	glm::vec3 translation{0.0, 0.0, 0.0};
 	glm::vec4 rotation{0.0, 0.0, 0.0, 1.0};
 	glm::vec3 scale{1.0, 1.0, 1.0};
@@ -47,9 +46,14 @@ struct Node {
 	std::optional<std::string> camera;
 	std::optional<std::string> environment;
 	std::optional<std::string> light;
+	// references resolved at load time:
+	std::vector<uint32_t> child_indices; // into doc->nodes (names that match no node are left out)
+	uint32_t mesh_index = NoIndex; // into doc->meshes
+	uint32_t camera_index = NoIndex; // into doc->cameras
+	uint32_t environment_index = NoIndex; // into doc->environments
+	uint32_t light_index = NoIndex; // into doc->lights
 	glm::vec3 aabb_min = glm::vec3(std::numeric_limits<float>::max()); // axis-aligned bounding box min
 	glm::vec3 aabb_max = glm::vec3(std::numeric_limits<float>::lowest()); // axis-aligned bounding box max
-	bool model_matrix_is_dirty;
 };
 
 struct Mesh {
@@ -66,6 +70,7 @@ struct Mesh {
 	std::optional<DataStream> indices;
 	std::map<std::string, DataStream> attributes;
 	std::optional<std::string> material;
+	uint32_t material_index = NoIndex; // into doc->materials
 	ObjectRange range;
 };
 
@@ -84,6 +89,7 @@ struct Camera {
 struct Driver {
 	std::string name;
 	std::string node;
+	uint32_t node_index = NoIndex; // into doc->nodes
 	std::string channel;
 	std::vector<float> times;
 	std::vector<float> values;
@@ -153,6 +159,80 @@ struct Light {
 	std::optional<Spot> spot;
 };
 
+// The scene graph flattened for per-frame transform updates (built at load time):
+// instances are stored parent-before-child, in depth-first order from the scene's roots,
+// so every instance's subtree is a contiguous range; a node reachable along several
+// paths gets one instance per path.
+struct Hierarchy {
+	enum class Kind : uint8_t { None, Mesh, Light, Camera, Environment };
+
+	// per node (indexed like doc->nodes); copy of each node's current transform (SceneTree::update_animation writes both,
+	// SceneTree::mark_dirty copies the node's here):
+	std::vector<glm::vec3> translation;
+	std::vector<glm::vec4> rotation;
+	std::vector<glm::vec3> scale;
+	std::vector<glm::mat4> local; // local matrix made from translation/rotation/scale
+	std::vector<uint8_t> local_dirty; // local needs to be recomputed (node is then also in dirty_nodes)
+
+	// per instance:
+	std::vector<uint32_t> node; // index into doc->nodes
+	std::vector<uint32_t> parent; // index of parent instance (always less than own index), or NoIndex for roots
+	std::vector<uint32_t> subtree_end; // instances [i, subtree_end[i]) are i and its descendants
+	std::vector<glm::mat4> world; // world matrix
+	std::vector<Kind> kind; // what the node carries (if it resolved)
+	std::vector<uint32_t> slot; // position in the matching *_instances list below, or NoIndex
+
+	// instances of each node: node n's are node_instances[node_instances_first[n] .. node_instances_first[n+1])
+	std::vector<uint32_t> node_instances_first;
+	std::vector<uint32_t> node_instances;
+
+	// instances whose node has a (resolved) mesh, light, camera, or environment, in instance order:
+	std::vector<uint32_t> mesh_instances;
+	std::vector<uint32_t> light_instances;
+	std::vector<uint32_t> camera_instances;
+	std::vector<uint32_t> environment_instances;
+
+	// pending updates:
+	std::vector<uint32_t> dirty_nodes; // nodes with local_dirty set
+	bool rebuild = true; // every world matrix must be recomputed
+};
+
+// Drivers compiled for per-frame evaluation (built at load time; see SceneTree::update_animation):
+// one track per driver with a known channel, a resolved node, and at least one keyframe -- except that
+// only the last driver on any given node channel is kept, since it would overwrite the others anyway.
+struct Animation {
+	enum class Channel : uint8_t { Translation, Scale, Rotation };
+	enum class Mode : uint8_t { Step, Linear, Slerp };
+
+	// keyframes of all tracks:
+	std::vector<float> times;
+	std::vector<glm::vec4> values; // (translation and scale use xyz; rotation is a quaternion stored xyzw)
+
+	// per track:
+	std::vector<uint32_t> node; // index into doc->nodes
+	std::vector<Channel> channel;
+	std::vector<Mode> mode;
+	std::vector<uint32_t> key_first; // into times and values
+	std::vector<uint32_t> key_count;
+
+	// per track, the keyframe interval last evaluated (moved forward incrementally as time advances):
+	std::vector<uint32_t> cursor; // key at the start of the interval
+	std::vector<float> interval_begin; // interval is reused while interval_begin <= time < interval_end
+	std::vector<float> interval_end;
+	std::vector<float> key_time; // time of the cursor key
+	std::vector<float> key_duration; // time to the next key (0 while holding the first or last value)
+	std::vector<glm::vec4> from; // value at the cursor key
+	std::vector<glm::vec4> to; // value at the next key (for Slerp, negated if needed to take the short way around)
+	std::vector<float> angle; // Slerp: angle between from and to (0 when close enough to interpolate linearly)
+	std::vector<float> sin_angle; // Slerp: sin(angle)
+	std::vector<std::vector<uint32_t>> changed; // scratch: per chunk of tracks evaluated together, nodes that changed
+
+	// tracks are sorted by mode, for batched evaluation:
+	//  [0, linear_begin) are Step, [linear_begin, slerp_begin) are Linear, [slerp_begin, node.size()) are Slerp
+	uint32_t linear_begin = 0;
+	uint32_t slerp_begin = 0;
+};
+
 struct Document {
 	Scene scene;
 	std::vector<Node> nodes;
@@ -162,12 +242,29 @@ struct Document {
 	std::vector<Material> materials;
 	std::vector<Environment> environments;
 	std::vector<Light> lights;
+	Hierarchy hierarchy;
+	Animation animation;
 };
 
+//loads a '.s72' (or a cooked '.s72b'; see S72Binary.hpp):
+//  NOTE: if 'scene.s72b' sits next to 'scene.s72' and is up to date, it is loaded instead
 std::shared_ptr<Document> load_file(const std::string &path);
-std::shared_ptr<Document> load_string(const std::string &contents);
+std::shared_ptr<Document> load_string(std::string_view contents);
+
+//(re)builds doc.hierarchy from the resolved node references (load_file and load_string call this):
+//  NOTE: throws if a node is its own ancestor
+void build_hierarchy(Document &doc);
+
+//(re)builds doc.animation from doc.drivers (load_file and load_string call this):
+void compile_animation(Document &doc);
 
 std::vector<uint8_t> load_mesh_data(const std::string &base_path, const std::string &mesh);
 std::vector<uint8_t> load_mesh_data(const std::string &base_path, const Mesh &mesh);
 
+//bounding box of a mesh's vertices (position is assumed to be the first 3 floats of each vertex):
+std::pair<glm::vec3, glm::vec3> compute_mesh_aabb(const std::vector<uint8_t> &mesh_data, uint32_t count);
+
+//positions of a mesh's vertices (same layout assumption), e.g. for rasterizing it on the CPU:
+std::vector<glm::vec3> extract_mesh_positions(const std::vector<uint8_t> &mesh_data, uint32_t count);
+
 } // namespace S72Loader
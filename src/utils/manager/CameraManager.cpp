@@ -5,6 +5,11 @@
 #include <cmath>
 #include <glm/gtc/constants.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAMERA_MANAGER_SIMD 1
+#include <immintrin.h>
+#endif
+
 void CameraManager::create(const std::shared_ptr<S72Loader::Document> doc, 
 				const uint32_t swapchain_width, const uint32_t swapchain_height, 
 				const std::vector<SceneTree::CameraTreeData>& camera_tree_data, 
@@ -215,15 +220,26 @@ glm::mat4 CameraManager::get_view() const{
     return glm::lookAtRH(active_camera.camera_position, active_camera.camera_position +  active_camera.camera_forward, active_camera.camera_up);
 }
 
-CameraManager::Frustum CameraManager::get_frustum() const {
-	Frustum frustum;
-
+glm::mat4 CameraManager::get_culling_perspective() const {
 	const Camera& scene_camera = cameras[active_camera_index];
-	glm::mat4 view = glm::lookAtRH(scene_camera.camera_position, scene_camera.camera_position + scene_camera.camera_forward, scene_camera.camera_up);
 	glm::mat4 perspective = glm::perspectiveRH_ZO(scene_camera.camera_fov, scene_camera.aspect, scene_camera.camera_near, scene_camera.camera_far);
     perspective[1][1] *= -1.0f;
+	return perspective;
+}
+
+glm::mat4 CameraManager::get_culling_view() const {
+	const Camera& scene_camera = cameras[active_camera_index];
+	return glm::lookAtRH(scene_camera.camera_position, scene_camera.camera_position + scene_camera.camera_forward, scene_camera.camera_up);
+}
+
+glm::mat4 CameraManager::get_culling_clip_from_world() const {
+	return get_culling_perspective() * get_culling_view();
+}
 
-	glm::mat4 vp = perspective * view;
+CameraManager::Frustum CameraManager::get_frustum() const {
+	Frustum frustum;
+
+	glm::mat4 vp = get_culling_clip_from_world();
 	
 	// Extract frustum planes from view-projection matrix
 	// Left plane
@@ -260,6 +276,27 @@ CameraManager::Frustum CameraManager::get_frustum() const {
 	return frustum;
 }
 
+CameraManager::Frustum CameraManager::Frustum::from_matrix(const glm::mat4& clip_from_world) {
+	const glm::mat4& m = clip_from_world;
+	auto row = [&m](int r) { return glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+
+	// inside is -w <= x <= w, -w <= y <= w, 0 <= z <= w
+	const std::array<glm::vec4, 6> equations{
+		row(3) + row(0), row(3) - row(0),
+		row(3) + row(1), row(3) - row(1),
+		row(2), row(3) - row(2),
+	};
+
+	Frustum frustum;
+	for (size_t p = 0; p < equations.size(); ++p) {
+		const glm::vec3 normal(equations[p]);
+		const float len = glm::length(normal);
+		frustum.planes[p].normal = normal / len;
+		frustum.planes[p].distance = equations[p].w / len;
+	}
+	return frustum;
+}
+
 bool CameraManager::Frustum::is_box_visible(const glm::vec3& min, const glm::vec3& max) const {
     const glm::vec3 center = (min + max) * 0.5f;
     const glm::vec3 extent = (max - min) * 0.5f;
@@ -274,6 +311,115 @@ bool CameraManager::Frustum::is_box_visible(const glm::vec3& min, const glm::vec
     return true;
 }
 
+namespace {
+	// Batch culling math, shared by the SIMD and scalar paths (same operations in the same order, so
+	// a box gets the same answer whichever lane or path tests it):
+	//   world center = transform * (center, 1), world extent = |transform| * extent,
+	//   culled if (n . world center + distance) + (|n| . world extent) < 0 for any plane
+	template<typename Ops>
+	typename Ops::Mask boxes_culled(const CameraManager::Frustum& frustum, const CameraManager::BoxBatch& boxes, size_t i) {
+		using V = typename Ops::V;
+		V center[3], extent[3];
+		for (int a = 0; a < 3; ++a) {
+			center[a] = Ops::load(&boxes.center[a][i]);
+			extent[a] = Ops::load(&boxes.extent[a][i]);
+		}
+		V world_center[3], world_extent[3];
+		for (int row = 0; row < 3; ++row) {
+			const auto& m = boxes.transform[row];
+			const V m0 = Ops::load(&m[0][i]), m1 = Ops::load(&m[1][i]), m2 = Ops::load(&m[2][i]);
+			world_center[row] = Ops::add(Ops::add(Ops::add(Ops::mul(m0, center[0]), Ops::mul(m1, center[1])), Ops::mul(m2, center[2])), Ops::load(&m[3][i]));
+			world_extent[row] = Ops::add(Ops::add(Ops::mul(Ops::abs(m0), extent[0]), Ops::mul(Ops::abs(m1), extent[1])), Ops::mul(Ops::abs(m2), extent[2]));
+		}
+		typename Ops::Mask culled = Ops::none();
+		for (const auto& plane : frustum.planes) {
+			const V nx = Ops::set(plane.normal.x), ny = Ops::set(plane.normal.y), nz = Ops::set(plane.normal.z);
+			const V d = Ops::add(Ops::add(Ops::add(Ops::mul(nx, world_center[0]), Ops::mul(ny, world_center[1])), Ops::mul(nz, world_center[2])), Ops::set(plane.distance));
+			const V r = Ops::add(Ops::add(Ops::mul(Ops::abs(nx), world_extent[0]), Ops::mul(Ops::abs(ny), world_extent[1])), Ops::mul(Ops::abs(nz), world_extent[2]));
+			culled = Ops::or_less_than_zero(culled, Ops::add(d, r));
+		}
+		return culled;
+	}
+
+	struct ScalarOps {
+		static constexpr size_t Width = 1;
+		using V = float;
+		using Mask = bool;
+		static V load(const float* p) { return *p; }
+		static V set(float x) { return x; }
+		static V add(V a, V b) { return a + b; }
+		static V mul(V a, V b) { return a * b; }
+		static V abs(V a) { return std::fabs(a); }
+		static Mask none() { return false; }
+		static Mask or_less_than_zero(Mask m, V a) { return m || (a < 0.0f); }
+		static uint32_t bits(Mask m) { return m ? 1u : 0u; }
+	};
+
+#if defined(__AVX512F__)
+	struct WideOps {
+		static constexpr size_t Width = 16;
+		using V = __m512;
+		using Mask = __mmask16;
+		static V load(const float* p) { return _mm512_loadu_ps(p); }
+		static V set(float x) { return _mm512_set1_ps(x); }
+		static V add(V a, V b) { return _mm512_add_ps(a, b); }
+		static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+		static V abs(V a) { return _mm512_abs_ps(a); }
+		static Mask none() { return 0; }
+		static Mask or_less_than_zero(Mask m, V a) { return Mask(m | _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_LT_OQ)); }
+		static uint32_t bits(Mask m) { return uint32_t(m); }
+	};
+#elif defined(__AVX__)
+	struct WideOps {
+		static constexpr size_t Width = 8;
+		using V = __m256;
+		using Mask = __m256;
+		static V load(const float* p) { return _mm256_loadu_ps(p); }
+		static V set(float x) { return _mm256_set1_ps(x); }
+		static V add(V a, V b) { return _mm256_add_ps(a, b); }
+		static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+		static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static Mask none() { return _mm256_setzero_ps(); }
+		static Mask or_less_than_zero(Mask m, V a) { return _mm256_or_ps(m, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ)); }
+		static uint32_t bits(Mask m) { return uint32_t(_mm256_movemask_ps(m)); }
+	};
+#elif defined(CAMERA_MANAGER_SIMD)
+	struct WideOps {
+		static constexpr size_t Width = 4;
+		using V = __m128;
+		using Mask = __m128;
+		static V load(const float* p) { return _mm_loadu_ps(p); }
+		static V set(float x) { return _mm_set1_ps(x); }
+		static V add(V a, V b) { return _mm_add_ps(a, b); }
+		static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+		static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static Mask none() { return _mm_setzero_ps(); }
+		static Mask or_less_than_zero(Mask m, V a) { return _mm_or_ps(m, _mm_cmplt_ps(a, _mm_setzero_ps())); }
+		static uint32_t bits(Mask m) { return uint32_t(_mm_movemask_ps(m)); }
+	};
+#else
+	using WideOps = ScalarOps; // no SIMD path for this target; the compiler may still vectorize the scalar loop
+#endif
+}
+
+void CameraManager::Frustum::are_boxes_visible(const BoxBatch& boxes, std::vector<uint64_t>& visible) const {
+	const size_t count = boxes.size();
+	visible.assign((count + 63) / 64, 0);
+
+	// Width divides 64, so each group of boxes lands inside one mask word
+	constexpr uint64_t group_bits = (uint64_t(1) << WideOps::Width) - 1;
+	size_t i = 0;
+	for (; i + WideOps::Width <= count; i += WideOps::Width) {
+		const uint64_t culled = WideOps::bits(boxes_culled<WideOps>(*this, boxes, i));
+		visible[i / 64] |= (~culled & group_bits) << (i % 64);
+	}
+	for (; i < count; ++i) {
+		if (!boxes_culled<ScalarOps>(*this, boxes, i)) {
+			visible[i / 64] |= uint64_t(1) << (i % 64);
+		}
+	}
+}
+
 void CameraManager::on_input(const InputEvent& event) {
 	if (event.type == InputEvent::KeyDown) {
 		if (event.key.key >= 0 && event.key.key <= GLFW_KEY_LAST) {
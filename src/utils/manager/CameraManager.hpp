@@ -10,6 +10,7 @@
 #include <GLFW/glfw3.h>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 #include <array>
 
 class CameraManager {
@@ -20,11 +21,50 @@ public:
 		float distance;
 	};
 	
+	// Boxes for batch culling, as structure-of-arrays (entry i of every array belongs to box i):
+	struct BoxBatch {
+		std::array<std::vector<float>, 3> center; // local-space box center x, y, z
+		std::array<std::vector<float>, 3> extent; // local-space box half-size x, y, z
+		std::array<std::array<std::vector<float>, 4>, 3> transform; // local-to-world affine transform, [row][column]
+
+		size_t size() const { return center[0].size(); }
+
+		void resize(size_t count) {
+			for (auto& v : center) v.resize(count);
+			for (auto& v : extent) v.resize(count);
+			for (auto& row : transform) {
+				for (auto& v : row) v.resize(count);
+			}
+		}
+
+		// Store box i from its local bounds and (affine) model matrix
+		void set(size_t i, const glm::vec3& min, const glm::vec3& max, const glm::mat4& model) {
+			for (int a = 0; a < 3; ++a) {
+				center[a][i] = (min[a] + max[a]) * 0.5f;
+				extent[a][i] = (max[a] - min[a]) * 0.5f;
+			}
+			for (int row = 0; row < 3; ++row) {
+				for (int column = 0; column < 4; ++column) {
+					transform[row][column][i] = model[column][row];
+				}
+			}
+		}
+	};
+
 	// Frustum structure with 6 planes
 	struct Frustum {
 		std::array<FrustumPlane, 6> planes; // left, right, bottom, top, near, far
-		
+
 		bool is_box_visible(const glm::vec3& min, const glm::vec3& max) const;
+
+		// Frustum of a world-to-clip matrix with Vulkan's [0, 1] depth range (reversed or not);
+		// planes[4] and planes[5] are the two depth planes
+		static Frustum from_matrix(const glm::mat4& clip_from_world);
+
+		// Test every box in the batch; afterwards bit (i % 64) of visible[i / 64] is set if box i may be visible.
+		// Boxes go through the planes 4, 8 or 16 at a time (SSE2, AVX or AVX-512, whichever the build targets),
+		// with each world-space box taken as transformed center +- |transform| * extent
+		void are_boxes_visible(const BoxBatch& boxes, std::vector<uint64_t>& visible) const;
 	};
 
 	// Camera data structure
@@ -71,6 +111,11 @@ public:
 	
 	// Get current frustum for culling
 	Frustum get_frustum() const;
+
+	// World-to-clip matrix get_frustum() is taken from: the scene camera's (never the debug camera's), depth not reversed
+	glm::mat4 get_culling_clip_from_world() const;
+	glm::mat4 get_culling_perspective() const;
+	glm::mat4 get_culling_view() const;
 	
 	Camera& get_active_camera() { return open_debug_camera ? debug_camera : cameras[active_camera_index]; }
 	const Camera& get_active_camera() const { return open_debug_camera ? debug_camera : cameras[active_camera_index]; }
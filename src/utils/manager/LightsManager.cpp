@@ -37,6 +37,34 @@ namespace {
 		}
 	}
 
+	// Run fn(i) for i in [0, count), spread over jobs if there are any
+	template< typename F >
+	void for_each_index(JobSystem* jobs, size_t count, const F& fn) {
+		if (jobs) {
+			jobs->parallel_for(count, 1, [&fn](size_t, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) fn(i);
+			});
+		} else {
+			for (size_t i = 0; i < count; ++i) fn(i);
+		}
+	}
+
+	// Size the per-view lists for a new frame
+	void begin_casters(LightsManager::ShadowCasters& casters, size_t view_count) {
+		casters.view_lists.resize(view_count);
+		for (auto& list : casters.view_lists) list.clear();
+	}
+
+	// Concatenate the per-view lists, in view order
+	void finish_casters(LightsManager::ShadowCasters& casters) {
+		casters.instances.clear();
+		casters.view_first.assign(1, 0);
+		for (const auto& list : casters.view_lists) {
+			casters.instances.insert(casters.instances.end(), list.begin(), list.end());
+			casters.view_first.emplace_back(uint32_t(casters.instances.size()));
+		}
+	}
+
 	template< typename LightsT >
 	void overwrite_lights_payload(const LightsT& lights, std::vector<uint8_t>& bytes) {
 		using LightT = typename std::decay_t<LightsT>::value_type;
@@ -349,6 +377,7 @@ void LightsManager::create(
 			dst.shadow = static_cast<int32_t>(src_light.shadow);
 			dst.near_plane = 0.1f;
 			dst.far_plane = dst.limit;
+			dst.atlas_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
 			if (has_shadow) shadow_spot_lights.emplace_back(std::move(dst));
 			else spot_lights.emplace_back(std::move(dst));
 		}
@@ -483,5 +512,85 @@ void LightsManager::update(
 	overwrite_lights_payload(shadow_sphere_matrices, shadow_sphere_matrices_bytes);
 }
 
+void LightsManager::set_shadow_spot_atlas_tile(uint32_t index, const glm::mat4& perspective, const glm::vec4& atlas_rect, int32_t resolution) {
+	SpotLight light = shadow_spot_lights.at(index);
+	light.perspective = perspective;
+	light.atlas_rect = atlas_rect;
+	light.shadow = resolution;
+	std::memcpy(shadow_spot_lights_bytes.data() + sizeof(LightsHeader) + sizeof(SpotLight) * index, &light, sizeof(SpotLight));
+}
+
 // Compute shader integration replaces the CPU tile packing functions.
 
+CameraManager::Frustum LightsManager::sun_cascade_frustum(const SunLight& sun, uint32_t cascade) {
+	CameraManager::Frustum frustum = CameraManager::Frustum::from_matrix(sun.orthographic[cascade]);
+	// the depth plane facing the sun bounds the volume on the light side; anything past it still casts into the cascade
+	for (size_t p = 4; p < 6; ++p) {
+		if (glm::dot(frustum.planes[p].normal, sun.direction) > 0.0f) {
+			frustum.planes[p] = CameraManager::FrustumPlane{glm::vec3(0.0f), std::numeric_limits<float>::max()};
+		}
+	}
+	return frustum;
+}
+
+void LightsManager::get_shadow_view_frustums(std::vector<CameraManager::Frustum>& out) const {
+	for (const SunLight& sun : shadow_sun_lights) {
+		for (uint32_t cascade = 0; cascade < SunCascadeCount; ++cascade) {
+			out.emplace_back(sun_cascade_frustum(sun, cascade));
+		}
+	}
+	for (const SphereShadowMatrices& matrices : shadow_sphere_matrices) {
+		for (uint32_t face = 0; face < SphereShadowFaceCount; ++face) {
+			out.emplace_back(CameraManager::Frustum::from_matrix(matrices.face_pv[face]));
+		}
+	}
+	for (const SpotLight& spot : shadow_spot_lights) {
+		out.emplace_back(CameraManager::Frustum::from_matrix(spot.perspective));
+	}
+}
+
+void LightsManager::cull_shadow_casters(
+	const BVH& bvh,
+	const std::vector<SunLight>& suns,
+	const std::vector<SphereLight>& spheres,
+	const std::vector<SphereShadowMatrices>& sphere_matrices,
+	const std::vector<SpotLight>& spots,
+	ShadowCasters& sun_casters,
+	ShadowCasters& sphere_casters,
+	ShadowCasters& spot_casters,
+	JobSystem* jobs
+) {
+	assert(sphere_matrices.size() == spheres.size());
+
+	begin_casters(sun_casters, suns.size() * SunCascadeCount);
+	for_each_index(jobs, sun_casters.view_lists.size(), [&](size_t view) {
+		bvh.cull(sun_cascade_frustum(suns[view / SunCascadeCount], uint32_t(view % SunCascadeCount)), sun_casters.view_lists[view]);
+	});
+	finish_casters(sun_casters);
+
+	begin_casters(sphere_casters, spheres.size() * SphereShadowFaceCount);
+	for_each_index(jobs, spheres.size(), [&](size_t light) {
+		// one range query for the light, then split among the faces (a box on a face edge goes to both)
+		std::vector<uint32_t> candidates;
+		bvh.overlap_sphere(spheres[light].position, spheres[light].far_plane, candidates);
+		std::array<CameraManager::Frustum, SphereShadowFaceCount> faces;
+		for (uint32_t face = 0; face < SphereShadowFaceCount; ++face) {
+			faces[face] = CameraManager::Frustum::from_matrix(sphere_matrices[light].face_pv[face]);
+		}
+		for (uint32_t item : candidates) {
+			const BVH::Box& box = bvh.item_bounds(item);
+			for (uint32_t face = 0; face < SphereShadowFaceCount; ++face) {
+				if (faces[face].is_box_visible(box.min, box.max)) {
+					sphere_casters.view_lists[light * SphereShadowFaceCount + face].emplace_back(item);
+				}
+			}
+		}
+	});
+	finish_casters(sphere_casters);
+
+	begin_casters(spot_casters, spots.size());
+	for_each_index(jobs, spots.size(), [&](size_t light) {
+		bvh.cull(CameraManager::Frustum::from_matrix(spots[light].perspective), spot_casters.view_lists[light]);
+	});
+	finish_casters(spot_casters);
+}
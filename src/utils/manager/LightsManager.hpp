@@ -8,6 +8,8 @@
 #include "SceneTree.hpp"
 #include "A3CommonData.hpp"
 #include "CameraManager.hpp"
+#include "BVH.hpp"
+#include "JobSystem.hpp"
 
 #include <vulkan/vulkan.h>
 #include <vector>
@@ -17,6 +19,7 @@
 
 class LightsManager {
 public:
+	static constexpr uint32_t SunCascadeCount = 4;
 	static constexpr uint32_t SphereShadowFaceCount = 6;
 
 	struct alignas(16) SunLight {
@@ -52,8 +55,9 @@ public:
         int32_t shadow;
 		float near_plane;
 		float far_plane;
+		glm::vec4 atlas_rect; // (offset, size) of its map in the shadow map's uv; all of it unless it is an atlas tile
     };
-	static_assert(sizeof(SpotLight) == 128, "SpotLight must match std430 layout.");
+	static_assert(sizeof(SpotLight) == 144, "SpotLight must match std430 layout.");
 
     struct alignas(16) LightsHeader {
         uint32_t count;
@@ -66,6 +70,59 @@ public:
 	};
 	static_assert(sizeof(SphereShadowMatrices) == 384, "SphereShadowMatrices must match std430 layout.");
 
+	// Shadow casters of every view of one kind of shadow light, as items of the BVH they were culled from.
+	// View v draws instances[first(v)] .. instances[first(v) + count(v) - 1]
+	struct ShadowCasters {
+		std::vector<uint32_t> instances;
+		std::vector<uint32_t> view_first; // view_count() + 1 entries
+
+		uint32_t view_count() const { return view_first.empty() ? 0 : uint32_t(view_first.size() - 1); }
+		uint32_t first(uint32_t view) const { return view_first[view]; }
+		uint32_t count(uint32_t view) const { return view_first[view + 1] - view_first[view]; }
+
+		std::vector<std::vector<uint32_t>> view_lists; // (per-view scratch, kept to reuse allocations)
+	};
+
+	// Cull casters for each shadow view: sun cascades (view light * SunCascadeCount + cascade) against their
+	// orthographic volume with the light-side plane dropped, so casters between the sun and the cascade still count;
+	// sphere faces (view light * SphereShadowFaceCount + face) within the light's far_plane and the face frustum;
+	// spots (view light) against their frustum
+	static void cull_shadow_casters(
+		const BVH& bvh,
+		const std::vector<SunLight>& suns,
+		const std::vector<SphereLight>& spheres,
+		const std::vector<SphereShadowMatrices>& sphere_matrices,
+		const std::vector<SpotLight>& spots,
+		ShadowCasters& sun_casters,
+		ShadowCasters& sphere_casters,
+		ShadowCasters& spot_casters,
+		JobSystem* jobs = nullptr
+	);
+
+	// Same, for this manager's shadow lights
+	void cull_shadow_casters(
+		const BVH& bvh,
+		ShadowCasters& sun_casters,
+		ShadowCasters& sphere_casters,
+		ShadowCasters& spot_casters,
+		JobSystem* jobs = nullptr
+	) const {
+		cull_shadow_casters(bvh, shadow_sun_lights, shadow_sphere_lights, shadow_sphere_matrices, shadow_spot_lights,
+			sun_casters, sphere_casters, spot_casters, jobs);
+	}
+
+	// Culling volume of one sun cascade (as used by cull_shadow_casters)
+	static CameraManager::Frustum sun_cascade_frustum(const SunLight& sun, uint32_t cascade);
+
+	// Append the frustum of each of this manager's shadow views to 'out', in the view order of cull_shadow_casters:
+	// sun cascades, then sphere faces, then spots (sphere faces are not limited to the light's far_plane here)
+	void get_shadow_view_frustums(std::vector<CameraManager::Frustum>& out) const;
+
+	// Point shadow spot light 'index' at a tile of a shadow atlas, in its uploaded bytes only (until the next update):
+	// 'atlas_rect' is the tile's (offset, size) in uv, drawn 'resolution' texels wide with 'perspective'
+	// (an empty rect leaves the light unshadowed)
+	void set_shadow_spot_atlas_tile(uint32_t index, const glm::mat4& perspective, const glm::vec4& atlas_rect, int32_t resolution);
+
 	// Storage buffer capacities for the Compute Shader.
 	// Buffer layout: [tiles_x: u32][tiles_y: u32][TileInfo × (tiles_x*tiles_y)]
 	inline VkDeviceSize tile_data_buffer_size(uint32_t tile_count) const {
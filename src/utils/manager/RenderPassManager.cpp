@@ -24,6 +24,8 @@ void RenderPassManager::create(
 		(shadow_buffer_manager && shadow_buffer_manager->depth_format != VK_FORMAT_UNDEFINED)
 			? shadow_buffer_manager->depth_format
 			: main_depth_format;
+	//occlusion culling builds a depth pyramid from the main view's depth, and two-phase culling draws on top of it:
+	bool const keep_main_depth = (rtg.configuration.occlusion_culling != OcclusionCullingMode::Disabled);
 
 	{ //create render pass
 		//attachments
@@ -121,11 +123,11 @@ void RenderPassManager::create(
 				.format = main_depth_format,
 				.samples = VK_SAMPLE_COUNT_1_BIT,
 				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-				.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.storeOp = keep_main_depth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
 				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				.finalLayout = keep_main_depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 			},
 		};
 
@@ -180,6 +182,45 @@ void RenderPassManager::create(
 		};
 
 		VK( vkCreateRenderPass(rtg.device, &hdr_create_info, nullptr, &hdr_render_pass) );
+
+		if (keep_main_depth) { // HDR load render pass: the second phase of two-phase occlusion culling draws on top of the first
+			std::array< VkAttachmentDescription, 2 > load_attachments = hdr_attachments;
+			for (VkAttachmentDescription &attachment : load_attachments) {
+				attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				attachment.initialLayout = attachment.finalLayout;
+			}
+
+			std::array< VkSubpassDependency, 2 > load_dependencies{
+				VkSubpassDependency{ // color drawn by the first phase
+					.srcSubpass = VK_SUBPASS_EXTERNAL,
+					.dstSubpass = 0,
+					.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+					.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+					.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				},
+				VkSubpassDependency{ // depth drawn by the first phase, then read to build the depth pyramid
+					.srcSubpass = VK_SUBPASS_EXTERNAL,
+					.dstSubpass = 0,
+					.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+					.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				},
+			};
+
+			VkRenderPassCreateInfo load_create_info{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+				.attachmentCount = uint32_t(load_attachments.size()),
+				.pAttachments = load_attachments.data(),
+				.subpassCount = 1,
+				.pSubpasses = &hdr_subpass,
+				.dependencyCount = uint32_t(load_dependencies.size()),
+				.pDependencies = load_dependencies.data(),
+			};
+
+			VK( vkCreateRenderPass(rtg.device, &load_create_info, nullptr, &hdr_load_render_pass) );
+		}
 	}
 
 	{ // Create GBuffer render pass (for deferred geometry writes)
@@ -265,6 +306,45 @@ void RenderPassManager::create(
 		};
 
 		VK( vkCreateRenderPass(rtg.device, &gbuffer_create_info, nullptr, &gbuffer_render_pass) );
+
+		if (keep_main_depth) { // GBuffer load render pass: the second phase of two-phase occlusion culling writes on top of the first
+			std::array< VkAttachmentDescription, 3 > load_attachments = gbuffer_attachments;
+			for (VkAttachmentDescription &attachment : load_attachments) {
+				attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				attachment.initialLayout = attachment.finalLayout;
+			}
+
+			std::array< VkSubpassDependency, 2 > load_dependencies{
+				VkSubpassDependency{ // color drawn by the first phase
+					.srcSubpass = VK_SUBPASS_EXTERNAL,
+					.dstSubpass = 0,
+					.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+					.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+					.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				},
+				VkSubpassDependency{ // depth drawn by the first phase, then read to build the depth pyramid
+					.srcSubpass = VK_SUBPASS_EXTERNAL,
+					.dstSubpass = 0,
+					.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+					.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				},
+			};
+
+			VkRenderPassCreateInfo load_create_info{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+				.attachmentCount = uint32_t(load_attachments.size()),
+				.pAttachments = load_attachments.data(),
+				.subpassCount = 1,
+				.pSubpasses = &gbuffer_subpass,
+				.dependencyCount = uint32_t(load_dependencies.size()),
+				.pDependencies = load_dependencies.data(),
+			};
+
+			VK( vkCreateRenderPass(rtg.device, &load_create_info, nullptr, &gbuffer_load_render_pass) );
+		}
 	}
 
 	{ // Create AO render pass (fullscreen AO output)
@@ -432,6 +512,97 @@ void RenderPassManager::create(
 		};
 
 		VK( vkCreateRenderPass(rtg.device, &shadow_create_info, nullptr, &shadow_render_pass) );
+
+		if (rtg.configuration.shadow_cache == ShadowCacheMode::SplitShadowCache) { // Shadow load render pass: moving casters drawn over a copy of the static casters' map
+			std::array< VkAttachmentDescription, 1 > load_attachments = shadow_attachments;
+			load_attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			load_attachments[0].initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+			std::array< VkSubpassDependency, 2 > load_dependencies = shadow_dependencies;
+			load_dependencies[0] = VkSubpassDependency{ // the copy
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			};
+
+			VkRenderPassCreateInfo load_create_info{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+				.attachmentCount = uint32_t(load_attachments.size()),
+				.pAttachments = load_attachments.data(),
+				.subpassCount = 1,
+				.pSubpasses = &shadow_subpass,
+				.dependencyCount = uint32_t(load_dependencies.size()),
+				.pDependencies = load_dependencies.data(),
+			};
+
+			VK( vkCreateRenderPass(rtg.device, &load_create_info, nullptr, &shadow_load_render_pass) );
+		}
+
+		if (rtg.configuration.shadow_atlas != 0) { // Shadow atlas render pass: load ops only touch the render area, so other tiles survive
+			std::array< VkAttachmentDescription, 1 > atlas_attachments = shadow_attachments;
+			atlas_attachments[0].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+			std::array< VkSubpassDependency, 2 > atlas_dependencies = shadow_dependencies;
+			atlas_dependencies[0] = VkSubpassDependency{ // lighting reading the atlas, and other tiles' passes (the layout changes cover the whole image)
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			};
+
+			VkRenderPassCreateInfo atlas_create_info{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+				.attachmentCount = uint32_t(atlas_attachments.size()),
+				.pAttachments = atlas_attachments.data(),
+				.subpassCount = 1,
+				.pSubpasses = &shadow_subpass,
+				.dependencyCount = uint32_t(atlas_dependencies.size()),
+				.pDependencies = atlas_dependencies.data(),
+			};
+
+			VK( vkCreateRenderPass(rtg.device, &atlas_create_info, nullptr, &shadow_atlas_render_pass) );
+		}
+
+		if (rtg.configuration.layered_shadows) { // Shadow cube render pass: view i draws into layer i (face i), and the clear covers all six
+			const uint32_t cube_view_mask = (1u << 6) - 1;
+			VkRenderPassMultiviewCreateInfo cube_multiview{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+				.subpassCount = 1,
+				.pViewMasks = &cube_view_mask,
+				.dependencyCount = 0,
+				.pViewOffsets = nullptr,
+				.correlationMaskCount = 1,
+				.pCorrelationMasks = &cube_view_mask, //(the faces share casters, so they may be drawn concurrently)
+			};
+
+			VkRenderPassCreateInfo cube_create_info = shadow_create_info;
+			cube_create_info.pNext = &cube_multiview;
+
+			VK( vkCreateRenderPass(rtg.device, &cube_create_info, nullptr, &shadow_cube_render_pass) );
+		}
+
+		if (rtg.configuration.layered_shadows) { // Shadow cascade render pass: the same, view i drawing into layer i (cascade i) of a sun's map
+			const uint32_t cascade_view_mask = (1u << 4) - 1;
+			VkRenderPassMultiviewCreateInfo cascade_multiview{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO,
+				.subpassCount = 1,
+				.pViewMasks = &cascade_view_mask,
+				.dependencyCount = 0,
+				.pViewOffsets = nullptr,
+				.correlationMaskCount = 1,
+				.pCorrelationMasks = &cascade_view_mask, //(neighbouring cascades overlap, so they share most casters)
+			};
+
+			VkRenderPassCreateInfo cascade_create_info = shadow_create_info;
+			cascade_create_info.pNext = &cascade_multiview;
+
+			VK( vkCreateRenderPass(rtg.device, &cascade_create_info, nullptr, &shadow_cascade_render_pass) );
+		}
 	}
 }
 
@@ -446,11 +617,21 @@ void RenderPassManager::destroy(RTG& rtg) {
 		hdr_render_pass = VK_NULL_HANDLE;
 	}
 
+	if (hdr_load_render_pass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(rtg.device, hdr_load_render_pass, nullptr);
+		hdr_load_render_pass = VK_NULL_HANDLE;
+	}
+
 	if (gbuffer_render_pass != VK_NULL_HANDLE) {
 		vkDestroyRenderPass(rtg.device, gbuffer_render_pass, nullptr);
 		gbuffer_render_pass = VK_NULL_HANDLE;
 	}
 
+	if (gbuffer_load_render_pass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(rtg.device, gbuffer_load_render_pass, nullptr);
+		gbuffer_load_render_pass = VK_NULL_HANDLE;
+	}
+
 	if (ao_render_pass != VK_NULL_HANDLE) {
 		vkDestroyRenderPass(rtg.device, ao_render_pass, nullptr);
 		ao_render_pass = VK_NULL_HANDLE;
@@ -465,6 +646,26 @@ void RenderPassManager::destroy(RTG& rtg) {
 		vkDestroyRenderPass(rtg.device, shadow_render_pass, nullptr);
 		shadow_render_pass = VK_NULL_HANDLE;
 	}
+
+	if (shadow_load_render_pass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(rtg.device, shadow_load_render_pass, nullptr);
+		shadow_load_render_pass = VK_NULL_HANDLE;
+	}
+
+	if (shadow_atlas_render_pass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(rtg.device, shadow_atlas_render_pass, nullptr);
+		shadow_atlas_render_pass = VK_NULL_HANDLE;
+	}
+
+	if (shadow_cube_render_pass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(rtg.device, shadow_cube_render_pass, nullptr);
+		shadow_cube_render_pass = VK_NULL_HANDLE;
+	}
+
+	if (shadow_cascade_render_pass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(rtg.device, shadow_cascade_render_pass, nullptr);
+		shadow_cascade_render_pass = VK_NULL_HANDLE;
+	}
 }
 
 RenderPassManager::~RenderPassManager() {
@@ -474,6 +675,12 @@ RenderPassManager::~RenderPassManager() {
     if(hdr_render_pass != VK_NULL_HANDLE) {
         std::cerr << "[RenderPassManager] hdr_render_pass not properly destroyed" << std::endl;
     }
+    if(hdr_load_render_pass != VK_NULL_HANDLE) {
+        std::cerr << "[RenderPassManager] hdr_load_render_pass not properly destroyed" << std::endl;
+    }
+    if(gbuffer_load_render_pass != VK_NULL_HANDLE) {
+        std::cerr << "[RenderPassManager] gbuffer_load_render_pass not properly destroyed" << std::endl;
+    }
     if(tonemap_render_pass != VK_NULL_HANDLE) {
         std::cerr << "[RenderPassManager] tonemap_render_pass not properly destroyed" << std::endl;
     }
@@ -483,4 +690,16 @@ RenderPassManager::~RenderPassManager() {
 	if(shadow_render_pass != VK_NULL_HANDLE) {
 		std::cerr << "[RenderPassManager] spot_shadow_render_pass not properly destroyed" << std::endl;
 	}
+	if(shadow_load_render_pass != VK_NULL_HANDLE) {
+		std::cerr << "[RenderPassManager] shadow_load_render_pass not properly destroyed" << std::endl;
+	}
+	if(shadow_atlas_render_pass != VK_NULL_HANDLE) {
+		std::cerr << "[RenderPassManager] shadow_atlas_render_pass not properly destroyed" << std::endl;
+	}
+	if(shadow_cube_render_pass != VK_NULL_HANDLE) {
+		std::cerr << "[RenderPassManager] shadow_cube_render_pass not properly destroyed" << std::endl;
+	}
+	if(shadow_cascade_render_pass != VK_NULL_HANDLE) {
+		std::cerr << "[RenderPassManager] shadow_cascade_render_pass not properly destroyed" << std::endl;
+	}
 }
\ No newline at end of file
@@ -29,9 +29,15 @@ public:
     // HDR render pass: scene -> HDR texture (with depth)
     VkRenderPass hdr_render_pass = VK_NULL_HANDLE;
 
+    // HDR load render pass: keeps HDR color and depth (second phase of two-phase occlusion culling only)
+    VkRenderPass hdr_load_render_pass = VK_NULL_HANDLE;
+
     // GBuffer render pass: scene geometry -> deferred textures (with depth)
     VkRenderPass gbuffer_render_pass = VK_NULL_HANDLE;
 
+    // GBuffer load render pass: keeps the deferred textures and depth (second phase of two-phase occlusion culling only)
+    VkRenderPass gbuffer_load_render_pass = VK_NULL_HANDLE;
+
     // AO render pass: fullscreen AO resolve -> AO texture (no depth)
     VkRenderPass ao_render_pass = VK_NULL_HANDLE;
 
@@ -41,4 +47,16 @@ public:
     // Spot shadow render pass: depth-only rendering for spot light shadow maps
     VkRenderPass shadow_render_pass = VK_NULL_HANDLE;
 
+    // Shadow load render pass: keeps the depth copied in from a static shadow map (split shadow caching only)
+    VkRenderPass shadow_load_render_pass = VK_NULL_HANDLE;
+
+    // Shadow atlas render pass: clears and draws one tile (the render area), keeping the rest of the atlas (--shadow-atlas only)
+    VkRenderPass shadow_atlas_render_pass = VK_NULL_HANDLE;
+
+    // Shadow cube render pass: all six faces of a sphere light's cube map at once, one multiview view per face (--layered-shadows only)
+    VkRenderPass shadow_cube_render_pass = VK_NULL_HANDLE;
+
+    // Shadow cascade render pass: all cascades of a sun's map at once, one multiview view per cascade (--layered-shadows only)
+    VkRenderPass shadow_cascade_render_pass = VK_NULL_HANDLE;
+
 };
\ No newline at end of file
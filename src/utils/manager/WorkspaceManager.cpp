@@ -1,5 +1,7 @@
 #include "WorkspaceManager.hpp"
 
+#include <algorithm>
+
 const std::unordered_map<VkDescriptorType, VkBufferUsageFlagBits> WorkspaceManager::descriptor_type_to_buffer_usage{{
     {VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT},
     {VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VkBufferUsageFlagBits::VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT}
@@ -34,6 +36,7 @@ WorkspaceManager::Workspace::DescriptorSetGroup& WorkspaceManager::Workspace::De
 
 WorkspaceManager::Workspace::Workspace(Workspace&& other) noexcept
     : command_buffer(std::move(other.command_buffer)),
+        thread_command_pools(std::move(other.thread_command_pools)),
         manager(std::move(other.manager)),
         pipeline_descriptor_set_groups(std::move(other.pipeline_descriptor_set_groups)),
         global_buffer_pairs(std::move(other.global_buffer_pairs)),
@@ -45,6 +48,7 @@ WorkspaceManager::Workspace::Workspace(Workspace&& other) noexcept
 WorkspaceManager::Workspace& WorkspaceManager::Workspace::operator=(Workspace&& other) noexcept {
     if (this != &other) {
         command_buffer = std::move(other.command_buffer);
+        thread_command_pools = std::move(other.thread_command_pools);
         manager = std::move(other.manager);
         pipeline_descriptor_set_groups = std::move(other.pipeline_descriptor_set_groups);
         global_buffer_pairs = std::move(other.global_buffer_pairs);
@@ -66,6 +70,18 @@ void WorkspaceManager::Workspace::create(RTG& rtg) {
         VK( vkAllocateCommandBuffers(rtg.device, &alloc_info, &command_buffer) );
     }
 
+    { // one pool of secondary command buffers per job thread (buffers are allocated as they are first needed)
+        thread_command_pools.resize(rtg.jobs.thread_count());
+        for (auto &thread_pool : thread_command_pools) {
+            VkCommandPoolCreateInfo create_info{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, //re-recorded every render (reset when begun)
+                .queueFamilyIndex = rtg.graphics_queue_family.value(),
+            };
+            VK( vkCreateCommandPool(rtg.device, &create_info, nullptr, &thread_pool.pool) );
+        }
+    }
+
     // Create buffer pairs for each pipeline
     pipeline_descriptor_set_groups.resize(manager->block_descriptor_configs_by_pipeline.size());
     for (size_t pipeline_index = 0; pipeline_index < manager->block_descriptor_configs_by_pipeline.size(); ++pipeline_index) {
@@ -98,12 +114,14 @@ void WorkspaceManager::Workspace::create(RTG& rtg) {
     for(auto &global_buffer_config : manager->global_buffer_configs) {
         auto new_pair = std::make_shared<BufferPair>();
 
-        new_pair->host = rtg.helpers.create_buffer(
-            global_buffer_config.size, 
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            Helpers::Mapped
-        );
+        if (!global_buffer_config.device_only) {
+            new_pair->host = rtg.helpers.create_buffer(
+                global_buffer_config.size, 
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                Helpers::Mapped
+            );
+        }
 
         new_pair->device = rtg.helpers.create_buffer(
             global_buffer_config.size,
@@ -130,6 +148,11 @@ void WorkspaceManager::Workspace::destroy(RTG &rtg) {
         command_buffer = VK_NULL_HANDLE;
     }
 
+    for (auto &thread_pool : thread_command_pools) {
+        vkDestroyCommandPool(rtg.device, thread_pool.pool, nullptr); //(frees its buffers)
+    }
+    thread_command_pools.clear();
+
     manager = nullptr;
 
     for(auto& [name, buffer_pair] : global_buffer_pairs) {
@@ -277,6 +300,42 @@ void WorkspaceManager::Workspace::update_global_descriptor(
     }
 }
 
+void WorkspaceManager::Workspace::update_global_buffer(
+    RTG& rtg, 
+    std::string buffer_name, 
+    VkDeviceSize size
+){
+    auto config = std::find_if(manager->global_buffer_configs.begin(), manager->global_buffer_configs.end(), [&](GlobalBufferConfig const &c) {
+        return c.name == buffer_name;
+    });
+    if (config == manager->global_buffer_configs.end()) {
+        throw std::runtime_error("No global buffer named '" + buffer_name + "'.");
+    }
+    auto& buffer_pair = global_buffer_pairs[buffer_name];
+
+    if(buffer_pair->host.handle != VK_NULL_HANDLE) {
+        rtg.helpers.destroy_buffer(std::move(buffer_pair->host));
+    }
+    if(buffer_pair->device.handle != VK_NULL_HANDLE) {
+        rtg.helpers.destroy_buffer(std::move(buffer_pair->device));
+    }
+
+    if (!config->device_only) {
+        buffer_pair->host = rtg.helpers.create_buffer(
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            Helpers::Mapped
+        );
+    }
+    buffer_pair->device = rtg.helpers.create_buffer(
+        size,
+        config->usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        Helpers::Unmapped
+    );
+}
+
 void WorkspaceManager::Workspace::update_data_buffer_pair(
     RTG& rtg, 
     uint32_t pipeline_index, 
@@ -335,6 +394,9 @@ void WorkspaceManager::Workspace::write_global_buffer(
     VkDeviceSize size
 ){
     auto& buffer_pair = global_buffer_pairs[buffer_name];
+    if (buffer_pair->host.handle == VK_NULL_HANDLE) {
+        throw std::runtime_error("Global buffer '" + buffer_name + "' is device-only; it can't be written from the CPU.");
+    }
 
     memcpy(buffer_pair->host.allocation.data(), data, size);
 
@@ -380,6 +442,35 @@ void WorkspaceManager::Workspace::end_recording(){
 
 void WorkspaceManager::Workspace::reset_recording(){
     VK( vkResetCommandBuffer(command_buffer, 0) );
+
+    // (secondary command buffers are reset when they are begun again)
+    for (auto &thread_pool : thread_command_pools) {
+        thread_pool.used = 0;
+    }
+}
+
+VkCommandBuffer WorkspaceManager::Workspace::begin_secondary_recording(RTG& rtg, VkCommandBufferInheritanceInfo const &inheritance){
+    assert(rtg.jobs.thread_index() < thread_command_pools.size());
+    ThreadCommandPool &thread_pool = thread_command_pools[rtg.jobs.thread_index()];
+
+    if (thread_pool.used == thread_pool.buffers.size()) {
+        VkCommandBufferAllocateInfo alloc_info{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = thread_pool.pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+        VK( vkAllocateCommandBuffers(rtg.device, &alloc_info, &thread_pool.buffers.emplace_back()) );
+    }
+    VkCommandBuffer secondary = thread_pool.buffers[thread_pool.used++];
+
+    VkCommandBufferBeginInfo begin_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, //entirely inside a render pass
+        .pInheritanceInfo = &inheritance,
+    };
+    VK( vkBeginCommandBuffer(secondary, &begin_info) );
+    return secondary;
 }
 
 void WorkspaceManager::create(
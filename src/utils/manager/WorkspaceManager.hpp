@@ -38,9 +38,18 @@ class WorkspaceManager {
             };
 
             VkCommandBuffer command_buffer = VK_NULL_HANDLE; //from the command pool above; reset at the start of every render.
+
+            //secondary command buffers, recorded in parallel by the job threads and executed from command_buffer;
+            //  each thread gets its own pool, since a pool's buffers can only be recorded by one thread at a time:
+            struct ThreadCommandPool {
+                VkCommandPool pool = VK_NULL_HANDLE;
+                std::vector<VkCommandBuffer> buffers; //allocated so far
+                uint32_t used = 0; //buffers handed out since the last reset_recording()
+            };
+            std::vector<ThreadCommandPool> thread_command_pools; // [JobSystem::thread_index()]
             WorkspaceManager *manager = nullptr;
             std::vector<std::vector<DescriptorSetGroup>> pipeline_descriptor_set_groups; // [pipelines_index][descriptor_set_index]
-            std::unordered_map<std::string, std::shared_ptr<BufferPair>> global_buffer_pairs; // buffer pairs that have a fixed size and are shared across pipelines; keyed by buffer name
+            std::unordered_map<std::string, std::shared_ptr<BufferPair>> global_buffer_pairs; // buffer pairs that have a fixed size and are shared across pipelines; keyed by buffer name (device_only ones have no host buffer)
             std::vector<std::vector<std::unique_ptr<BufferPair>>> data_buffer_pairs; // [pipelines_index][data_buffer_index] buffer pairs that need to be recreated per frame.
 
             void create(RTG& rtg);
@@ -81,6 +90,11 @@ class WorkspaceManager {
                 uint32_t descriptor_index, 
                 std::string buffer_name
             );
+            void update_global_buffer(
+                RTG& rtg, 
+                std::string buffer_name, 
+                VkDeviceSize size
+            ); // re-allocates a global buffer at a new size; descriptors pointing at it must be updated again
             void update_data_buffer_pair(
                 RTG& rtg, 
                 uint32_t pipeline_index, 
@@ -91,6 +105,28 @@ class WorkspaceManager {
             void end_recording();
             void reset_recording();
 
+            // begins the calling job thread's next secondary command buffer, to run within the subpass in 'inheritance'
+            VkCommandBuffer begin_secondary_recording(RTG& rtg, VkCommandBufferInheritanceInfo const &inheritance);
+
+            // records 'count' command sequences in parallel, each into its own secondary command buffer (secondaries[i]):
+            // record(i, command_buffer) records sequence i, which runs within the subpass inheritance_of(i) returns
+            template<typename InheritanceOf, typename Record>
+            void record_secondaries(
+                RTG& rtg, 
+                size_t count, 
+                InheritanceOf const &inheritance_of, 
+                Record const &record, 
+                std::vector<VkCommandBuffer> &secondaries
+            ) {
+                secondaries.resize(count);
+                rtg.jobs.parallel_for(count, 1, [&](size_t i, size_t, size_t) {
+                    VkCommandBuffer secondary = begin_secondary_recording(rtg, inheritance_of(i));
+                    record(i, secondary);
+                    VK( vkEndCommandBuffer(secondary) );
+                    secondaries[i] = secondary;
+                });
+            }
+
             Workspace(WorkspaceManager &manager) : manager(&manager) {}
             ~Workspace();
             Workspace(Workspace&& other) noexcept;
@@ -100,7 +136,8 @@ class WorkspaceManager {
         struct GlobalBufferConfig {
             std::string name;
             VkDeviceSize size;
-            VkBufferUsageFlagBits usage;
+            VkBufferUsageFlags usage;
+            bool device_only = false; //only written on the GPU (by shaders or fills): no host buffer, so no write_global_buffer
         };
 
         WorkspaceManager() = default;
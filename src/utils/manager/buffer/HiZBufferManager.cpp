@@ -0,0 +1,121 @@
+#include "HiZBufferManager.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+void HiZBufferManager::create(RTG &rtg) {
+    destroy(rtg);
+
+    VkSamplerCreateInfo sampler_info{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+        .unnormalizedCoordinates = VK_FALSE,
+    };
+
+    VK(vkCreateSampler(rtg.device, &sampler_info, nullptr, &sampler));
+}
+
+void HiZBufferManager::on_swapchain(RTG &rtg, VkExtent2D const &depth_extent) {
+    destroy_pyramid(rtg);
+
+    // halve (rounding down, at least one texel) until a 1x1 level:
+    level_count = 0;
+    VkExtent2D level_extent = depth_extent;
+    while (level_count < MaxLevels) {
+        level_extents[level_count++] = level_extent;
+        if (level_extent.width == 1 && level_extent.height == 1) break;
+        level_extent = VkExtent2D{
+            .width = std::max(1u, level_extent.width / 2),
+            .height = std::max(1u, level_extent.height / 2),
+        };
+    }
+
+    image = rtg.helpers.create_image(
+        depth_extent,
+        format,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        Helpers::Unmapped,
+        0,
+        level_count,
+        1
+    );
+
+    auto create_view = [&](uint32_t base_level, uint32_t count) {
+        VkImageViewCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image.handle,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = format,
+            .subresourceRange{
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = base_level,
+                .levelCount = count,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+
+        VkImageView image_view = VK_NULL_HANDLE;
+        VK(vkCreateImageView(rtg.device, &create_info, nullptr, &image_view));
+        return image_view;
+    };
+
+    view = create_view(0, level_count);
+    for (uint32_t level = 0; level < level_count; ++level) {
+        level_views[level] = create_view(level, 1);
+    }
+
+    rtg.helpers.transition_image_layout(image.handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, level_count, 1);
+}
+
+void HiZBufferManager::destroy_pyramid(RTG &rtg) {
+    for (VkImageView &level_view : level_views) {
+        if (level_view != VK_NULL_HANDLE) {
+            vkDestroyImageView(rtg.device, level_view, nullptr);
+            level_view = VK_NULL_HANDLE;
+        }
+    }
+
+    if (view != VK_NULL_HANDLE) {
+        vkDestroyImageView(rtg.device, view, nullptr);
+        view = VK_NULL_HANDLE;
+    }
+
+    if (image.handle != VK_NULL_HANDLE) {
+        rtg.helpers.destroy_image(std::move(image));
+    }
+
+    level_count = 0;
+}
+
+void HiZBufferManager::destroy(RTG &rtg) {
+    destroy_pyramid(rtg);
+
+    if (sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(rtg.device, sampler, nullptr);
+        sampler = VK_NULL_HANDLE;
+    }
+}
+
+HiZBufferManager::~HiZBufferManager() {
+    if (image.handle != VK_NULL_HANDLE || view != VK_NULL_HANDLE) {
+        std::cerr << "HiZBufferManager: depth pyramid not destroyed" << std::endl;
+    }
+    if (sampler != VK_NULL_HANDLE) {
+        std::cerr << "HiZBufferManager: sampler not destroyed" << std::endl;
+    }
+}
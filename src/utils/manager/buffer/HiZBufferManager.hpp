@@ -0,0 +1,37 @@
+#pragma once
+
+#include "RTG.hpp"
+#include "VK.hpp"
+
+#include <array>
+#include <cstdint>
+
+// Depth pyramid for occlusion culling (--occlusion-culling).
+// Level 0 matches the depth buffer; every texel of a later level holds the farthest depth
+// of the texels it covers on the level before, so one fetch bounds a whole screen rectangle.
+// The image stays in VK_IMAGE_LAYOUT_GENERAL: written as a storage image, read with texelFetch.
+class HiZBufferManager {
+public:
+    static constexpr uint32_t MaxLevels = 16;
+
+    VkFormat format = VK_FORMAT_R32_SFLOAT;
+
+    Helpers::AllocatedImage image;
+    uint32_t level_count = 0;
+    std::array<VkExtent2D, MaxLevels> level_extents{};
+
+    VkImageView view = VK_NULL_HANDLE; // all levels (culling pass)
+    std::array<VkImageView, MaxLevels> level_views{}; // one level each (pyramid build)
+
+    VkSampler sampler = VK_NULL_HANDLE; // nearest, clamped; also used to read the depth buffer
+
+    void create(RTG &rtg);
+    void on_swapchain(RTG &rtg, VkExtent2D const &depth_extent);
+    void destroy(RTG &rtg);
+
+    HiZBufferManager() = default;
+    ~HiZBufferManager();
+
+private:
+    void destroy_pyramid(RTG &rtg);
+};
@@ -86,7 +86,8 @@ TargetArray create_target_array(
     VkImageUsageFlags usage,
     VkImageAspectFlags aspect,
     VkRenderPass render_pass,
-    VkImageCreateFlags image_create_flags
+    VkImageCreateFlags image_create_flags,
+    VkRenderPass layered_render_pass
 ) {
     assert(layer_count > 0);
 
@@ -134,6 +135,12 @@ TargetArray create_target_array(
         }
     }
 
+    if (layered_render_pass != VK_NULL_HANDLE) {
+        // (multiview framebuffers have one layer; the views pick the attachment's layers)
+        std::vector<VkImageView> attachments{ target.array_view };
+        target.layered_framebuffer = create_framebuffer(rtg, layered_render_pass, extent, attachments);
+    }
+
     return target;
 }
 
@@ -143,7 +150,8 @@ TargetCube create_target_cube(
     VkFormat format,
     VkImageUsageFlags usage,
     VkImageAspectFlags aspect,
-    VkRenderPass render_pass
+    VkRenderPass render_pass,
+    VkRenderPass layered_render_pass
 ) {
     TargetCube target{};
 
@@ -186,6 +194,22 @@ TargetCube create_target_cube(
         }
     }
 
+    if (layered_render_pass != VK_NULL_HANDLE) {
+        // (multiview framebuffers have one layer; the views pick the attachment's layers)
+        target.layered_view = create_image_view(
+            rtg,
+            target.image.handle,
+            VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+            format,
+            aspect,
+            0,
+            6
+        );
+
+        std::vector<VkImageView> attachments{ target.layered_view };
+        target.layered_framebuffer = create_framebuffer(rtg, layered_render_pass, extent, attachments);
+    }
+
     return target;
 }
 
@@ -206,6 +230,11 @@ void destroy_target_2d(RTG &rtg, Target2D &target) {
 }
 
 void destroy_target_array(RTG &rtg, TargetArray &target) {
+    if (target.layered_framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(rtg.device, target.layered_framebuffer, nullptr);
+        target.layered_framebuffer = VK_NULL_HANDLE;
+    }
+
     for (VkFramebuffer &framebuffer : target.layer_framebuffers) {
         if (framebuffer != VK_NULL_HANDLE) {
             vkDestroyFramebuffer(rtg.device, framebuffer, nullptr);
@@ -233,6 +262,16 @@ void destroy_target_array(RTG &rtg, TargetArray &target) {
 }
 
 void destroy_target_cube(RTG &rtg, TargetCube &target) {
+    if (target.layered_framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(rtg.device, target.layered_framebuffer, nullptr);
+        target.layered_framebuffer = VK_NULL_HANDLE;
+    }
+
+    if (target.layered_view != VK_NULL_HANDLE) {
+        vkDestroyImageView(rtg.device, target.layered_view, nullptr);
+        target.layered_view = VK_NULL_HANDLE;
+    }
+
     for (VkFramebuffer &framebuffer : target.face_framebuffers) {
         if (framebuffer != VK_NULL_HANDLE) {
             vkDestroyFramebuffer(rtg.device, framebuffer, nullptr);
@@ -19,6 +19,7 @@ struct TargetArray {
     VkImageView array_view = VK_NULL_HANDLE;
     std::vector<VkImageView> layer_views;
     std::vector<VkFramebuffer> layer_framebuffers;
+    VkFramebuffer layered_framebuffer = VK_NULL_HANDLE; // all layers at once, on array_view (only with a layered render pass)
 };
 
 struct TargetCube {
@@ -26,6 +27,8 @@ struct TargetCube {
     VkImageView cube_view = VK_NULL_HANDLE;
     std::array<VkImageView, 6> face_views{};
     std::array<VkFramebuffer, 6> face_framebuffers{};
+    VkImageView layered_view = VK_NULL_HANDLE; // all six faces as layers (only with a layered render pass)
+    VkFramebuffer layered_framebuffer = VK_NULL_HANDLE;
 };
 
 Target2D create_target_2d(
@@ -38,6 +41,7 @@ Target2D create_target_2d(
     VkImageCreateFlags image_create_flags = 0
 );
 
+// (layered_render_pass, a multiview pass with one view per layer, also gets a framebuffer of every layer)
 TargetArray create_target_array(
     RTG &rtg,
     VkExtent2D const &extent,
@@ -46,16 +50,19 @@ TargetArray create_target_array(
     VkImageUsageFlags usage,
     VkImageAspectFlags aspect,
     VkRenderPass render_pass = VK_NULL_HANDLE,
-    VkImageCreateFlags image_create_flags = 0
+    VkImageCreateFlags image_create_flags = 0,
+    VkRenderPass layered_render_pass = VK_NULL_HANDLE
 );
 
+// (layered_render_pass, a multiview pass with one view per face, also gets a framebuffer of all six faces)
 TargetCube create_target_cube(
     RTG &rtg,
     VkExtent2D const &extent,
     VkFormat format,
     VkImageUsageFlags usage,
     VkImageAspectFlags aspect,
-    VkRenderPass render_pass = VK_NULL_HANDLE
+    VkRenderPass render_pass = VK_NULL_HANDLE,
+    VkRenderPass layered_render_pass = VK_NULL_HANDLE
 );
 
 void destroy_target_2d(RTG &rtg, Target2D &target);
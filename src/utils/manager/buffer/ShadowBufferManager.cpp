@@ -4,6 +4,12 @@
 
 #include <array>
 #include <iostream>
+#include <iterator>
+
+namespace {
+    // Side of the smallest spot light atlas tile (lights far away or out of view):
+    constexpr uint32_t AtlasMinTile = 64;
+}
 
 void ShadowBufferManager::create(
     RTG &rtg,
@@ -26,6 +32,13 @@ void ShadowBufferManager::create(
         .depthStencil{ .depth = rtg.configuration.reverse_z ? 0.0f : 1.0f, .stencil = 0 },
     };
 
+    // split shadow caching copies each view's static map into its shadow map before drawing moving casters on top:
+    const bool static_copies = (rtg.configuration.shadow_cache == ShadowCacheMode::SplitShadowCache);
+    const VkImageUsageFlags shadow_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+        | (static_copies ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0);
+    const VkImageUsageFlags static_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    cache.invalidate();
+
     VkSamplerCreateInfo sun_sampler_info{
         .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
         .magFilter = VK_FILTER_LINEAR,
@@ -67,11 +80,24 @@ void ShadowBufferManager::create(
             extent,
             SunCascadeCount,
             depth_format,
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            shadow_usage,
             VK_IMAGE_ASPECT_DEPTH_BIT,
-            render_pass_manager.shadow_render_pass
+            render_pass_manager.shadow_render_pass,
+            0,
+            render_pass_manager.shadow_cascade_render_pass
         );
         target.depth_target = std::move(array_target);
+        if (static_copies) {
+            target.static_depth_target = BufferRenderTarget::create_target_array(
+                rtg,
+                extent,
+                SunCascadeCount,
+                depth_format,
+                static_usage,
+                VK_IMAGE_ASPECT_DEPTH_BIT,
+                render_pass_manager.shadow_render_pass
+            );
+        }
 
         sun_shadow_targets.emplace_back(std::move(target));
     }
@@ -136,48 +162,86 @@ void ShadowBufferManager::create(
             rtg,
             extent,
             depth_format,
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            shadow_usage,
             VK_IMAGE_ASPECT_DEPTH_BIT,
-            render_pass_manager.shadow_render_pass
+            render_pass_manager.shadow_render_pass,
+            render_pass_manager.shadow_cube_render_pass
         );
         target.depth_target = std::move(cube_target);
+        if (static_copies) {
+            target.static_depth_target = BufferRenderTarget::create_target_cube(
+                rtg,
+                extent,
+                depth_format,
+                static_usage,
+                VK_IMAGE_ASPECT_DEPTH_BIT,
+                render_pass_manager.shadow_render_pass
+            );
+        }
 
         sphere_shadow_targets.emplace_back(std::move(target));
     }
 
     spot_shadow_targets.clear();
-    spot_shadow_targets.reserve(shadow_spot_lights.size());
-    for (const auto &light : shadow_spot_lights) {
-        uint32_t resolution = static_cast<uint32_t>(light.shadow);
-        if (resolution == 0) {
-            continue;
-        }
-
-        SpotShadowTarget target{};
-        target.resolution = resolution;
-
-        VkExtent2D extent{
-            .width = resolution,
-            .height = resolution,
-        };
-
-        auto spot_target = BufferRenderTarget::create_target_2d(
+    if (rtg.configuration.shadow_atlas != 0) {
+        // (one map of a fixed size, however many spot lights share it)
+        const uint32_t atlas_size = rtg.configuration.shadow_atlas;
+        spot_atlas_target = BufferRenderTarget::create_target_2d(
             rtg,
-            extent,
+            VkExtent2D{ .width = atlas_size, .height = atlas_size },
             depth_format,
             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
             VK_IMAGE_ASPECT_DEPTH_BIT,
-            render_pass_manager.shadow_render_pass
+            render_pass_manager.shadow_atlas_render_pass
         );
-        target.depth_target = std::move(spot_target);
-
-        spot_shadow_targets.emplace_back(std::move(target));
+        spot_atlas.configure(atlas_size, AtlasMinTile, rtg.configuration.shadow_atlas_budget);
+        atlas_prepared = false;
+        atlas_perspectives.assign(shadow_spot_lights.size(), glm::mat4(1.0f));
+    } else {
+        spot_shadow_targets.reserve(shadow_spot_lights.size());
+        for (const auto &light : shadow_spot_lights) {
+            uint32_t resolution = static_cast<uint32_t>(light.shadow);
+            if (resolution == 0) {
+                continue;
+            }
+
+            SpotShadowTarget target{};
+            target.resolution = resolution;
+
+            VkExtent2D extent{
+                .width = resolution,
+                .height = resolution,
+            };
+
+            auto spot_target = BufferRenderTarget::create_target_2d(
+                rtg,
+                extent,
+                depth_format,
+                shadow_usage,
+                VK_IMAGE_ASPECT_DEPTH_BIT,
+                render_pass_manager.shadow_render_pass
+            );
+            target.depth_target = std::move(spot_target);
+            if (static_copies) {
+                target.static_depth_target = BufferRenderTarget::create_target_2d(
+                    rtg,
+                    extent,
+                    depth_format,
+                    static_usage,
+                    VK_IMAGE_ASPECT_DEPTH_BIT,
+                    render_pass_manager.shadow_render_pass
+                );
+            }
+
+            spot_shadow_targets.emplace_back(std::move(target));
+        }
     }
 }
 
 void ShadowBufferManager::destroy(RTG &rtg) {
     for (SunShadowTarget &target : sun_shadow_targets) {
         BufferRenderTarget::destroy_target_array(rtg, target.depth_target);
+        BufferRenderTarget::destroy_target_array(rtg, target.static_depth_target);
     }
     sun_shadow_targets.clear();
 
@@ -188,8 +252,10 @@ void ShadowBufferManager::destroy(RTG &rtg) {
 
     for (SpotShadowTarget &target : spot_shadow_targets) {
         BufferRenderTarget::destroy_target_2d(rtg, target.depth_target);
+        BufferRenderTarget::destroy_target_2d(rtg, target.static_depth_target);
     }
     spot_shadow_targets.clear();
+    BufferRenderTarget::destroy_target_2d(rtg, spot_atlas_target);
 
     if (spot_shadow_sampler != VK_NULL_HANDLE) {
         vkDestroySampler(rtg.device, spot_shadow_sampler, nullptr);
@@ -198,6 +264,7 @@ void ShadowBufferManager::destroy(RTG &rtg) {
 
     for (SphereShadowTarget &target : sphere_shadow_targets) {
         BufferRenderTarget::destroy_target_cube(rtg, target.depth_target);
+        BufferRenderTarget::destroy_target_cube(rtg, target.static_depth_target);
     }
     sphere_shadow_targets.clear();
 
@@ -207,25 +274,243 @@ void ShadowBufferManager::destroy(RTG &rtg) {
     }
 }
 
-VkRect2D ShadowBufferManager::get_shadow_scissor(uint32_t shadow_resolution) {
+void ShadowBufferManager::update_cache(
+    RTG const &rtg,
+    LightsManager const &lights_manager,
+    LightsManager::ShadowCasters &sun_casters,
+    LightsManager::ShadowCasters &sphere_casters,
+    LightsManager::ShadowCasters &spot_casters,
+    std::vector<uint32_t> const &moved,
+    bool all_moved,
+    size_t item_count
+) {
+    const bool split = (rtg.configuration.shadow_cache == ShadowCacheMode::SplitShadowCache);
+    cache.begin_update(split, moved, all_moved, item_count);
+
+    // (views in the order of LightsManager::cull_shadow_casters)
+    view_matrices.clear();
+    for (LightsManager::SunLight const &sun : lights_manager.get_shadow_sun_lights()) {
+        view_matrices.insert(view_matrices.end(), std::begin(sun.orthographic), std::end(sun.orthographic));
+    }
+    cache.update_views(ShadowCache::Sun, view_matrices, sun_casters.instances, sun_casters.view_first);
+
+    view_matrices.clear();
+    for (LightsManager::SphereShadowMatrices const &matrices : lights_manager.get_shadow_sphere_matrices()) {
+        view_matrices.insert(view_matrices.end(), matrices.face_pv.begin(), matrices.face_pv.end());
+    }
+    cache.update_views(ShadowCache::Sphere, view_matrices, sphere_casters.instances, sphere_casters.view_first);
+
+    view_matrices.clear();
+    for (LightsManager::SpotLight const &spot : lights_manager.get_shadow_spot_lights()) {
+        view_matrices.emplace_back(spot.perspective);
+    }
+    cache.update_views(ShadowCache::Spot, view_matrices, spot_casters.instances, spot_casters.view_first);
+}
+
+void ShadowBufferManager::update_atlas(RTG const &rtg, LightsManager &lights_manager, CameraManager const &camera_manager) {
+    if (spot_atlas.size == 0) return;
+    std::vector<LightsManager::SpotLight> const &spots = lights_manager.get_shadow_spot_lights();
+    std::vector<ShadowCache::View> const &cache_views = cache.views[ShadowCache::Spot];
+    const bool cached = (rtg.configuration.shadow_cache != ShadowCacheMode::NoShadowCache && cache_views.size() == spots.size());
+
+    const CameraManager::Camera &camera = camera_manager.get_active_camera();
+    const CameraManager::Frustum frustum = camera_manager.get_frustum();
+
+    atlas_requests.resize(spots.size());
+    for (size_t i = 0; i < spots.size(); ++i) {
+        LightsManager::SpotLight const &spot = spots[i];
+
+        // a spot light reaches a sphere of radius 'limit'; out of view, it lights nothing visible
+        const glm::vec3 reach(spot.limit);
+        ShadowAtlas::Request request{ .resolution = 0, .importance = 0.0f, .dirty = true };
+        if (frustum.is_box_visible(spot.position - reach, spot.position + reach)) {
+            request = ShadowAtlas::coverage_request(glm::length(spot.position - camera.camera_position), spot.limit, camera.camera_fov,
+                float(rtg.swapchain_extent.width), float(rtg.swapchain_extent.height), uint32_t(spot.shadow));
+        }
+        request.dirty = (cached ? cache_views[i].draw : true);
+        atlas_requests[i] = request;
+    }
+    spot_atlas.update(atlas_requests);
+
+    // lights keep the projection their tile was drawn with until it is next drawn:
+    atlas_perspectives.resize(spots.size(), glm::mat4(1.0f));
+    const float atlas_size = float(spot_atlas.size);
+    for (uint32_t i = 0; i < uint32_t(spots.size()); ++i) {
+        ShadowAtlas::Light const &light = spot_atlas.lights[i];
+        if (light.draw) atlas_perspectives[i] = spots[i].perspective;
+        const glm::vec4 rect = (light.valid
+            ? glm::vec4(float(light.tile.x), float(light.tile.y), float(light.tile.size), float(light.tile.size)) / atlas_size
+            : glm::vec4(0.0f));
+        lights_manager.set_shadow_spot_atlas_tile(i, atlas_perspectives[i], rect, int32_t(light.tile.size));
+    }
+}
+
+void ShadowBufferManager::prepare_atlas(VkCommandBuffer command_buffer) {
+    if (atlas_prepared || spot_atlas_target.image.handle == VK_NULL_HANDLE) return;
+    atlas_prepared = true;
+
+    // (shadow_atlas_render_pass expects the layout it leaves the atlas in; tiles are only sampled once drawn)
+    const VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = spot_atlas_target.image.handle,
+        .subresourceRange{
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+}
+
+bool ShadowBufferManager::draws_view(RTG const &rtg, ShadowCache::Kind kind, uint32_t view) const {
+    if (kind == ShadowCache::Spot && spot_atlas.size != 0) {
+        return view < spot_atlas.lights.size() && spot_atlas.lights[view].draw;
+    }
+    if (rtg.configuration.shadow_cache == ShadowCacheMode::NoShadowCache) return true;
+    return cache.views[kind][view].draw;
+}
+
+bool ShadowBufferManager::draws_layers(RTG const &rtg, ShadowCache::Kind kind, uint32_t first_view, uint32_t count) const {
+    for (uint32_t view = first_view; view < first_view + count; ++view) {
+        if (draws_view(rtg, kind, view)) return true;
+    }
+    return false;
+}
+
+VkImageView ShadowBufferManager::spot_shadow_view(uint32_t light) const {
+    if (spot_atlas_target.view != VK_NULL_HANDLE) return spot_atlas_target.view;
+    if (spot_shadow_targets.empty()) return VK_NULL_HANDLE;
+    return spot_shadow_targets[light % spot_shadow_targets.size()].depth_target.view;
+}
+
+void ShadowBufferManager::copy_static_layer(
+    VkCommandBuffer command_buffer,
+    VkImage static_image,
+    VkImage image,
+    uint32_t layer,
+    uint32_t resolution
+) {
+    const VkImageSubresourceRange range{
+        .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = layer,
+        .layerCount = 1,
+    };
+
+    // (the static map may have just been drawn; the shadow map's old contents are replaced)
+    std::array<VkImageMemoryBarrier, 2> barriers{
+        VkImageMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = static_image,
+            .subresourceRange = range,
+        },
+        VkImageMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = range,
+        },
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        uint32_t(barriers.size()), barriers.data()
+    );
+
+    const VkImageSubresourceLayers layers{
+        .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .mipLevel = 0,
+        .baseArrayLayer = layer,
+        .layerCount = 1,
+    };
+    const VkImageCopy region{
+        .srcSubresource = layers,
+        .srcOffset = {.x = 0, .y = 0, .z = 0},
+        .dstSubresource = layers,
+        .dstOffset = {.x = 0, .y = 0, .z = 0},
+        .extent = {.width = resolution, .height = resolution, .depth = 1},
+    };
+    vkCmdCopyImage(
+        command_buffer,
+        static_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region
+    );
+
+    // back to the layout shadow_render_pass leaves it in, with its next redraw waiting for the copy:
+    const VkImageMemoryBarrier static_barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = 0,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = static_image,
+        .subresourceRange = range,
+    };
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &static_barrier
+    );
+}
+
+VkRect2D ShadowBufferManager::get_shadow_scissor(uint32_t shadow_resolution, VkOffset2D offset) {
     if (shadow_resolution == 0) {
         shadow_resolution = 1;
     }
 
     return VkRect2D{
-        .offset = {.x = 0, .y = 0},
+        .offset = offset,
         .extent = VkExtent2D{shadow_resolution, shadow_resolution},
     };
 }
 
-VkViewport ShadowBufferManager::get_shadow_viewport(uint32_t shadow_resolution) {
+VkViewport ShadowBufferManager::get_shadow_viewport(uint32_t shadow_resolution, VkOffset2D offset) {
     if (shadow_resolution == 0) {
         shadow_resolution = 1;
     }
 
     return VkViewport{
-        .x = 0.0f,
-        .y = 0.0f,
+        .x = static_cast<float>(offset.x),
+        .y = static_cast<float>(offset.y),
         .width = static_cast<float>(shadow_resolution),
         .height = static_cast<float>(shadow_resolution),
         .minDepth = 0.0f,
@@ -259,6 +544,10 @@ ShadowBufferManager::~ShadowBufferManager() {
         }
     }
 
+    if (spot_atlas_target.image.handle != VK_NULL_HANDLE) {
+        std::cerr << "ShadowBufferManager: spot shadow atlas not destroyed" << std::endl;
+    }
+
     if (spot_shadow_sampler != VK_NULL_HANDLE) {
         std::cerr << "ShadowBufferManager: spot_shadow_sampler not destroyed" << std::endl;
     }
@@ -5,6 +5,8 @@
 #include "RenderPassManager.hpp"
 #include "LightsManager.hpp"
 #include "RenderTarget.hpp"
+#include "ShadowCache.hpp"
+#include "ShadowAtlas.hpp"
 
 #include <array>
 #include <vector>
@@ -17,32 +19,85 @@ public:
     VkFormat depth_format = VK_FORMAT_UNDEFINED;
     VkClearValue shadow_clear_value{};
 
+    // (static_depth_target holds the static casters of each view, and is only created for split shadow caching)
     struct SunShadowTarget {
         uint32_t resolution = 0;
         BufferRenderTarget::TargetArray depth_target;
+        BufferRenderTarget::TargetArray static_depth_target;
     };
 
     struct SpotShadowTarget {
         uint32_t resolution = 0;
         BufferRenderTarget::Target2D depth_target;
+        BufferRenderTarget::Target2D static_depth_target;
     };
 
     struct SphereShadowTarget {
         uint32_t resolution = 0;
         BufferRenderTarget::TargetCube depth_target;
+        BufferRenderTarget::TargetCube static_depth_target;
     };
 
     std::vector<SunShadowTarget> sun_shadow_targets;
     VkSampler sun_shadow_sampler = VK_NULL_HANDLE;
 
-    std::vector<SpotShadowTarget> spot_shadow_targets;
+    std::vector<SpotShadowTarget> spot_shadow_targets; // (none with --shadow-atlas)
     VkSampler spot_shadow_sampler = VK_NULL_HANDLE;
 
+    // With --shadow-atlas, every spot light's map is a tile of one atlas image (drawn with shadow_atlas_render_pass)
+    BufferRenderTarget::Target2D spot_atlas_target;
+    ShadowAtlas spot_atlas;
+
     std::vector<SphereShadowTarget> sphere_shadow_targets;
     VkSampler sphere_shadow_sampler = VK_NULL_HANDLE;
 
-    static VkRect2D get_shadow_scissor(uint32_t shadow_resolution);
-    static VkViewport get_shadow_viewport(uint32_t shadow_resolution);
+    // Which shadow views to draw this frame (--shadow-cache); the maps are re-created invalid
+    ShadowCache cache;
+
+    // Decide which views to draw from the lights' current projections and the casters just culled for them;
+    // 'moved' lists the items (of the BVH the casters came from) whose transforms changed, 'all_moved' means any may have.
+    // With split caching each view's casters are reordered, static first (see ShadowCache::View::dynamic_first)
+    void update_cache(
+        RTG const &rtg,
+        LightsManager const &lights_manager,
+        LightsManager::ShadowCasters &sun_casters,
+        LightsManager::ShadowCasters &sphere_casters,
+        LightsManager::ShadowCasters &spot_casters,
+        std::vector<uint32_t> const &moved,
+        bool all_moved,
+        size_t item_count
+    );
+
+    // Size each spot light's atlas tile by its projected screen coverage (up to the light's own shadow size) and pick the
+    // tiles to draw this frame; with --shadow-cache, only lights whose view the cache would draw need drawing (so call
+    // this after update_cache). Each shadow spot light's bytes in 'lights_manager' are pointed at its tile, and at the
+    // projection the tile was drawn with
+    void update_atlas(RTG const &rtg, LightsManager &lights_manager, CameraManager const &camera_manager);
+
+    // Record the atlas' first layout transition (before any tile is drawn; does nothing after the first call)
+    void prepare_atlas(VkCommandBuffer command_buffer);
+
+    // Whether a view's map is drawn this frame: not if --shadow-cache kept it, or (spot lights) the atlas left it for later
+    bool draws_view(RTG const &rtg, ShadowCache::Kind kind, uint32_t view) const;
+
+    // Whether any of 'count' views from 'first_view' is drawn this frame (a layered map is redrawn whole, see --layered-shadows)
+    bool draws_layers(RTG const &rtg, ShadowCache::Kind kind, uint32_t first_view, uint32_t count) const;
+
+    // Image view spot light 'light' samples its map from (VK_NULL_HANDLE if there are no spot maps)
+    VkImageView spot_shadow_view(uint32_t light) const;
+
+    // Copy one layer of a static map into the same layer of its shadow map (outside any render pass),
+    // leaving the shadow map's layer in TRANSFER_DST_OPTIMAL for shadow_load_render_pass
+    static void copy_static_layer(
+        VkCommandBuffer command_buffer,
+        VkImage static_image,
+        VkImage image,
+        uint32_t layer,
+        uint32_t resolution
+    );
+
+    static VkRect2D get_shadow_scissor(uint32_t shadow_resolution, VkOffset2D offset = {.x = 0, .y = 0});
+    static VkViewport get_shadow_viewport(uint32_t shadow_resolution, VkOffset2D offset = {.x = 0, .y = 0});
 
     void create(
         RTG &rtg,
@@ -56,4 +111,11 @@ public:
 
     ShadowBufferManager() = default;
     ~ShadowBufferManager();
+
+private:
+    std::vector<glm::mat4> view_matrices; // (scratch) clip_from_world of each view of one kind
+
+    bool atlas_prepared = false;
+    std::vector<ShadowAtlas::Request> atlas_requests; // (scratch)
+    std::vector<glm::mat4> atlas_perspectives; // per spot light: the projection its tile was drawn with
 };
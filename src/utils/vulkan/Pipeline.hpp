@@ -47,12 +47,18 @@ struct Pipeline
     virtual void destroy(RTG &) = 0;
     
 	void create_pipeline(RTG& rtg, VkRenderPass render_pass, uint32_t subpass, bool enable_depth = true, bool enable_cull = true, bool lines_draw = false, uint32_t color_attachment_count = 1, bool enable_fragment_stage = true, bool enable_vertex_attributes = true) {
+		pipeline = build_pipeline(rtg, vert_module, render_pass, subpass, enable_depth, enable_cull, lines_draw, color_attachment_count, enable_fragment_stage, enable_vertex_attributes);
+	}
+
+	//builds a pipeline on 'layout' and frag_module with 'vert' as its vertex stage and returns it, leaving 'pipeline' alone
+	//(for variants such as the multiview shadow pipelines; the caller destroys the result):
+	VkPipeline build_pipeline(RTG& rtg, VkShaderModule vert, VkRenderPass render_pass, uint32_t subpass, bool enable_depth = true, bool enable_cull = true, bool lines_draw = false, uint32_t color_attachment_count = 1, bool enable_fragment_stage = true, bool enable_vertex_attributes = true) {
         //shader code for vertex and fragment pipeline stages:
 		std::vector< VkPipelineShaderStageCreateInfo > stages;
 		stages.emplace_back(VkPipelineShaderStageCreateInfo{
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 			.stage = VK_SHADER_STAGE_VERTEX_BIT,
-			.module = vert_module,
+			.module = vert,
 			.pName = "main"
 		});
 
@@ -163,6 +169,8 @@ struct Pipeline
 			.subpass = subpass,
 		};
 
-		VK( vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline) );
+		VkPipeline built = VK_NULL_HANDLE;
+		VK( vkCreateGraphicsPipelines(rtg.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &built) );
+		return built;
     }
 };
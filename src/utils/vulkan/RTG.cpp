@@ -89,10 +89,94 @@ void RTG::Configuration::parse(int argc, char **argv) {
 		else if (arg == "--reverse-z") {
 			reverse_z = true;
 		}
+		else if (arg == "--gpu-culling") {
+			gpu_culling = true;
+		}
+		else if (arg == "--occlusion-culling") {
+			if (argi + 1 >= argc) throw std::runtime_error("--occlusion-culling requires a parameter (a mode).");
+			argi += 1;
+			std::string mode_str = argv[argi];
+			if (mode_str == "last-frame") {
+				occlusion_culling = OcclusionCullingMode::LastFrame;
+			} else if (mode_str == "two-phase") {
+				occlusion_culling = OcclusionCullingMode::TwoPhase;
+			} else {
+				throw std::runtime_error("--occlusion-culling mode should be 'last-frame' or 'two-phase', got '" + mode_str + "'.");
+			}
+			gpu_culling = true;
+		}
+		else if (arg == "--software-occlusion") {
+			if (argi + 1 >= argc) throw std::runtime_error("--software-occlusion requires a parameter (an occluder count).");
+			argi += 1;
+			software_occlusion = std::stoul(argv[argi]);
+		}
+		else if (arg == "--software-occlusion-dump") {
+			if (argi + 1 >= argc) throw std::runtime_error("--software-occlusion-dump requires a parameter (a filename).");
+			argi += 1;
+			software_occlusion_dump = argv[argi];
+		}
+		else if (arg == "--visibility-cache") {
+			if (argi + 2 >= argc) throw std::runtime_error("--visibility-cache requires two parameters (a distance and an angle in degrees).");
+			visibility_cache = true;
+			visibility_cache_distance = std::stof(argv[argi + 1]);
+			visibility_cache_degrees = std::stof(argv[argi + 2]);
+			argi += 2;
+		}
+		else if (arg == "--shadow-cache") {
+			if (argi + 1 >= argc) throw std::runtime_error("--shadow-cache requires a parameter (a mode).");
+			argi += 1;
+			std::string mode_str = argv[argi];
+			if (mode_str == "static") {
+				shadow_cache = ShadowCacheMode::StaticShadowCache;
+			} else if (mode_str == "split") {
+				shadow_cache = ShadowCacheMode::SplitShadowCache;
+			} else {
+				throw std::runtime_error("--shadow-cache mode should be 'static' or 'split', got '" + mode_str + "'.");
+			}
+		}
+		else if (arg == "--shadow-atlas") {
+			if (argi + 2 >= argc) throw std::runtime_error("--shadow-atlas requires two parameters (a size and a tile count per frame).");
+			shadow_atlas = std::stoul(argv[argi + 1]);
+			shadow_atlas_budget = std::stoul(argv[argi + 2]);
+			argi += 2;
+			if (shadow_atlas < 256 || (shadow_atlas & (shadow_atlas - 1)) != 0) {
+				throw std::runtime_error("--shadow-atlas size should be a power of two, at least 256.");
+			}
+		}
+		else if (arg == "--layered-shadows") {
+			layered_shadows = true;
+		}
+		else if (arg == "--threads") {
+			if (argi + 1 >= argc) throw std::runtime_error("--threads requires a parameter (a thread count).");
+			argi += 1;
+			threads = std::stoul(argv[argi]);
+		}
 		else {
 			throw std::runtime_error("Unrecognized argument '" + arg + "'.");
 		}
 	}
+
+	if (software_occlusion > 0 && gpu_culling) {
+		throw std::runtime_error("--software-occlusion culls on the CPU path; it can't be combined with --gpu-culling or --occlusion-culling.");
+	}
+	if (visibility_cache && gpu_culling) {
+		throw std::runtime_error("--visibility-cache caches CPU culling results; it can't be combined with --gpu-culling or --occlusion-culling.");
+	}
+	if (shadow_cache != ShadowCacheMode::NoShadowCache && gpu_culling) {
+		throw std::runtime_error("--shadow-cache tracks CPU-culled shadow casters; it can't be combined with --gpu-culling or --occlusion-culling.");
+	}
+	if (shadow_atlas != 0 && shadow_cache == ShadowCacheMode::SplitShadowCache) {
+		throw std::runtime_error("--shadow-atlas draws each spot light into one tile of a shared map; it can't be combined with '--shadow-cache split'.");
+	}
+	if (layered_shadows && gpu_culling) {
+		throw std::runtime_error("--layered-shadows draws from CPU-culled casters' face and cascade masks; it can't be combined with --gpu-culling or --occlusion-culling.");
+	}
+	if (layered_shadows && shadow_cache == ShadowCacheMode::SplitShadowCache) {
+		throw std::runtime_error("--layered-shadows redraws a light's faces (or cascades) together; it can't be combined with '--shadow-cache split'.");
+	}
+	if (!software_occlusion_dump.empty() && software_occlusion == 0) {
+		throw std::runtime_error("--software-occlusion-dump needs --software-occlusion.");
+	}
 }
 
 void RTG::Configuration::usage(std::function< void(const char *, const char *) > const &callback) {
@@ -106,6 +190,15 @@ void RTG::Configuration::usage(std::function< void(const char *, const char *) >
 	callback("--exposure <float>", "Set the background exposure (A2).");
 	callback("--tone-map <method>", "Set the tone mapping method (A2). Method should be 'linear' or 'aces'.");
 	callback("--reverse-z", "Use reversed Z (A3).");
+	callback("--gpu-culling", "Cull instances and build draw commands on the GPU (A3, Deferred).");
+	callback("--occlusion-culling <mode>", "Also cull instances hidden in a depth pyramid (implies --gpu-culling). Mode should be 'last-frame' or 'two-phase'.");
+	callback("--software-occlusion <n>", "Rasterize the n largest visible instances on the CPU and cull instances hidden behind them (A3, Deferred; CPU culling path).");
+	callback("--software-occlusion-dump <file>", "Write the software occlusion depth buffer to a PGM image every update (meant for --headless runs).");
+	callback("--visibility-cache <d> <deg>", "Reuse CPU frustum culling results while the camera stays within d units and deg degrees of where they were computed, retesting only instances near the frustum edges (A3, Deferred).");
+	callback("--shadow-cache <mode>", "Only redraw shadow maps whose light or casters changed (A3, Deferred; CPU culling path). Mode should be 'static' (keep each map until then) or 'split' (also keep a map of the static casters, and redraw only moving casters over a copy of it).");
+	callback("--shadow-atlas <size> <n>", "Draw shadowed spot lights into tiles of one size x size depth atlas (A3, Deferred), sized by each light's screen coverage, redrawing at most n tiles per frame (0 for no limit), most important and longest waiting first.");
+	callback("--layered-shadows", "Draw all six faces of each shadowed sphere light's cube map, and all cascades of each sun's map, in one multiview pass per light, each caster reaching only the faces or cascades it touches (A3, Deferred; CPU culling path).");
+	callback("--threads <n>", "Use n threads for per-frame scene updates and command recording (default: one per core; 1 runs them all on the main thread).");
 }
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
@@ -128,7 +221,7 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
 	return VK_FALSE;
 }
 
-RTG::RTG(Configuration const &configuration_) : helpers(*this) {
+RTG::RTG(Configuration const &configuration_) : helpers(*this), jobs(configuration_.threads) {
 
 	//copy input configuration:
 	configuration = configuration_;
@@ -437,22 +530,24 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this) {
 				});
 			}
 
-			VkPhysicalDeviceDescriptorIndexingFeatures indexing_features{
-				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
-				.pNext = nullptr,
-				.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
-				.descriptorBindingVariableDescriptorCount = VK_TRUE,
-				.runtimeDescriptorArray = VK_TRUE,
-			};
-
 			VkPhysicalDeviceVulkan13Features supported_vulkan13_features{
 				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
 				.pNext = nullptr,
 			};
 
+			VkPhysicalDeviceVulkan12Features supported_vulkan12_features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+				.pNext = &supported_vulkan13_features,
+			};
+
+			VkPhysicalDeviceVulkan11Features supported_vulkan11_features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+				.pNext = &supported_vulkan12_features,
+			};
+
 			VkPhysicalDeviceFeatures2 supported_features2{
 				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-				.pNext = &supported_vulkan13_features,
+				.pNext = &supported_vulkan11_features,
 			};
 			vkGetPhysicalDeviceFeatures2(physical_device, &supported_features2);
 
@@ -460,20 +555,63 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this) {
 				throw std::runtime_error("Physical device does not support shaderDemoteToHelperInvocation, but the compiled shaders require it.");
 			}
 
+			//indirect draws select their instance with firstInstance; many of them per call need multiDrawIndirect:
+			const bool multi_draw_indirect = supported_features2.features.multiDrawIndirect == VK_TRUE;
+			const bool draw_indirect_first_instance = supported_features2.features.drawIndirectFirstInstance == VK_TRUE;
+			if (draw_indirect_first_instance) {
+				VkPhysicalDeviceProperties properties;
+				vkGetPhysicalDeviceProperties(physical_device, &properties);
+				max_draw_indirect_count = (multi_draw_indirect ? properties.limits.maxDrawIndirectCount : 1);
+			}
+
+			//GPU culling writes its own draw commands (firstInstance selects the instance) and draw counts:
+			if (configuration.gpu_culling && (
+				supported_vulkan12_features.drawIndirectCount != VK_TRUE
+				|| supported_features2.features.multiDrawIndirect != VK_TRUE
+				|| supported_features2.features.drawIndirectFirstInstance != VK_TRUE
+				|| supported_vulkan12_features.descriptorBindingPartiallyBound != VK_TRUE
+			)) {
+				throw std::runtime_error("Physical device does not support drawIndirectCount, multiDrawIndirect, drawIndirectFirstInstance and descriptorBindingPartiallyBound, which --gpu-culling requires.");
+			}
+
+			//layered shadow maps draw every face (or cascade) of a light in one pass, one view per layer:
+			if (configuration.layered_shadows && supported_vulkan11_features.multiview != VK_TRUE) {
+				throw std::runtime_error("Physical device does not support multiview, which --layered-shadows requires.");
+			}
+
 			VkPhysicalDeviceVulkan13Features vulkan13_features{
 				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
-				.pNext = &indexing_features,
+				.pNext = nullptr,
 				.shaderDemoteToHelperInvocation = VK_TRUE,
 			};
 
+			//(descriptor indexing features live here, since the 1.2 feature struct can't be chained with VkPhysicalDeviceDescriptorIndexingFeatures)
+			VkPhysicalDeviceVulkan12Features vulkan12_features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+				.pNext = &vulkan13_features,
+				.drawIndirectCount = configuration.gpu_culling ? VK_TRUE : VK_FALSE,
+				.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+				.descriptorBindingPartiallyBound = configuration.gpu_culling ? VK_TRUE : VK_FALSE, //(the culling pass's depth pyramid is only written with --occlusion-culling)
+				.descriptorBindingVariableDescriptorCount = VK_TRUE,
+				.runtimeDescriptorArray = VK_TRUE,
+			};
+
+			VkPhysicalDeviceVulkan11Features vulkan11_features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+				.pNext = &vulkan12_features,
+				.multiview = configuration.layered_shadows ? VK_TRUE : VK_FALSE,
+			};
+
 			VkPhysicalDeviceFeatures device_features{
+				.multiDrawIndirect = multi_draw_indirect ? VK_TRUE : VK_FALSE,
+				.drawIndirectFirstInstance = draw_indirect_first_instance ? VK_TRUE : VK_FALSE,
 				.fillModeNonSolid = VK_TRUE,
 				.pipelineStatisticsQuery = VK_TRUE,
 			};
 
 			VkPhysicalDeviceFeatures2 device_features2{
 				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-				.pNext = &vulkan13_features,
+				.pNext = &vulkan11_features,
 				.features = device_features,
 			};
 
@@ -2,6 +2,7 @@
 
 #include "Helpers.hpp"
 #include "InputEvent.hpp"
+#include "JobSystem.hpp"
 #include "sejp.hpp"
 #include "Timer.hpp"
 #include "VK.hpp"
@@ -85,6 +86,47 @@ struct RTG {
 		// A3 Parameters
 		bool reverse_z = false;
 
+		//if true, A3 and Deferred cull instances in a compute pass and draw with vkCmdDrawIndirectCount:
+		// `--gpu-culling` command-line flag
+		bool gpu_culling = false;
+
+		//if set, GPU culling also rejects instances hidden behind the depth pyramid of the main view (implies gpu_culling):
+		// `--occlusion-culling <mode>` command-line flag, mode 'last-frame' or 'two-phase'
+		OcclusionCullingMode occlusion_culling = OcclusionCullingMode::Disabled;
+
+		//if nonzero, CPU culling also rejects instances hidden behind this many occluders rasterized on the CPU
+		// (the largest visible instances): `--software-occlusion <n>` command-line flag
+		uint32_t software_occlusion = 0;
+
+		//if set, the software occlusion depth buffer is written here (as a PGM) every update:
+		// `--software-occlusion-dump <file>` command-line flag
+		std::string software_occlusion_dump = "";
+
+		//if true, CPU frustum culling is reused while the camera stays within a distance and angle (in degrees) of the
+		// camera it was computed for, and only instances near the frustum boundary or that moved are retested:
+		// `--visibility-cache <distance> <degrees>` command-line flag
+		bool visibility_cache = false;
+		float visibility_cache_distance = 0.5f;
+		float visibility_cache_degrees = 2.0f;
+
+		//if set, shadow maps are only redrawn when their light's projection or one of their casters changes (CPU culling path):
+		// `--shadow-cache <mode>` command-line flag, mode 'static' or 'split'
+		ShadowCacheMode shadow_cache = ShadowCacheMode::NoShadowCache;
+
+		//if nonzero, shadowed spot lights share one depth atlas this many texels wide, with tiles sized by each light's
+		// screen coverage, and at most shadow_atlas_budget tiles (0 for no limit) drawn per frame:
+		// `--shadow-atlas <size> <tiles-per-frame>` command-line flag
+		uint32_t shadow_atlas = 0;
+		uint32_t shadow_atlas_budget = 0;
+
+		//if true, each shadowed sphere light's six cube faces (and each sun's cascades) are drawn in one multiview pass, each
+		// caster reaching only the faces (cascades) it was culled into (CPU culling path): `--layered-shadows` command-line flag
+		bool layered_shadows = false;
+
+		//threads for per-frame CPU work (scene update, culling, command recording), counting the main thread; 0 means one per core:
+		// `--threads <n>` command-line flag
+		uint32_t threads = 0;
+
 		//requested (priority-ranked) formats for output surface: (will use first available)
 		std::vector< VkSurfaceFormatKHR > surface_formats{
 			VkSurfaceFormatKHR{ .format = VK_FORMAT_B8G8R8A8_SRGB, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
@@ -115,6 +157,11 @@ struct RTG {
 	// see Helpers.hpp
 	Helpers helpers;
 
+	//------------------------------------------------
+	//Thread pool for per-frame CPU work (see JobSystem.hpp):
+	// sized by configuration.threads
+	JobSystem jobs;
+
 	//------------------------------------------------
 	//Basic vulkan handles:
 
@@ -123,6 +170,10 @@ struct RTG {
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 	VkDevice device = VK_NULL_HANDLE;
 
+	//draw commands one vkCmdDrawIndirect may submit (maxDrawIndirectCount, or 1 without multiDrawIndirect);
+	//  0 if indirect draws can't set firstInstance (no drawIndirectFirstInstance):
+	uint32_t max_draw_indirect_count = 0;
+
 	//queue for graphics and transfer operations:
 	std::optional< uint32_t > graphics_queue_family;
 	VkQueue graphics_queue = VK_NULL_HANDLE;